@@ -24,10 +24,13 @@ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 
 
 #include "backprop.h"
+#include "backprop_simd.h"
 
 #include <math.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -42,6 +45,51 @@ WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
 #define BACKPROP_MIN_GOLD    (0.3819660113)
 
 
+// Number of input rows evaluated together by block activation.
+#define BACKPROP_BLOCK_ROWS_COUNT    (16)
+
+// Number of layer inputs (weight matrix columns) per cache block in block activation.
+#define BACKPROP_BLOCK_X_COUNT    (256)
+
+// Number of mini-batch pairs in each shard of data parallel training.
+// Fixed, so the order of the gradient sums does not depend on the number of threads.
+#define BACKPROP_SHARD_ROWS_COUNT    (16)
+
+
+// Alignment of weight matrices in memory blocks.
+#define BACKPROP_CACHE_LINE_SIZE    (64)
+
+// Round _size_ up to a multiple of BACKPROP_CACHE_LINE_SIZE.
+#define BACKPROP_CACHE_LINE_ALIGN(_size_)    ((((_size_) + BACKPROP_CACHE_LINE_SIZE - 1) / BACKPROP_CACHE_LINE_SIZE) * BACKPROP_CACHE_LINE_SIZE)
+
+// Round pointer _ptr_ up to the next BACKPROP_CACHE_LINE_SIZE boundary.
+#define BACKPROP_CACHE_LINE_ALIGN_PTR(_ptr_)    ((void*) BACKPROP_CACHE_LINE_ALIGN((uintptr_t) (_ptr_)))
+
+// Number of weights in a weight matrix row of _x_count_ inputs, padded to a whole number of cache lines.
+#define BACKPROP_W_STRIDE(_x_count_)    (BACKPROP_CACHE_LINE_ALIGN((_x_count_) * sizeof(BACKPROP_FLOAT_T)) / sizeof(BACKPROP_FLOAT_T))
+
+
+// Number of random numbers generated at a time into stack buffers by bulk consumers.
+#define BACKPROP_RANDOM_CHUNK_COUNT    (256)
+
+// Seed of each new PRNG until it is seeded, the same default as srand().
+#define BACKPROP_RANDOM_DEFAULT_SEED    (1)
+
+
+// Standard deviations of a sampled training set error covered by its confidence interval, about 99.7%.
+#define BACKPROP_EXERCISE_SAMPLE_Z    (3.0)
+
+
+// Sigmoid table covers [-BACKPROP_SIGMOID_TABLE_LIMIT, BACKPROP_SIGMOID_TABLE_LIMIT].
+#define BACKPROP_SIGMOID_TABLE_LIMIT    (16)
+
+// Number of sigmoid table entries per unit of input.
+#define BACKPROP_SIGMOID_TABLE_SCALE    (64)
+
+// Number of sigmoid table entries, plus one so the last entry can be interpolated.
+#define BACKPROP_SIGMOID_TABLE_COUNT    (2 * BACKPROP_SIGMOID_TABLE_LIMIT * BACKPROP_SIGMOID_TABLE_SCALE + 2)
+
+
 //#define USE_BACKPROP_TRACE
 
 #ifdef USE_BACKPROP_TRACE
@@ -86,6 +134,15 @@ typedef struct Backprop
   size_t malloc_total;
   size_t free_total;
 
+  bool sigmoid_table_ready;
+  BACKPROP_FLOAT_T sigmoid_table[BACKPROP_SIGMOID_TABLE_COUNT];
+
+  uint64_t weights_version;  ///< Last version given to modified layer weights.
+  uint64_t clones_count;     ///< Number of networks cloned, each clone splits its PRNG with the next number.
+
+  bool random_ready;         ///< True once random has been seeded.
+  BackpropRandom_t random;   ///< Module PRNG, for callers without a PRNG of their own.
+
 } Backprop_t;
 
 
@@ -124,11 +181,315 @@ BACKPROP_FLOAT_T Backprop_Sigmoid(BACKPROP_FLOAT_T x)
 
 
 
+/** Guards the one time build of the sigmoid table.
+ */
+static pthread_once_t Backprop_SigmoidTableOnce = PTHREAD_ONCE_INIT;
+
+
+
+
+static void Backprop_BuildSigmoidTable(void)
+{
+  BACKPROP_TRACE();
+
+  for (size_t i = 0; i < BACKPROP_SIGMOID_TABLE_COUNT - 1; ++i)
+  {
+    const BACKPROP_FLOAT_T x = -BACKPROP_SIGMOID_TABLE_LIMIT + ((BACKPROP_FLOAT_T) i) / BACKPROP_SIGMOID_TABLE_SCALE;
+    Backprop.sigmoid_table[i] = Backprop_Sigmoid(x);
+  }
+
+  Backprop.sigmoid_table[BACKPROP_SIGMOID_TABLE_COUNT - 1] = Backprop.sigmoid_table[BACKPROP_SIGMOID_TABLE_COUNT - 2];
+
+  Backprop.sigmoid_table_ready = true;
+}
+
+
+
+
+/** Build the sigmoid table if it is not built yet.
+ *  Safe to call from any thread, every process builds its own table on first use.
+ */
+static void Backprop_InitSigmoidTable(void)
+{
+  BACKPROP_TRACE();
+
+  pthread_once(&Backprop_SigmoidTableOnce, Backprop_BuildSigmoidTable);
+}
+
+
+
+
+/** Approximate sigmoid by linear interpolation of a table.
+ *  Backprop_InitSigmoidTable() must have been called.
+ */
+static inline BACKPROP_FLOAT_T Backprop_SigmoidTableInline(BACKPROP_FLOAT_T x)
+{
+  const BACKPROP_FLOAT_T t = (x > BACKPROP_SIGMOID_TABLE_LIMIT) ? BACKPROP_SIGMOID_TABLE_LIMIT
+                           : (x < -BACKPROP_SIGMOID_TABLE_LIMIT) ? -BACKPROP_SIGMOID_TABLE_LIMIT
+                           : x;
+
+  const BACKPROP_FLOAT_T u = (t + BACKPROP_SIGMOID_TABLE_LIMIT) * BACKPROP_SIGMOID_TABLE_SCALE;
+  const size_t i = (size_t) u;
+  const BACKPROP_FLOAT_T f = u - i;
+
+  const BACKPROP_FLOAT_T* T = Backprop.sigmoid_table + i;
+
+  return T[0] + f * (T[1] - T[0]);
+}
+
+
+
+
+BACKPROP_FLOAT_T Backprop_SigmoidTable(BACKPROP_FLOAT_T x)
+{
+  BACKPROP_TRACE();
+
+  Backprop_InitSigmoidTable();
+
+  return Backprop_SigmoidTableInline(x);
+}
+
+
+
+
+/** Replace each of count weighted sums in x with its sigmoid, using mode.
+ */
+static void Backprop_SigmoidArray(BackpropSigmoid_t mode, BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T count)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(x);
+
+  switch (mode)
+  {
+    case BACKPROP_SIGMOID_FAST:
+      Backprop_GetKernels()->SigmoidFast(x, count);
+      break;
+
+    case BACKPROP_SIGMOID_TABLE:
+      // models mapped from another process come here without BackpropNetwork_SetSigmoid()
+      Backprop_InitSigmoidTable();
+      BACKPROP_ASSERT(Backprop.sigmoid_table_ready);
+      for (BACKPROP_SIZE_T i = 0; i < count; ++i)
+      {
+        x[i] = Backprop_SigmoidTableInline(x[i]);
+      }
+      break;
+
+    case BACKPROP_SIGMOID_EXACT:
+    default:
+      for (BACKPROP_SIZE_T i = 0; i < count; ++i)
+      {
+        x[i] = (BACKPROP_FLOAT_T) Backprop_Sigmoid(x[i]);
+      }
+      break;
+  }
+}
+
+
+
+
+BACKPROP_FLOAT_T Backprop_SigmoidMode(BackpropSigmoid_t mode, BACKPROP_FLOAT_T x)
+{
+  BACKPROP_TRACE();
+
+  switch (mode)
+  {
+    case BACKPROP_SIGMOID_FAST:   return Backprop_SigmoidFast(x);
+    case BACKPROP_SIGMOID_TABLE:  return Backprop_SigmoidTable(x);
+    case BACKPROP_SIGMOID_EXACT:
+    default:                      return Backprop_Sigmoid(x);
+  }
+}
+
+
+
+
+const char* Backprop_GetSigmoidName(BackpropSigmoid_t mode)
+{
+  BACKPROP_TRACE();
+
+  switch (mode)
+  {
+    case BACKPROP_SIGMOID_EXACT:  return "exact";
+    case BACKPROP_SIGMOID_FAST:   return "fast";
+    case BACKPROP_SIGMOID_TABLE:  return "table";
+    default:                      return "unknown";
+  }
+}
+
+
+
+
+void BackpropRandom_Seed(BackpropRandom_t* self, unsigned long seed)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  // expand the seed with splitmix64, so similar seeds give unrelated streams
+  uint64_t z = seed;
+
+  for (size_t w = 0; w < 4; ++w)
+  {
+    for (size_t lane = 0; lane < BACKPROP_RANDOM_LANES; ++lane)
+    {
+      uint64_t x = (z += 0x9E3779B97F4A7C15ull);
+      x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+      x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+
+      self->s[w][lane] = x ^ (x >> 31);
+    }
+  }
+
+  self->pool_next = BACKPROP_RANDOM_POOL_COUNT;
+}
+
+
+
+
+void BackpropRandom_Split(BackpropRandom_t* self, const BackpropRandom_t* parent, uint64_t index)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(parent);
+
+  // expand the index with splitmix64 over the parent state, so each word depends on both
+  uint64_t z = index;
+
+  for (size_t w = 0; w < 4; ++w)
+  {
+    for (size_t lane = 0; lane < BACKPROP_RANDOM_LANES; ++lane)
+    {
+      uint64_t x = (z += 0x9E3779B97F4A7C15ull) ^ parent->s[w][lane];
+      x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+      x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+
+      self->s[w][lane] = x ^ (x >> 31);
+    }
+  }
+
+  self->pool_next = BACKPROP_RANDOM_POOL_COUNT;
+}
+
+
+
+
+void BackpropRandom_Fill(BackpropRandom_t* self, BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T count)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(x);
+
+  Backprop_GetKernels()->RandomFill(self, x, count);
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropRandom_UniformFloat(BackpropRandom_t* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  if (self->pool_next >= BACKPROP_RANDOM_POOL_COUNT)
+  {
+    BackpropRandom_Fill(self, self->pool, BACKPROP_RANDOM_POOL_COUNT);
+    self->pool_next = 0;
+  }
+
+  return self->pool[self->pool_next++];
+}
+
+
+
+
+BACKPROP_SIZE_T BackpropRandom_ArrayIndex(BackpropRandom_t* self, size_t lower, size_t upper)
+{
+  BACKPROP_TRACE();
+
+  if (lower >= upper)
+  {
+    return lower;
+  }
+
+  else
+  {
+    BACKPROP_SIZE_T value = (BACKPROP_SIZE_T) (BackpropRandom_UniformFloat(self) * (upper - lower) + lower);
+
+    if (value >= upper)
+    {
+      value = upper - 1;
+    }
+
+    return value;
+  }
+}
+
+
+
+
+/** Add gain * (2 * uniform random number - 1) to each of count weights.
+ */
+static void BackpropRandom_AddWeights(BackpropRandom_t* self, BACKPROP_FLOAT_T* W, BACKPROP_SIZE_T count, BACKPROP_FLOAT_T gain)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(W);
+
+  BACKPROP_FLOAT_T r[BACKPROP_RANDOM_CHUNK_COUNT];
+
+  if (!gain)
+  {
+    return;
+  }
+
+  while (count)
+  {
+    const BACKPROP_SIZE_T n = (count < BACKPROP_RANDOM_CHUNK_COUNT) ? count : BACKPROP_RANDOM_CHUNK_COUNT;
+
+    BackpropRandom_Fill(self, r, n);
+
+    for (BACKPROP_SIZE_T j = 0; j < n; ++j)
+    {
+      W[j] += gain * (2.0 * r[j] - 1.0);
+    }
+
+    W += n;
+    count -= n;
+  }
+}
+
+
+
+
+/** Returns the module PRNG, seeding it on first use.
+ */
+static BackpropRandom_t* Backprop_GetRandom(void)
+{
+  BACKPROP_TRACE();
+
+  if (!Backprop.random_ready)
+  {
+    Backprop_RandomSeed(BACKPROP_RANDOM_DEFAULT_SEED);
+  }
+
+  return &Backprop.random;
+}
+
+
+
+
 void Backprop_RandomSeed(unsigned long seed)
 {
   BACKPROP_TRACE();
 
-  srand((unsigned int) seed);
+  BackpropRandom_Seed(&Backprop.random, seed);
+  Backprop.random_ready = true;
 }
 
 
@@ -148,7 +509,7 @@ int Backprop_UniformRandomInt(void)
 {
   BACKPROP_TRACE();
 
-  return rand();
+  return (int) (Backprop_UniformRandomFloat() * ((double) RAND_MAX + 1.0));
 }
 
 
@@ -158,8 +519,7 @@ BACKPROP_FLOAT_T Backprop_UniformRandomFloat(void)
 {
   BACKPROP_TRACE();
 
-  const double x = rand();
-  return (BACKPROP_FLOAT_T)(x / RAND_MAX);
+  return BackpropRandom_UniformFloat(Backprop_GetRandom());
 }
 
 
@@ -192,7 +552,8 @@ static void* Backprop_Malloc(size_t size)
   }
   else
   {
-    Backprop.malloc_total += size;
+    // trainer threads may allocate scratch memory
+    __atomic_add_fetch(&Backprop.malloc_total, size, __ATOMIC_RELAXED);
 
 #if USE_BACKPROP_VERBOSE
     printf("malloc/free = %ld/%ld, ptr = %p\n", Backprop.malloc_total, Backprop.free_total, ptr);
@@ -211,7 +572,7 @@ static void Backprop_Free(void* ptr, size_t size)
 {
   BACKPROP_TRACE();
 
-  Backprop.free_total += size;
+  __atomic_add_fetch(&Backprop.free_total, size, __ATOMIC_RELAXED);
 
 #if USE_BACKPROP_VERBOSE
   printf("malloc/free = %ld/%ld, ptr = %p\n", Backprop.malloc_total, Backprop.free_total, ptr);
@@ -280,31 +641,6 @@ void Backprop_ResetTotals(void)
 
 
 
-static BackpropByteArray_t BackpropByteArray_Malloc(size_t size)
-{
-  BACKPROP_TRACE();
-
-  BackpropByteArray_t array;
-  array.size = size;
-
-  array.data = Backprop_Malloc(size * sizeof(BACKPROP_BYTE_T));
-
-  return array;
-}
-
-
-
-
-static void BackpropByteArray_Free(BackpropByteArray_t array)
-{
-  BACKPROP_TRACE();
-
-  Backprop_Free(array.data, array.size);
-}
-
-
-
-
 /*-------------------------------------------------------------------*
  *
  * BackpropLayer
@@ -324,18 +660,38 @@ struct BackpropLayer
 {
 	BACKPROP_SIZE_T x_count; ///< Number of inputs to each neuron (M).
 	BACKPROP_SIZE_T y_count; ///< Number of neurons in the layer (N).
+	BACKPROP_SIZE_T W_stride; ///< Number of weights from the start of one W row to the next, M padded to a cache line.
 
-	BACKPROP_FLOAT_T* W; ///< Pointer to weight matrix  [NxM].
+	BACKPROP_FLOAT_T* W; ///< Pointer to weight matrix  [NxW_stride], each row is cache line aligned.
 	BACKPROP_FLOAT_T* g; ///< Pointer to layer gradient [Nx1].
 
 	BACKPROP_FLOAT_T* x; ///< Pointer to layer input    [Mx1].
 	BACKPROP_FLOAT_T* y; ///< Pointer to layer output   [Nx1].
 
+	uint64_t version;    ///< Changed every time W is modified, unique within the process.
+
+	BackpropSigmoid_t sigmoid;  ///< Activation function approximation used by the layer.
+
 };
 
 
 
 
+/** Mark the layer weights as modified.
+ *  Training threads may touch layers concurrently, so the version is taken atomically.
+ */
+static void BackpropLayer_Touch(BackpropLayer_t* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  __atomic_store_n(&self->version, __atomic_add_fetch(&Backprop.weights_version, 1, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+
+
+
 static size_t BackpropLayer_x_MallocSize(BACKPROP_SIZE_T x_count, BACKPROP_SIZE_T y_count)
 {
   BACKPROP_TRACE();
@@ -350,7 +706,7 @@ static size_t BackpropLayer_W_MallocSize(BACKPROP_SIZE_T x_count, BACKPROP_SIZE_
 {
   BACKPROP_TRACE();
 
-  return x_count * y_count * sizeof(BACKPROP_FLOAT_T);
+  return y_count * BACKPROP_W_STRIDE(x_count) * sizeof(BACKPROP_FLOAT_T);
 }
 
 
@@ -414,6 +770,7 @@ static void BackpropLayer_MallocInternal(BackpropLayer_t* self, BACKPROP_SIZE_T
 
   const BACKPROP_SIZE_T W_size = BackpropLayer_W_MallocSize(x_count, y_count);
   self->W = Backprop_Malloc(W_size);
+  self->W_stride = BACKPROP_W_STRIDE(x_count);
 
   const BACKPROP_SIZE_T y_size = BackpropLayer_y_MallocSize(x_count, y_count);
   self->y = Backprop_Malloc(y_size);
@@ -427,11 +784,59 @@ static void BackpropLayer_MallocInternal(BackpropLayer_t* self, BACKPROP_SIZE_T
 
 
 
-static void BackpropLayer_FreeInternal(BackpropLayer_t* layer)
+/** Place the layer buffers in block starting at offset, each on a cache line boundary.
+ *  If self is NULL, only the size is computed.
+ *  The layer input is only placed if place_x is true, otherwise the caller must set x.
+ *  Returns the offset following the layer buffers.
+ */
+static size_t BackpropLayer_Layout(BackpropLayer_t* self, char* block, size_t offset, BACKPROP_SIZE_T x_count, BACKPROP_SIZE_T y_count, bool place_x)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(layer);
+  BACKPROP_ASSERT(x_count);
+  BACKPROP_ASSERT(y_count);
+
+  if (self)
+  {
+    self->x_count = x_count;
+    self->y_count = y_count;
+    self->W_stride = BACKPROP_W_STRIDE(x_count);
+    self->W = (BACKPROP_FLOAT_T*) (block + offset);
+  }
+  offset += BACKPROP_CACHE_LINE_ALIGN(BackpropLayer_W_MallocSize(x_count, y_count));
+
+  if (place_x)
+  {
+    if (self)
+    {
+      self->x = (BACKPROP_FLOAT_T*) (block + offset);
+    }
+    offset += BACKPROP_CACHE_LINE_ALIGN(BackpropLayer_x_MallocSize(x_count, y_count));
+  }
+
+  if (self)
+  {
+    self->y = (BACKPROP_FLOAT_T*) (block + offset);
+  }
+  offset += BACKPROP_CACHE_LINE_ALIGN(BackpropLayer_y_MallocSize(x_count, y_count));
+
+  if (self)
+  {
+    self->g = (BACKPROP_FLOAT_T*) (block + offset);
+  }
+  offset += BACKPROP_CACHE_LINE_ALIGN(BackpropLayer_g_MallocSize(x_count, y_count));
+
+  return offset;
+}
+
+
+
+
+static void BackpropLayer_FreeInternal(BackpropLayer_t* layer)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(layer);
 
   if (!layer)
   {
@@ -591,11 +996,23 @@ void BackpropLayer_SetAtG(const struct BackpropLayer* self, size_t i, BACKPROP_F
 
 
 
+/** Returns the position in W of weight i, counting x_count weights per row.
+ */
+static BACKPROP_SIZE_T BackpropLayer_WIndex(const BackpropLayer_t* self, BACKPROP_SIZE_T i)
+{
+  BACKPROP_TRACE();
+  BACKPROP_ASSERT(self);
+  return (i / self->x_count) * self->W_stride + (i % self->x_count);
+}
+
+
+
+
 BACKPROP_FLOAT_T BackpropLayer_GetAtW(const struct BackpropLayer* self, BACKPROP_SIZE_T i)
 {
   BACKPROP_TRACE();
   BACKPROP_ASSERT(self);
-  return self->W[i];
+  return self->W[BackpropLayer_WIndex(self, i)];
 }
 
 
@@ -603,7 +1020,8 @@ void BackpropLayer_SetAtW(struct BackpropLayer* self, size_t i, BACKPROP_FLOAT_T
 {
   BACKPROP_TRACE();
   BACKPROP_ASSERT(self);
-  self->W[i] = value;
+  self->W[BackpropLayer_WIndex(self, i)] = value;
+  BackpropLayer_Touch(self);
 }
 
 
@@ -612,6 +1030,7 @@ BACKPROP_FLOAT_T* BackpropLayer_GetW(struct BackpropLayer* self)
 {
   BACKPROP_TRACE();
   BACKPROP_ASSERT(self);
+  BackpropLayer_Touch(self);  // the caller may modify the weights
   return self->W;
 }
 
@@ -626,6 +1045,15 @@ const BACKPROP_FLOAT_T* BackpropLayer_GetConstW(const struct BackpropLayer* self
 
 
 
+BACKPROP_SIZE_T BackpropLayer_GetWStride(const struct BackpropLayer* self)
+{
+  BACKPROP_TRACE();
+  BACKPROP_ASSERT(self);
+  return self->W_stride;
+}
+
+
+
 
 BACKPROP_SIZE_T BackpropLayer_WeightCount(const BackpropLayer_t* self)
 {
@@ -654,22 +1082,7 @@ BACKPROP_SIZE_T Backprop_RandomArrayIndex(size_t lower, size_t upper)
 {
   BACKPROP_TRACE();
 
-  if (lower >= upper)
-  {
-    return lower;
-  }
-
-  else
-  {
-    BACKPROP_SIZE_T value = (BACKPROP_SIZE_T) (Backprop_UniformRandomFloat() * (upper - lower) + lower);
-
-    if (value >= upper)
-    {
-      value = upper - 1;
-    }
-
-    return value;
-  }
+  return BackpropRandom_ArrayIndex(Backprop_GetRandom(), lower, upper);
 }
 
 
@@ -702,41 +1115,54 @@ static void BackpropLayer_DeepCopy(const BackpropLayer_t* self, BackpropLayer_t*
 
   memcpy(dest->x, self->x, self->x_count * sizeof(BACKPROP_FLOAT_T));
   memcpy(dest->y, self->y, self->y_count * sizeof(BACKPROP_FLOAT_T));
-  memcpy(dest->W, self->W, self->x_count * self->y_count * sizeof(BACKPROP_FLOAT_T));
+  memcpy(dest->W, self->W, BackpropLayer_W_MallocSize(self->x_count, self->y_count));
   memcpy(dest->g, self->g, self->y_count * sizeof(BACKPROP_FLOAT_T));
+
+  dest->sigmoid = self->sigmoid;
+
+  BackpropLayer_Touch(dest);
 }
 
 
 
 
-void BackpropLayer_Randomize(BackpropLayer_t* self, BACKPROP_FLOAT_T gain)
+static void BackpropLayer_RandomizeWith(BackpropLayer_t* self, BackpropRandom_t* random, BACKPROP_FLOAT_T gain)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(random);
   {
-    size_t count = BackpropLayer_WeightCount(self);
-
-    BACKPROP_FLOAT_T* W = self->W;
+    BackpropLayer_Touch(self);
 
-    do
+    for (size_t j = 0; j < self->y_count; ++j)
     {
-        *W += gain * BackpropLayer_RandomWeight();
-        ++W;
-
-    } while (--count);
+      BackpropRandom_AddWeights(random, self->W + j * self->W_stride, self->x_count, gain);
+    }
   }
 }
 
 
 
 
+void BackpropLayer_Randomize(BackpropLayer_t* self, BACKPROP_FLOAT_T gain)
+{
+  BACKPROP_TRACE();
+
+  BackpropLayer_RandomizeWith(self, Backprop_GetRandom(), gain);
+}
+
+
+
+
 void BackpropLayer_Identity(BackpropLayer_t* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
   {
+    BackpropLayer_Touch(self);
+
     BACKPROP_FLOAT_T* W = self->W;
 
     BACKPROP_SIZE_T y = self->y_count;
@@ -749,6 +1175,8 @@ void BackpropLayer_Identity(BackpropLayer_t* self)
         ++W;
       } while (--x);
 
+      W += self->W_stride - self->x_count;
+
     } while (--y);
   }
 }
@@ -762,7 +1190,10 @@ void BackpropLayer_Prune(BackpropLayer_t* self, BACKPROP_FLOAT_T threshold)
 
   BACKPROP_ASSERT(self);
   {
-    size_t count = BackpropLayer_WeightCount(self);
+    BackpropLayer_Touch(self);
+
+    // padding weights are zero, so they can be walked with the rest
+    size_t count = self->y_count * self->W_stride;
 
     BACKPROP_FLOAT_T* W = self->W;
     do
@@ -787,7 +1218,10 @@ void BackpropLayer_Round(BackpropLayer_t* self)
 
   BACKPROP_ASSERT(self);
   {
-    size_t count = BackpropLayer_WeightCount(self);
+    BackpropLayer_Touch(self);
+
+    // padding weights are zero, so they can be walked with the rest
+    size_t count = self->y_count * self->W_stride;
 
     BACKPROP_FLOAT_T* W = self->W;
     do
@@ -853,37 +1287,96 @@ void BackpropLayer_Activate(BackpropLayer_t* self)
     BACKPROP_ASSERT(W);
     BACKPROP_ASSERT(y);
 
+    const BackpropKernels_t* kernels = Backprop_GetKernels();
+    const size_t x_count = self->x_count;
+
     // for each neuron in layer
     do
     {
-      const BACKPROP_FLOAT_T* x = self->x;
-      BACKPROP_ASSERT(x);
+      BACKPROP_ASSERT(self->x);
       {
         // calculate weighted input
-        BACKPROP_FLOAT_T sum = 0;
+        *y = kernels->Dot(W, self->x, x_count);
 
-        size_t x_count = self->x_count;
-        do
-        {
-          sum += (*W) * (*x);
+        W += self->W_stride;
+        ++y;
+      }
+    } while (--y_count);
 
-          ++W;
-          ++x;
+    // compute activation function and save output of layer
+    Backprop_SigmoidArray(self->sigmoid, self->y, self->y_count);
+  }
+}
 
-        } while (--x_count);
 
-        // compute activation function and save output of layer
-        *y = (BACKPROP_FLOAT_T) Backprop_Sigmoid(sum);
 
-        ++y;
+
+/** Activate a block of inputs through a weight matrix W of y_count rows of x_count weights, W_stride apart.
+ *  X holds rows input vectors of x_count values, Y receives rows output vectors of y_count values.
+ *  The weight matrix is walked in column blocks of BACKPROP_BLOCK_X_COUNT so that each
+ *  slice of W and X stays in cache while it is reused for every row in the block.
+ *  Each weighted sum is the same as BackpropLayer_Activate() when x_count <= BACKPROP_BLOCK_X_COUNT.
+ */
+static void Backprop_ActivateBlock( const BACKPROP_FLOAT_T* W_
+                                  , BACKPROP_SIZE_T x_count
+                                  , BACKPROP_SIZE_T y_count
+                                  , BACKPROP_SIZE_T W_stride
+                                  , BackpropSigmoid_t sigmoid
+                                  , const BACKPROP_FLOAT_T* X
+                                  , BACKPROP_FLOAT_T* Y
+                                  , BACKPROP_SIZE_T rows)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(W_);
+  BACKPROP_ASSERT(X);
+  BACKPROP_ASSERT(Y);
+  BACKPROP_ASSERT(rows);
+  {
+    const BackpropKernels_t* kernels = Backprop_GetKernels();
+
+    memset(Y, 0, rows * y_count * sizeof(BACKPROP_FLOAT_T));
+
+    for (BACKPROP_SIZE_T m0 = 0; m0 < x_count; m0 += BACKPROP_BLOCK_X_COUNT)
+    {
+      const BACKPROP_SIZE_T m1 = ((m0 + BACKPROP_BLOCK_X_COUNT) < x_count) ? (m0 + BACKPROP_BLOCK_X_COUNT) : x_count;
+
+      const BACKPROP_FLOAT_T* W = W_ + m0;
+
+      for (BACKPROP_SIZE_T n = 0; n < y_count; ++n)
+      {
+        for (BACKPROP_SIZE_T r = 0; r < rows; ++r)
+        {
+          Y[r * y_count + n] += kernels->Dot(W, X + r * x_count + m0, m1 - m0);
+        }
+
+        W += W_stride;
       }
-    } while (--y_count);
+    }
+
+    // compute activation function and save output of layer
+    Backprop_SigmoidArray(sigmoid, Y, rows * y_count);
   }
 }
 
 
 
 
+/** Activate a layer for a block of inputs, see Backprop_ActivateBlock().
+ *  Does not use or modify the layer x and y.
+ */
+static void BackpropLayer_ActivateBlock(const BackpropLayer_t* self, const BACKPROP_FLOAT_T* X, BACKPROP_FLOAT_T* Y, BACKPROP_SIZE_T rows)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  Backprop_ActivateBlock(self->W, self->x_count, self->y_count, self->W_stride, self->sigmoid, X, Y, rows);
+}
+
+
+
+
 static void BackpropLayer_WeightedGradient(const BackpropLayer_t* l, BACKPROP_FLOAT_T* Wg)
 {
   BACKPROP_TRACE();
@@ -891,13 +1384,17 @@ static void BackpropLayer_WeightedGradient(const BackpropLayer_t* l, BACKPROP_FL
   BACKPROP_ASSERT(l);
   BACKPROP_ASSERT(Wg);
 
-  for(size_t i=0; i < l->x_count; ++i)
   {
-    Wg[i]=0;
+    const BackpropKernels_t* kernels = Backprop_GetKernels();
+    const BACKPROP_FLOAT_T* W = l->W;
+
+    memset(Wg, 0, l->x_count * sizeof(BACKPROP_FLOAT_T));
 
+    // accumulate one weight row at a time, so W is read contiguously
     for(size_t j=0; j < l->y_count; ++j)
     {
-      Wg[i] += (*(l->W + j*l->x_count + i)) * (l->g[j]);
+      kernels->Axpy(Wg, l->g[j], W, l->x_count);
+      W += l->W_stride;
     }
   }
 }
@@ -932,14 +1429,18 @@ BACKPROP_FLOAT_T BackpropLayer_GetWeightsSum(const BackpropLayer_t* self)
   BACKPROP_TRACE();
   {
     BACKPROP_FLOAT_T sum = 0.0;
-    BACKPROP_SIZE_T count = BackpropLayer_GetWeightsCount(self);
-    BACKPROP_FLOAT_T* w = self->W;
 
-    do
+    for (size_t j = 0; j < self->y_count; ++j)
     {
-      sum += *w;
-      ++w;
-    } while (--count);
+      const BACKPROP_FLOAT_T* w = self->W + j * self->W_stride;
+
+      BACKPROP_SIZE_T count = self->x_count;
+      do
+      {
+        sum += *w;
+        ++w;
+      } while (--count);
+    }
 
     return sum;
   }
@@ -976,17 +1477,21 @@ BACKPROP_FLOAT_T BackpropLayer_GetWeightsStdDev(const BackpropLayer_t* self)
     const BACKPROP_FLOAT_T mean = BackpropLayer_GetWeightsMean(self);
 
     BACKPROP_FLOAT_T ddsum = 0.0;
-    BACKPROP_FLOAT_T* w = self->W;
 
-    BACKPROP_SIZE_T i = count;
-    do
+    for (size_t j = 0; j < self->y_count; ++j)
     {
-      const BACKPROP_FLOAT_T d = *w - mean;
+      const BACKPROP_FLOAT_T* w = self->W + j * self->W_stride;
 
-      ddsum += d*d;
+      BACKPROP_SIZE_T i = self->x_count;
+      do
+      {
+        const BACKPROP_FLOAT_T d = *w - mean;
 
-      ++w;
-    } while (--i);
+        ddsum += d*d;
+
+        ++w;
+      } while (--i);
+    }
 
     return sqrt(ddsum / count);
   }
@@ -1064,6 +1569,15 @@ struct BackpropNetwork
   BackpropByteArray_t y;         ///< Byte output array, each bit represents neuron output.
 
   BACKPROP_FLOAT_T jitter;       ///< Amount of jitter associated with input.
+  BackpropRandom_t random;       ///< PRNG for input jitter and BackpropNetwork_Randomize().
+
+  bool chain_layers;             ///< If true, the x of each layer after the first is the y of the previous layer.
+
+  BACKPROP_FLOAT_T* x_table;     ///< First layer partial sums [x_size][256][N], NULL if not used.
+  uint64_t x_table_version;      ///< First layer version the table was computed from.
+
+  void* block;                   ///< Memory block holding the network, as returned by Backprop_Malloc(), NULL if the caller owns the memory.
+  size_t block_size;             ///< Size in bytes of the memory block, the same as BackpropNetwork_MallocSizeWith().
 };
 
 
@@ -1166,6 +1680,18 @@ BACKPROP_FLOAT_T BackpropNetwork_GetJitter(const struct BackpropNetwork* self)
 
 
 
+BackpropRandom_t* BackpropNetwork_GetRandom(struct BackpropNetwork* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return &self->random;
+}
+
+
+
+
 void BackpropNetwork_SetJitter(struct BackpropNetwork* self, BACKPROP_FLOAT_T jitter)
 {
   BACKPROP_TRACE();
@@ -1178,36 +1704,74 @@ void BackpropNetwork_SetJitter(struct BackpropNetwork* self, BACKPROP_FLOAT_T ji
 
 
 
-size_t BackpropNetwork_MallocSize(BACKPROP_SIZE_T x_size, BACKPROP_SIZE_T y_size, BACKPROP_SIZE_T layers_count)
+void BackpropNetwork_SetSigmoid(struct BackpropNetwork* self, BackpropSigmoid_t mode)
 {
   BACKPROP_TRACE();
 
-  size_t total_size = sizeof(struct BackpropNetwork)
-                      + x_size * sizeof(BACKPROP_BYTE_T)
-                      + y_size * sizeof(BACKPROP_BYTE_T)
-                      + layers_count * sizeof(BackpropLayer_t);
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(mode < BACKPROP_SIGMOID_COUNT);
 
-  if (1 == layers_count)
+  if (BACKPROP_SIGMOID_TABLE == mode)
   {
-    BackpropLayer_MallocInternalSize(x_size * CHAR_BIT, y_size * CHAR_BIT);
+    Backprop_InitSigmoidTable();
   }
-  else
+
+  for (size_t i = 0; i < self->layers.count; ++i)
   {
-    // compute size of hidden layers
-    BACKPROP_SIZE_T hid_count = CHAR_BIT * ((x_size > y_size) ? x_size : y_size);
+    // the mode changes the layer output as much as the weights do, so exercises of the old mode are stale
+    if (self->layers.data[i].sigmoid != mode)
+    {
+      self->layers.data[i].sigmoid = mode;
+      BackpropLayer_Touch(&self->layers.data[i]);
+    }
+  }
+}
 
-    total_size += (layers_count - 1) * BackpropLayer_MallocInternalSize(x_size * CHAR_BIT, hid_count);
 
-    total_size += BackpropLayer_MallocInternalSize(hid_count, y_size * CHAR_BIT);
-  }
 
-  return total_size;
+
+BackpropSigmoid_t BackpropNetwork_GetSigmoid(const struct BackpropNetwork* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->layers.data[0].sigmoid;
 }
 
 
 
 
-struct BackpropNetwork* BackpropNetwork_Malloc(BACKPROP_SIZE_T x_size, BACKPROP_SIZE_T y_size, BACKPROP_SIZE_T layers_count, bool chain_layers)
+uint64_t BackpropNetwork_GetWeightsVersion(const struct BackpropNetwork* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  {
+    uint64_t version = 0;
+
+    for (size_t i = 0; i < self->layers.count; ++i)
+    {
+      if (self->layers.data[i].version > version)
+      {
+        version = self->layers.data[i].version;
+      }
+    }
+
+    return version;
+  }
+}
+
+
+
+
+/** Place a network and all of its buffers in block, each on a cache line boundary.
+ *  block must be cache line aligned, and if block is NULL, only the size is computed.
+ *  The network is at the start of the block, followed by x, y, the layers array,
+ *  and then the buffers of each layer in order, so activation walks memory forwards.
+ *  Returns the size in bytes used from block.
+ */
+static size_t BackpropNetwork_Layout(char* block, BACKPROP_SIZE_T x_size, BACKPROP_SIZE_T y_size, BACKPROP_SIZE_T layers_count, bool chain_layers)
 {
   BACKPROP_TRACE();
 
@@ -1215,96 +1779,114 @@ struct BackpropNetwork* BackpropNetwork_Malloc(BACKPROP_SIZE_T x_size, BACKPROP_
   BACKPROP_ASSERT(y_size);
   BACKPROP_ASSERT(layers_count);
   {
-    struct BackpropNetwork* ptr = Backprop_Malloc(sizeof(struct BackpropNetwork));
+    struct BackpropNetwork* self = (struct BackpropNetwork*) block;
+    size_t offset = BACKPROP_CACHE_LINE_ALIGN(sizeof(struct BackpropNetwork));
 
-    ptr->x = BackpropByteArray_Malloc(x_size);
-    ptr->y = BackpropByteArray_Malloc(y_size);
+    if (self)
+    {
+      self->chain_layers = chain_layers;
 
-    ptr->layers.count = layers_count;
-    ptr->layers.data = Backprop_Malloc(layers_count * sizeof(BackpropLayer_t));
+      self->x.size = x_size;
+      self->x.data = (BACKPROP_BYTE_T*) (block + offset);
+    }
+    offset += BACKPROP_CACHE_LINE_ALIGN(x_size * sizeof(BACKPROP_BYTE_T));
 
-    if (layers_count == 1)
+    if (self)
     {
-      BackpropLayer_MallocInternal(&ptr->layers.data[0], x_size * CHAR_BIT, y_size * CHAR_BIT);
+      self->y.size = y_size;
+      self->y.data = (BACKPROP_BYTE_T*) (block + offset);
     }
-    else
+    offset += BACKPROP_CACHE_LINE_ALIGN(y_size * sizeof(BACKPROP_BYTE_T));
+
+    if (self)
     {
-      // compute size of hidden layers
-      BACKPROP_SIZE_T hid_count = CHAR_BIT * ((x_size > y_size) ? x_size : y_size);
+      self->layers.count = layers_count;
+      self->layers.data = (BackpropLayer_t*) (block + offset);
+    }
+    offset += BACKPROP_CACHE_LINE_ALIGN(layers_count * sizeof(BackpropLayer_t));
 
-      // malloc input layer
-      BackpropLayer_MallocInternal(&ptr->layers.data[0], x_size * CHAR_BIT, hid_count);
+    {
+      // compute size of hidden layers
+      const BACKPROP_SIZE_T hid_count = CHAR_BIT * ((x_size > y_size) ? x_size : y_size);
 
-      // malloc hidden layers
+      for (size_t i = 0; i < layers_count; ++i)
       {
-        size_t i = 1;
-        for (; i < layers_count - 1; ++i)
+        const BACKPROP_SIZE_T x_count = (0 == i) ? x_size * CHAR_BIT : hid_count;
+        const BACKPROP_SIZE_T y_count = (layers_count - 1 == i) ? y_size * CHAR_BIT : hid_count;
+
+        // chained layer inputs are the previous layer outputs
+        const bool chained = chain_layers && i;
+
+        BackpropLayer_t* layer = self ? &self->layers.data[i] : NULL;
+
+        offset = BackpropLayer_Layout(layer, block, offset, x_count, y_count, !chained);
+
+        if (layer && chained)
         {
-          BackpropLayer_MallocInternal(&ptr->layers.data[i], hid_count, hid_count);
+          layer->x = self->layers.data[i - 1].y;
         }
-
-        // malloc output layer
-        BackpropLayer_MallocInternal(&ptr->layers.data[i], hid_count, y_size * CHAR_BIT);
       }
     }
 
-    return ptr;
+    return offset;
   }
 }
 
 
 
 
-void BackpropNetwork_Free(struct BackpropNetwork* network)
+size_t BackpropNetwork_MallocSize(BACKPROP_SIZE_T x_size, BACKPROP_SIZE_T y_size, BACKPROP_SIZE_T layers_count)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(network);
+  // unchained layers have their own input buffers, so this is the larger of the two
+  return BackpropNetwork_MallocSizeWith(x_size, y_size, layers_count, false);
+}
+
+
 
-  for (size_t i = 0; i < network->layers.count; ++i)
-  {
-    BackpropLayer_FreeInternal(&network->layers.data[i]);
-  }
 
-  Backprop_Free(network->x.data, network->x.size * sizeof(BACKPROP_BYTE_T));
-  Backprop_Free(network->y.data, network->y.size * sizeof(BACKPROP_BYTE_T));
-  Backprop_Free(network->layers.data, network->layers.count * sizeof(BackpropLayer_t));
+size_t BackpropNetwork_MallocSizeWith(BACKPROP_SIZE_T x_size, BACKPROP_SIZE_T y_size, BACKPROP_SIZE_T layers_count, bool chain_layers)
+{
+  BACKPROP_TRACE();
 
-  Backprop_Free(network, sizeof(struct BackpropNetwork));
+  // Backprop_Malloc() makes no alignment promise, leave room to align the start of the block
+  return BackpropNetwork_Layout(NULL, x_size, y_size, layers_count, chain_layers) + BACKPROP_CACHE_LINE_SIZE - 1;
 }
 
 
 
 
-/** Copy input bits to the network first layer inputs.
- */
-static void BackpropNetwork_InputToLayer0(struct BackpropNetwork* self)
+struct BackpropNetwork* BackpropNetwork_Init(void* buffer, size_t size, BACKPROP_SIZE_T x_size, BACKPROP_SIZE_T y_size, BACKPROP_SIZE_T layers_count, bool chain_layers)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(buffer);
+  BACKPROP_ASSERT(x_size);
+  BACKPROP_ASSERT(y_size);
+  BACKPROP_ASSERT(layers_count);
   {
-    // Input each bit value
-    BackpropLayer_t* layer0 = BackpropNetwork_GetFirstLayer(self);
-
-    BACKPROP_FLOAT_T* x = layer0->x;
+    const size_t malloc_size = BackpropNetwork_MallocSizeWith(x_size, y_size, layers_count, chain_layers);
 
-    BACKPROP_ASSERT((self->x.size * CHAR_BIT) == layer0->x_count);
+    if (!buffer || (size < malloc_size))
+    {
+      return NULL;
+    }
 
-    for (size_t i = 0; i < self->x.size; ++i)
     {
-      // convert bits to float
-      BACKPROP_BYTE_T bits = self->x.data[i];
+      struct BackpropNetwork* ptr = BACKPROP_CACHE_LINE_ALIGN_PTR(buffer);
 
-      size_t b = CHAR_BIT;
-      do
-      {
-        // set value to either 0.0 or 1.0 +/- jitter
-        *x = (bits & 1) + 2.0 * self->jitter * Backprop_UniformRandomFloat() - 1.0;
-        bits >>= 1;
-        ++x;
+      // start from zero, the same as Backprop_Malloc()
+      memset(ptr, 0, BackpropNetwork_Layout(NULL, x_size, y_size, layers_count, chain_layers));
 
-      } while (--b);
+      BackpropNetwork_Layout((char*) ptr, x_size, y_size, layers_count, chain_layers);
+
+      BackpropRandom_Seed(&ptr->random, BACKPROP_RANDOM_DEFAULT_SEED);
+
+      ptr->block = NULL;
+      ptr->block_size = malloc_size;
+
+      return ptr;
     }
   }
 }
@@ -1312,1307 +1894,3589 @@ static void BackpropNetwork_InputToLayer0(struct BackpropNetwork* self)
 
 
 
-static int BackpropNetwork_IsSimilar(const struct BackpropNetwork* self, const struct BackpropNetwork* other)
+struct BackpropNetwork* BackpropNetwork_Malloc(BACKPROP_SIZE_T x_size, BACKPROP_SIZE_T y_size, BACKPROP_SIZE_T layers_count, bool chain_layers)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
-  BACKPROP_ASSERT(other);
-
-  if (self == other)
+  BACKPROP_ASSERT(x_size);
+  BACKPROP_ASSERT(y_size);
+  BACKPROP_ASSERT(layers_count);
   {
-    return 0; // same is not similar
-  }
+    const size_t size = BackpropNetwork_MallocSizeWith(x_size, y_size, layers_count, chain_layers);
+    void* block = Backprop_Malloc(size);
 
-  if ((self->x.size != other->x.size) || (self->y.size != other->y.size) || (self->layers.count != other->layers.count))
-  {
-    return 0;
-  }
+    if (!block)
+    {
+      return NULL;
+    }
 
-  for (size_t i = 0; i < self->layers.count; ++i)
-  {
-    if (!BackpropLayer_IsSimilar(&self->layers.data[i], &other->layers.data[i]))
     {
-      return 0;
+      struct BackpropNetwork* ptr = BackpropNetwork_Init(block, size, x_size, y_size, layers_count, chain_layers);
+
+      ptr->block = block;
+
+      return ptr;
     }
   }
-
-  return 1;
 }
 
 
 
 
-static void BackpropNetwork_DeepCopy(const struct BackpropNetwork* self, struct BackpropNetwork* dest)
+struct BackpropNetwork* BackpropNetwork_Clone(const struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
-  BACKPROP_ASSERT(dest);
-
-  if (!BackpropNetwork_IsSimilar(self, dest))
   {
-    return;
-  }
+    const size_t size = self->block_size;
+    void* block = Backprop_Malloc(size);
 
-  for (size_t i = 0; i < self->layers.count; ++i)
-  {
-    BackpropLayer_DeepCopy(&self->layers.data[i], &dest->layers.data[i]);
+    if (!block)
+    {
+      return NULL;
+    }
+
+    {
+      struct BackpropNetwork* ptr = BACKPROP_CACHE_LINE_ALIGN_PTR(block);
+
+      // copy everything, then point the copy at its own buffers
+      memcpy(ptr, self, BackpropNetwork_Layout(NULL, self->x.size, self->y.size, self->layers.count, self->chain_layers));
+
+      BackpropNetwork_Layout((char*) ptr, self->x.size, self->y.size, self->layers.count, self->chain_layers);
+
+      ptr->block = block;
+      ptr->block_size = size;
+
+      // a copied PRNG would give the clone the same jitter as self
+      BackpropRandom_Split(&ptr->random, &self->random, __atomic_add_fetch(&Backprop.clones_count, 1, __ATOMIC_RELAXED));
+
+      // the lookup table is not part of the block
+      ptr->x_table = NULL;
+      if (self->x_table)
+      {
+        BackpropNetwork_SetUseInputTable(ptr, true);
+      }
+
+      return ptr;
+    }
   }
 }
 
 
 
 
-void BackpropNetwork_Input(struct BackpropNetwork* self, const BACKPROP_BYTE_T* values, BACKPROP_SIZE_T values_size)
+void BackpropNetwork_Detach(struct BackpropNetwork* network)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
-  BACKPROP_ASSERT(values);
-  BACKPROP_ASSERT(values_size);
-
-  BACKPROP_ASSERT(self->x.size == values_size);
+  BACKPROP_ASSERT(network);
 
-  // copy data into input array
-  for (size_t i = 0; i < values_size; ++i)
-  {
-    self->x.data[i] = values[i];
-  }
+  // the lookup table is the only memory outside the network block
+  BackpropNetwork_SetUseInputTable(network, false);
 }
 
 
 
 
-void BackpropNetwork_InputCStr(struct BackpropNetwork* self, const char* values)
+void BackpropNetwork_Free(struct BackpropNetwork* network)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
-  BACKPROP_ASSERT(values);
-  {
-    const BACKPROP_SIZE_T values_size = strlen(values);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(network->block);
 
-    if (!values_size)
-    {
-      return;
-    }
+  BackpropNetwork_Detach(network);
 
-    BackpropNetwork_Input(self, (const BACKPROP_BYTE_T*) values, values_size);
+  if (network->block)
+  {
+    Backprop_Free(network->block, network->block_size);
   }
 }
 
 
 
 
-BACKPROP_SIZE_T BackpropNetwork_GetOutput(const struct BackpropNetwork* self, BACKPROP_BYTE_T* values, BACKPROP_SIZE_T values_size)
+/** Convert input bytes to first layer input values.
+ *  x must hold x_size * CHAR_BIT values.
+ *  The jitter noise is drawn from random.
+ */
+static void BackpropNetwork_BytesToLayer0(const struct BackpropNetwork* self, BackpropRandom_t* random, const BACKPROP_BYTE_T* bytes, BACKPROP_FLOAT_T* x)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
-  BACKPROP_ASSERT(values);
-  BACKPROP_ASSERT(values_size);
+  BACKPROP_ASSERT(random || !self->jitter);
+  BACKPROP_ASSERT(bytes);
+  BACKPROP_ASSERT(x);
   {
-    const BACKPROP_BYTE_T* data = self->y.data;
-    const BACKPROP_SIZE_T y_size = self->y.size;
+    const BACKPROP_FLOAT_T jitter = self->jitter;
 
-    BACKPROP_SIZE_T i = (y_size < values_size) ? y_size : values_size;
-    do
+    if (jitter)
     {
-      *values = *data;
-      ++values;
-      ++data;
+      // generate all the noise first, then add the bits to it in place
+      BackpropRandom_Fill(random, x, self->x.size * CHAR_BIT);
+    }
 
-    } while (--i);
+    for (size_t i = 0; i < self->x.size; ++i)
+    {
+      // convert bits to float
+      BACKPROP_BYTE_T bits = bytes[i];
 
-    return y_size;
+      size_t b = CHAR_BIT;
+      do
+      {
+        // set value to either 0.0 or 1.0 +/- jitter
+        *x = jitter ? ((bits & 1) + 2.0 * jitter * (*x) - 1.0) : ((bits & 1) - 1.0);
+        bits >>= 1;
+        ++x;
+
+      } while (--b);
+    }
   }
 }
 
 
 
 
-size_t BackpropNetwork_GetOutputCStr(const struct BackpropNetwork* self, char* str, size_t str_size)
+/** Copy input bits to the network first layer inputs.
+ */
+static void BackpropNetwork_InputToLayer0(struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
-  BACKPROP_ASSERT(str);
-
-  if (!str_size)
   {
-    return 0;
-  }
+    // Input each bit value
+    BackpropLayer_t* layer0 = BackpropNetwork_GetFirstLayer(self);
 
-  return BackpropNetwork_GetOutput(self, (BACKPROP_BYTE_T*) str, str_size);
+    BACKPROP_ASSERT((self->x.size * CHAR_BIT) == layer0->x_count);
+
+    BackpropNetwork_BytesToLayer0(self, &self->random, self->x.data, layer0->x);
+  }
 }
 
 
 
 
-static void BackpropNetwork_ActivateLayers(struct BackpropNetwork* self)
+/** Convert size input bytes to size * CHAR_BIT input values without jitter.
+ *  Each 1 bit is 0.0 and each 0 bit is -1.0, the same as BackpropNetwork_BytesToLayer0() with no jitter.
+ */
+static void Backprop_BytesToFloats(const BACKPROP_BYTE_T* bytes, BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T size)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
-  BACKPROP_ASSERT(self->layers.count > 0);
+  BACKPROP_ASSERT(bytes);
+  BACKPROP_ASSERT(x);
+
+  for (size_t i = 0; i < size; ++i)
   {
-    // activate all layers except last
-    const size_t layers_count = self->layers.count - 1;
+    BACKPROP_BYTE_T bits = bytes[i];
 
-    for(size_t i=0; i < layers_count; ++i)
+    size_t b = CHAR_BIT;
+    do
     {
-      BackpropLayer_t* layer = &self->layers.data[i];
-
-      BackpropLayer_Activate(layer);
-      BackpropLayer_Input(&self->layers.data[i + 1], layer->y, layer->y_count);
-    }
+      *x = (bits & 1) - 1.0;
+      bits >>= 1;
+      ++x;
 
-    // activate the last layer
-    BackpropLayer_Activate(&self->layers.data[layers_count]);
+    } while (--b);
   }
 }
 
 
 
 
-BackpropLayer_t* BackpropNetwork_GetFirstLayer(struct BackpropNetwork* self)
+/** Copy input bits to the network first layer inputs without jitter.
+ *  Unlike BackpropNetwork_InputToLayer0(), does not consume random numbers.
+ */
+static void BackpropNetwork_InputBitsToLayer0(struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
-  BACKPROP_ASSERT(self->layers.data);
-  BACKPROP_ASSERT(self->layers.count);
 
-  return &self->layers.data[0];
+  Backprop_BytesToFloats(self->x.data, BackpropNetwork_GetFirstLayer(self)->x, self->x.size);
 }
 
 
 
 
-BackpropLayer_t* BackpropNetwork_GetLastLayer(struct BackpropNetwork* self)
+/** Returns the number of bytes used by the first layer lookup table.
+ */
+static size_t BackpropNetwork_InputTableSize(const struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
-  BACKPROP_ASSERT(self->layers.data);
-  BACKPROP_ASSERT(self->layers.count);
 
-  if (self->layers.count)
-  {
-    return &self->layers.data[self->layers.count - 1];
-  }
-  else
-  {
-    return &self->layers.data[0];
-  }
+  return self->x.size * (UCHAR_MAX + 1) * self->layers.data[0].y_count * sizeof(BACKPROP_FLOAT_T);
 }
 
 
 
 
-const BackpropLayer_t* BackpropNetwork_GetConstLastLayer(const struct BackpropNetwork* self)
+/** Returns true if the first layer lookup table matches the current first layer weights.
+ *  The table only holds sums for inputs of exactly 0 or 1, so it is not used with jitter.
+ */
+static bool BackpropNetwork_IsInputTableValid(const struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-  return BackpropNetwork_GetLastLayer((struct BackpropNetwork*) self);
+  BACKPROP_ASSERT(self);
+
+  return self->x_table
+      && (0.0 == self->jitter)
+      && (self->x_table_version == self->layers.data[0].version);
 }
 
 
 
 
-static void BackpropNetwork_LastLayerToOutput(struct BackpropNetwork* self)
+bool BackpropNetwork_UpdateInputTable(struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+
+  if (!self->x_table || (0.0 != self->jitter))
   {
-    const BackpropLayer_t* last_layer = BackpropNetwork_GetConstLastLayer(self);
-    BACKPROP_ASSERT(last_layer);
-    {
-      // Input each bit value
-      BACKPROP_FLOAT_T* y = last_layer->y;
-      BACKPROP_ASSERT((self->y.size * CHAR_BIT) == last_layer->y_count);
+    return false;
+  }
 
-      for (size_t i = 0; i < self->y.size; ++i)
-      {
-        // convert bits to float
-        BACKPROP_BYTE_T bits = 0;
-        BACKPROP_SIZE_T bit_shift = 0;
+  if (self->x_table_version != self->layers.data[0].version)
+  {
+    const BackpropLayer_t* layer0 = &self->layers.data[0];
+    const BACKPROP_SIZE_T y_count = layer0->y_count;
 
-        size_t b = CHAR_BIT;
-        do
-        {
-          // set value to 1 if greater than 0.5, otherwise set to 0
-          const BACKPROP_BYTE_T bit = (*y) > 0.5;
-          bits |= (bit << bit_shift);
+    BACKPROP_FLOAT_T* T = self->x_table;
 
-          ++bit_shift;
-          ++y;
+    for (size_t i = 0; i < self->x.size; ++i)
+    {
+      for (unsigned int v = 0; v <= UCHAR_MAX; ++v)
+      {
+        const BACKPROP_FLOAT_T* W = layer0->W + i * CHAR_BIT;
 
-        } while (--b);
+        for (size_t n = 0; n < y_count; ++n)
+        {
+          // same input values as BackpropNetwork_InputBitsToLayer0()
+          BACKPROP_FLOAT_T sum = 0;
+          for (size_t b = 0; b < CHAR_BIT; ++b)
+          {
+            sum += W[b] * (((v >> b) & 1) - 1.0);
+          }
 
-        self->y.data[i] = bits;
+          *T = sum;
+          ++T;
+          W += layer0->W_stride;
+        }
       }
     }
+
+    self->x_table_version = layer0->version;
   }
+
+  return true;
 }
 
 
 
 
-void BackpropNetwork_Activate(struct BackpropNetwork* self)
+/** Activate the first layer for one input row using the lookup table.
+ *  y receives the first layer y_count outputs.
+ */
+static void BackpropNetwork_InputTableActivate(const struct BackpropNetwork* self, const BACKPROP_BYTE_T* bytes, BACKPROP_FLOAT_T* y)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(self->x_table);
+  BACKPROP_ASSERT(bytes);
+  BACKPROP_ASSERT(y);
+  {
+    const BackpropKernels_t* kernels = Backprop_GetKernels();
+    const BACKPROP_SIZE_T y_count = self->layers.data[0].y_count;
+    const BACKPROP_FLOAT_T* T = self->x_table;
 
-  // convert byte input in to network layer input
-  BackpropNetwork_InputToLayer0(self);
+    memset(y, 0, y_count * sizeof(BACKPROP_FLOAT_T));
 
-  // activate the network layers
-  BackpropNetwork_ActivateLayers(self);
+    // one table row per input byte replaces CHAR_BIT multiply-adds per neuron
+    for (size_t i = 0; i < self->x.size; ++i)
+    {
+      kernels->Axpy(y, 1.0, T + bytes[i] * y_count, y_count);
+      T += (UCHAR_MAX + 1) * y_count;
+    }
 
-  // copy to output bits
-  BackpropNetwork_LastLayerToOutput(self);
+    Backprop_SigmoidArray(self->layers.data[0].sigmoid, y, y_count);
+  }
 }
 
 
 
 
-void BackpropNetwork_Randomize(struct BackpropNetwork* self, BACKPROP_FLOAT_T gain, unsigned int seed)
+void BackpropNetwork_SetUseInputTable(struct BackpropNetwork* self, bool use)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
 
-  Backprop_RandomSeed(seed);
+  if (use && !self->x_table)
+  {
+    self->x_table = Backprop_Malloc(BackpropNetwork_InputTableSize(self));
+    self->x_table_version = 0;
 
-  for(size_t i = 0; i < self->layers.count; ++i)
+    if (self->x_table)
+    {
+      // force the first update to compute the table
+      BackpropLayer_Touch(&self->layers.data[0]);
+    }
+  }
+  else if (!use && self->x_table)
   {
-    BackpropLayer_Randomize(self->layers.data + i, gain);
+    Backprop_Free(self->x_table, BackpropNetwork_InputTableSize(self));
+    self->x_table = NULL;
   }
 }
 
 
 
 
-void BackpropNetwork_Round(struct BackpropNetwork* self)
+bool BackpropNetwork_GetUseInputTable(const struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
 
-  for(size_t i = 0; i < self->layers.count; ++i)
-  {
-    BackpropLayer_Round(self->layers.data + i);
-  }
+  return NULL != self->x_table;
 }
 
 
 
 
-void BackpropNetwork_Identity(struct BackpropNetwork* self)
+static int BackpropNetwork_IsSimilar(const struct BackpropNetwork* self, const struct BackpropNetwork* other)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(other);
 
-  for(size_t i = 0; i < self->layers.count; ++i)
+  if (self == other)
   {
-    BackpropLayer_Identity(self->layers.data + i);
+    return 0; // same is not similar
+  }
+
+  if ((self->x.size != other->x.size) || (self->y.size != other->y.size) || (self->layers.count != other->layers.count))
+  {
+    return 0;
+  }
+
+  for (size_t i = 0; i < self->layers.count; ++i)
+  {
+    if (!BackpropLayer_IsSimilar(&self->layers.data[i], &other->layers.data[i]))
+    {
+      return 0;
+    }
   }
+
+  return 1;
 }
 
 
 
 
-void BackpropNetwork_Reset(struct BackpropNetwork* self)
+static void BackpropNetwork_DeepCopy(const struct BackpropNetwork* self, struct BackpropNetwork* dest)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(dest);
 
-  memset(self->x.data, 0, self->x.size);
-  memset(self->y.data, 0, self->y.size);
+  if (!BackpropNetwork_IsSimilar(self, dest))
+  {
+    return;
+  }
 
   for (size_t i = 0; i < self->layers.count; ++i)
   {
-    BackpropLayer_Reset(&self->layers.data[i]);
+    BackpropLayer_DeepCopy(&self->layers.data[i], &dest->layers.data[i]);
   }
 }
 
 
 
 
-void BackpropNetwork_Prune(struct BackpropNetwork* self, BACKPROP_FLOAT_T threshold)
+void BackpropNetwork_Input(struct BackpropNetwork* self, const BACKPROP_BYTE_T* values, BACKPROP_SIZE_T values_size)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(values);
+  BACKPROP_ASSERT(values_size);
 
-  for(size_t i = 0; i < self->layers.count; ++i)
+  BACKPROP_ASSERT(self->x.size == values_size);
+
+  // copy data into input array
+  for (size_t i = 0; i < values_size; ++i)
   {
-    BackpropLayer_Prune(&self->layers.data[i], threshold);
+    self->x.data[i] = values[i];
   }
 }
 
 
 
 
-BACKPROP_SIZE_T BackpropNetwork_GetWeightsCount(const struct BackpropNetwork* self)
+void BackpropNetwork_InputCStr(struct BackpropNetwork* self, const char* values)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_SIZE_T total_count = 0;
-
-  for(size_t i = 0; i < self->layers.count; ++i)
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(values);
   {
-    total_count += BackpropLayer_WeightCount(&self->layers.data[i]);
-  }
+    const BACKPROP_SIZE_T values_size = strlen(values);
 
-  return total_count;
+    if (!values_size)
+    {
+      return;
+    }
+
+    BackpropNetwork_Input(self, (const BACKPROP_BYTE_T*) values, values_size);
+  }
 }
 
 
 
 
-BACKPROP_SIZE_T BackpropNetwork_GetWeightsSize(const struct BackpropNetwork* self)
+BACKPROP_SIZE_T BackpropNetwork_GetOutput(const struct BackpropNetwork* self, BACKPROP_BYTE_T* values, BACKPROP_SIZE_T values_size)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(values);
+  BACKPROP_ASSERT(values_size);
+  {
+    const BACKPROP_BYTE_T* data = self->y.data;
+    const BACKPROP_SIZE_T y_size = self->y.size;
 
-  return BackpropNetwork_GetWeightsCount(self) * sizeof(BACKPROP_FLOAT_T);
+    BACKPROP_SIZE_T i = (y_size < values_size) ? y_size : values_size;
+    do
+    {
+      *values = *data;
+      ++values;
+      ++data;
+
+    } while (--i);
+
+    return y_size;
+  }
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropNetwork_GetWeightsSum(const struct BackpropNetwork* self)
+size_t BackpropNetwork_GetOutputCStr(const struct BackpropNetwork* self, char* str, size_t str_size)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_FLOAT_T result = 0;
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(str);
 
-  for(size_t i = 0; i < self->layers.count; ++i)
+  if (!str_size)
   {
-    result += BackpropLayer_GetWeightsSum(self->layers.data + i);
+    return 0;
   }
 
-  return result;
+  return BackpropNetwork_GetOutput(self, (BACKPROP_BYTE_T*) str, str_size);
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropNetwork_GetWeightsMean(const struct BackpropNetwork* self)
+/** Activate the network layers, starting from layer first.
+ */
+static void BackpropNetwork_ActivateLayers(struct BackpropNetwork* self, size_t first)
 {
   BACKPROP_TRACE();
 
-  const BACKPROP_FLOAT_T sum = BackpropNetwork_GetWeightsSum(self);
-  const BACKPROP_SIZE_T count = BackpropNetwork_GetWeightsCount(self);
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(self->layers.count >= first);
 
-  return sum / count;
+  for(size_t i = first; i < self->layers.count; ++i)
+  {
+    BackpropLayer_t* layer = &self->layers.data[i];
+
+    // output of each layer is input to the next, chained layers already share it
+    if (i && !self->chain_layers)
+    {
+      const BackpropLayer_t* prev = &self->layers.data[i - 1];
+      BackpropLayer_Input(layer, prev->y, prev->y_count);
+    }
+
+    BackpropLayer_Activate(layer);
+  }
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropNetwork_GetWeightsStdDev(const struct BackpropNetwork* self)
+BackpropLayer_t* BackpropNetwork_GetFirstLayer(struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-//  const BACKPROP_FLOAT_T mean = BackpropNetwork_GetWeightsMean(self);
-
-//  BACKPROP_FLOAT_T result = 0;
-
-//  BACKPROP_FLOAT_T dev_sum = 0;
-
-//  BACKPROP_FLOAT_T* W = self->layers.data[0];
-
-//  for(size_t i = 0; i < self->layers.count; ++i)
-//  {
-
-//  }
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(self->layers.data);
+  BACKPROP_ASSERT(self->layers.count);
 
-//  return result;
-  return 0.0;
+  return &self->layers.data[0];
 }
 
 
 
 
-static BACKPROP_SIZE_T BackpropNetwork_GetLayersSize(const struct BackpropNetwork* self)
+BackpropLayer_t* BackpropNetwork_GetLastLayer(struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-  const struct BackpropLayersArray* layers = BackpropNetwork_GetLayers(self);
-
-  BACKPROP_SIZE_T total_size = 0;
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(self->layers.data);
+  BACKPROP_ASSERT(self->layers.count);
 
-  const BACKPROP_SIZE_T count = layers->count;
-  for (BACKPROP_SIZE_T i = 0; i < count; ++i)
+  if (self->layers.count)
   {
-    total_size += BackpropLayer_GetSize(layers->data + i);
+    return &self->layers.data[self->layers.count - 1];
+  }
+  else
+  {
+    return &self->layers.data[0];
   }
-
-  return total_size;
 }
 
 
 
 
-void BackpropNetwork_GetStats(const struct BackpropNetwork* self, BackpropNetworkStats_t* stats)
+const BackpropLayer_t* BackpropNetwork_GetConstLastLayer(const struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
-  BACKPROP_ASSERT(stats);
+  return BackpropNetwork_GetLastLayer((struct BackpropNetwork*) self);
+}
 
-  stats->x_size = self->x.size;
-  stats->y_size = self->y.size;
-  stats->layers_count = self->layers.count;
 
-  stats->layers_W_count = BackpropNetwork_GetWeightsCount(self);
-  stats->layers_W_size = BackpropNetwork_GetWeightsSize(self);
-  stats->layers_W_avg = BackpropNetwork_GetWeightsMean(self);
-  stats->layers_W_stddev = BackpropNetwork_GetWeightsStdDev(self);
 
-  stats->layers_size = BackpropNetwork_GetLayersSize(self);
-}
 
+/** Convert size * CHAR_BIT output values to size output bytes.
+ *  Each value greater than 0.5 is a 1 bit, least significant bit first.
+ */
+static void Backprop_FloatsToBytes(const BACKPROP_FLOAT_T* y, BACKPROP_BYTE_T* bytes, BACKPROP_SIZE_T size)
+{
+  BACKPROP_TRACE();
 
+  BACKPROP_ASSERT(y);
+  BACKPROP_ASSERT(bytes);
 
+  for (size_t i = 0; i < size; ++i)
+  {
+    // convert bits to float
+    BACKPROP_BYTE_T bits = 0;
+    BACKPROP_SIZE_T bit_shift = 0;
 
+    size_t b = CHAR_BIT;
+    do
+    {
+      // set value to 1 if greater than 0.5, otherwise set to 0
+      const BACKPROP_BYTE_T bit = (*y) > 0.5;
+      bits |= (bit << bit_shift);
 
+      ++bit_shift;
+      ++y;
 
+    } while (--b);
 
-/*-------------------------------------------------------------------*
- *
- * BackpropTrainingSet
- *
- *-------------------------------------------------------------------*/
+    bytes[i] = bits;
+  }
+}
 
-#pragma mark BackpropTrainingSet
 
 
-BackpropTrainingSet_t* BackpropTrainingSet_Malloc(size_t count, size_t x_size, size_t y_size)
+
+/** Convert last layer output values to output bytes.
+ *  y must hold y_size * CHAR_BIT values.
+ */
+static void BackpropNetwork_LayerNToBytes(const struct BackpropNetwork* self, const BACKPROP_FLOAT_T* y, BACKPROP_BYTE_T* bytes)
 {
   BACKPROP_TRACE();
 
-  BackpropTrainingSet_t* self = Backprop_Malloc(sizeof(BackpropTrainingSet_t));
+  BACKPROP_ASSERT(self);
 
-  self->dims.count = count;
+  Backprop_FloatsToBytes(y, bytes, self->y.size);
+}
 
-  self->dims.x_size = x_size;
-  self->dims.y_size = y_size;
 
-  if (count && x_size)
-  {
-    self->x = Backprop_Malloc(count * x_size);
-  }
 
-  if (count && y_size)
+
+static void BackpropNetwork_LastLayerToOutput(struct BackpropNetwork* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
   {
-    self->y = Backprop_Malloc(count * y_size);
-  }
+    const BackpropLayer_t* last_layer = BackpropNetwork_GetConstLastLayer(self);
+    BACKPROP_ASSERT(last_layer);
+    BACKPROP_ASSERT((self->y.size * CHAR_BIT) == last_layer->y_count);
 
-  return self;
+    BackpropNetwork_LayerNToBytes(self, last_layer->y, self->y.data);
+  }
 }
 
 
 
 
-void BackpropTrainingSet_Free(BackpropTrainingSet_t* self)
+void BackpropNetwork_Activate(struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-  size_t count = self->dims.count;
-  size_t x_size = self->dims.x_size;
-  size_t y_size = self->dims.y_size;
+  BACKPROP_ASSERT(self);
 
-  Backprop_Free(self->x, count * x_size);
-  Backprop_Free(self->y, count * y_size);
-  Backprop_Free(self, sizeof(BackpropTrainingSet_t));
+  // a stale table is not rebuilt here, a single activation between weight updates costs less without it
+  if (BackpropNetwork_IsInputTableValid(self))
+  {
+    // layer 0 x is still needed for training, but its weighted sums come from the table
+    BackpropNetwork_InputBitsToLayer0(self);
+    BackpropNetwork_InputTableActivate(self, self->x.data, self->layers.data[0].y);
+
+    BackpropNetwork_ActivateLayers(self, 1);
+  }
+  else
+  {
+    // convert byte input in to network layer input
+    BackpropNetwork_InputToLayer0(self);
+
+    // activate the network layers
+    BackpropNetwork_ActivateLayers(self, 0);
+  }
+
+  // copy to output bits
+  BackpropNetwork_LastLayerToOutput(self);
 }
 
 
 
 
-size_t BackpropTrainingSet_GetXSize(BackpropTrainingSet_t* self)
+/** Returns the largest input or output count of any network layer.
+ */
+static BACKPROP_SIZE_T BackpropNetwork_GetMaxLayerCount(const struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  {
+    BACKPROP_SIZE_T max_count = 0;
 
-  return self->dims.x_size;
+    for (size_t i = 0; i < self->layers.count; ++i)
+    {
+      const BackpropLayer_t* layer = &self->layers.data[i];
+
+      if (layer->x_count > max_count)
+      {
+        max_count = layer->x_count;
+      }
+
+      if (layer->y_count > max_count)
+      {
+        max_count = layer->y_count;
+      }
+    }
+
+    return max_count;
+  }
 }
 
 
 
 
-size_t BackpropTrainingSet_GetYSize(BackpropTrainingSet_t* self)
+/** Returns the number of bytes of scratch memory used by BackpropNetwork_ActivateBlocks().
+ */
+static size_t BackpropNetwork_ActivateBlocksScratchSize(const struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
-
-  return self->dims.y_size;
+  // two ping-pong buffers of BACKPROP_BLOCK_ROWS_COUNT rows each
+  return 2 * BACKPROP_BLOCK_ROWS_COUNT * BackpropNetwork_GetMaxLayerCount(self) * sizeof(BACKPROP_FLOAT_T);
 }
 
 
 
 
-void BackpropTrainingSet_GetPair(BackpropTrainingSet_t* self, BACKPROP_SIZE_T index, BACKPROP_BYTE_T* x, BACKPROP_BYTE_T* y)
+/** Activate the network for count packed input rows, using caller provided scratch memory.
+ *  Does not modify the network, jitter noise is drawn from random.
+ */
+static void BackpropNetwork_ActivateBlocks( const struct BackpropNetwork* self
+                                          , BackpropRandom_t* random
+                                          , BACKPROP_FLOAT_T* scratch
+                                          , const BACKPROP_BYTE_T* x
+                                          , BACKPROP_BYTE_T* y
+                                          , BACKPROP_SIZE_T count)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(scratch);
   BACKPROP_ASSERT(x);
   BACKPROP_ASSERT(y);
+  {
+    const BACKPROP_SIZE_T x_size = self->x.size;
+    const BACKPROP_SIZE_T y_size = self->y.size;
+    const BACKPROP_SIZE_T block_size = BACKPROP_BLOCK_ROWS_COUNT * BackpropNetwork_GetMaxLayerCount(self);
+    const bool use_table = BackpropNetwork_IsInputTableValid(self);
 
-  memcpy(x, self->x + index * self->dims.x_size, self->dims.x_size);
-}
-
+    while (count)
+    {
+      const BACKPROP_SIZE_T rows = (count < BACKPROP_BLOCK_ROWS_COUNT) ? count : BACKPROP_BLOCK_ROWS_COUNT;
 
-//void BackpropTrainingSet_SetPair(BackpropTrainingSet_t* self, BACKPROP_SIZE_T index, const BACKPROP_BYTE_T* x, const BACKPROP_BYTE_T* y)
-//{
-//  BACKPROP_ASSERT(self);
-//  BACKPROP_ASSERT(x);
-//  BACKPROP_ASSERT(y);
-//}
+      BACKPROP_FLOAT_T* X = scratch;
+      BACKPROP_FLOAT_T* Y = scratch + block_size;
 
+      size_t first = 0;
 
+      if (use_table)
+      {
+        // first layer output straight from the lookup table
+        const BACKPROP_SIZE_T y_count = self->layers.data[0].y_count;
 
+        for (BACKPROP_SIZE_T r = 0; r < rows; ++r)
+        {
+          BackpropNetwork_InputTableActivate(self, x + r * x_size, X + r * y_count);
+        }
 
-/*-------------------------------------------------------------------*
- *
- * BackpropLearningAccelerator
- *
- *-------------------------------------------------------------------*/
+        first = 1;
+      }
+      else
+      {
+        // convert byte input in to network layer input
+        const BACKPROP_SIZE_T x_count = self->layers.data[0].x_count;
 
-#pragma mark BackpropLearningAccelerator
+        for (BACKPROP_SIZE_T r = 0; r < rows; ++r)
+        {
+          BackpropNetwork_BytesToLayer0(self, random, x + r * x_size, X + r * x_count);
+        }
+      }
 
+      // activate the network layers, output of each layer is input to the next
+      for (size_t i = first; i < self->layers.count; ++i)
+      {
+        BackpropLayer_ActivateBlock(&self->layers.data[i], X, Y, rows);
 
-void BackpropLearningAccelerator_SetToDefault(BackpropLearningAccelerator_t* self)
-{
-  BACKPROP_TRACE();
+        {
+          BACKPROP_FLOAT_T* swap = X;
+          X = Y;
+          Y = swap;
+        }
+      }
 
-  BACKPROP_ASSERT(self);
+      // copy to output bits
+      {
+        const BACKPROP_SIZE_T y_count = BackpropNetwork_GetConstLastLayer(self)->y_count;
 
-  memset(self, 0, sizeof(BackpropLearningAccelerator_t));
+        for (BACKPROP_SIZE_T r = 0; r < rows; ++r)
+        {
+          BackpropNetwork_LayerNToBytes(self, X + r * y_count, y + r * y_size);
+        }
+      }
 
-  self->min_learning_rate = 0.1;
-  self->max_learning_rate = 0.9;
-  self->acceleration = 0.1;
+      x += rows * x_size;
+      y += rows * y_size;
+      count -= rows;
+    }
+  }
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropLearningAccelerator_Accelerate(BackpropLearningAccelerator_t* self, BACKPROP_FLOAT_T learning_rate, BACKPROP_FLOAT_T error_now, BACKPROP_FLOAT_T error_prev)
+bool BackpropNetwork_ActivateBatch(const struct BackpropNetwork* self, BackpropRandom_t* random, const BACKPROP_BYTE_T* x, BACKPROP_BYTE_T* y, BACKPROP_SIZE_T count)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
-  BACKPROP_ASSERT(self->min_learning_rate <= self->max_learning_rate);
+  BACKPROP_ASSERT(random || !self->jitter);
+  BACKPROP_ASSERT(x);
+  BACKPROP_ASSERT(y);
+
+  if (!count)
   {
-    const BACKPROP_FLOAT_T max_learning_rate = self->max_learning_rate;
-    BACKPROP_FLOAT_T min_learning_rate = self->min_learning_rate;
-    BACKPROP_FLOAT_T acceleration = self->acceleration;
-    const BACKPROP_FLOAT_T error_diff = error_now - error_prev;
+    return true;
+  }
 
-    if (min_learning_rate > max_learning_rate)
-    {
-      min_learning_rate = max_learning_rate;
-    }
+  else
+  {
+    const size_t scratch_size = BackpropNetwork_ActivateBlocksScratchSize(self);
+    BACKPROP_FLOAT_T* scratch = Backprop_Malloc(scratch_size);
 
-    if (error_diff > 0) // more error is bad
+    // the network activation buffers are not ours to use, self may be shared by concurrent callers
+    if (!scratch)
     {
-      learning_rate = min_learning_rate;
-      acceleration = 0;
-    }
-    else // less error is good
-    {
-      if (learning_rate < min_learning_rate)
-      {
-        learning_rate = min_learning_rate;
-        acceleration = 0;
-      }
-      else if (learning_rate > max_learning_rate)
-      {
-        learning_rate = max_learning_rate;
-        acceleration = 0;
-      }
+      return false;
     }
 
-    return learning_rate + acceleration;
+    // self is not modified, so any jitter comes from the caller PRNG
+    BackpropNetwork_ActivateBlocks(self, random, scratch, x, y, count);
+
+    Backprop_Free(scratch, scratch_size);
+
+    return true;
   }
 }
 
 
 
 
+void BackpropNetwork_Randomize(struct BackpropNetwork* self, BACKPROP_FLOAT_T gain, unsigned int seed)
+{
+  BACKPROP_TRACE();
 
+  BACKPROP_ASSERT(self);
 
+  BackpropRandom_Seed(&self->random, seed);
 
+  for(size_t i = 0; i < self->layers.count; ++i)
+  {
+    BackpropLayer_RandomizeWith(self->layers.data + i, &self->random, gain);
+  }
+}
 
-/*-------------------------------------------------------------------*
- *
- * BackpropTrainer
- *
- *-------------------------------------------------------------------*/
 
-#pragma mark BackpropTrainer
 
 
-/** Backprop Trainer structure.
- *  Holds parameters that affect network training.
- */
-struct BackpropTrainer
+void BackpropNetwork_Round(struct BackpropNetwork* self)
 {
-  BACKPROP_FLOAT_T error_tolerance;                   ///< Minimum allowable error for network to be considered trained.
-  BACKPROP_FLOAT_T learning_rate;                     ///< Weight adjustment factor used when training networks.
-  BACKPROP_FLOAT_T mutation_rate;                     ///< Amount of mutation applied to network weight matrices.
-  BACKPROP_FLOAT_T momentum_rate;
-
-  BackpropLearningAccelerator_t learning_accelerator;
+  BACKPROP_TRACE();
 
-  BACKPROP_SIZE_T max_reps;                           ///< Maximum number of training repetitions given to a single neuron.
-  BACKPROP_SIZE_T max_batch_sets;                     ///< Maximum number of training sets ran per batch.
-  BACKPROP_SIZE_T max_batches;                        ///< Maximum number of batches per training session.
+  BACKPROP_ASSERT(self);
 
-  BACKPROP_FLOAT_T stagnate_tolerance;
-  BACKPROP_SIZE_T max_stagnate_sets;
-  BACKPROP_SIZE_T max_stagnate_batches;
-
-  BACKPROP_FLOAT_T min_set_weight_correction_limit;   ///< Minimum weight correction that must be reached by each training set or else trainer gives up training.
-  BACKPROP_FLOAT_T min_batch_weight_correction_limit; ///< Minimum weight correction that must be reached by each batch or else trainer gives up training.
-
-  BACKPROP_FLOAT_T batch_prune_threshold;             ///< Weight threshold for network pruning.
-  BACKPROP_FLOAT_T batch_prune_rate;                  ///< Amount that pruning threshold is increased for each batch.
-
-  BACKPROP_FLOAT_T training_ratio;                    ///< Ratio of training set pairs to be used as training input.  1.0 means all training pairs, 0.5 means on average only half are used.
-
-  BACKPROP_FLOAT_T** W_prev;                          ///< Array of pointers to layer weight matrices that store the previous training weights.
-
-  struct BackpropTrainerEvents events;                ///< Structure of event callback function pointers.
-
-};
+  for(size_t i = 0; i < self->layers.count; ++i)
+  {
+    BackpropLayer_Round(self->layers.data + i);
+  }
+}
 
 
 
 
-static BACKPROP_FLOAT_T BackpropTrainer_ComputeByteError(BACKPROP_BYTE_T byte1, BACKPROP_BYTE_T byte2)
+void BackpropNetwork_Identity(struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_FLOAT_T error = 0;
+  BACKPROP_ASSERT(self);
 
-  size_t b = CHAR_BIT;
-  do
+  for(size_t i = 0; i < self->layers.count; ++i)
   {
-    error += ((byte1 & 1) != (byte2 & 1));
-
-    byte1 >>= 1;
-    byte2 >>= 1;
-
-  } while (--b);
-
-  return error;
+    BackpropLayer_Identity(self->layers.data + i);
+  }
 }
 
 
 
 
-static BACKPROP_FLOAT_T BackpropTrainer_ComputeLastLayerError( const struct BackpropNetwork* self
-                                                             , const const BACKPROP_BYTE_T* yd
-                                                             , BACKPROP_SIZE_T yd_size)
+void BackpropNetwork_Reset(struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_FLOAT_T error = 0.0;
-
   BACKPROP_ASSERT(self);
-  {
-    const BackpropLayer_t* last_layer = BackpropNetwork_GetConstLastLayer(self);
-    BACKPROP_ASSERT(last_layer);
-    {
-      // Input each bit value
-      BACKPROP_FLOAT_T* y = last_layer->y;
-      BACKPROP_ASSERT((self->y.size * CHAR_BIT) == last_layer->y_count);
-
-      for (size_t i = 0; i < yd_size; ++i)
-      {
-        // convert bits to float
-        BACKPROP_BYTE_T bits = *yd;
-        BACKPROP_SIZE_T bit_shift = 0;
-
-        size_t b = CHAR_BIT;
-        do
-        {
-          const BACKPROP_FLOAT_T e = (0 < (bits & 1)) - *y;
-          error += fabs(e);
-
-          bits = bits >> 1;
-          ++y;
 
-        } while (--b);
+  memset(self->x.data, 0, self->x.size);
+  memset(self->y.data, 0, self->y.size);
 
-        ++yd;
-      }
-    }
+  for (size_t i = 0; i < self->layers.count; ++i)
+  {
+    BackpropLayer_Reset(&self->layers.data[i]);
   }
-
-  return error;
 }
 
 
 
 
-static BACKPROP_FLOAT_T BackpropTrainer_ComputeError(const struct BackpropNetwork* network, const BACKPROP_BYTE_T* yd, BACKPROP_SIZE_T yd_size)
+void BackpropNetwork_Prune(struct BackpropNetwork* self, BACKPROP_FLOAT_T threshold)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(network);
-  BACKPROP_ASSERT(yd);
-  BACKPROP_ASSERT(yd_size);
-  BACKPROP_ASSERT(yd_size == network->y.size);
-  {
-    BACKPROP_BYTE_T* y = network->y.data;
-
-    BACKPROP_FLOAT_T error = 0;
-    do
-    {
-      error += BackpropTrainer_ComputeByteError(*y, *yd);
-
-      ++y;
-      ++yd;
-
-    } while (--yd_size);
+  BACKPROP_ASSERT(self);
 
-    return error;
+  for(size_t i = 0; i < self->layers.count; ++i)
+  {
+    BackpropLayer_Prune(&self->layers.data[i], threshold);
   }
 }
 
 
 
 
-size_t BackpropTrainer_MallocSize(const struct BackpropNetwork* network)
+BACKPROP_SIZE_T BackpropNetwork_GetWeightsCount(const struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-  return sizeof(BackpropTrainer_t);
+  BACKPROP_SIZE_T total_count = 0;
+
+  for(size_t i = 0; i < self->layers.count; ++i)
+  {
+    total_count += BackpropLayer_WeightCount(&self->layers.data[i]);
+  }
+
+  return total_count;
 }
 
 
 
 
-BackpropTrainer_t* BackpropTrainer_Malloc(struct BackpropNetwork* network)
+BACKPROP_SIZE_T BackpropNetwork_GetWeightsSize(const struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-  return Backprop_Malloc(BackpropTrainer_MallocSize(network));
+  BACKPROP_ASSERT(self);
+
+  return BackpropNetwork_GetWeightsCount(self) * sizeof(BACKPROP_FLOAT_T);
 }
 
 
 
 
-void BackpropTrainer_Free(BackpropTrainer_t* trainer)
+void BackpropNetwork_GetWeights(const struct BackpropNetwork* self, BACKPROP_FLOAT_T* weights)
 {
   BACKPROP_TRACE();
 
-  Backprop_Free(trainer, sizeof(BackpropTrainer_t));
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(weights);
+
+  for (size_t k = 0; k < self->layers.count; ++k)
+  {
+    const BackpropLayer_t* layer = &self->layers.data[k];
+    const BACKPROP_FLOAT_T* W = layer->W;
+
+    for (size_t n = 0; n < layer->y_count; ++n)
+    {
+      memcpy(weights, W, layer->x_count * sizeof(BACKPROP_FLOAT_T));
+
+      weights += layer->x_count;
+      W += layer->W_stride;
+    }
+  }
 }
 
 
 
-struct BackpropTrainerEvents* BackpropTrainer_GetEvents(BackpropTrainer_t* self)
+
+void BackpropNetwork_SetWeights(struct BackpropNetwork* self, const BACKPROP_FLOAT_T* weights)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(weights);
 
-  return &self->events;
+  for (size_t k = 0; k < self->layers.count; ++k)
+  {
+    BackpropLayer_t* layer = &self->layers.data[k];
+    BACKPROP_FLOAT_T* W = layer->W;
+
+    BackpropLayer_Touch(layer);
+
+    for (size_t n = 0; n < layer->y_count; ++n)
+    {
+      memcpy(W, weights, layer->x_count * sizeof(BACKPROP_FLOAT_T));
+
+      weights += layer->x_count;
+      W += layer->W_stride;
+    }
+  }
 }
 
 
 
 
-void BackpropTrainer_SetToDefault(BackpropTrainer_t* self)
+void BackpropNetwork_AddWeights(struct BackpropNetwork* self, BACKPROP_FLOAT_T scale, const BACKPROP_FLOAT_T* deltas)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(deltas);
+  {
+    const BackpropKernels_t* kernels = Backprop_GetKernels();
 
-  memset(self, 0, sizeof(BackpropTrainer_t));
-
-  self->error_tolerance = 0;
-  self->max_reps = 0xFF;
-  self->max_batch_sets = 0xFF;
-  self->learning_rate = BACKPROP_MIN_GOLD;
-  self->mutation_rate = 0.001;
-  self->momentum_rate = 0.01;
-  self->stagnate_tolerance = 1;
-  self->max_stagnate_sets = 0x0F;
-  self->max_stagnate_batches = 0x0F;
-  self->min_batch_weight_correction_limit = 0.1;
-  self->min_set_weight_correction_limit = 0.1;
+    for (size_t k = 0; k < self->layers.count; ++k)
+    {
+      BackpropLayer_t* layer = &self->layers.data[k];
+      BACKPROP_FLOAT_T* W = layer->W;
 
-  self->batch_prune_rate = 0.1;
-  self->batch_prune_threshold = 0.5;
-  self->max_batches = 0xFF;
+      BackpropLayer_Touch(layer);
 
-  self->training_ratio = 0.5;
+      for (size_t n = 0; n < layer->y_count; ++n)
+      {
+        kernels->Axpy(W, scale, deltas, layer->x_count);
 
-  BackpropLearningAccelerator_SetToDefault(&self->learning_accelerator);
+        deltas += layer->x_count;
+        W += layer->W_stride;
+      }
+    }
+  }
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_GetErrorTolerance(const struct BackpropTrainer* self)
+BACKPROP_FLOAT_T BackpropNetwork_GetWeightsSum(const struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
+  BACKPROP_FLOAT_T result = 0;
 
-  return self->error_tolerance;
+  for(size_t i = 0; i < self->layers.count; ++i)
+  {
+    result += BackpropLayer_GetWeightsSum(self->layers.data + i);
+  }
+
+  return result;
 }
 
 
 
 
-void BackpropTrainer_SetErrorTolerance(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+BACKPROP_FLOAT_T BackpropNetwork_GetWeightsMean(const struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
+  const BACKPROP_FLOAT_T sum = BackpropNetwork_GetWeightsSum(self);
+  const BACKPROP_SIZE_T count = BackpropNetwork_GetWeightsCount(self);
 
-  self->error_tolerance = value;
+  return sum / count;
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_GetLearningRate(const struct BackpropTrainer* self)
+BACKPROP_FLOAT_T BackpropNetwork_GetWeightsStdDev(const struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
-
-  return self->learning_rate;
-}
+//  const BACKPROP_FLOAT_T mean = BackpropNetwork_GetWeightsMean(self);
 
+//  BACKPROP_FLOAT_T result = 0;
 
+//  BACKPROP_FLOAT_T dev_sum = 0;
 
+//  BACKPROP_FLOAT_T* W = self->layers.data[0];
 
-void BackpropTrainer_SetLearningRate(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
-{
-  BACKPROP_TRACE();
+//  for(size_t i = 0; i < self->layers.count; ++i)
+//  {
 
-  BACKPROP_ASSERT(self);
+//  }
 
-  self->learning_rate = value;
+//  return result;
+  return 0.0;
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_GetMutationRate(const struct BackpropTrainer* self)
+static BACKPROP_SIZE_T BackpropNetwork_GetLayersSize(const struct BackpropNetwork* self)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
+  const struct BackpropLayersArray* layers = BackpropNetwork_GetLayers(self);
 
-  return self->mutation_rate;
+  BACKPROP_SIZE_T total_size = 0;
+
+  const BACKPROP_SIZE_T count = layers->count;
+  for (BACKPROP_SIZE_T i = 0; i < count; ++i)
+  {
+    total_size += BackpropLayer_GetSize(layers->data + i);
+  }
+
+  return total_size;
 }
 
 
 
 
-void BackpropTrainer_SetMutationRate(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+void BackpropNetwork_GetStats(const struct BackpropNetwork* self, BackpropNetworkStats_t* stats)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(stats);
 
-  self->mutation_rate = value;
+  stats->x_size = self->x.size;
+  stats->y_size = self->y.size;
+  stats->layers_count = self->layers.count;
+
+  stats->layers_W_count = BackpropNetwork_GetWeightsCount(self);
+  stats->layers_W_size = BackpropNetwork_GetWeightsSize(self);
+  stats->layers_W_avg = BackpropNetwork_GetWeightsMean(self);
+  stats->layers_W_stddev = BackpropNetwork_GetWeightsStdDev(self);
+
+  stats->layers_size = BackpropNetwork_GetLayersSize(self);
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_GetMomentumRate(const struct BackpropTrainer* self)
-{
-  BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
 
-  return self->momentum_rate;
-}
 
+/*-------------------------------------------------------------------*
+ *
+ * BackpropInferenceModel
+ *
+ *-------------------------------------------------------------------*/
 
+#pragma mark BackpropInferenceModel
 
 
-void BackpropTrainer_SetMomentumRate(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+/**
+ * Inference model layer.
+ */
+typedef struct BackpropInferenceLayer
 {
-  BACKPROP_TRACE();
-
-  BACKPROP_ASSERT(self);
+  BACKPROP_SIZE_T x_count;     ///< Number of inputs to each neuron (M).
+  BACKPROP_SIZE_T y_count;     ///< Number of neurons in the layer (N).
+  BACKPROP_SIZE_T W_stride;    ///< Number of weights from the start of one W row to the next.
+  BackpropSigmoid_t sigmoid;   ///< Activation function approximation used by the layer.
+  BACKPROP_SIZE_T W_offset;    ///< Offset in bytes from the start of the model to the weight matrix [NxW_stride].
 
-  self->momentum_rate = value;
-}
+} BackpropInferenceLayer_t;
 
 
 
 
-BACKPROP_SIZE_T BackpropTrainer_GetMaxReps(const struct BackpropTrainer* self)
+/**
+ * Inference model structure.
+ * One block of memory: this header, the layers, then each layer weight matrix.
+ * Only offsets are stored, so a model may be copied with memcpy() or mapped at any address.
+ */
+struct BackpropInferenceModel
 {
-  BACKPROP_TRACE();
-
-  BACKPROP_ASSERT(self);
+  BACKPROP_SIZE_T size;          ///< Size in bytes of the whole model.
+  BACKPROP_SIZE_T x_size;        ///< Size of the input in bytes.
+  BACKPROP_SIZE_T y_size;        ///< Size of the output in bytes.
+  BACKPROP_SIZE_T max_count;     ///< Largest input or output count of any layer.
+  BACKPROP_SIZE_T layers_count;  ///< Number of layers.
 
-  return self->max_reps;
-}
+  BackpropInferenceLayer_t layers[];
+};
 
 
 
 
-void BackpropTrainer_SetMaxReps(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+/** Returns the size of the model header and layers, rounded up so the first weight matrix is aligned.
+ */
+static size_t BackpropInferenceModel_HeaderSize(BACKPROP_SIZE_T layers_count)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
-
-  self->max_reps = value;
+  return BACKPROP_CACHE_LINE_ALIGN(sizeof(struct BackpropInferenceModel) + layers_count * sizeof(BackpropInferenceLayer_t));
 }
 
 
 
 
-BACKPROP_SIZE_T BackpropTrainer_GetMaxBatchSets(const struct BackpropTrainer* self)
+size_t BackpropInferenceModel_MallocSize(const struct BackpropNetwork* network)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(network);
+  {
+    size_t size = BackpropInferenceModel_HeaderSize(network->layers.count);
 
-  return self->max_batch_sets;
+    for (size_t i = 0; i < network->layers.count; ++i)
+    {
+      const BackpropLayer_t* layer = &network->layers.data[i];
+
+      size += BACKPROP_CACHE_LINE_ALIGN(BackpropLayer_W_MallocSize(layer->x_count, layer->y_count));
+    }
+
+    return size;
+  }
 }
 
 
 
 
-void BackpropTrainer_SetMaxBatchSets(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+struct BackpropInferenceModel* BackpropInferenceModel_Init(void* buffer, size_t size, const struct BackpropNetwork* network)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(buffer);
+  BACKPROP_ASSERT(network);
 
-  self->max_batch_sets = value;
-}
+  if (size < BackpropInferenceModel_MallocSize(network))
+  {
+    return NULL;
+  }
+  else
+  {
+    struct BackpropInferenceModel* self = buffer;
+    size_t offset = BackpropInferenceModel_HeaderSize(network->layers.count);
 
+    self->x_size = network->x.size;
+    self->y_size = network->y.size;
+    self->max_count = BackpropNetwork_GetMaxLayerCount(network);
+    self->layers_count = network->layers.count;
 
+    for (size_t i = 0; i < network->layers.count; ++i)
+    {
+      const BackpropLayer_t* layer = &network->layers.data[i];
+      BackpropInferenceLayer_t* model_layer = &self->layers[i];
 
+      // rows keep their padding, so the model activates exactly like the network
+      const size_t W_size = BackpropLayer_W_MallocSize(layer->x_count, layer->y_count);
 
-BACKPROP_SIZE_T BackpropTrainer_GetMaxBatches(const struct BackpropTrainer* self)
-{
-  BACKPROP_TRACE();
+      model_layer->x_count = layer->x_count;
+      model_layer->y_count = layer->y_count;
+      model_layer->W_stride = layer->W_stride;
+      model_layer->sigmoid = layer->sigmoid;
+      model_layer->W_offset = offset;
 
-  BACKPROP_ASSERT(self);
+      memcpy((char*) self + offset, layer->W, W_size);
 
-  return self->max_batches;
+      offset += BACKPROP_CACHE_LINE_ALIGN(W_size);
+    }
+
+    self->size = offset;
+
+    return self;
+  }
 }
 
 
 
 
-void BackpropTrainer_SetMaxBatches(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+bool BackpropInferenceModel_HasLayout(const struct BackpropInferenceModel* self, const struct BackpropNetwork* network)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(network);
 
-  self->max_batches = value;
+  if (   (self->size != BackpropInferenceModel_MallocSize(network))
+      || (self->x_size != network->x.size)
+      || (self->y_size != network->y.size)
+      || (self->max_count != BackpropNetwork_GetMaxLayerCount(network))
+      || (self->layers_count != network->layers.count))
+  {
+    return false;
+  }
+
+  {
+    // the offsets follow from the layer sizes as in BackpropInferenceModel_Init()
+    size_t offset = BackpropInferenceModel_HeaderSize(network->layers.count);
+
+    for (size_t i = 0; i < network->layers.count; ++i)
+    {
+      const BackpropLayer_t* layer = &network->layers.data[i];
+      const BackpropInferenceLayer_t* model_layer = &self->layers[i];
+
+      if (   (model_layer->x_count != layer->x_count)
+          || (model_layer->y_count != layer->y_count)
+          || (model_layer->W_stride != layer->W_stride)
+          || (model_layer->W_offset != offset))
+      {
+        return false;
+      }
+
+      offset += BACKPROP_CACHE_LINE_ALIGN(BackpropLayer_W_MallocSize(layer->x_count, layer->y_count));
+    }
+
+    return true;
+  }
 }
 
 
 
 
-BACKPROP_SIZE_T BackpropTrainer_GetMaxStagnateSets(const struct BackpropTrainer* self)
+struct BackpropInferenceModel* BackpropInferenceModel_Malloc(const struct BackpropNetwork* network)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(network);
+  {
+    const size_t size = BackpropInferenceModel_MallocSize(network);
+    void* buffer = Backprop_Malloc(size);
 
-  return self->max_stagnate_sets;
+    if (!buffer)
+    {
+      return NULL;
+    }
+
+    return BackpropInferenceModel_Init(buffer, size, network);
+  }
 }
 
 
 
 
-void BackpropTrainer_SetMaxStagnateSets(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+void BackpropInferenceModel_Free(struct BackpropInferenceModel* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
 
-  self->max_stagnate_sets = value;
+  Backprop_Free(self, self->size);
 }
 
 
 
 
-BACKPROP_SIZE_T BackpropTrainer_GetMaxStagnateBatches(const struct BackpropTrainer* self)
+size_t BackpropInferenceModel_GetSize(const struct BackpropInferenceModel* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
 
-  return self->max_stagnate_batches;
+  return self->size;
 }
 
 
 
 
-void BackpropTrainer_SetMaxStagnateBatches(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+BACKPROP_SIZE_T BackpropInferenceModel_GetXSize(const struct BackpropInferenceModel* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
 
-  self->max_stagnate_batches = value;
+  return self->x_size;
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_GetMinSetWeightCorrectionLimit(const struct BackpropTrainer* self)
+BACKPROP_SIZE_T BackpropInferenceModel_GetYSize(const struct BackpropInferenceModel* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
 
-  return self->min_set_weight_correction_limit;
+  return self->y_size;
 }
 
 
 
 
-void BackpropTrainer_SetMinSetWeightCorrectionLimit(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+size_t BackpropInferenceModel_GetScratchSize(const struct BackpropInferenceModel* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
 
-  self->min_set_weight_correction_limit = value;
+  // two ping-pong buffers of BACKPROP_BLOCK_ROWS_COUNT rows each
+  return 2 * BACKPROP_BLOCK_ROWS_COUNT * self->max_count * sizeof(BACKPROP_FLOAT_T);
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_GetMinBatchWeightCorrectionLimit(const struct BackpropTrainer* self)
+void BackpropInferenceModel_ActivateBatch( const struct BackpropInferenceModel* self
+                                         , void* scratch
+                                         , const BACKPROP_BYTE_T* x
+                                         , BACKPROP_BYTE_T* y
+                                         , BACKPROP_SIZE_T count)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(scratch);
+  BACKPROP_ASSERT(x);
+  BACKPROP_ASSERT(y);
+  {
+    const BACKPROP_SIZE_T block_size = BACKPROP_BLOCK_ROWS_COUNT * self->max_count;
 
-  return self->min_batch_weight_correction_limit;
-}
+    while (count)
+    {
+      const BACKPROP_SIZE_T rows = (count < BACKPROP_BLOCK_ROWS_COUNT) ? count : BACKPROP_BLOCK_ROWS_COUNT;
 
+      BACKPROP_FLOAT_T* X = scratch;
+      BACKPROP_FLOAT_T* Y = X + block_size;
 
+      // convert byte input in to first layer input
+      for (BACKPROP_SIZE_T r = 0; r < rows; ++r)
+      {
+        Backprop_BytesToFloats(x + r * self->x_size, X + r * self->layers[0].x_count, self->x_size);
+      }
 
+      // activate the layers, output of each layer is input to the next
+      for (size_t i = 0; i < self->layers_count; ++i)
+      {
+        const BackpropInferenceLayer_t* layer = &self->layers[i];
+        const BACKPROP_FLOAT_T* W = (const BACKPROP_FLOAT_T*) ((const char*) self + layer->W_offset);
 
-void BackpropTrainer_SetMinBatchWeightCorrectionLimit(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
-{
-  BACKPROP_TRACE();
+        Backprop_ActivateBlock(W, layer->x_count, layer->y_count, layer->W_stride, layer->sigmoid, X, Y, rows);
 
-  BACKPROP_ASSERT(self);
+        {
+          BACKPROP_FLOAT_T* swap = X;
+          X = Y;
+          Y = swap;
+        }
+      }
 
-  self->min_batch_weight_correction_limit = value;
+      // copy to output bits
+      {
+        const BACKPROP_SIZE_T y_count = self->layers[self->layers_count - 1].y_count;
+
+        for (BACKPROP_SIZE_T r = 0; r < rows; ++r)
+        {
+          Backprop_FloatsToBytes(X + r * y_count, y + r * self->y_size, self->y_size);
+        }
+      }
+
+      x += rows * self->x_size;
+      y += rows * self->y_size;
+      count -= rows;
+    }
+  }
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_GetTrainingRatio(const struct BackpropTrainer* self)
+void BackpropInferenceModel_Activate(const struct BackpropInferenceModel* self, void* scratch, const BACKPROP_BYTE_T* x, BACKPROP_BYTE_T* y)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
-
-  return self->training_ratio;
+  BackpropInferenceModel_ActivateBatch(self, scratch, x, y, 1);
 }
 
 
 
 
-void BackpropTrainer_SetTrainingRatio(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
-{
-  BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
 
-  self->training_ratio = value;
-}
 
+/*-------------------------------------------------------------------*
+ *
+ * BackpropTrainingSet
+ *
+ *-------------------------------------------------------------------*/
 
+#pragma mark BackpropTrainingSet
 
 
-BACKPROP_FLOAT_T BackpropTrainer_GetBatchPruneThreshold(const struct BackpropTrainer* self)
+BackpropTrainingSet_t* BackpropTrainingSet_Malloc(size_t count, size_t x_size, size_t y_size)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
+  BackpropTrainingSet_t* self = Backprop_Malloc(sizeof(BackpropTrainingSet_t));
 
-  return self->batch_prune_threshold;
+  self->dims.count = count;
+
+  self->dims.x_size = x_size;
+  self->dims.y_size = y_size;
+
+  if (count && x_size)
+  {
+    self->x = Backprop_Malloc(count * x_size);
+  }
+
+  if (count && y_size)
+  {
+    self->y = Backprop_Malloc(count * y_size);
+  }
+
+  return self;
 }
 
 
 
 
-void BackpropTrainer_SetBatchPruneThreshold(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+void BackpropTrainingSet_Free(BackpropTrainingSet_t* self)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(self);
+  size_t count = self->dims.count;
+  size_t x_size = self->dims.x_size;
+  size_t y_size = self->dims.y_size;
 
-  self->batch_prune_threshold = value;
+  Backprop_Free(self->x, count * x_size);
+  Backprop_Free(self->y, count * y_size);
+  Backprop_Free(self, sizeof(BackpropTrainingSet_t));
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_GetStagnateTolerance(const struct BackpropTrainer* self)
+size_t BackpropTrainingSet_GetXSize(BackpropTrainingSet_t* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
 
-  return self->stagnate_tolerance;
+  return self->dims.x_size;
 }
 
 
 
 
-void BackpropTrainer_SetStagnateTolerance(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+size_t BackpropTrainingSet_GetYSize(BackpropTrainingSet_t* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
 
-  self->stagnate_tolerance = value;
+  return self->dims.y_size;
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_GetBatchPruneRate(const struct BackpropTrainer* self)
+void BackpropTrainingSet_GetPair(BackpropTrainingSet_t* self, BACKPROP_SIZE_T index, BACKPROP_BYTE_T* x, BACKPROP_BYTE_T* y)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(x);
+  BACKPROP_ASSERT(y);
 
-  return self->batch_prune_rate;
+  memcpy(x, self->x + index * self->dims.x_size, self->dims.x_size);
 }
 
 
+//void BackpropTrainingSet_SetPair(BackpropTrainingSet_t* self, BACKPROP_SIZE_T index, const BACKPROP_BYTE_T* x, const BACKPROP_BYTE_T* y)
+//{
+//  BACKPROP_ASSERT(self);
+//  BACKPROP_ASSERT(x);
+//  BACKPROP_ASSERT(y);
+//}
+
+
 
 
-void BackpropTrainer_SetBatchPruneRate(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+/*-------------------------------------------------------------------*
+ *
+ * BackpropLearningAccelerator
+ *
+ *-------------------------------------------------------------------*/
+
+#pragma mark BackpropLearningAccelerator
+
+
+void BackpropLearningAccelerator_SetToDefault(BackpropLearningAccelerator_t* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
 
-  self->batch_prune_rate = value;
+  memset(self, 0, sizeof(BackpropLearningAccelerator_t));
+
+  self->min_learning_rate = 0.1;
+  self->max_learning_rate = 0.9;
+  self->acceleration = 0.1;
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_ExerciseConst(BackpropTrainer_t* trainer, BackpropExerciseStats_t* stats, struct BackpropNetwork* network, const BackpropConstTrainingSet_t* training_set)
+BACKPROP_FLOAT_T BackpropLearningAccelerator_Accelerate(BackpropLearningAccelerator_t* self, BACKPROP_FLOAT_T learning_rate, BACKPROP_FLOAT_T error_now, BACKPROP_FLOAT_T error_prev)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(trainer);
-  BACKPROP_ASSERT(stats);
-  BACKPROP_ASSERT(network);
-  BACKPROP_ASSERT(training_set);
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(self->min_learning_rate <= self->max_learning_rate);
   {
-    const long int clock_start = clock();
-
-    BACKPROP_FLOAT_T error = 0;
-
-    const BACKPROP_BYTE_T* x = training_set->x;
-    const BACKPROP_BYTE_T* y = training_set->y;
-    const BACKPROP_SIZE_T x_size = training_set->dims.x_size;
-
-    const size_t count = training_set->dims.count;
-
-    memset(stats, 0, sizeof(BackpropExerciseStats_t));
+    const BACKPROP_FLOAT_T max_learning_rate = self->max_learning_rate;
+    BACKPROP_FLOAT_T min_learning_rate = self->min_learning_rate;
+    BACKPROP_FLOAT_T acceleration = self->acceleration;
+    const BACKPROP_FLOAT_T error_diff = error_now - error_prev;
 
-    for(size_t i = 0; i < count; ++i)
+    if (min_learning_rate > max_learning_rate)
     {
-      BackpropNetwork_Input(network, x, x_size);
+      min_learning_rate = max_learning_rate;
+    }
 
-      if (trainer->events.AfterInput)
+    if (error_diff > 0) // more error is bad
+    {
+      learning_rate = min_learning_rate;
+      acceleration = 0;
+    }
+    else // less error is good
+    {
+      if (learning_rate < min_learning_rate)
       {
-        trainer->events.AfterInput(trainer, network, x, x_size);
+        learning_rate = min_learning_rate;
+        acceleration = 0;
       }
-
-      BackpropNetwork_Activate(network);
-
-      if (trainer->events.AfterActivate)
+      else if (learning_rate > max_learning_rate)
       {
-        trainer->events.AfterActivate(trainer, network);
+        learning_rate = max_learning_rate;
+        acceleration = 0;
       }
-
-      error += BackpropTrainer_ComputeError(network, y, training_set->dims.y_size);
-
-      x += training_set->dims.x_size;
-      y += training_set->dims.y_size;
-
-      ++(stats->activate_count);
-    }
-
-    {
-      const long int clock_stop = clock();
-      stats->exercise_clock_ticks += (clock_stop - clock_start);
     }
 
-    stats->error += error;
-    return error;
+    return learning_rate + acceleration;
   }
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_Exercise(BackpropTrainer_t* trainer, BackpropExerciseStats_t* stats, struct BackpropNetwork* network, const BackpropTrainingSet_t* training_set)
-{
-  BACKPROP_TRACE();
-
-  BACKPROP_ASSERT(trainer);
-  BACKPROP_ASSERT(stats);
-  BACKPROP_ASSERT(network);
-  BACKPROP_ASSERT(training_set);
-  {
-    BackpropConstTrainingSet_t const_training_set;
-    const_training_set.dims = training_set->dims;
-
-    const_training_set.x = training_set->x;
-    const_training_set.y = training_set->y;
-
-    return BackpropTrainer_ExerciseConst(trainer, stats, network, &const_training_set);
-  }
-}
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_TeachPair( BackpropTrainer_t* trainer
+/*-------------------------------------------------------------------*
+ *
+ * BackpropTrainer
+ *
+ *-------------------------------------------------------------------*/
+
+#pragma mark BackpropTrainer
+
+
+/** Weight velocities of a trainer, the last correction applied to each network weight.
+ *  The velocities are stored after the trainer, in the same buffer,
+ *  laid out like the weight matrices of the network layers one after another.
+ */
+typedef struct BackpropTrainerVelocity
+{
+  size_t malloc_size;                                 ///< Size in bytes of the trainer buffer, including the velocities.
+  void* block;                                        ///< Start of the allocation holding the trainer, NULL if built by BackpropTrainer_Init().
+  BACKPROP_FLOAT_T* data;                             ///< Velocities, NULL if the trainer was sized without a network.
+  BACKPROP_SIZE_T count;                              ///< Number of velocities, one for each padded weight.
+  const struct BackpropNetwork* network;              ///< Network the velocities belong to, NULL if they are all zero.
+
+} BackpropTrainerVelocity_t;
+
+
+
+
+/** Backprop Trainer structure.
+ *  Holds parameters that affect network training.
+ */
+struct BackpropTrainer
+{
+  BACKPROP_FLOAT_T error_tolerance;                   ///< Minimum allowable error for network to be considered trained.
+  BACKPROP_FLOAT_T learning_rate;                     ///< Weight adjustment factor used when training networks.
+  BACKPROP_FLOAT_T mutation_rate;                     ///< Amount of mutation applied to network weight matrices.
+  BACKPROP_FLOAT_T mutation_probability;              ///< Probability that a weight is mutated by each weight update, 1 mutates every weight.
+  BACKPROP_FLOAT_T momentum_rate;                     ///< Fraction of the previous weight correction added to each weight correction.
+
+  BackpropLearningAccelerator_t learning_accelerator;
+
+  BACKPROP_SIZE_T max_reps;                           ///< Maximum number of training repetitions given to a single neuron.
+  BACKPROP_SIZE_T max_batch_sets;                     ///< Maximum number of training sets ran per batch.
+  BACKPROP_SIZE_T max_batches;                        ///< Maximum number of batches per training session.
+
+  BACKPROP_FLOAT_T stagnate_tolerance;
+  BACKPROP_SIZE_T max_stagnate_sets;
+  BACKPROP_SIZE_T max_stagnate_batches;
+
+  BACKPROP_FLOAT_T min_set_weight_correction_limit;   ///< Minimum weight correction that must be reached by each training set or else trainer gives up training.
+  BACKPROP_FLOAT_T min_batch_weight_correction_limit; ///< Minimum weight correction that must be reached by each batch or else trainer gives up training.
+
+  BACKPROP_FLOAT_T batch_prune_threshold;             ///< Weight threshold for network pruning.
+  BACKPROP_FLOAT_T batch_prune_rate;                  ///< Amount that pruning threshold is increased for each batch.
+
+  BACKPROP_FLOAT_T training_ratio;                    ///< Ratio of training set pairs to be used as training input.  1.0 means all training pairs, 0.5 means on average only half are used.
+
+  BACKPROP_SIZE_T minibatch_size;                     ///< Number of pairs whose corrections are summed into one weight update by BackpropTrainer_TrainSet(), 0 or 1 updates after every pair.
+  BACKPROP_SIZE_T train_thread_count;                 ///< Number of threads updating the shared weights in BackpropTrainer_TrainSet(), 0 trains with BackpropTrainer_TrainPair().
+  bool data_parallel;                                 ///< True if BackpropTrainer_TrainSet() threads combine their gradients into one update per mini-batch.
+
+  BACKPROP_SIZE_T exercise_sample_count;              ///< Number of pairs sampled to estimate the training set error, 0 always exercises the whole set.
+  BACKPROP_SIZE_T exercise_thread_count;              ///< Number of threads exercising a training set, 0 or 1 exercises in the calling thread.
+
+  BackpropTrainerVelocity_t velocity;                 ///< Weight velocities used for momentum.
+
+  BackpropRandom_t random;                            ///< PRNG for training pair selection and mutation.
+
+  struct BackpropTrainerEvents events;                ///< Structure of event callback function pointers.
+
+};
+
+
+
+
+static BACKPROP_FLOAT_T BackpropTrainer_ComputeByteError(BACKPROP_BYTE_T byte1, BACKPROP_BYTE_T byte2)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_FLOAT_T error = 0;
+
+  size_t b = CHAR_BIT;
+  do
+  {
+    error += ((byte1 & 1) != (byte2 & 1));
+
+    byte1 >>= 1;
+    byte2 >>= 1;
+
+  } while (--b);
+
+  return error;
+}
+
+
+
+
+static BACKPROP_FLOAT_T BackpropTrainer_ComputeLastLayerError( const struct BackpropNetwork* self
+                                                             , const const BACKPROP_BYTE_T* yd
+                                                             , BACKPROP_SIZE_T yd_size)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_FLOAT_T error = 0.0;
+
+  BACKPROP_ASSERT(self);
+  {
+    const BackpropLayer_t* last_layer = BackpropNetwork_GetConstLastLayer(self);
+    BACKPROP_ASSERT(last_layer);
+    {
+      // Input each bit value
+      BACKPROP_FLOAT_T* y = last_layer->y;
+      BACKPROP_ASSERT((self->y.size * CHAR_BIT) == last_layer->y_count);
+
+      for (size_t i = 0; i < yd_size; ++i)
+      {
+        // convert bits to float
+        BACKPROP_BYTE_T bits = *yd;
+        BACKPROP_SIZE_T bit_shift = 0;
+
+        size_t b = CHAR_BIT;
+        do
+        {
+          const BACKPROP_FLOAT_T e = (0 < (bits & 1)) - *y;
+          error += fabs(e);
+
+          bits = bits >> 1;
+          ++y;
+
+        } while (--b);
+
+        ++yd;
+      }
+    }
+  }
+
+  return error;
+}
+
+
+
+
+static BACKPROP_FLOAT_T BackpropTrainer_ComputeBytesError(const BACKPROP_BYTE_T* y, const BACKPROP_BYTE_T* yd, BACKPROP_SIZE_T yd_size)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(y);
+  BACKPROP_ASSERT(yd);
+  BACKPROP_ASSERT(yd_size);
+  {
+    BACKPROP_FLOAT_T error = 0;
+    do
+    {
+      error += BackpropTrainer_ComputeByteError(*y, *yd);
+
+      ++y;
+      ++yd;
+
+    } while (--yd_size);
+
+    return error;
+  }
+}
+
+
+
+
+static BACKPROP_FLOAT_T BackpropTrainer_ComputeError(const struct BackpropNetwork* network, const BACKPROP_BYTE_T* yd, BACKPROP_SIZE_T yd_size)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(yd_size == network->y.size);
+
+  return BackpropTrainer_ComputeBytesError(network->y.data, yd, yd_size);
+}
+
+
+
+
+static BACKPROP_SIZE_T BackpropTrainer_VelocityCount(const struct BackpropNetwork* network)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_SIZE_T count = 0;
+
+  if (network)
+  {
+    for (BACKPROP_SIZE_T k = 0; k < network->layers.count; ++k)
+    {
+      count += network->layers.data[k].y_count * network->layers.data[k].W_stride;
+    }
+  }
+
+  return count;
+}
+
+
+
+
+/** Returns the velocities of the first layer of network, or NULL if momentum is off or the trainer was not sized for network.
+ *  The velocities are cleared when the trainer moves on to another network.
+ */
+static BACKPROP_FLOAT_T* BackpropTrainer_GetVelocity(BackpropTrainer_t* self, const struct BackpropNetwork* network)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(network);
+
+  if (!self->momentum_rate || !self->velocity.data || (self->velocity.count != BackpropTrainer_VelocityCount(network)))
+  {
+    return NULL;
+  }
+
+  if (self->velocity.network != network)
+  {
+    memset(self->velocity.data, 0, self->velocity.count * sizeof(BACKPROP_FLOAT_T));
+    self->velocity.network = network;
+  }
+
+  return self->velocity.data;
+}
+
+
+
+
+/** Returns the velocities of layer k, given the velocities of the first layer.
+ */
+static BACKPROP_FLOAT_T* BackpropTrainer_GetLayerVelocity(BACKPROP_FLOAT_T* velocity, const struct BackpropNetwork* network, BACKPROP_SIZE_T k)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(k < network->layers.count);
+
+  if (velocity)
+  {
+    for (BACKPROP_SIZE_T j = 0; j < k; ++j)
+    {
+      velocity += network->layers.data[j].y_count * network->layers.data[j].W_stride;
+    }
+  }
+
+  return velocity;
+}
+
+
+
+
+static void BackpropTrainer_ResetVelocity(BackpropTrainer_t* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  if (self->velocity.network)
+  {
+    memset(self->velocity.data, 0, self->velocity.count * sizeof(BACKPROP_FLOAT_T));
+    self->velocity.network = NULL;
+  }
+}
+
+
+
+
+size_t BackpropTrainer_MallocSize(const struct BackpropNetwork* network)
+{
+  BACKPROP_TRACE();
+
+  // Backprop_Malloc() makes no alignment promise, leave room to align the start of the block
+  return BACKPROP_CACHE_LINE_SIZE - 1 + BACKPROP_CACHE_LINE_ALIGN(sizeof(BackpropTrainer_t)) + BackpropTrainer_VelocityCount(network) * sizeof(BACKPROP_FLOAT_T);
+}
+
+
+
+
+BackpropTrainer_t* BackpropTrainer_Init(void* buffer, size_t size, const struct BackpropNetwork* network)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(buffer);
+
+  const size_t malloc_size = BackpropTrainer_MallocSize(network);
+
+  if (!buffer || (size < malloc_size))
+  {
+    return NULL;
+  }
+
+  {
+    BackpropTrainer_t* self = BACKPROP_CACHE_LINE_ALIGN_PTR(buffer);
+
+    // start from zero, the same as Backprop_Malloc()
+    memset(self, 0, malloc_size - (BACKPROP_CACHE_LINE_SIZE - 1));
+
+    self->velocity.malloc_size = malloc_size;
+    self->velocity.block = NULL;
+    self->velocity.count = BackpropTrainer_VelocityCount(network);
+
+    BackpropRandom_Seed(&self->random, BACKPROP_RANDOM_DEFAULT_SEED);
+
+    if (self->velocity.count)
+    {
+      self->velocity.data = (BACKPROP_FLOAT_T*) ((char*) self + BACKPROP_CACHE_LINE_ALIGN(sizeof(BackpropTrainer_t)));
+    }
+
+    return self;
+  }
+}
+
+
+
+
+BackpropTrainer_t* BackpropTrainer_Malloc(struct BackpropNetwork* network)
+{
+  BACKPROP_TRACE();
+
+  const size_t size = BackpropTrainer_MallocSize(network);
+  void* block = Backprop_Malloc(size);
+
+  if (!block)
+  {
+    return NULL;
+  }
+
+  {
+    BackpropTrainer_t* self = BackpropTrainer_Init(block, size, network);
+
+    self->velocity.block = block;
+
+    return self;
+  }
+}
+
+
+
+
+void BackpropTrainer_Detach(BackpropTrainer_t* trainer)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+
+  // a trainer holds no memory outside its own buffer
+}
+
+
+
+
+void BackpropTrainer_Free(BackpropTrainer_t* trainer)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer->velocity.block);
+
+  BackpropTrainer_Detach(trainer);
+
+  if (trainer->velocity.block)
+  {
+    Backprop_Free(trainer->velocity.block, trainer->velocity.malloc_size);
+  }
+}
+
+
+
+struct BackpropTrainerEvents* BackpropTrainer_GetEvents(BackpropTrainer_t* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return &self->events;
+}
+
+
+
+
+BackpropRandom_t* BackpropTrainer_GetRandom(BackpropTrainer_t* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return &self->random;
+}
+
+
+
+
+void BackpropTrainer_SetToDefault(BackpropTrainer_t* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  // the velocity buffer belongs to the allocation and the PRNG is state, neither are settings
+  const BackpropTrainerVelocity_t velocity = self->velocity;
+  const BackpropRandom_t random = self->random;
+
+  memset(self, 0, sizeof(BackpropTrainer_t));
+
+  self->velocity = velocity;
+  BackpropTrainer_ResetVelocity(self);
+
+  self->random = random;
+
+  self->error_tolerance = 0;
+  self->max_reps = 0xFF;
+  self->max_batch_sets = 0xFF;
+  self->learning_rate = BACKPROP_MIN_GOLD;
+  self->mutation_rate = 0.001;
+  self->mutation_probability = 1.0;
+  self->momentum_rate = 0;
+  self->stagnate_tolerance = 1;
+  self->max_stagnate_sets = 0x0F;
+  self->max_stagnate_batches = 0x0F;
+  self->min_batch_weight_correction_limit = 0.1;
+  self->min_set_weight_correction_limit = 0.1;
+
+  self->batch_prune_rate = 0.1;
+  self->batch_prune_threshold = 0.5;
+  self->max_batches = 0xFF;
+
+  self->training_ratio = 0.5;
+
+  BackpropLearningAccelerator_SetToDefault(&self->learning_accelerator);
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_GetErrorTolerance(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->error_tolerance;
+}
+
+
+
+
+void BackpropTrainer_SetErrorTolerance(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->error_tolerance = value;
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_GetLearningRate(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->learning_rate;
+}
+
+
+
+
+void BackpropTrainer_SetLearningRate(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->learning_rate = value;
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_GetMutationRate(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->mutation_rate;
+}
+
+
+
+
+void BackpropTrainer_SetMutationRate(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->mutation_rate = value;
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_GetMutationProbability(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->mutation_probability;
+}
+
+
+
+
+void BackpropTrainer_SetMutationProbability(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->mutation_probability = value;
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_GetMomentumRate(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->momentum_rate;
+}
+
+
+
+
+void BackpropTrainer_SetMomentumRate(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->momentum_rate = value;
+}
+
+
+
+
+BACKPROP_SIZE_T BackpropTrainer_GetMaxReps(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->max_reps;
+}
+
+
+
+
+void BackpropTrainer_SetMaxReps(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->max_reps = value;
+}
+
+
+
+
+BACKPROP_SIZE_T BackpropTrainer_GetMaxBatchSets(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->max_batch_sets;
+}
+
+
+
+
+void BackpropTrainer_SetMaxBatchSets(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->max_batch_sets = value;
+}
+
+
+
+
+BACKPROP_SIZE_T BackpropTrainer_GetMaxBatches(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->max_batches;
+}
+
+
+
+
+void BackpropTrainer_SetMaxBatches(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->max_batches = value;
+}
+
+
+
+
+BACKPROP_SIZE_T BackpropTrainer_GetMaxStagnateSets(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->max_stagnate_sets;
+}
+
+
+
+
+void BackpropTrainer_SetMaxStagnateSets(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->max_stagnate_sets = value;
+}
+
+
+
+
+BACKPROP_SIZE_T BackpropTrainer_GetMaxStagnateBatches(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->max_stagnate_batches;
+}
+
+
+
+
+void BackpropTrainer_SetMaxStagnateBatches(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->max_stagnate_batches = value;
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_GetMinSetWeightCorrectionLimit(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->min_set_weight_correction_limit;
+}
+
+
+
+
+void BackpropTrainer_SetMinSetWeightCorrectionLimit(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->min_set_weight_correction_limit = value;
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_GetMinBatchWeightCorrectionLimit(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->min_batch_weight_correction_limit;
+}
+
+
+
+
+void BackpropTrainer_SetMinBatchWeightCorrectionLimit(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->min_batch_weight_correction_limit = value;
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_GetTrainingRatio(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->training_ratio;
+}
+
+
+
+
+void BackpropTrainer_SetTrainingRatio(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->training_ratio = value;
+}
+
+
+
+
+BACKPROP_SIZE_T BackpropTrainer_GetMiniBatchSize(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->minibatch_size;
+}
+
+
+
+
+void BackpropTrainer_SetMiniBatchSize(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->minibatch_size = value;
+}
+
+
+
+
+BACKPROP_SIZE_T BackpropTrainer_GetTrainThreadCount(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->train_thread_count;
+}
+
+
+
+
+void BackpropTrainer_SetTrainThreadCount(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->train_thread_count = value;
+}
+
+
+
+
+bool BackpropTrainer_GetDataParallel(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->data_parallel;
+}
+
+
+
+
+void BackpropTrainer_SetDataParallel(struct BackpropTrainer* self, bool value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->data_parallel = value;
+}
+
+
+
+
+BACKPROP_SIZE_T BackpropTrainer_GetExerciseSampleCount(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->exercise_sample_count;
+}
+
+
+
+
+void BackpropTrainer_SetExerciseSampleCount(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->exercise_sample_count = value;
+}
+
+
+
+
+BACKPROP_SIZE_T BackpropTrainer_GetExerciseThreadCount(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->exercise_thread_count;
+}
+
+
+
+
+void BackpropTrainer_SetExerciseThreadCount(struct BackpropTrainer* self, BACKPROP_SIZE_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->exercise_thread_count = value;
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_GetBatchPruneThreshold(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->batch_prune_threshold;
+}
+
+
+
+
+void BackpropTrainer_SetBatchPruneThreshold(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->batch_prune_threshold = value;
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_GetStagnateTolerance(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->stagnate_tolerance;
+}
+
+
+
+
+void BackpropTrainer_SetStagnateTolerance(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->stagnate_tolerance = value;
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_GetBatchPruneRate(const struct BackpropTrainer* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  return self->batch_prune_rate;
+}
+
+
+
+
+void BackpropTrainer_SetBatchPruneRate(struct BackpropTrainer* self, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->batch_prune_rate = value;
+}
+
+
+
+
+/** Returns the number of bytes of scratch memory used by BackpropTrainer_ExerciseBlocks().
+ */
+static size_t BackpropTrainer_ExerciseBlocksScratchSize(const struct BackpropNetwork* network)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(network);
+
+  // activation scratch, followed by the output bytes of one block
+  return BackpropNetwork_ActivateBlocksScratchSize(network) + BACKPROP_BLOCK_ROWS_COUNT * network->y.size;
+}
+
+
+
+
+/** Exercise network with count packed pairs in blocks and return the total error.
+ *  Stops after the first block that takes the total error above error_limit,
+ *  and sets activate_count to the number of pairs exercised.
+ *  If shared_error is not NULL, the error of each block is also added to it,
+ *  and it is the total compared with error_limit, so threads exercising parts of a set stop together.
+ *  Does not modify the network, jitter noise is drawn from random.
+ */
+static BACKPROP_FLOAT_T BackpropTrainer_ExerciseBlocks( const struct BackpropNetwork* network
+                                                      , BackpropRandom_t* random
+                                                      , BACKPROP_FLOAT_T* scratch
+                                                      , const BACKPROP_BYTE_T* x
+                                                      , const BACKPROP_BYTE_T* y
+                                                      , BACKPROP_SIZE_T y_size
+                                                      , size_t count
+                                                      , BACKPROP_FLOAT_T error_limit
+                                                      , uint64_t* shared_error
+                                                      , size_t* activate_count)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(scratch);
+  BACKPROP_ASSERT(x);
+  BACKPROP_ASSERT(y);
+  BACKPROP_ASSERT(activate_count);
+  {
+    const BACKPROP_SIZE_T x_size = network->x.size;
+
+    BACKPROP_BYTE_T* y_block = (BACKPROP_BYTE_T*) scratch + BackpropNetwork_ActivateBlocksScratchSize(network);
+    BACKPROP_FLOAT_T error = 0;
+    BACKPROP_FLOAT_T total_error = 0;
+
+    *activate_count = 0;
+
+    for (size_t i = 0; (i < count) && !(total_error > error_limit); i += BACKPROP_BLOCK_ROWS_COUNT)
+    {
+      const size_t rows = ((count - i) < BACKPROP_BLOCK_ROWS_COUNT) ? (count - i) : BACKPROP_BLOCK_ROWS_COUNT;
+
+      BACKPROP_FLOAT_T block_error = 0;
+
+      BackpropNetwork_ActivateBlocks(network, random, scratch, x, y_block, rows);
+
+      for (size_t r = 0; r < rows; ++r)
+      {
+        block_error += BackpropTrainer_ComputeBytesError(y_block + r * y_size, y, y_size);
+
+        x += x_size;
+        y += y_size;
+      }
+
+      error += block_error;
+      *activate_count += rows;
+
+      // pair errors are whole numbers of bits, so the shared total is kept as an integer
+      total_error = shared_error ? __atomic_add_fetch(shared_error, (uint64_t) block_error, __ATOMIC_RELAXED) : error;
+    }
+
+    return error;
+  }
+}
+
+
+
+
+/** Part of a training set exercised by one thread of BackpropTrainer_ExerciseThreads().
+ */
+typedef struct BackpropExerciseThread
+{
+  pthread_t thread;
+  bool started;                             ///< True if thread was created and must be joined.
+
+  const struct BackpropNetwork* network;
+  BackpropRandom_t* random;                 ///< Not drawn from, the network has no jitter.
+  BACKPROP_FLOAT_T* scratch;                ///< Scratch memory of the thread, see BackpropTrainer_ExerciseBlocksScratchSize().
+
+  const BACKPROP_BYTE_T* x;                 ///< First input of the part.
+  const BACKPROP_BYTE_T* y;                 ///< First desired output of the part.
+  BACKPROP_SIZE_T y_size;
+  size_t count;                             ///< Number of pairs in the part.
+  BACKPROP_FLOAT_T error_limit;             ///< The part stops once the shared error exceeds the limit.
+  uint64_t* shared_error;                   ///< Error of the blocks exercised by all the parts so far.
+
+  BACKPROP_FLOAT_T error;                   ///< Total error of the part.
+  size_t activate_count;                    ///< Number of pairs of the part exercised.
+
+} BackpropExerciseThread_t;
+
+
+
+
+static void* BackpropExerciseThread_Run(void* arg)
+{
+  BACKPROP_TRACE();
+
+  BackpropExerciseThread_t* self = arg;
+
+  BACKPROP_ASSERT(self);
+
+  self->error = BackpropTrainer_ExerciseBlocks( self->network
+                                              , self->random
+                                              , self->scratch
+                                              , self->x
+                                              , self->y
+                                              , self->y_size
+                                              , self->count
+                                              , self->error_limit
+                                              , self->shared_error
+                                              , &self->activate_count);
+
+  return NULL;
+}
+
+
+
+
+/** Exercise network with the training set split into contiguous parts over thread_count threads.
+ *  Each thread has its own activation scratch, and the network is only read.
+ *  The part errors are added in part order, and since each pair error is a whole number of bits,
+ *  the total is exactly the total of BackpropTrainer_ExerciseBlocks() over the whole set.
+ *  The calling thread exercises the first part.
+ *  The threads add the error of each block to a shared total, and every part stops at its next block boundary
+ *  once that total exceeds error_limit, so all threads together exercise at most one block each past the serial stop.
+ *  If the error of the set does not exceed error_limit, no part stops and the result does not depend on how the threads are scheduled.
+ *  Otherwise stopped is set, and the total, which then exceeds error_limit, depends on how far each part got.
+ *  Returns the total error and sets activate_count, which is 0 if the set was not exercised.
+ */
+static BACKPROP_FLOAT_T BackpropTrainer_ExerciseThreads( const struct BackpropNetwork* network
+                                                       , size_t thread_count
+                                                       , const BackpropConstTrainingSet_t* training_set
+                                                       , BACKPROP_FLOAT_T error_limit
+                                                       , BACKPROP_SIZE_T* activate_count
+                                                       , bool* stopped)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(!network->jitter);
+  BACKPROP_ASSERT(training_set);
+  BACKPROP_ASSERT(activate_count);
+  BACKPROP_ASSERT(stopped);
+  {
+    const size_t count = training_set->dims.count;
+    const BACKPROP_SIZE_T x_size = training_set->dims.x_size;
+    const BACKPROP_SIZE_T y_size = training_set->dims.y_size;
+
+    // parts are whole blocks, so threads are not given less than a block each
+    const size_t blocks_count = (count + BACKPROP_BLOCK_ROWS_COUNT - 1) / BACKPROP_BLOCK_ROWS_COUNT;
+
+    *activate_count = 0;
+
+    if (thread_count > blocks_count)
+    {
+      thread_count = blocks_count;
+    }
+
+    if (thread_count < 2)
+    {
+      return 0;
+    }
+
+    {
+      const size_t scratch_size = BACKPROP_CACHE_LINE_ALIGN(BackpropTrainer_ExerciseBlocksScratchSize(network));
+      const size_t malloc_size = thread_count * (sizeof(BackpropExerciseThread_t) + scratch_size) + BACKPROP_CACHE_LINE_SIZE - 1;
+
+      void* block = Backprop_Malloc(malloc_size);
+
+      if (!block)
+      {
+        return 0;
+      }
+
+      {
+        // scratch of each thread on its own cache lines, followed by the thread parts
+        char* scratch = BACKPROP_CACHE_LINE_ALIGN_PTR(block);
+        BackpropExerciseThread_t* threads = (BackpropExerciseThread_t*) (scratch + thread_count * scratch_size);
+
+        BACKPROP_FLOAT_T error = 0;
+        uint64_t shared_error = 0;
+        size_t first_block = 0;
+
+        for (size_t t = 0; t < thread_count; ++t)
+        {
+          BackpropExerciseThread_t* part = &threads[t];
+
+          const size_t last_block = (blocks_count * (t + 1)) / thread_count;
+          const size_t first = first_block * BACKPROP_BLOCK_ROWS_COUNT;
+          const size_t last = (last_block * BACKPROP_BLOCK_ROWS_COUNT < count) ? (last_block * BACKPROP_BLOCK_ROWS_COUNT) : count;
+
+          part->started = false;
+          part->network = network;
+          part->random = (BackpropRandom_t*) &network->random;
+          part->scratch = (BACKPROP_FLOAT_T*) (scratch + t * scratch_size);
+          part->x = training_set->x + first * x_size;
+          part->y = training_set->y + first * y_size;
+          part->y_size = y_size;
+          part->count = last - first;
+          part->error_limit = error_limit;
+          part->shared_error = &shared_error;
+          part->error = 0;
+          part->activate_count = 0;
+
+          first_block = last_block;
+        }
+
+        for (size_t t = 1; t < thread_count; ++t)
+        {
+          threads[t].started = (0 == pthread_create(&threads[t].thread, NULL, BackpropExerciseThread_Run, &threads[t]));
+        }
+
+        BackpropExerciseThread_Run(&threads[0]);
+
+        for (size_t t = 1; t < thread_count; ++t)
+        {
+          if (threads[t].started)
+          {
+            pthread_join(threads[t].thread, NULL);
+          }
+
+          else
+          {
+            // the thread could not be created, so exercise its part here
+            BackpropExerciseThread_Run(&threads[t]);
+          }
+        }
+
+        *stopped = false;
+
+        for (size_t t = 0; t < thread_count; ++t)
+        {
+          error += threads[t].error;
+          *activate_count += threads[t].activate_count;
+          *stopped = *stopped || (threads[t].activate_count < threads[t].count);
+        }
+
+        Backprop_Free(block, malloc_size);
+
+        return error;
+      }
+    }
+  }
+}
+
+
+
+
+/** Exercise network with the training set until the total error exceeds error_limit.
+ *  Without per pair events the set is exercised in blocks, and the error is checked after each block,
+ *  otherwise it is checked after each pair.
+ *  Sets stats->stopped if pairs were left unexercised, the error is then a lower bound of the error of the set.
+ */
+static BACKPROP_FLOAT_T BackpropTrainer_ExerciseConstBounded( BackpropTrainer_t* trainer
+                                                            , BackpropExerciseStats_t* stats
+                                                            , struct BackpropNetwork* network
+                                                            , const BackpropConstTrainingSet_t* training_set
+                                                            , BACKPROP_FLOAT_T error_limit)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(stats);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(training_set);
+  {
+    const long int clock_start = clock();
+
+    BACKPROP_FLOAT_T error = 0;
+
+    const BACKPROP_BYTE_T* x = training_set->x;
+    const BACKPROP_BYTE_T* y = training_set->y;
+    const BACKPROP_SIZE_T x_size = training_set->dims.x_size;
+
+    const size_t count = training_set->dims.count;
+
+    memset(stats, 0, sizeof(BackpropExerciseStats_t));
+
+    // every pair of the set reuses the same weights
+    BackpropNetwork_UpdateInputTable(network);
+
+    // without per pair events, exercise the set in blocks
+    if (count && !trainer->events.AfterInput && !trainer->events.AfterActivate)
+    {
+
+      // threads share the network, so they cannot share its jitter PRNG
+      if ((trainer->exercise_thread_count > 1) && !network->jitter)
+      {
+        error = BackpropTrainer_ExerciseThreads(network, trainer->exercise_thread_count, training_set, error_limit, &stats->activate_count, &stats->stopped);
+      }
+
+      if (!stats->activate_count)
+      {
+        const size_t scratch_size = BackpropTrainer_ExerciseBlocksScratchSize(network);
+
+        BACKPROP_FLOAT_T* scratch = Backprop_Malloc(scratch_size);
+
+        if (scratch)
+        {
+          size_t activate_count = 0;
+
+          error = BackpropTrainer_ExerciseBlocks(network, &network->random, scratch, x, y, training_set->dims.y_size, count, error_limit, NULL, &activate_count);
+          stats->activate_count = activate_count;
+          stats->stopped = (activate_count < count);
+
+          Backprop_Free(scratch, scratch_size);
+        }
+      }
+
+      x += stats->activate_count * x_size;
+      y += stats->activate_count * training_set->dims.y_size;
+    }
+
+    for(size_t i = stats->activate_count; !stats->stopped && (i < count); ++i)
+    {
+      BackpropNetwork_Input(network, x, x_size);
+
+      if (trainer->events.AfterInput)
+      {
+        trainer->events.AfterInput(trainer, network, x, x_size);
+      }
+
+      BackpropNetwork_Activate(network);
+
+      if (trainer->events.AfterActivate)
+      {
+        trainer->events.AfterActivate(trainer, network);
+      }
+
+      error += BackpropTrainer_ComputeError(network, y, training_set->dims.y_size);
+
+      x += training_set->dims.x_size;
+      y += training_set->dims.y_size;
+
+      ++(stats->activate_count);
+
+      stats->stopped = (error > error_limit) && (i + 1 < count);
+    }
+
+    {
+      const long int clock_stop = clock();
+      stats->exercise_clock_ticks += (clock_stop - clock_start);
+    }
+
+    stats->error += error;
+    return error;
+  }
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_ExerciseConst(BackpropTrainer_t* trainer, BackpropExerciseStats_t* stats, struct BackpropNetwork* network, const BackpropConstTrainingSet_t* training_set)
+{
+  BACKPROP_TRACE();
+
+  return BackpropTrainer_ExerciseConstBounded(trainer, stats, network, training_set, HUGE_VAL);
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_Exercise(BackpropTrainer_t* trainer, BackpropExerciseStats_t* stats, struct BackpropNetwork* network, const BackpropTrainingSet_t* training_set)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(stats);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(training_set);
+  {
+    BackpropConstTrainingSet_t const_training_set;
+    const_training_set.dims = training_set->dims;
+
+    const_training_set.x = training_set->x;
+    const_training_set.y = training_set->y;
+
+    return BackpropTrainer_ExerciseConst(trainer, stats, network, &const_training_set);
+  }
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_ExerciseBounded( BackpropTrainer_t* trainer
+                                                , BackpropExerciseStats_t* stats
+                                                , struct BackpropNetwork* network
+                                                , const BackpropTrainingSet_t* training_set
+                                                , BACKPROP_FLOAT_T error_limit)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(stats);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(training_set);
+  {
+    BackpropConstTrainingSet_t const_training_set;
+    const_training_set.dims = training_set->dims;
+
+    const_training_set.x = training_set->x;
+    const_training_set.y = training_set->y;
+
+    return BackpropTrainer_ExerciseConstBounded(trainer, stats, network, &const_training_set, error_limit);
+  }
+}
+
+
+
+
+/** Estimate the error of network over the training set from exercise_sample_count pairs drawn at random.
+ *  Returns the estimated total error, and the largest error of a sampled pair in max_error.
+ *  stats->error_bound is set to the half width of the confidence interval of the estimate.
+ */
+static BACKPROP_FLOAT_T BackpropTrainer_ExerciseSample( BackpropTrainer_t* trainer
+                                                      , BackpropExerciseStats_t* stats
+                                                      , struct BackpropNetwork* network
+                                                      , const BackpropTrainingSet_t* training_set
+                                                      , BACKPROP_FLOAT_T* max_error)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(stats);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(training_set);
+  BACKPROP_ASSERT(max_error);
+  BACKPROP_ASSERT(trainer->exercise_sample_count > 1);
+  {
+    const long int clock_start = clock();
+
+    const BACKPROP_SIZE_T x_size = training_set->dims.x_size;
+    const BACKPROP_SIZE_T y_size = training_set->dims.y_size;
+    const size_t count = training_set->dims.count;
+    const size_t n = trainer->exercise_sample_count;
+
+    BACKPROP_FLOAT_T sum = 0;
+    BACKPROP_FLOAT_T sum_squares = 0;
+
+    memset(stats, 0, sizeof(BackpropExerciseStats_t));
+    *max_error = 0;
+
+    // every sampled pair reuses the same weights
+    BackpropNetwork_UpdateInputTable(network);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      const size_t k = BackpropRandom_ArrayIndex(&trainer->random, 0, count);
+      const BACKPROP_BYTE_T* x = training_set->x + k * x_size;
+
+      BackpropNetwork_Input(network, x, x_size);
+
+      if (trainer->events.AfterInput)
+      {
+        trainer->events.AfterInput(trainer, network, x, x_size);
+      }
+
+      BackpropNetwork_Activate(network);
+
+      if (trainer->events.AfterActivate)
+      {
+        trainer->events.AfterActivate(trainer, network);
+      }
+
+      {
+        const BACKPROP_FLOAT_T error = BackpropTrainer_ComputeError(network, training_set->y + k * y_size, y_size);
+
+        sum += error;
+        sum_squares += error * error;
+
+        if (error > *max_error)
+        {
+          *max_error = error;
+        }
+      }
+
+      ++(stats->activate_count);
+    }
+
+    {
+      const BACKPROP_FLOAT_T mean = sum / n;
+      const BACKPROP_FLOAT_T variance = (sum_squares - sum * mean) / (n - 1);
+
+      stats->error = count * mean;
+      stats->error_bound = BACKPROP_EXERCISE_SAMPLE_Z * count * sqrt(((variance > 0) ? variance : 0) / n);
+    }
+
+    {
+      const long int clock_stop = clock();
+      stats->exercise_clock_ticks += (clock_stop - clock_start);
+    }
+
+    return stats->error;
+  }
+}
+
+
+
+
+struct BackpropExerciseCache
+{
+  BackpropExerciseRecord_t* records;  ///< Open addressed by network, records without a network are unused.
+  size_t records_count;               ///< Power of 2, at least twice the number of networks, so probes stay short.
+};
+
+
+
+
+/** Returns the first record to probe for network.
+ */
+static size_t BackpropExerciseCache_Hash(const struct BackpropExerciseCache* self, const struct BackpropNetwork* network)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  // networks are cache line aligned, so mix in the high bits before masking
+  return (size_t) ((((uint64_t) (uintptr_t) network) * 0x9E3779B97F4A7C15ull) >> 32) & (self->records_count - 1);
+}
+
+
+
+
+struct BackpropExerciseCache* BackpropExerciseCache_Malloc(struct BackpropNetwork* const* networks, size_t count)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(networks || !count);
+  {
+    struct BackpropExerciseCache* self = Backprop_Malloc(sizeof(struct BackpropExerciseCache));
+
+    if (!self)
+    {
+      return NULL;
+    }
+
+    self->records_count = 2;
+
+    while (self->records_count < 2 * count)
+    {
+      self->records_count *= 2;
+    }
+
+    self->records = Backprop_Malloc(self->records_count * sizeof(BackpropExerciseRecord_t));
+
+    if (!self->records)
+    {
+      Backprop_Free(self, sizeof(struct BackpropExerciseCache));
+      return NULL;
+    }
+
+    memset(self->records, 0, self->records_count * sizeof(BackpropExerciseRecord_t));
+
+    // the networks never change, so each keeps the record it is given here
+    for (size_t i = 0; i < count; ++i)
+    {
+      size_t k = BackpropExerciseCache_Hash(self, networks[i]);
+
+      while (self->records[k].network && (self->records[k].network != networks[i]))
+      {
+        k = (k + 1) & (self->records_count - 1);
+      }
+
+      self->records[k].network = networks[i];
+    }
+
+    return self;
+  }
+}
+
+
+
+
+void BackpropExerciseCache_Free(struct BackpropExerciseCache* self)
+{
+  BACKPROP_TRACE();
+
+  if (!self)
+  {
+    return;
+  }
+
+  Backprop_Free(self->records, self->records_count * sizeof(BackpropExerciseRecord_t));
+  Backprop_Free(self, sizeof(struct BackpropExerciseCache));
+}
+
+
+
+
+void BackpropExerciseCache_Clear(struct BackpropExerciseCache* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  for (size_t i = 0; i < self->records_count; ++i)
+  {
+    self->records[i].training_set = NULL;
+    self->records[i].weights_version = 0;
+  }
+}
+
+
+
+
+BackpropExerciseRecord_t* BackpropExerciseCache_Find(struct BackpropExerciseCache* self, const struct BackpropNetwork* network)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(network);
+  {
+    size_t k = BackpropExerciseCache_Hash(self, network);
+
+    while (self->records[k].network)
+    {
+      if (self->records[k].network == network)
+      {
+        return &self->records[k];
+      }
+
+      k = (k + 1) & (self->records_count - 1);
+    }
+
+    return NULL;
+  }
+}
+
+
+
+
+/** Returns the error of network over the training set of the session.
+ *  The last whole set exercise of the network in the session is reused if the weights have not changed since.
+ *  The whole set exercise stops once the error exceeds error_limit, so pass HUGE_VAL unless the caller
+ *  only compares the error with the limit. A stopped exercise is not reused.
+ *  With a limit, a sample also replaces the whole set if it shows that the error is above the error tolerance,
+ *  either because one sampled pair exceeds it, or because the confidence interval of the estimate lies above it.
+ *  Either way session->exercise_stats->stopped is set, and the error returned is only good for the comparison.
+ */
+static BACKPROP_FLOAT_T BackpropTrainer_ExerciseSession( BackpropTrainer_t* trainer
+                                                       , struct BackpropNetwork* network
+                                                       , struct BackpropTrainingSession* session
+                                                       , BACKPROP_FLOAT_T error_limit)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(session);
+  {
+    BackpropExerciseRecord_t* last = session->exercise_cache ? BackpropExerciseCache_Find(session->exercise_cache, network) : NULL;
+
+    if (!last)
+    {
+      last = &session->last_exercise;
+    }
+
+    // jitter and per pair events make each exercise differ
+    const bool reusable = !network->jitter && !trainer->events.AfterInput && !trainer->events.AfterActivate;
+    const uint64_t weights_version = BackpropNetwork_GetWeightsVersion(network);
+
+    BACKPROP_FLOAT_T error = 0;
+
+    if (   reusable && weights_version
+        && (last->network == network) && (last->training_set == session->training_set) && (last->weights_version == weights_version))
+    {
+      *session->exercise_stats = last->stats;
+      return last->stats.error;
+    }
+
+    // an estimate is never returned as the error of the set, so only sample when the caller compares
+    if (   (error_limit < HUGE_VAL)
+        && (trainer->exercise_sample_count > 1) && (trainer->exercise_sample_count < session->training_set->dims.count))
+    {
+      BACKPROP_FLOAT_T max_error = 0;
+
+      error = BackpropTrainer_ExerciseSample(trainer, session->exercise_stats, network, session->training_set, &max_error);
+      session->activate_total += session->exercise_stats->activate_count;
+
+      if ((max_error > trainer->error_tolerance) || ((error - session->exercise_stats->error_bound) > trainer->error_tolerance))
+      {
+        session->exercise_stats->stopped = true;
+        return error;
+      }
+    }
+
+    error = BackpropTrainer_ExerciseBounded(trainer, session->exercise_stats, network, session->training_set, error_limit);
+    session->activate_total += session->exercise_stats->activate_count;
+
+    if (reusable && !session->exercise_stats->stopped)
+    {
+      last->network = network;
+      last->training_set = session->training_set;
+      last->weights_version = weights_version;
+      last->stats = *session->exercise_stats;
+    }
+
+    return error;
+  }
+}
+
+
+
+
+/** Returns the number of weights before the next mutated one, drawn from a geometric distribution
+ *  with log_q the log of the probability a weight is not mutated, at most remaining.
+ */
+static BACKPROP_SIZE_T BackpropTrainer_MutationGap(BackpropRandom_t* random, double log_q, BACKPROP_SIZE_T remaining)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(random);
+  BACKPROP_ASSERT(log_q < 0);
+  {
+    const double gap = log(1.0 - BackpropRandom_UniformFloat(random)) / log_q;
+
+    // a tiny probability gives gaps past the range of BACKPROP_SIZE_T, infinite if 1.0 - U is 0, so clamp before the cast
+    return (gap < (double) remaining) ? (BACKPROP_SIZE_T) gap : remaining;
+  }
+}
+
+
+
+
+/** Add random mutations drawn from random to count weights.
+ *  Each weight is mutated with probability mutation_probability.
+ */
+static void BackpropTrainer_MutateWeights(const BackpropTrainer_t* trainer, BackpropRandom_t* random, BACKPROP_FLOAT_T* W, BACKPROP_SIZE_T count)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(random);
+  BACKPROP_ASSERT(W);
+  {
+    const BACKPROP_FLOAT_T p = trainer->mutation_probability;
+
+    if (p >= 1)
+    {
+      BackpropRandom_AddWeights(random, W, count, trainer->mutation_rate);
+    }
+
+    else if (p > 0)
+    {
+      // the gaps between mutated weights are geometric, so draw the gaps instead of a number per weight
+      const double log_q = log1p(-p);
+
+      BACKPROP_SIZE_T j = BackpropTrainer_MutationGap(random, log_q, count);
+
+      while (j < count)
+      {
+        W[j] += trainer->mutation_rate * (2.0 * BackpropRandom_UniformFloat(random) - 1.0);
+
+        j += 1 + BackpropTrainer_MutationGap(random, log_q, count - j - 1);
+      }
+    }
+  }
+}
+
+
+
+
+/** Forward pass kept between the teaches of one pair by BackpropTrainer_TrainPair().
+ */
+typedef struct BackpropTrainerForward
+{
+  bool valid;                         ///< True if the network is activated for the pair and the errors below are current.
+  BACKPROP_FLOAT_T last_layer_error;  ///< Last layer error of the activation.
+  BACKPROP_FLOAT_T error;             ///< Output bit error of the activation.
+
+} BackpropTrainerForward_t;
+
+
+
+
+/** Teach one pair, as BackpropTrainer_TeachPair().
+ *  If forward is valid, the network is already activated for the pair and the input and activation are skipped,
+ *  along with their events, which already fired for the same state.
+ *  If forward is not NULL, it is left holding the activation that follows the weight update.
+ */
+static BACKPROP_FLOAT_T BackpropTrainer_TeachPairForward( BackpropTrainer_t* trainer
+                                                        , BackpropTrainingStats_t* stats
+                                                        , struct BackpropNetwork* network
+                                                        , const BACKPROP_BYTE_T* x, BACKPROP_SIZE_T x_size
+                                                        , const BACKPROP_BYTE_T* y_desired, BACKPROP_SIZE_T y_desired_size
+                                                        , BackpropTrainerForward_t* forward)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(x);
+  BACKPROP_ASSERT(x_size);
+  BACKPROP_ASSERT(y_desired);
+  BACKPROP_ASSERT(y_desired_size);
+  BACKPROP_ASSERT(network->layers.count > 1);
+  {
+    const BackpropKernels_t* kernels = Backprop_GetKernels();
+    BACKPROP_FLOAT_T error = 0;
+    BACKPROP_FLOAT_T weight_correction_total = 0;
+
+    BACKPROP_FLOAT_T begin_last_layer_error = 0;
+
+    if (trainer->events.BeforeTeachPair)
+    {
+      trainer->events.BeforeTeachPair(trainer, stats, network, x, x_size, y_desired, y_desired_size);
+    }
+
+    if (forward && forward->valid)
+    {
+      begin_last_layer_error = forward->last_layer_error;
+      error = forward->error;
+    }
+
+    else
+    {
+      BackpropNetwork_Input(network, x, x_size);
+
+      if (trainer->events.AfterInput)
+      {
+        trainer->events.AfterInput(trainer, network, x, x_size);
+      }
+
+      BackpropNetwork_Activate(network);
+
+      if (trainer->events.AfterActivate)
+      {
+        trainer->events.AfterActivate(trainer, network);
+      }
+
+      begin_last_layer_error = BackpropTrainer_ComputeLastLayerError(network, y_desired, y_desired_size);
+
+      if (trainer->events.AfterComputeLastLayerError)
+      {
+        trainer->events.AfterComputeLastLayerError(trainer, network, begin_last_layer_error);
+      }
+
+      error = BackpropTrainer_ComputeError(network, y_desired, y_desired_size);
+
+      if (trainer->events.AfterComputeError)
+      {
+        trainer->events.AfterComputeError(trainer, network, error);
+      }
+    }
+
+    if (error < trainer->error_tolerance)
+    {
+      return error;
+    }
+
+   {
+      // update the output layer
+      BackpropLayer_t* layer = BackpropNetwork_GetLastLayer(network);
+
+      BACKPROP_FLOAT_T* W = layer->W;
+      BackpropLayer_Touch(layer);
+      BACKPROP_FLOAT_T* g = layer->g;
+      BACKPROP_FLOAT_T* y = layer->y;
+      const BACKPROP_BYTE_T* yd = y_desired;
+
+      BACKPROP_FLOAT_T* const velocity = BackpropTrainer_GetVelocity(trainer, network);
+      BACKPROP_FLOAT_T* V = BackpropTrainer_GetLayerVelocity(velocity, network, network->layers.count - 1);
+
+      size_t size = y_desired_size;
+      do
+      {
+        size_t yd_bit = 1;
+
+        size_t b = CHAR_BIT;
+        do
+        {
+          const BACKPROP_FLOAT_T yd_bit_value = 0 < ((*yd) & yd_bit);
+          const BACKPROP_FLOAT_T output_error = (yd_bit_value - (*y));
+          const BACKPROP_FLOAT_T local_gradient = (*y) * (1 - (*y));
+          const BACKPROP_FLOAT_T local_gradient_output_error = local_gradient * output_error;
+          const BACKPROP_FLOAT_T correction_strength = (trainer->learning_rate) * local_gradient_output_error;
+
+          *g = local_gradient_output_error;
+
+          // update the layer weights
+          if (V)
+          {
+            weight_correction_total += kernels->MomentumAbsSum(W, V, trainer->momentum_rate, correction_strength, layer->x, layer->x_count);
+            V += layer->W_stride;
+          }
+          else
+          {
+            weight_correction_total += kernels->AxpyAbsSum(W, correction_strength, layer->x, layer->x_count);
+          }
+
+          if (trainer->mutation_rate)
+          {
+            BackpropTrainer_MutateWeights(trainer, &trainer->random, W, layer->x_count);
+          }
+
+          W += layer->W_stride;
+
+          yd_bit <<= 1;
+          ++g;
+          ++y;
+
+        } while (--b);
+
+        ++yd;
+
+      } while(--size);
+
+
+      // compute error and update weights
+      for(BACKPROP_SIZE_T k = network->layers.count - 1; k > 0; --k)  // for each layer in the network
+      {
+        BackpropLayer_t* pl_next = &network->layers.data[k];
+        layer = &network->layers.data[k-1];
+
+        // calculate weighted gradient of next layer
+        BackpropLayer_WeightedGradient(pl_next, layer->g);
+
+        // calculate the error
+        W = layer->W;
+        BackpropLayer_Touch(layer);
+        V = BackpropTrainer_GetLayerVelocity(velocity, network, k-1);
+
+        for(size_t i = 0; i < layer->y_count; ++i)
+        {
+          layer->g[i] *= layer->y[i] * (1 - layer->y[i]);  // local gradient
+
+          //                   learning rate *   gradient    *   signal
+          const BACKPROP_FLOAT_T correction_strength = (trainer->learning_rate) * (layer->g[i]);
+
+          if (V)
+          {
+            weight_correction_total += kernels->MomentumAbsSum(W, V, trainer->momentum_rate, correction_strength, layer->x, layer->x_count);
+            V += layer->W_stride;
+          }
+          else
+          {
+            weight_correction_total += kernels->AxpyAbsSum(W, correction_strength, layer->x, layer->x_count);
+          }
+
+          if (trainer->mutation_rate)
+          {
+            BackpropTrainer_MutateWeights(trainer, &trainer->random, W, layer->x_count);
+          }
+
+          W += layer->W_stride;
+        }
+      }
+    }
+
+    // re-activate the network and compute the new error
+    BackpropNetwork_Activate(network);
+
+    if (trainer->events.AfterActivate)
+    {
+      trainer->events.AfterActivate(trainer, network);
+    }
+
+    const BACKPROP_FLOAT_T end_last_layer_error = BackpropTrainer_ComputeLastLayerError(network, y_desired, y_desired_size);
+
+    if (trainer->events.AfterComputeLastLayerError)
+    {
+      trainer->events.AfterComputeLastLayerError(trainer, network, end_last_layer_error);
+    }
+
+    error = BackpropTrainer_ComputeError(network, y_desired, y_desired_size);
+
+    if (trainer->events.AfterComputeError)
+    {
+      trainer->events.AfterComputeError(trainer, network, error);
+    }
+
+    stats->pair_error_correction = end_last_layer_error - begin_last_layer_error;
+
+    if (forward)
+    {
+      // with jitter the next teach must draw a new input
+      forward->valid = !network->jitter;
+      forward->last_layer_error = end_last_layer_error;
+      forward->error = error;
+    }
+
+    if (trainer->events.AfterTeachPair)
+    {
+      trainer->events.AfterTeachPair(trainer, stats, network, x, x_size, y_desired, y_desired_size, network->y.data, network->y.size, error, weight_correction_total);
+    }
+
+
+    stats->batch_weight_correction_total += weight_correction_total;
+    stats->set_weight_correction_total += weight_correction_total;
+
+    ++stats->teach_total;
+
+    return error;
+  }
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_TeachPair( BackpropTrainer_t* trainer
+                                          , BackpropTrainingStats_t* stats
+                                          , struct BackpropNetwork* network
+                                          , const BACKPROP_BYTE_T* x, BACKPROP_SIZE_T x_size
+                                          , const BACKPROP_BYTE_T* y_desired, BACKPROP_SIZE_T y_desired_size)
+{
+  BACKPROP_TRACE();
+
+  return BackpropTrainer_TeachPairForward(trainer, stats, network, x, x_size, y_desired, y_desired_size, NULL);
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_TrainPair( BackpropTrainer_t* trainer
                                           , BackpropTrainingStats_t* stats
                                           , struct BackpropNetwork* network
                                           , const BACKPROP_BYTE_T* x, BACKPROP_SIZE_T x_size
@@ -2620,884 +5484,3335 @@ BACKPROP_FLOAT_T BackpropTrainer_TeachPair( BackpropTrainer_t* trainer
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(stats);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(x);
+  BACKPROP_ASSERT(x_size);
+  BACKPROP_ASSERT(y_desired);
+  BACKPROP_ASSERT(y_desired_size);
+  {
+    const BACKPROP_FLOAT_T tolerance = trainer->error_tolerance;
+    size_t reps = trainer->max_reps;
+    BACKPROP_FLOAT_T error = 0;
+
+    // each repetition starts from the activation that ended the previous one
+    BackpropTrainerForward_t forward = {.valid = false};
+
+    if (trainer->events.BeforeTrainPair)
+    {
+      trainer->events.BeforeTrainPair(trainer, stats, network, x, x_size, y_desired, y_desired_size);
+    }
+
+    do
+    {
+      error = BackpropTrainer_TeachPairForward(trainer, stats, network, x, x_size, y_desired, y_desired_size, &forward);
+
+    } while (--reps && (error > tolerance));
+
+
+    if (trainer->events.AfterTrainPair)
+    {
+      trainer->events.AfterTrainPair(trainer, stats, network, x, x_size, y_desired, y_desired_size, network->y.data, network->y.size, error);
+    }
+
+    ++stats->pair_total;
+
+    return error;
+  }
+}
+
+
+
+
+/** Returns the number of bytes of scratch memory used by BackpropTrainer_TeachMiniBatch() for rows pairs.
+ */
+static size_t BackpropTrainer_MiniBatchScratchSize(const struct BackpropNetwork* network, BACKPROP_SIZE_T rows)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(network);
+  {
+    // first layer inputs, and the outputs and gradients of every layer, for each row
+    size_t count = rows * network->layers.data[0].x_count;
+
+    for (size_t k = 0; k < network->layers.count; ++k)
+    {
+      count += 2 * rows * network->layers.data[k].y_count;
+    }
+
+    // one weight row of summed corrections
+    count += BackpropNetwork_GetMaxLayerCount(network);
+
+    // output bytes of one pair, rounded up to keep the indexes aligned
+    count += (network->y.size + sizeof(BACKPROP_FLOAT_T) - 1) / sizeof(BACKPROP_FLOAT_T);
+
+    return count * sizeof(BACKPROP_FLOAT_T) + rows * sizeof(size_t);
+  }
+}
+
+
+
+
+/** Mini-batch buffers in scratch memory, see BackpropTrainer_MiniBatchScratchSize().
+ */
+typedef struct BackpropTrainerMiniBatch
+{
+  BACKPROP_FLOAT_T* X0;             ///< First layer inputs [rows][x_count of layer 0].
+  BACKPROP_FLOAT_T** Y;             ///< Outputs of each layer [rows][y_count].
+  BACKPROP_FLOAT_T** G;             ///< Gradients of each layer [rows][y_count].
+  BACKPROP_FLOAT_T* D;              ///< One weight row of summed corrections.
+  BACKPROP_BYTE_T* y_bytes;         ///< Output bytes of one pair.
+
+} BackpropTrainerMiniBatch_t;
+
+
+
+
+/** Place the buffers of a mini-batch of rows pairs in scratch.
+ *  Y and G must hold a pointer for each network layer.
+ */
+static void BackpropTrainer_MiniBatchLayout( const struct BackpropNetwork* network
+                                           , BACKPROP_SIZE_T rows
+                                           , BACKPROP_FLOAT_T* scratch
+                                           , BackpropTrainerMiniBatch_t* batch)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(scratch);
+  BACKPROP_ASSERT(batch);
+  {
+    // X0, then Y and G of each layer, then D, then the output bytes
+    BACKPROP_FLOAT_T* ptr = scratch + rows * network->layers.data[0].x_count;
+
+    batch->X0 = scratch;
+
+    for (size_t k = 0; k < network->layers.count; ++k)
+    {
+      batch->Y[k] = ptr;
+      batch->G[k] = batch->Y[k] + rows * network->layers.data[k].y_count;
+      ptr = batch->G[k] + rows * network->layers.data[k].y_count;
+    }
+
+    batch->D = ptr;
+    batch->y_bytes = (BACKPROP_BYTE_T*) (batch->D + BackpropNetwork_GetMaxLayerCount(network));
+  }
+}
+
+
+
+
+/** Run the forward and backward passes of the rows training set pairs at indexes,
+ *  as blocked matrix products, leaving the layer outputs and gradients in batch.
+ *  Pairs already within the error tolerance get zero gradients, as in BackpropTrainer_TeachPair(),
+ *  and teach_count is set to the number of the other pairs, which are taught.
+ *  Input jitter is drawn from input_random.  Only batch is written.
+ *  Returns the sum of the pair errors.
+ */
+static BACKPROP_FLOAT_T BackpropTrainer_MiniBatchBackward( const BackpropTrainer_t* trainer
+                                                         , const struct BackpropNetwork* network
+                                                         , const BackpropTrainingSet_t* training_set
+                                                         , const size_t* indexes
+                                                         , BACKPROP_SIZE_T rows
+                                                         , BackpropTrainerMiniBatch_t* batch
+                                                         , BackpropRandom_t* input_random
+                                                         , BACKPROP_SIZE_T* teach_count)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(training_set);
+  BACKPROP_ASSERT(indexes);
+  BACKPROP_ASSERT(rows);
+  BACKPROP_ASSERT(batch);
+  BACKPROP_ASSERT(input_random);
+  BACKPROP_ASSERT(teach_count);
+  {
+    const BackpropKernels_t* kernels = Backprop_GetKernels();
+    const BACKPROP_SIZE_T layers_count = network->layers.count;
+    const BACKPROP_SIZE_T x_size = training_set->dims.x_size;
+    const BACKPROP_SIZE_T y_size = training_set->dims.y_size;
+
+    BACKPROP_FLOAT_T* const X0 = batch->X0;
+    BACKPROP_FLOAT_T** const Y = batch->Y;
+    BACKPROP_FLOAT_T** const G = batch->G;
+
+    BACKPROP_FLOAT_T error = 0;
+
+    *teach_count = 0;
+
+    // forward pass
+    for (size_t r = 0; r < rows; ++r)
+    {
+      BackpropNetwork_BytesToLayer0(network, input_random, training_set->x + indexes[r] * x_size, X0 + r * network->layers.data[0].x_count);
+    }
+
+    for (size_t k = 0; k < layers_count; ++k)
+    {
+      BackpropLayer_ActivateBlock(&network->layers.data[k], k ? Y[k - 1] : X0, Y[k], rows);
+    }
+
+    // output layer gradient
+    {
+      const BackpropLayer_t* layer = BackpropNetwork_GetConstLastLayer(network);
+      const BACKPROP_SIZE_T y_count = layer->y_count;
+
+      for (size_t r = 0; r < rows; ++r)
+      {
+        const BACKPROP_BYTE_T* yd = training_set->y + indexes[r] * y_size;
+        const BACKPROP_FLOAT_T* y = Y[layers_count - 1] + r * y_count;
+        BACKPROP_FLOAT_T* g = G[layers_count - 1] + r * y_count;
+
+        Backprop_FloatsToBytes(y, batch->y_bytes, y_size);
+
+        const BACKPROP_FLOAT_T pair_error = BackpropTrainer_ComputeBytesError(batch->y_bytes, yd, y_size);
+        error += pair_error;
+
+        // pairs within tolerance are not taught, as BackpropTrainer_TeachPair() does not count them
+        *teach_count += (pair_error >= trainer->error_tolerance);
+
+        for (size_t n = 0; n < y_count; ++n)
+        {
+          const BACKPROP_FLOAT_T yd_bit_value = (yd[n / CHAR_BIT] >> (n % CHAR_BIT)) & 1;
+
+          g[n] = (pair_error < trainer->error_tolerance) ? 0 : y[n] * (1 - y[n]) * (yd_bit_value - y[n]);
+        }
+      }
+    }
+
+    // backward pass, G[k-1] = (G[k] * W[k]) .* Y[k-1] .* (1 - Y[k-1])
+    for (size_t k = layers_count - 1; k > 0; --k)
+    {
+      const BackpropLayer_t* layer = &network->layers.data[k];
+      const BACKPROP_SIZE_T x_count = layer->x_count;
+      const BACKPROP_FLOAT_T* W = layer->W;
+
+      memset(G[k - 1], 0, rows * x_count * sizeof(BACKPROP_FLOAT_T));
+
+      // each weight row is reused for every pair while it is in cache
+      for (size_t n = 0; n < layer->y_count; ++n)
+      {
+        for (size_t r = 0; r < rows; ++r)
+        {
+          kernels->Axpy(G[k - 1] + r * x_count, G[k][r * layer->y_count + n], W, x_count);
+        }
+
+        W += layer->W_stride;
+      }
+
+      for (size_t i = 0; i < rows * x_count; ++i)
+      {
+        G[k - 1][i] *= Y[k - 1][i] * (1 - Y[k - 1][i]);
+      }
+    }
+
+    return error;
+  }
+}
+
+
+
+
+/** Sum the corrections of the rows pairs of batch to weight row n of layer k into D, D = G[k][:,n]' * X[k].
+ */
+static void BackpropTrainer_MiniBatchCorrection( const struct BackpropNetwork* network
+                                               , const BackpropTrainerMiniBatch_t* batch
+                                               , BACKPROP_SIZE_T rows
+                                               , size_t k
+                                               , size_t n
+                                               , BACKPROP_FLOAT_T* D)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(batch);
+  BACKPROP_ASSERT(D);
+  {
+    const BackpropKernels_t* kernels = Backprop_GetKernels();
+    const BACKPROP_SIZE_T x_count = network->layers.data[k].x_count;
+    const BACKPROP_SIZE_T y_count = network->layers.data[k].y_count;
+    const BACKPROP_FLOAT_T* X = k ? batch->Y[k - 1] : batch->X0;
+
+    memset(D, 0, x_count * sizeof(BACKPROP_FLOAT_T));
+
+    for (size_t r = 0; r < rows; ++r)
+    {
+      kernels->Axpy(D, batch->G[k][r * y_count + n], X + r * x_count, x_count);
+    }
+  }
+}
+
+
+
+
+/** Add learning rate times the summed corrections D to the x_count weights of row W, with momentum if V is not NULL,
+ *  then mutate the row with mutations drawn from random.
+ *  Returns the sum of the absolute weight changes.
+ */
+static BACKPROP_FLOAT_T BackpropTrainer_ApplyCorrection( const BackpropTrainer_t* trainer
+                                                       , BackpropRandom_t* random
+                                                       , BACKPROP_FLOAT_T* W
+                                                       , BACKPROP_FLOAT_T* V
+                                                       , const BACKPROP_FLOAT_T* D
+                                                       , BACKPROP_SIZE_T x_count)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(W);
+  BACKPROP_ASSERT(D);
+  {
+    const BackpropKernels_t* kernels = Backprop_GetKernels();
+
+    BACKPROP_FLOAT_T weight_correction = 0;
+
+    if (V)
+    {
+      weight_correction = kernels->MomentumAbsSum(W, V, trainer->momentum_rate, trainer->learning_rate, D, x_count);
+    }
+    else
+    {
+      weight_correction = kernels->AxpyAbsSum(W, trainer->learning_rate, D, x_count);
+    }
+
+    if (trainer->mutation_rate)
+    {
+      BackpropTrainer_MutateWeights(trainer, random, W, x_count);
+    }
+
+    return weight_correction;
+  }
+}
+
+
+
+
+/** Teach the rows training set pairs at indexes with one weight update per layer.
+ *  The forward and backward passes run over all rows as blocked matrix products,
+ *  and each weight row receives the sum of the corrections of every pair.
+ *  Pairs already within the error tolerance make no correction, as in BackpropTrainer_TeachPair().
+ *  Input jitter is drawn from input_random and mutations from random.
+ *  Only the network weights and the trainer velocities are written, so several threads may teach one network.
+ *  Returns the sum of the pair errors before the update.
+ */
+static BACKPROP_FLOAT_T BackpropTrainer_TeachMiniBatch( BackpropTrainer_t* trainer
+                                                      , BackpropTrainingStats_t* stats
+                                                      , struct BackpropNetwork* network
+                                                      , const BackpropTrainingSet_t* training_set
+                                                      , const size_t* indexes
+                                                      , BACKPROP_SIZE_T rows
+                                                      , BACKPROP_FLOAT_T* scratch
+                                                      , BackpropRandom_t* input_random
+                                                      , BackpropRandom_t* random)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(stats);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(training_set);
+  BACKPROP_ASSERT(indexes);
+  BACKPROP_ASSERT(rows);
+  BACKPROP_ASSERT(scratch);
+  BACKPROP_ASSERT(input_random);
+  BACKPROP_ASSERT(random);
+  {
+    const BACKPROP_SIZE_T layers_count = network->layers.count;
+
+    BACKPROP_FLOAT_T* Y[layers_count];
+    BACKPROP_FLOAT_T* G[layers_count];
+    BackpropTrainerMiniBatch_t batch = { .Y = Y, .G = G };
+
+    BACKPROP_FLOAT_T weight_correction_total = 0;
+    BACKPROP_SIZE_T teach_count = 0;
+
+    BackpropTrainer_MiniBatchLayout(network, rows, scratch, &batch);
+
+    const BACKPROP_FLOAT_T error = BackpropTrainer_MiniBatchBackward(trainer, network, training_set, indexes, rows, &batch, input_random, &teach_count);
+
+    // one fused update per layer, W[k] += learning rate * G[k]' * X[k]
+    BACKPROP_FLOAT_T* V = BackpropTrainer_GetVelocity(trainer, network);
+
+    for (size_t k = 0; k < layers_count; ++k)
+    {
+      BackpropLayer_t* layer = &network->layers.data[k];
+
+      BACKPROP_FLOAT_T* W = layer->W;
+      BackpropLayer_Touch(layer);
+
+      for (size_t n = 0; n < layer->y_count; ++n)
+      {
+        BackpropTrainer_MiniBatchCorrection(network, &batch, rows, k, n, batch.D);
+
+        weight_correction_total += BackpropTrainer_ApplyCorrection(trainer, random, W, V, batch.D, layer->x_count);
+
+        W += layer->W_stride;
+        if (V)
+        {
+          V += layer->W_stride;
+        }
+      }
+    }
+
+    stats->batch_weight_correction_total += weight_correction_total;
+    stats->set_weight_correction_total += weight_correction_total;
+
+    stats->teach_total += teach_count;
+    stats->pair_total += rows;
+
+    return error;
+  }
+}
+
+
+
+
+/** Share of a training set taught by one thread of BackpropTrainer_TrainSetThreads().
+ */
+typedef struct BackpropTrainerThread
+{
+  pthread_t thread;
+  bool started;                             ///< True if thread was created and must be joined.
+
+  BackpropTrainer_t* trainer;
+  struct BackpropNetwork* network;
+  const BackpropTrainingSet_t* training_set;
+
+  BackpropRandom_t random;                  ///< PRNG of the thread, for pair selection, jitter and mutation.
+  BackpropTrainingStats_t stats;            ///< Stats of the pairs taught by the thread.
+  BACKPROP_FLOAT_T* scratch;                ///< Scratch memory of the thread, see BackpropTrainer_MiniBatchScratchSize().
+
+  size_t count;                             ///< Number of pairs to teach.
+  BACKPROP_SIZE_T rows;                     ///< Number of pairs taught together.
+  BACKPROP_FLOAT_T error;                   ///< Sum of the pair errors before each update.
+
+} BackpropTrainerThread_t;
+
+
+
+
+static void* BackpropTrainerThread_Run(void* arg)
+{
+  BACKPROP_TRACE();
+
+  BackpropTrainerThread_t* self = arg;
+
+  BACKPROP_ASSERT(self);
+  {
+    const size_t count = self->training_set->dims.count;
+
+    // the pair indexes are at the end of the scratch memory
+    size_t* indexes = (size_t*) ((char*) self->scratch + BackpropTrainer_MiniBatchScratchSize(self->network, self->rows) - self->rows * sizeof(size_t));
+
+    for (size_t i = 0; i < self->count; )
+    {
+      const size_t rows = ((self->count - i) < self->rows) ? (self->count - i) : self->rows;
+
+      for (size_t r = 0; r < rows; ++r)
+      {
+        indexes[r] = BackpropRandom_ArrayIndex(&self->random, 0, count);
+      }
+
+      self->error += BackpropTrainer_TeachMiniBatch(self->trainer, &self->stats, self->network, self->training_set, indexes, rows, self->scratch, &self->random, &self->random);
+
+      i += rows;
+    }
+
+    return NULL;
+  }
+}
+
+
+
+
+/** Teach pair_count random pairs with train_thread_count threads updating the shared weights without locks (Hogwild).
+ *  Each thread teaches its share in mini-batches of minibatch_size pairs, or one pair at a time,
+ *  with its own scratch memory and a PRNG seeded from the trainer PRNG.
+ *  A thread may read weights that another thread is writing, so the result depends on thread timing.
+ *  The thread stats are added to the session stats when all threads are done.
+ *  The calling thread is the first thread, so with one thread no thread is created,
+ *  which gives the same per pair work as more threads for comparison.
+ *  Returns the sum of the pair errors and sets taught to the number of pairs taught, 0 if the threads could not be set up.
+ */
+static BACKPROP_FLOAT_T BackpropTrainer_TrainSetThreads( BackpropTrainer_t* trainer
+                                                       , struct BackpropNetwork* network
+                                                       , struct BackpropTrainingSession* session
+                                                       , size_t pair_count
+                                                       , size_t* taught)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(session);
+  BACKPROP_ASSERT(taught);
+  {
+    const size_t thread_count = (trainer->train_thread_count < pair_count) ? trainer->train_thread_count : pair_count;
+    const BACKPROP_SIZE_T rows = (trainer->minibatch_size > 1) ? trainer->minibatch_size : 1;
+
+    *taught = 0;
+
+    if (thread_count < 1)
+    {
+      return 0;
+    }
+
+    {
+      const size_t scratch_size = BACKPROP_CACHE_LINE_ALIGN(BackpropTrainer_MiniBatchScratchSize(network, rows));
+      const size_t thread_size = BACKPROP_CACHE_LINE_ALIGN(sizeof(BackpropTrainerThread_t));
+      const size_t malloc_size = thread_count * (thread_size + scratch_size) + BACKPROP_CACHE_LINE_SIZE - 1;
+
+      void* block = Backprop_Malloc(malloc_size);
+
+      if (!block)
+      {
+        return 0;
+      }
+
+      {
+        // each thread and its scratch on their own cache lines
+        char* ptr = BACKPROP_CACHE_LINE_ALIGN_PTR(block);
+
+        BACKPROP_FLOAT_T error = 0;
+
+        BackpropTrainerThread_t* threads[thread_count];
+
+        // the velocities must belong to the network before the threads share them
+        BackpropTrainer_GetVelocity(trainer, network);
+
+        for (size_t t = 0; t < thread_count; ++t)
+        {
+          BackpropTrainerThread_t* thread = (BackpropTrainerThread_t*) (ptr + t * (thread_size + scratch_size));
+
+          memset(thread, 0, sizeof(BackpropTrainerThread_t));
+
+          thread->trainer = trainer;
+          thread->network = network;
+          thread->training_set = session->training_set;
+          thread->scratch = (BACKPROP_FLOAT_T*) ((char*) thread + thread_size);
+          thread->count = (pair_count * (t + 1)) / thread_count - (pair_count * t) / thread_count;
+          thread->rows = rows;
+
+          BackpropRandom_Seed(&thread->random, (unsigned long) BackpropRandom_ArrayIndex(&trainer->random, 0, ULONG_MAX));
+
+          threads[t] = thread;
+        }
+
+        for (size_t t = 1; t < thread_count; ++t)
+        {
+          threads[t]->started = (0 == pthread_create(&threads[t]->thread, NULL, BackpropTrainerThread_Run, threads[t]));
+        }
+
+        BackpropTrainerThread_Run(threads[0]);
+
+        for (size_t t = 1; t < thread_count; ++t)
+        {
+          if (threads[t]->started)
+          {
+            pthread_join(threads[t]->thread, NULL);
+          }
+
+          else
+          {
+            // the thread could not be created, so teach its share here
+            BackpropTrainerThread_Run(threads[t]);
+          }
+        }
+
+        for (size_t t = 0; t < thread_count; ++t)
+        {
+          const BackpropTrainingStats_t* stats = &threads[t]->stats;
+
+          error += threads[t]->error;
+
+          session->stats->set_weight_correction_total += stats->set_weight_correction_total;
+          session->stats->batch_weight_correction_total += stats->batch_weight_correction_total;
+          session->stats->teach_total += stats->teach_total;
+          session->stats->pair_total += stats->pair_total;
+        }
+
+        Backprop_Free(block, malloc_size);
+
+        *taught = pair_count;
+
+        return error;
+      }
+    }
+  }
+}
+
+
+
+
+/** Barrier of a fixed group of threads.
+ */
+typedef struct BackpropBarrier
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  size_t count;             ///< Number of threads in the group.
+  size_t waiting;           ///< Number of threads waiting.
+  size_t generation;        ///< Number of times the barrier was passed.
+
+} BackpropBarrier_t;
+
+
+
+
+static bool BackpropBarrier_Init(BackpropBarrier_t* self, size_t count)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->count = count;
+  self->waiting = 0;
+  self->generation = 0;
+
+  if (0 != pthread_mutex_init(&self->mutex, NULL))
+  {
+    return false;
+  }
+
+  if (0 != pthread_cond_init(&self->cond, NULL))
+  {
+    pthread_mutex_destroy(&self->mutex);
+    return false;
+  }
+
+  return true;
+}
+
+
+
+
+static void BackpropBarrier_Destroy(BackpropBarrier_t* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  pthread_cond_destroy(&self->cond);
+  pthread_mutex_destroy(&self->mutex);
+}
+
+
+
+
+/** Change the number of threads in the group, before any of the remaining threads wait.
+ */
+static void BackpropBarrier_SetCount(BackpropBarrier_t* self, size_t count)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  pthread_mutex_lock(&self->mutex);
+  self->count = count;
+  pthread_mutex_unlock(&self->mutex);
+}
+
+
+
+
+/** Wait until every thread of the group is waiting.
+ */
+static void BackpropBarrier_Wait(BackpropBarrier_t* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  pthread_mutex_lock(&self->mutex);
+  {
+    const size_t generation = self->generation;
+
+    if (++self->waiting >= self->count)
+    {
+      self->waiting = 0;
+      ++self->generation;
+      pthread_cond_broadcast(&self->cond);
+    }
+
+    else
+    {
+      while (generation == self->generation)
+      {
+        pthread_cond_wait(&self->cond, &self->mutex);
+      }
+    }
+  }
+  pthread_mutex_unlock(&self->mutex);
+}
+
+
+
+
+/** Mini-batch shared by the threads of BackpropTrainer_TrainSetDataParallel().
+ *  Each mini-batch is split into shards of BACKPROP_SHARD_ROWS_COUNT pairs, and each shard has its own gradient buffer,
+ *  laid out like the weight matrices of the network layers one after another.
+ */
+typedef struct BackpropDataParallel
+{
+  const BackpropTrainer_t* trainer;
+  const struct BackpropNetwork* network;
+  const BackpropTrainingSet_t* training_set;
+
+  BackpropBarrier_t barrier;
+  size_t thread_count;                      ///< Number of parts the shards and the gradients are split into.
+
+  BACKPROP_FLOAT_T* gradients;              ///< Gradient buffers of the shards, gradient_count apart.
+  size_t gradient_count;                    ///< Number of gradients in each buffer, one for each padded weight.
+
+  size_t* indexes;                          ///< Training set indexes of the mini-batch pairs.
+  BACKPROP_SIZE_T* teach_counts;            ///< Number of pairs of each shard taught, not within tolerance.
+  unsigned long* seeds;                     ///< Jitter PRNG seed of each shard.
+  BACKPROP_FLOAT_T* errors;                 ///< Sum of the pair errors of each shard.
+
+  BACKPROP_SIZE_T rows;                     ///< Number of pairs in the mini-batch.
+  size_t shards;                            ///< Number of shards in the mini-batch.
+  bool done;                                ///< True when the threads must return.
+
+} BackpropDataParallel_t;
+
+
+
+
+/** Thread of BackpropTrainer_TrainSetDataParallel().
+ */
+typedef struct BackpropDataParallelThread
+{
+  pthread_t thread;
+  bool started;                             ///< True if thread was created and must be joined.
+
+  BackpropDataParallel_t* job;
+  size_t part;                              ///< Part of the shards and gradients handled by the thread.
+
+  BackpropRandom_t random;                  ///< Jitter PRNG, seeded for each shard.
+  BACKPROP_FLOAT_T* scratch;                ///< Scratch memory, see BackpropTrainer_MiniBatchScratchSize().
+
+} BackpropDataParallelThread_t;
+
+
+
+
+/** Compute the gradients of the shards of part into their buffers, against the unchanging weights.
+ */
+static void BackpropDataParallel_ComputeShards(BackpropDataParallel_t* self, BackpropDataParallelThread_t* thread, size_t part)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(thread);
+  {
+    const struct BackpropNetwork* network = self->network;
+    const BACKPROP_SIZE_T layers_count = network->layers.count;
+
+    BACKPROP_FLOAT_T* Y[layers_count];
+    BACKPROP_FLOAT_T* G[layers_count];
+    BackpropTrainerMiniBatch_t batch = { .Y = Y, .G = G };
+
+    for (size_t shard = part; shard < self->shards; shard += self->thread_count)
+    {
+      const size_t first = shard * BACKPROP_SHARD_ROWS_COUNT;
+      const BACKPROP_SIZE_T rows = ((self->rows - first) < BACKPROP_SHARD_ROWS_COUNT) ? (self->rows - first) : BACKPROP_SHARD_ROWS_COUNT;
+
+      BACKPROP_FLOAT_T* gradient = self->gradients + shard * self->gradient_count;
+
+      if (network->jitter)
+      {
+        BackpropRandom_Seed(&thread->random, self->seeds[shard]);
+      }
+
+      BackpropTrainer_MiniBatchLayout(network, rows, thread->scratch, &batch);
+
+      self->errors[shard] = BackpropTrainer_MiniBatchBackward(self->trainer, network, self->training_set, self->indexes + first, rows, &batch, &thread->random, &self->teach_counts[shard]);
+
+      for (size_t k = 0; k < layers_count; ++k)
+      {
+        const BackpropLayer_t* layer = &network->layers.data[k];
+
+        for (size_t n = 0; n < layer->y_count; ++n)
+        {
+          BackpropTrainer_MiniBatchCorrection(network, &batch, rows, k, n, gradient);
+          gradient += layer->W_stride;
+        }
+      }
+    }
+  }
+}
+
+
+
+
+/** Sum part of the gradients of every shard into the first shard buffer with a tree of pairwise sums,
+ *  each level adding the buffer step shards on to every buffer 2 * step shards apart.
+ *  The tree only depends on the number of shards, so every sum is the same for any number of parts.
+ */
+static void BackpropDataParallel_ReduceGradients(BackpropDataParallel_t* self, size_t part)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  {
+    const BackpropKernels_t* kernels = Backprop_GetKernels();
+
+    // parts are whole cache lines of gradients, the last part takes any remainder
+    const size_t lines_count = self->gradient_count * sizeof(BACKPROP_FLOAT_T) / BACKPROP_CACHE_LINE_SIZE;
+    const size_t line_size = BACKPROP_CACHE_LINE_SIZE / sizeof(BACKPROP_FLOAT_T);
+
+    const size_t first = ((lines_count * part) / self->thread_count) * line_size;
+    const size_t last = ((part + 1) < self->thread_count) ? ((lines_count * (part + 1)) / self->thread_count) * line_size : self->gradient_count;
+
+    for (size_t step = 1; step < self->shards; step *= 2)
+    {
+      for (size_t i = 0; (i + step) < self->shards; i += 2 * step)
+      {
+        kernels->Axpy(self->gradients + i * self->gradient_count + first, 1.0, self->gradients + (i + step) * self->gradient_count + first, last - first);
+      }
+    }
+  }
+}
+
+
+
+
+static void* BackpropDataParallelThread_Run(void* arg)
+{
+  BACKPROP_TRACE();
+
+  BackpropDataParallelThread_t* self = arg;
+
+  BACKPROP_ASSERT(self);
+  {
+    BackpropDataParallel_t* job = self->job;
+
+    for (;;)
+    {
+      BackpropBarrier_Wait(&job->barrier);
+
+      if (job->done)
+      {
+        return NULL;
+      }
+
+      BackpropDataParallel_ComputeShards(job, self, self->part);
+
+      BackpropBarrier_Wait(&job->barrier);
+
+      BackpropDataParallel_ReduceGradients(job, self->part);
+
+      BackpropBarrier_Wait(&job->barrier);
+    }
+  }
+}
+
+
+
+
+/** Teach pair_count random pairs in mini-batches of minibatch_size pairs,
+ *  with train_thread_count threads computing the gradients of each mini-batch against the same weights.
+ *  The gradients are summed in a fixed order and applied once per mini-batch by the calling thread,
+ *  so the trained weights are the same, bit for bit, for any number of threads.
+ *  Returns the sum of the pair errors and sets taught to the number of pairs taught, 0 if the threads could not be set up.
+ */
+static BACKPROP_FLOAT_T BackpropTrainer_TrainSetDataParallel( BackpropTrainer_t* trainer
+                                                            , struct BackpropNetwork* network
+                                                            , struct BackpropTrainingSession* session
+                                                            , size_t pair_count
+                                                            , size_t* taught)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(session);
+  BACKPROP_ASSERT(taught);
+  {
+    const BACKPROP_SIZE_T minibatch_size = (trainer->minibatch_size > 1) ? trainer->minibatch_size : 1;
+    const size_t max_shards = (minibatch_size + BACKPROP_SHARD_ROWS_COUNT - 1) / BACKPROP_SHARD_ROWS_COUNT;
+    const size_t thread_count = (trainer->train_thread_count < 1) ? 1 : ((trainer->train_thread_count < max_shards) ? trainer->train_thread_count : max_shards);
+
+    const size_t gradient_count = BackpropTrainer_VelocityCount(network);
+
+    const size_t gradients_size = max_shards * gradient_count * sizeof(BACKPROP_FLOAT_T);
+    const size_t scratch_size = BACKPROP_CACHE_LINE_ALIGN(BackpropTrainer_MiniBatchScratchSize(network, BACKPROP_SHARD_ROWS_COUNT));
+    const size_t thread_size = BACKPROP_CACHE_LINE_ALIGN(sizeof(BackpropDataParallelThread_t));
+    const size_t batch_size = minibatch_size * sizeof(size_t) + max_shards * (sizeof(BACKPROP_SIZE_T) + sizeof(unsigned long) + sizeof(BACKPROP_FLOAT_T));
+    const size_t malloc_size = gradients_size + thread_count * (thread_size + scratch_size) + batch_size + BACKPROP_CACHE_LINE_SIZE - 1;
+
+    BACKPROP_FLOAT_T error = 0;
+    BACKPROP_FLOAT_T weight_correction_total = 0;
+    BACKPROP_SIZE_T teach_count = 0;
+
+    BackpropDataParallel_t job = {
+      .trainer = trainer,
+      .network = network,
+      .training_set = session->training_set,
+      .thread_count = thread_count,
+      .gradient_count = gradient_count
+    };
+
+    *taught = 0;
+
+    void* block = Backprop_Malloc(malloc_size);
+
+    if (!block)
+    {
+      return 0;
+    }
+
+    if (!BackpropBarrier_Init(&job.barrier, thread_count))
+    {
+      Backprop_Free(block, malloc_size);
+      return 0;
+    }
+
+    {
+      // gradients, then each thread and its scratch, then the mini-batch indexes, teach counts, errors and seeds
+      char* ptr = BACKPROP_CACHE_LINE_ALIGN_PTR(block);
+
+      BackpropDataParallelThread_t* threads[thread_count];
+
+      size_t threads_started = 1;
+
+      // padding gradients are never written, so they stay zero
+      job.gradients = (BACKPROP_FLOAT_T*) ptr;
+      memset(job.gradients, 0, gradients_size);
+      ptr += gradients_size;
+
+      for (size_t t = 0; t < thread_count; ++t)
+      {
+        threads[t] = (BackpropDataParallelThread_t*) ptr;
+        memset(threads[t], 0, sizeof(BackpropDataParallelThread_t));
+
+        threads[t]->job = &job;
+        threads[t]->part = t;
+        threads[t]->scratch = (BACKPROP_FLOAT_T*) (ptr + thread_size);
+
+        ptr += thread_size + scratch_size;
+      }
+
+      job.indexes = (size_t*) ptr;
+      job.teach_counts = (BACKPROP_SIZE_T*) (job.indexes + minibatch_size);
+      job.errors = (BACKPROP_FLOAT_T*) (job.teach_counts + max_shards);
+      job.seeds = (unsigned long*) (job.errors + max_shards);
+
+      for (size_t t = 1; t < thread_count; ++t)
+      {
+        threads[t]->started = (0 == pthread_create(&threads[t]->thread, NULL, BackpropDataParallelThread_Run, threads[t]));
+        threads_started += threads[t]->started;
+      }
+
+      // the calling thread does the parts of any threads that could not be created
+      BackpropBarrier_SetCount(&job.barrier, threads_started);
+
+      for (size_t i = 0; i < pair_count; )
+      {
+        const BACKPROP_SIZE_T rows = ((pair_count - i) < minibatch_size) ? (pair_count - i) : minibatch_size;
+
+        job.rows = rows;
+        job.shards = (rows + BACKPROP_SHARD_ROWS_COUNT - 1) / BACKPROP_SHARD_ROWS_COUNT;
+
+        for (size_t r = 0; r < rows; ++r)
+        {
+          job.indexes[r] = BackpropRandom_ArrayIndex(&trainer->random, 0, session->training_set->dims.count);
+        }
+
+        if (network->jitter)
+        {
+          for (size_t shard = 0; shard < job.shards; ++shard)
+          {
+            job.seeds[shard] = (unsigned long) BackpropRandom_ArrayIndex(&network->random, 0, ULONG_MAX);
+          }
+        }
+
+        BackpropBarrier_Wait(&job.barrier);
+
+        for (size_t t = 0; t < thread_count; ++t)
+        {
+          if (!t || !threads[t]->started)
+          {
+            BackpropDataParallel_ComputeShards(&job, threads[t], t);
+          }
+        }
+
+        BackpropBarrier_Wait(&job.barrier);
+
+        for (size_t t = 0; t < thread_count; ++t)
+        {
+          if (!t || !threads[t]->started)
+          {
+            BackpropDataParallel_ReduceGradients(&job, t);
+          }
+        }
+
+        BackpropBarrier_Wait(&job.barrier);
+
+        // apply the summed gradients once
+        {
+          const BACKPROP_FLOAT_T* gradient = job.gradients;
+          BACKPROP_FLOAT_T* V = BackpropTrainer_GetVelocity(trainer, network);
+
+          for (size_t shard = 0; shard < job.shards; ++shard)
+          {
+            error += job.errors[shard];
+            teach_count += job.teach_counts[shard];
+          }
+
+          for (size_t k = 0; k < network->layers.count; ++k)
+          {
+            BackpropLayer_t* layer = &network->layers.data[k];
+
+            BACKPROP_FLOAT_T* W = layer->W;
+            BackpropLayer_Touch(layer);
+
+            for (size_t n = 0; n < layer->y_count; ++n)
+            {
+              weight_correction_total += BackpropTrainer_ApplyCorrection(trainer, &trainer->random, W, V, gradient, layer->x_count);
+
+              W += layer->W_stride;
+              gradient += layer->W_stride;
+              if (V)
+              {
+                V += layer->W_stride;
+              }
+            }
+          }
+        }
+
+        i += rows;
+      }
+
+      job.done = true;
+      BackpropBarrier_Wait(&job.barrier);
+
+      for (size_t t = 1; t < thread_count; ++t)
+      {
+        if (threads[t]->started)
+        {
+          pthread_join(threads[t]->thread, NULL);
+        }
+      }
+
+      BackpropBarrier_Destroy(&job.barrier);
+      Backprop_Free(block, malloc_size);
+
+      session->stats->batch_weight_correction_total += weight_correction_total;
+      session->stats->set_weight_correction_total += weight_correction_total;
+      session->stats->teach_total += teach_count;
+      session->stats->pair_total += pair_count;
+
+      *taught = pair_count;
+
+      return error;
+    }
+  }
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_TrainSet( BackpropTrainer_t* trainer
+                                         , struct BackpropNetwork* network
+                                         , struct BackpropTrainingSession* session)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(session);
+
+  if (0 == session->training_set->dims.count)
+  {
+    return 0;
+  }
+
+  else
+  {
+    BACKPROP_FLOAT_T error = 0;
+
+    // determine how many training sets to present
+    BACKPROP_SIZE_T training_set_count = (BACKPROP_SIZE_T) (trainer->training_ratio * session->training_set->dims.count);
+
+    if (training_set_count > session->training_set->dims.count)
+    {
+      training_set_count = session->training_set->dims.count - 1;
+    }
+
+    if (training_set_count < 1)
+    {
+      training_set_count = 1;
+    }
+
+    if (trainer->events.BeforeTrainSet)
+    {
+      trainer->events.BeforeTrainSet(trainer, session->stats, network, session->training_set);
+    }
+
+    size_t i = 0;
+
+    if (trainer->data_parallel)
+    {
+      error = BackpropTrainer_TrainSetDataParallel(trainer, network, session, training_set_count, &i);
+    }
+
+    else if (trainer->train_thread_count > 0)
+    {
+      error = BackpropTrainer_TrainSetThreads(trainer, network, session, training_set_count, &i);
+    }
+
+    if ((i < training_set_count) && (trainer->minibatch_size > 1))
+    {
+      const BACKPROP_SIZE_T minibatch_size = trainer->minibatch_size;
+      const size_t scratch_size = BackpropTrainer_MiniBatchScratchSize(network, minibatch_size);
+
+      BACKPROP_FLOAT_T* scratch = Backprop_Malloc(scratch_size);
+
+      if (scratch)
+      {
+        size_t* indexes = (size_t*) ((char*) scratch + scratch_size - minibatch_size * sizeof(size_t));
+
+        for (; i < training_set_count; )
+        {
+          const size_t rows = ((training_set_count - i) < minibatch_size) ? (training_set_count - i) : minibatch_size;
+
+          // present random training sets
+          for (size_t r = 0; r < rows; ++r)
+          {
+            indexes[r] = BackpropRandom_ArrayIndex(&trainer->random, 0, session->training_set->dims.count);
+          }
+
+          error += BackpropTrainer_TeachMiniBatch(trainer, session->stats, network, session->training_set, indexes, rows, scratch, &network->random, &trainer->random);
+
+          i += rows;
+        }
+
+        Backprop_Free(scratch, scratch_size);
+      }
+    }
+
+    // any pairs not taught in mini-batches are trained one at a time
+    for(; i < training_set_count; ++i)
+    {
+      // preset a random training set
+      size_t j = BackpropRandom_ArrayIndex(&trainer->random, 0, session->training_set->dims.count);
+
+      const BACKPROP_BYTE_T* x = session->training_set->x + j * session->training_set->dims.x_size;
+      const BACKPROP_BYTE_T* y = session->training_set->y + j * session->training_set->dims.y_size;
+
+      const BACKPROP_FLOAT_T pair_error = BackpropTrainer_TrainPair(trainer, session->stats, network, x, session->training_set->dims.x_size, y, session->training_set->dims.y_size);
+
+      error += pair_error;
+    }
+
+    if (trainer->events.AfterTrainSet)
+    {
+      trainer->events.AfterTrainSet(trainer, session->stats, network, session->training_set, error);
+    }
+
+    // update stats
+    ++session->stats->set_total;
+
+    return error;
+  }
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_TrainBatch( BackpropTrainer_t* trainer
+                                         , struct BackpropNetwork* network
+                                         , struct BackpropTrainingSession* session)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(session);
+  {
+    const BACKPROP_FLOAT_T tolerance = trainer->error_tolerance;
+    const BACKPROP_FLOAT_T stagnate_tolerance = trainer->stagnate_tolerance;
+    const BACKPROP_FLOAT_T max_stagnate_sets = trainer->max_stagnate_sets;
+    const BACKPROP_FLOAT_T max_batch_sets = trainer->max_batch_sets;
+
+    BACKPROP_SIZE_T stagnate_sets = 0;
+    BACKPROP_SIZE_T batch_sets = 0;
+
+    BACKPROP_FLOAT_T error = BackpropTrainer_ExerciseSession(trainer, network, session, HUGE_VAL);
+    BACKPROP_FLOAT_T last_error = error;
+
+    bool stopped = false;
+
+    if (trainer->events.BeforeTrainBatch)
+    {
+      trainer->events.BeforeTrainBatch(trainer, session->stats, network, session->training_set);
+    }
+
+    do
+    {
+      session->stats->set_weight_correction_total = 0;
+
+      error = BackpropTrainer_TrainSet(trainer, network, session);
+
+      trainer->learning_rate = BackpropLearningAccelerator_Accelerate(&trainer->learning_accelerator, trainer->learning_rate, error, last_error);
+
+      // only whether the whole set is within tolerance matters here
+      stopped = false;
+
+      if (error <= tolerance)
+      {
+        const BACKPROP_FLOAT_T exercise_error = BackpropTrainer_ExerciseSession(trainer, network, session, tolerance);
+
+        // a stopped exercise only shows that the set is above tolerance, keep the error of the trained set
+        stopped = session->exercise_stats->stopped;
+
+        if (!stopped)
+        {
+          error = exercise_error;
+        }
+      }
+
+      if (trainer->min_set_weight_correction_limit > session->stats->set_weight_correction_total)
+      {
+        if (trainer->events.AfterStubbornSet)
+        {
+          trainer->events.AfterStubbornSet(trainer, session->stats, network, session->training_set, error);
+        }
+
+        if ((last_error <= error) || ((last_error - error) < stagnate_tolerance))
+        {
+          ++stagnate_sets;
+          if (trainer->events.AfterStagnateSet)
+          {
+            trainer->events.AfterStagnateSet(trainer, session->stats, network, session->training_set, batch_sets, stagnate_sets, error);
+          }
+        }
+        else
+        {
+          stagnate_sets = 0;
+        }
+      }
+
+      if (trainer->events.AfterTrainSet)
+      {
+        trainer->events.AfterTrainSet(trainer, session->stats, network, session->training_set, error);
+      }
+
+      last_error = error;
+      ++batch_sets;
+
+
+      if (!stopped && (error <= tolerance))
+      {
+        break;
+      }
+
+      if ((max_batch_sets) && (max_batch_sets <= batch_sets))
+      {
+        break;
+      }
+
+      if (max_stagnate_sets <= stagnate_sets)
+      {
+        break;
+      }
+
+      if (session->stats->set_weight_correction_total <= trainer->min_set_weight_correction_limit)
+      {
+        break;
+      }
+
+    } while (1);
+
+    // a stopped exercise only shows that the error is above tolerance, so return the error of the whole set
+    if (stopped)
+    {
+      error = BackpropTrainer_ExerciseSession(trainer, network, session, HUGE_VAL);
+    }
+
+    if ((stagnate_sets >= max_stagnate_sets) && trainer->events.AfterMaxStagnateSets)
+    {
+      trainer->events.AfterMaxStagnateSets(trainer, session->stats, network, session->training_set, batch_sets, stagnate_sets, error);
+    }
+
+    if (trainer->events.AfterTrainBatch)
+    {
+      trainer->events.AfterTrainBatch(trainer, session->stats, network, session->training_set, batch_sets, error);
+    }
+
+    ++session->stats->batches_total;
+
+    return error;
+  }
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropTrainer_Train( BackpropTrainer_t* trainer
+                                      , struct BackpropNetwork* network
+                                      , struct BackpropTrainingSession* session)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(session);
+  {
+    const BACKPROP_FLOAT_T stagnate_tolerance = trainer->stagnate_tolerance;
+    const BACKPROP_FLOAT_T max_stagnate_batches = trainer->max_stagnate_batches;
+    BACKPROP_FLOAT_T stagnate_batches = 0;
+
+    const BACKPROP_SIZE_T max_batch_count = trainer->max_batches;
+    BACKPROP_SIZE_T batch_count = 0;
+
+    BACKPROP_FLOAT_T batch_prune_threshold = trainer->batch_prune_rate;
+
+    // the weights may have changed since the last session, so start without momentum
+    BackpropTrainer_ResetVelocity(trainer);
+
+    const BACKPROP_FLOAT_T tolerance = trainer->error_tolerance;
+    BACKPROP_FLOAT_T error = BackpropTrainer_ExerciseSession(trainer, network, session, HUGE_VAL);
+    BACKPROP_FLOAT_T last_error = error;
+
+    long int clock_start = clock();
+
+    if (error < trainer->error_tolerance)
+    {
+      return error;
+    }
+
+    if (trainer->events.BeforeTrain)
+    {
+      trainer->events.BeforeTrain(trainer, session->stats, network, session->training_set);
+    }
+
+    do
+    {
+      session->stats->batch_weight_correction_total = 0;
+
+      error = BackpropTrainer_TrainBatch(trainer, network, session);
+
+      if (error > tolerance)
+      {
+        if (trainer->batch_prune_threshold && trainer->batch_prune_rate)
+        {
+          batch_prune_threshold = trainer->batch_prune_rate;
+        }
+      }
+      else
+      {
+        if (trainer->batch_prune_threshold)
+        {
+          BackpropTrainer_Prune(trainer, network, trainer->batch_prune_threshold);
+          batch_prune_threshold += trainer->batch_prune_rate;
+
+          if (batch_prune_threshold > trainer->batch_prune_threshold)
+          {
+            batch_prune_threshold = trainer->batch_prune_threshold;
+          }
+        }
+      }
+
+      error = BackpropTrainer_ExerciseSession(trainer, network, session, HUGE_VAL);
+
+      if (error > tolerance)
+      {
+        if (trainer->min_batch_weight_correction_limit > session->stats->batch_weight_correction_total)
+        {
+          ++session->stats->stubborn_batches_total;
+          if (trainer->events.AfterStubbornBatch)
+          {
+            trainer->events.AfterStubbornBatch(trainer, session->stats, network, session->training_set, error);
+          }
+
+          if ((last_error <= error) || ((last_error - error) < stagnate_tolerance))
+          {
+            if (trainer->events.AfterStagnateBatch)
+            {
+              trainer->events.AfterStagnateBatch(trainer, session->stats, network, session->training_set, stagnate_batches, error);
+            }
+            ++stagnate_batches;
+            ++session->stats->stagnate_batches_total;
+          }
+        }
+      }
+
+      last_error = error;
+
+      ++batch_count;
+
+      if (error <= tolerance)
+      {
+        break;
+      }
+
+      if ((max_batch_count) && (max_batch_count <= batch_count))
+      {
+        break;
+      }
+
+      if (trainer->batch_prune_threshold <= batch_prune_threshold)
+      {
+        break;
+      }
+
+      if ((max_stagnate_batches) && (max_stagnate_batches <= stagnate_batches))
+      {
+        break;
+      }
+
+    } while (1);
+
+    if ((stagnate_batches >= max_stagnate_batches) && trainer->events.AfterMaxStagnateBatches)
+    {
+      trainer->events.AfterMaxStagnateBatches(trainer, session->stats, network, session->training_set, stagnate_batches, error);
+    }
+
+    if (error > tolerance)
+    {
+      if (trainer->events.AfterTrainFailure)
+      {
+        trainer->events.AfterTrainFailure(trainer, session->stats, network, session->training_set, error);
+      }
+    }
+    else
+    {
+      if (trainer->events.AfterTrainSuccess)
+      {
+        trainer->events.AfterTrainSuccess(trainer, session->stats, network, session->training_set, error);
+      }
+    }
+
+    if (trainer->events.AfterTrain)
+    {
+      trainer->events.AfterTrain(trainer, session->stats, network, session->training_set, error);
+    }
+
+    {
+      long int clock_stop = clock();
+      session->stats->train_clock = clock_stop - clock_start;
+    }
+
+    return error;
+  }
+}
+
+
+
+
+void BackpropTrainer_Prune(BackpropTrainer_t* trainer, struct BackpropNetwork* network, BACKPROP_FLOAT_T threshold)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(network);
+
+  BackpropNetwork_Prune(network, trainer->batch_prune_threshold);
+}
+
+
+
+
+static struct BackpropNetwork** BackpropNetwork_MallocPool(BACKPROP_SIZE_T x_size, BACKPROP_SIZE_T y_size, BACKPROP_SIZE_T layers_count, BACKPROP_SIZE_T pool_count, bool chain_layers)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(x_size);
+  BACKPROP_ASSERT(y_size);
+  BACKPROP_ASSERT(layers_count);
+  BACKPROP_ASSERT(pool_count);
+  {
+    struct BackpropNetwork** network_pool = Backprop_Malloc(pool_count * sizeof(struct BackpropNetwork*));
+
+    for (size_t i = 0; i < pool_count; ++i)
+    {
+      struct BackpropNetwork* new_network = BackpropNetwork_Malloc(x_size, y_size, layers_count, chain_layers);
+
+      if (!new_network)
+      {
+        break;
+      }
+
+      network_pool[i] = new_network;
+    }
+
+    return network_pool;
+  }
+}
+
+
+
+
+static void BackpropNetwork_FreePool(struct BackpropNetwork** network_pool, BACKPROP_SIZE_T pool_count)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(network_pool);
+  BACKPROP_ASSERT(pool_count);
+
+  for (size_t i = 0; i < pool_count; ++i)
+  {
+    BackpropNetwork_Free(network_pool[i]);
+  }
+
+  Backprop_Free(network_pool, pool_count * sizeof(struct BackpropNetwork*));
+}
+
+
+
+
+
+
+
+
+/*-------------------------------------------------------------------*
+ *
+ * BackpropEvolver
+ *
+ *-------------------------------------------------------------------*/
+
+#pragma mark BackpropEvolver
+
+
+static void BackpropEvolver_MateLayers(BackpropEvolver_t* evolver, BackpropLayer_t* beta, const BackpropLayer_t* alpha)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(beta);
+  BACKPROP_ASSERT(alpha);
+  {
+    BackpropLayer_Touch(beta);
+
+    const BACKPROP_FLOAT_T mate_rate = evolver->mate_rate;
+    const BACKPROP_FLOAT_T one_minus_mate_rate = 1.0 - evolver->mate_rate;
+
+    for (size_t j = 0; j < beta->y_count; ++j)
+    {
+      BACKPROP_FLOAT_T* W_b = beta->W + j * beta->W_stride;
+      const BACKPROP_FLOAT_T* W_a = alpha->W + j * alpha->W_stride;
+
+      BACKPROP_FLOAT_T r[BACKPROP_RANDOM_CHUNK_COUNT];
+
+      size_t count = beta->x_count;
+      while (count)
+      {
+        // two numbers per weight
+        const size_t n = (count < BACKPROP_RANDOM_CHUNK_COUNT / 2) ? count : BACKPROP_RANDOM_CHUNK_COUNT / 2;
+
+        BackpropRandom_Fill(&evolver->random, r, 2 * n);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+          const BACKPROP_FLOAT_T rand_a = (2.0 * r[2 * i] - 1.0) * mate_rate;
+          const BACKPROP_FLOAT_T rand_b = (2.0 * r[2 * i + 1] - 1.0) * one_minus_mate_rate;
+
+          const BACKPROP_FLOAT_T W_new =  (((*W_a) + rand_a) + ((*W_b) + rand_b)) / 2;
+
+          (*W_b) = W_new;
+
+          ++W_b;
+          ++W_a;
+        }
+
+        count -= n;
+      }
+    }
+  }
+}
+
+
+
+
+static void BackpropEvolver_MateNetworks(BackpropEvolver_t* evolver,  BackpropEvolutionStats_t* evolution_stats, struct BackpropNetwork* beta, const struct BackpropNetwork* alpha)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(beta);
+  BACKPROP_ASSERT(alpha);
+
+  ++evolution_stats->mate_networks_count;
+
+  for (size_t i = 0; i < beta->layers.count; ++i)
+  {
+    if (evolver->BeforeMateLayers)
+    {
+      evolver->BeforeMateLayers(evolver, evolution_stats, beta, alpha);
+    }
+
+    BackpropEvolver_MateLayers(evolver, &beta->layers.data[i], &alpha->layers.data[i]);
+
+    if (evolver->AfterMateLayers)
+    {
+      evolver->AfterMateLayers(evolver, evolution_stats, beta, alpha);
+    }
+  }
+}
+
+
+
+
+/** A pool member trained by BackpropEvolver_TrainPool(), with its own trainer and statistics.
+ */
+typedef struct BackpropEvolverMember
+{
+  BackpropTrainer_t* trainer;                     ///< Copy of the evolve trainer, with its own velocities and PRNG.
+  struct BackpropNetwork* network;
+  BackpropTrainingStats_t stats;                  ///< Statistics of the current generation.
+  BackpropExerciseStats_t exercise_stats;         ///< Statistics of the current generation.
+  struct BackpropTrainingSession session;
+  bool unchanged;                                 ///< True if the last generation left the network as it was trained, so it is only exercised.
+  BACKPROP_FLOAT_T error;                         ///< Error after the current generation.
+
+} BackpropEvolverMember_t;
+
+
+
+
+/** Thread training every count-th member of a pool, starting from first.
+ */
+typedef struct BackpropEvolverThread
+{
+  pthread_t thread;
+  bool started;                                   ///< True if thread was created and must be joined.
+
+  BackpropEvolverMember_t* members;
+  size_t first;
+  size_t members_count;
+  size_t step;
+
+} BackpropEvolverThread_t;
+
+
+
+
+static void* BackpropEvolverThread_Run(void* arg)
+{
+  BACKPROP_TRACE();
+
+  BackpropEvolverThread_t* self = arg;
+
+  BACKPROP_ASSERT(self);
+
+  for (size_t i = self->first; i < self->members_count; i += self->step)
+  {
+    BackpropEvolverMember_t* member = &self->members[i];
+
+    if (member->unchanged)
+    {
+      member->error = BackpropTrainer_ExerciseSession(member->trainer, member->network, &member->session, HUGE_VAL);
+    }
+
+    else
+    {
+      member->error = BackpropTrainer_TrainBatch(member->trainer, member->network, &member->session);
+    }
+  }
+
+  return NULL;
+}
+
+
+
+
+/** Copy trainer into a new allocation, with its own zero velocities.
+ *  Returns NULL if error.
+ *  Must call BackpropTrainer_Free() with pointer returned from this function.
+ */
+static BackpropTrainer_t* BackpropTrainer_Clone(const BackpropTrainer_t* trainer)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(trainer);
+  {
+    void* block = Backprop_Malloc(trainer->velocity.malloc_size);
+
+    if (!block)
+    {
+      return NULL;
+    }
+
+    BackpropTrainer_t* self = BACKPROP_CACHE_LINE_ALIGN_PTR(block);
+
+    memcpy(self, trainer, sizeof(BackpropTrainer_t));
+
+    self->velocity.block = block;
+
+    if (self->velocity.count)
+    {
+      self->velocity.data = (BACKPROP_FLOAT_T*) ((char*) self + BACKPROP_CACHE_LINE_ALIGN(sizeof(BackpropTrainer_t)));
+      memset(self->velocity.data, 0, self->velocity.count * sizeof(BACKPROP_FLOAT_T));
+    }
+
+    self->velocity.network = NULL;
+
+    return self;
+  }
+}
+
+
+
+
+/** Add the counts of other to self, and take the last set and pair values from other.
+ */
+static void BackpropTrainingStats_Merge(BackpropTrainingStats_t* self, const BackpropTrainingStats_t* other)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(other);
+
+  self->pair_error_correction = other->pair_error_correction;
+  self->set_weight_correction_total = other->set_weight_correction_total;
+  self->batch_weight_correction_total += other->batch_weight_correction_total;
+  self->teach_total += other->teach_total;
+  self->pair_total += other->pair_total;
+  self->set_total += other->set_total;
+  self->batches_total += other->batches_total;
+  self->stubborn_batches_total += other->stubborn_batches_total;
+  self->stagnate_batches_total += other->stagnate_batches_total;
+  self->train_clock += other->train_clock;
+}
+
+
+
+
+/** Add the counts of other to self, and take the last error from other.
+ */
+static void BackpropExerciseStats_Merge(BackpropExerciseStats_t* self, const BackpropExerciseStats_t* other)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(other);
+
+  self->exercise_clock_ticks += other->exercise_clock_ticks;
+  self->activate_count += other->activate_count;
+
+  if (other->activate_count)
+  {
+    self->error = other->error;
+    self->error_bound = other->error_bound;
+    self->stopped = other->stopped;
+  }
+}
+
+
+
+
+/** Train pool members 1 to pool_count - 1 one batch each, or exercise the unchanged ones, with up to thread_count threads.
+ *  Each member has its own trainer, reseeded from trainer for each generation in member order,
+ *  so the members train the same for any number of threads.
+ *  The statistics of the members are merged in member order once all have trained.
+ */
+static void BackpropEvolver_TrainPool( const BackpropEvolver_t* evolver
+                                     , BackpropTrainer_t* trainer
+                                     , BackpropTrainingStats_t* training_stats
+                                     , BackpropExerciseStats_t* exercise_stats
+                                     , BackpropEvolverMember_t* members
+                                     , size_t members_count)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(evolver);
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(training_stats);
+  BACKPROP_ASSERT(exercise_stats);
+  BACKPROP_ASSERT(members);
+  {
+    const size_t thread_count = (evolver->thread_count < members_count) ? evolver->thread_count : members_count;
+
+    BackpropEvolverThread_t threads[thread_count ? thread_count : 1];
+
+    for (size_t i = 0; i < members_count; ++i)
+    {
+      BackpropEvolverMember_t* member = &members[i];
+
+      BackpropRandom_Seed(&member->trainer->random, (unsigned long) BackpropRandom_ArrayIndex(&trainer->random, 0, ULONG_MAX));
+
+      member->stats = (BackpropTrainingStats_t) {0};
+      member->exercise_stats = (BackpropExerciseStats_t) {0};
+    }
+
+    for (size_t t = 0; t < thread_count; ++t)
+    {
+      threads[t] = (BackpropEvolverThread_t) {
+        .members = members,
+        .first = t,
+        .members_count = members_count,
+        .step = thread_count
+      };
+    }
+
+    // the calling thread trains the first part, and the part of any thread that could not be created
+    for (size_t t = 1; t < thread_count; ++t)
+    {
+      threads[t].started = (0 == pthread_create(&threads[t].thread, NULL, BackpropEvolverThread_Run, &threads[t]));
+    }
+
+    for (size_t t = 0; t < thread_count; ++t)
+    {
+      if (!threads[t].started)
+      {
+        BackpropEvolverThread_Run(&threads[t]);
+      }
+    }
+
+    for (size_t t = 1; t < thread_count; ++t)
+    {
+      if (threads[t].started)
+      {
+        pthread_join(threads[t].thread, NULL);
+      }
+    }
+
+    for (size_t i = 0; i < members_count; ++i)
+    {
+      BackpropTrainingStats_Merge(training_stats, &members[i].stats);
+      BackpropExerciseStats_Merge(exercise_stats, &members[i].exercise_stats);
+    }
+  }
+}
+
+
+
+
+void BackpropEvolver_SetToDefault(BackpropEvolver_t* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  memset(self, 0, sizeof(BackpropEvolver_t));
+
+  self->pool_count = 4;                // 1 alpha + 2 beta + 1 charlie
+  self->mate_rate = BACKPROP_MIN_GOLD;
+  self->max_generations = 4; //32;
+  self->mutation_limit = 1.0;
+  self->random_gain = 4.0;
+  self->migration_interval = 2;
+  self->elite_count = 1;
+  self->tournament_size = 2;
+  self->cache_exercises = true;
+
+  BackpropEvolver_SetSeed(self, 0);
+}
+
+
+
+
+void BackpropEvolver_SetSeed(BackpropEvolver_t* self, unsigned int seed)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->seed = seed;
+  BackpropRandom_Seed(&self->random, seed);
+}
+
+
+
+
+const char* BackpropEvolver_GetSelectionName(BackpropSelection_t selection)
+{
+  BACKPROP_TRACE();
+
+  switch (selection)
+  {
+    case BACKPROP_SELECTION_BEST:        return "best";
+    case BACKPROP_SELECTION_TOURNAMENT:  return "tournament";
+    case BACKPROP_SELECTION_ELITE:       return "elite";
+    case BACKPROP_SELECTION_RANK:        return "rank";
+    default:                             return "unknown";
+  }
+}
+
+
+
+
+/** Indexed binary heap of the members of a pool, ordered by error, lowest first, or with max, highest first.
+ *  positions holds the place of each member in the heap, so a member whose error changed is moved in O(log n).
+ *  Equal errors are ordered by member index, so the order does not depend on the order of the updates.
+ */
+typedef struct BackpropFitnessHeap
+{
+  size_t* nodes;                    ///< Member indexes in heap order.
+  size_t* positions;                ///< Index in nodes of each member.
+  const BACKPROP_FLOAT_T* errors;   ///< Error of each member, shared by the heaps of a pool.
+  size_t count;                     ///< Number of members in the heap.
+  bool max;                         ///< True if the highest error is first.
+
+} BackpropFitnessHeap_t;
+
+
+
+
+/** Returns true if member a comes before member b in the heap.
+ */
+static bool BackpropFitnessHeap_Before(const BackpropFitnessHeap_t* self, size_t a, size_t b)
+{
+  const BACKPROP_FLOAT_T error_a = self->errors[a];
+  const BACKPROP_FLOAT_T error_b = self->errors[b];
+
+  if (error_a != error_b)
+  {
+    return self->max ? (error_a > error_b) : (error_a < error_b);
+  }
+
+  return a < b;
+}
+
+
+
+
+static void BackpropFitnessHeap_Place(BackpropFitnessHeap_t* self, size_t i, size_t member)
+{
+  self->nodes[i] = member;
+  self->positions[member] = i;
+}
+
+
+
+
+/** Move the member at heap index i up or down to its place.
+ */
+static void BackpropFitnessHeap_Sift(BackpropFitnessHeap_t* self, size_t i)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(i < self->count);
+  {
+    const size_t member = self->nodes[i];
+
+    while ((i > 0) && BackpropFitnessHeap_Before(self, member, self->nodes[(i - 1) / 2]))
+    {
+      BackpropFitnessHeap_Place(self, i, self->nodes[(i - 1) / 2]);
+      i = (i - 1) / 2;
+    }
+
+    for (;;)
+    {
+      size_t child = 2 * i + 1;
+
+      if (child >= self->count)
+      {
+        break;
+      }
+
+      if ((child + 1 < self->count) && BackpropFitnessHeap_Before(self, self->nodes[child + 1], self->nodes[child]))
+      {
+        ++child;
+      }
+
+      if (!BackpropFitnessHeap_Before(self, self->nodes[child], member))
+      {
+        break;
+      }
+
+      BackpropFitnessHeap_Place(self, i, self->nodes[child]);
+      i = child;
+    }
+
+    BackpropFitnessHeap_Place(self, i, member);
+  }
+}
+
+
+
+
+/** Fill the heap with members 0 to count - 1, using nodes and positions of count elements each.
+ */
+static void BackpropFitnessHeap_Init(BackpropFitnessHeap_t* self, size_t* nodes, size_t* positions, const BACKPROP_FLOAT_T* errors, size_t count, bool max)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(nodes || !count);
+  BACKPROP_ASSERT(positions || !count);
+  BACKPROP_ASSERT(errors || !count);
+
+  *self = (BackpropFitnessHeap_t) {
+    .nodes = nodes,
+    .positions = positions,
+    .errors = errors,
+    .count = count,
+    .max = max
+  };
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    BackpropFitnessHeap_Place(self, i, i);
+  }
+
+  // heapify, each sift is O(log n) but the total is O(n)
+  for (size_t i = count / 2; i-- > 0; )
+  {
+    BackpropFitnessHeap_Sift(self, i);
+  }
+}
+
+
+
+
+/** Move member to its place after its error changed, member must be in the heap.
+ */
+static void BackpropFitnessHeap_Update(BackpropFitnessHeap_t* self, size_t member)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(self->positions[member] < self->count);
+  BACKPROP_ASSERT(self->nodes[self->positions[member]] == member);
+
+  BackpropFitnessHeap_Sift(self, self->positions[member]);
+}
+
+
+
+
+/** Remove and return the first member, the heap must not be empty.
+ */
+static size_t BackpropFitnessHeap_Pop(BackpropFitnessHeap_t* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(self->count);
+  {
+    const size_t first = self->nodes[0];
+
+    --self->count;
+
+    if (self->count)
+    {
+      BackpropFitnessHeap_Place(self, 0, self->nodes[self->count]);
+      BackpropFitnessHeap_Sift(self, 0);
+    }
+
+    return first;
+  }
+}
+
+
+
+
+/** Add a member removed with BackpropFitnessHeap_Pop().
+ */
+static void BackpropFitnessHeap_Push(BackpropFitnessHeap_t* self, size_t member)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  BackpropFitnessHeap_Place(self, self->count, member);
+  ++self->count;
+
+  BackpropFitnessHeap_Sift(self, self->count - 1);
+}
+
+
+
+
+/** Network pool of an evolution, and its best and worst members.
+ */
+typedef struct BackpropEvolverPool
+{
+  struct BackpropNetwork** networks;              ///< Pool of networks, the first holds the evolved network.
+  size_t networks_count;
+  BackpropEvolverMember_t* members;               ///< Members 1 to pool_count - 1 when trained with threads, else NULL.
+  size_t members_count;
+
+  struct BackpropTrainingSession session;         ///< Session of the members trained with the evolve trainer.
+  struct BackpropExerciseCache* exercise_cache;   ///< Last exercise of each network, kept while the pool lives, NULL if not allocated.
+
+  BACKPROP_FLOAT_T error;                         ///< Error of the last member trained, or with threads, of the best member.
+
+  BACKPROP_FLOAT_T best_error;
+  struct BackpropNetwork* best;
+
+  BACKPROP_FLOAT_T worst_error;
+  struct BackpropNetwork* worst;
+
+  BACKPROP_FLOAT_T* errors;                       ///< Error of each network when last trained, benchmarked or received, followed by the arrays below.
+  uint64_t* versions;                             ///< Weights version of each network after the last generation trained it, 0 if none has.
+  size_t selection_size;                          ///< Size in bytes of the block starting at errors.
+  BackpropFitnessHeap_t best_heap;                ///< Networks by error, lowest first, kept by BackpropEvolverPool_Select().
+  BackpropFitnessHeap_t worst_heap;               ///< Networks by error, highest first.
+  size_t* ranks;                                  ///< Networks in order of error, as far as ordered by the last selection.
+  size_t* rank_of;                                ///< Index in ranks of each network, networks_count if not ordered.
+  size_t* parents;                                ///< Network each network mates with, networks_count if not mated.
+
+} BackpropEvolverPool_t;
+
+
+
+
+/** Free the trainers of the members, see BackpropEvolverPool_Start().
+ */
+static void BackpropEvolverPool_Stop(BackpropEvolverPool_t* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  if (self->members)
+  {
+    for (size_t i = 0; i < self->members_count; ++i)
+    {
+      BackpropTrainer_Free(self->members[i].trainer);
+    }
+
+    Backprop_Free(self->members, self->members_count * sizeof(BackpropEvolverMember_t));
+    self->members = NULL;
+    self->members_count = 0;
+  }
+}
+
+
+
+
+static void BackpropEvolverPool_Free(BackpropEvolverPool_t* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  BackpropEvolverPool_Stop(self);
+
+  BackpropExerciseCache_Free(self->exercise_cache);
+  self->exercise_cache = NULL;
+
+  if (self->errors)
+  {
+    Backprop_Free(self->errors, self->selection_size);
+    self->errors = NULL;
+  }
+
+  if (self->networks)
+  {
+    BackpropNetwork_FreePool(self->networks, self->networks_count);
+    self->networks = NULL;
+  }
+}
+
+
+
+
+/** Fill a pool of pool_count networks with a copy of network and randomized members.
+ *  Returns false if error.
+ */
+static bool BackpropEvolverPool_Init( BackpropEvolverPool_t* self
+                                    , const BackpropEvolver_t* evolver
+                                    , const struct BackpropNetwork* network)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(evolver);
   BACKPROP_ASSERT(network);
-  BACKPROP_ASSERT(x);
-  BACKPROP_ASSERT(x_size);
-  BACKPROP_ASSERT(y_desired);
-  BACKPROP_ASSERT(y_desired_size);
-  BACKPROP_ASSERT(network->layers.count > 1);
   {
-    BACKPROP_FLOAT_T error = 0;
-    BACKPROP_FLOAT_T weight_correction_total = 0;
+    const bool chain_layers = true;
+
+    *self = (BackpropEvolverPool_t) {0};
+
+    // allocate network pool
+    self->networks = BackpropNetwork_MallocPool( network->x.size
+                                               , network->y.size
+                                               , network->layers.count
+                                               , evolver->pool_count
+                                               , chain_layers);
+
+    if (!self->networks)
+    {
+      return false;
+    }
+
+    self->networks_count = evolver->pool_count;
+
+    // copy existing network data into pool
+    BackpropNetwork_DeepCopy(network, self->networks[0]);
+
+    // randomize rest of pool
+    {
+      unsigned int seed = evolver->seed;
+      for (size_t i = 1; i < self->networks_count; ++i)
+      {
+        BackpropNetwork_Randomize(self->networks[i], evolver->random_gain, seed);
+        ++seed;
+      }
+    }
+
+    // a jitter stream for each member, apart from the members of pools with other evolver seeds
+    for (size_t i = 0; i < self->networks_count; ++i)
+    {
+      BackpropRandom_Split(&self->networks[i]->random, &network->random, (uint64_t) evolver->seed + i);
+    }
+
+    // without the cache, each session only keeps the exercise of the last network
+    if (evolver->cache_exercises)
+    {
+      self->exercise_cache = BackpropExerciseCache_Malloc(self->networks, self->networks_count);
+    }
+
+    // errors, versions, then the heap nodes and positions, ranks, rank_of and parents of each network
+    self->selection_size = self->networks_count * (sizeof(BACKPROP_FLOAT_T) + sizeof(uint64_t) + 7 * sizeof(size_t));
+    self->errors = Backprop_Malloc(self->selection_size);
+
+    if (!self->errors)
+    {
+      BackpropEvolverPool_Free(self);
+      return false;
+    }
+
+    {
+      const size_t n = self->networks_count;
+
+      self->versions = (uint64_t*) (self->errors + n);
+
+      size_t* indexes = (size_t*) (self->versions + n);
+
+      for (size_t i = 0; i < n; ++i)
+      {
+        self->errors[i] = HUGE_VAL;
+        self->versions[i] = 0;
+      }
+
+      BackpropFitnessHeap_Init(&self->best_heap, indexes, indexes + n, self->errors, n, false);
+      BackpropFitnessHeap_Init(&self->worst_heap, indexes + 2 * n, indexes + 3 * n, self->errors, n, true);
+
+      self->ranks = indexes + 4 * n;
+      self->rank_of = indexes + 5 * n;
+      self->parents = indexes + 6 * n;
+    }
+
+    // no member has been exercised yet
+    self->best_error = HUGE_VAL;
+    self->best = self->networks[0];
+
+    self->worst_error = HUGE_VAL;
+    self->worst = self->networks[0];
+
+    return true;
+  }
+}
+
+
+
+
+/** Start evolving the pool with trainer for the given training set, and exercise the best member as the benchmark.
+ *  Must call BackpropEvolverPool_Stop() when done.
+ */
+static void BackpropEvolverPool_Start( BackpropEvolverPool_t* self
+                                     , const BackpropEvolver_t* evolver
+                                     , BackpropTrainer_t* trainer
+                                     , BackpropTrainingStats_t* training_stats
+                                     , BackpropExerciseStats_t* exercise_stats
+                                     , const BackpropTrainingSet_t* training_set)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(evolver);
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(training_set);
+
+  // the training set may have been changed in place, or be a new set at the address of an old one
+  if (self->exercise_cache)
+  {
+    BackpropExerciseCache_Clear(self->exercise_cache);
+  }
 
-    if (trainer->events.BeforeTeachPair)
-    {
-      trainer->events.BeforeTeachPair(trainer, stats, network, x, x_size, y_desired, y_desired_size);
-    }
+  // all pool members train in one session, so each exercise may be reused until the member changes
+  self->session = (struct BackpropTrainingSession) {
+    .training_set = training_set,
+    .stats = training_stats,
+    .exercise_stats = exercise_stats,
+    .exercise_cache = self->exercise_cache
+  };
+
+  // with threads, each member but the first trains with its own trainer
+  if (evolver->thread_count && (self->networks_count > 1))
+  {
+    const size_t members_count = self->networks_count - 1;
 
-    BackpropNetwork_Input(network, x, x_size);
+    self->members = Backprop_Malloc(members_count * sizeof(BackpropEvolverMember_t));
 
-    if (trainer->events.AfterInput)
+    for (size_t i = 0; self->members && (i < members_count); ++i)
     {
-      trainer->events.AfterInput(trainer, network, x, x_size);
-    }
+      BackpropEvolverMember_t* member = &self->members[i];
+
+      *member = (BackpropEvolverMember_t) {
+        .trainer = BackpropTrainer_Clone(trainer),
+        .network = self->networks[i + 1],
+        .session = {
+          .training_set = training_set,
+          .stats = &member->stats,
+          .exercise_stats = &member->exercise_stats,
+          .exercise_cache = self->exercise_cache
+        }
+      };
 
-    BackpropNetwork_Activate(network);
+      if (!member->trainer)
+      {
+        // train in the calling thread instead
+        while (i-- > 0)
+        {
+          BackpropTrainer_Free(self->members[i].trainer);
+        }
 
-    if (trainer->events.AfterActivate)
-    {
-      trainer->events.AfterActivate(trainer, network);
+        Backprop_Free(self->members, members_count * sizeof(BackpropEvolverMember_t));
+        self->members = NULL;
+      }
     }
 
-    const BACKPROP_FLOAT_T begin_last_layer_error = BackpropTrainer_ComputeLastLayerError(network, y_desired, y_desired_size);
+    self->members_count = self->members ? members_count : 0;
+  }
 
-    if (trainer->events.AfterComputeLastLayerError)
-    {
-      trainer->events.AfterComputeLastLayerError(trainer, network, begin_last_layer_error);
-    }
+  // get error benchmarks
+  self->error = BackpropTrainer_ExerciseSession(trainer, self->best, &self->session, HUGE_VAL);
 
-    error = BackpropTrainer_ComputeError(network, y_desired, y_desired_size);
+  self->best_error = self->error;
 
-    if (trainer->events.AfterComputeError)
-    {
-      trainer->events.AfterComputeError(trainer, network, error);
-    }
+  self->worst_error = self->error;
+  self->worst = self->best;
 
-    if (error < trainer->error_tolerance)
+  for (size_t i = 0; i < self->networks_count; ++i)
+  {
+    if (self->networks[i] == self->best)
     {
-      return error;
+      self->errors[i] = self->error;
     }
+  }
+}
 
-   {
-      // update the output layer
-      BackpropLayer_t* layer = BackpropNetwork_GetLastLayer(network);
 
-      BACKPROP_FLOAT_T* W = layer->W;
-      BACKPROP_FLOAT_T* g = layer->g;
-      BACKPROP_FLOAT_T* y = layer->y;
-      const BACKPROP_BYTE_T* yd = y_desired;
 
-    //  BACKPROP_FLOAT_T* W_prev = trainer->W_prev[network->layers.count - 1];
 
-      size_t size = y_desired_size;
-      do
-      {
-        size_t yd_bit = 1;
+/** Move every network to its place in the heaps after the errors changed, and take the best and worst from them.
+ */
+static void BackpropEvolverPool_UpdateHeaps(BackpropEvolverPool_t* self)
+{
+  BACKPROP_TRACE();
 
-        size_t b = CHAR_BIT;
-        do
-        {
-          const BACKPROP_FLOAT_T yd_bit_value = 0 < ((*yd) & yd_bit);
-          const BACKPROP_FLOAT_T output_error = (yd_bit_value - (*y));
-          const BACKPROP_FLOAT_T local_gradient = (*y) * (1 - (*y));
-          const BACKPROP_FLOAT_T local_gradient_output_error = local_gradient * output_error;
-          const BACKPROP_FLOAT_T correction_strength = (trainer->learning_rate) * local_gradient_output_error;
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(self->networks_count);
+  {
+    for (size_t i = 0; i < self->networks_count; ++i)
+    {
+      BackpropFitnessHeap_Update(&self->best_heap, i);
+      BackpropFitnessHeap_Update(&self->worst_heap, i);
+    }
 
-          *g = local_gradient_output_error;
+    {
+      const size_t best = self->best_heap.nodes[0];
+      const size_t worst = self->worst_heap.nodes[0];
 
-          // update the layer weights
-          for(size_t j = 0; j < layer->x_count; ++j)
-          {
-            BACKPROP_FLOAT_T momentum = 0.0;
-            BACKPROP_FLOAT_T mutation = 0.0;
+      self->best = self->networks[best];
+      self->best_error = self->errors[best];
 
-            if (trainer->momentum_rate)
-            {
-              // TODO add momentum
-              //momentum = trainer->momentum_rate * (*W - W_prev);
-            }
+      self->worst = self->networks[worst];
+      self->worst_error = self->errors[worst];
+    }
+  }
+}
 
-            if (trainer->mutation_rate)
-            {
-              mutation = trainer->mutation_rate * BackpropLayer_RandomWeight();
-            }
 
-            {
-              const BACKPROP_FLOAT_T correction = correction_strength * (layer->x[j]);
-              const BACKPROP_FLOAT_T total_correction = correction + momentum + mutation;
 
-//              printf("total_correction: %f\n", total_correction);
 
-              (*W) += total_correction;
+/** Select the network each network of the pool mates with into parents, for any selection but BACKPROP_SELECTION_BEST.
+ *  The elite_count best networks, and at least the best, are not mated.
+ *  Only the networks needed are ordered, by popping them off the best heap and pushing them back,
+ *  which is the elite for a tournament or elite selection, and the whole pool for a rank selection.
+ */
+static void BackpropEvolverPool_Select( BackpropEvolverPool_t* self
+                                      , BackpropEvolver_t* evolver
+                                      , BackpropEvolutionStats_t* evolution_stats)
+{
+  BACKPROP_TRACE();
 
-              weight_correction_total += fabs(correction);
-            }
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(evolver);
+  BACKPROP_ASSERT(evolution_stats);
+  BACKPROP_ASSERT(evolver->selection != BACKPROP_SELECTION_BEST);
+  {
+    const long int clock_start = clock();
 
-    //        *W_prev = *W;  // update for next round
+    const size_t n = self->networks_count;
 
-            ++W;
-    //        ++W_prev;
-          }
+    size_t elite_count = (evolver->elite_count < n) ? evolver->elite_count : n;
 
-          yd_bit <<= 1;
-          ++g;
-          ++y;
+    // the best is copied out of the pool with its error, so it must keep its weights
+    if (!elite_count)
+    {
+      elite_count = 1;
+    }
 
-        } while (--b);
+    const size_t ordered_count = (BACKPROP_SELECTION_RANK == evolver->selection) ? n : elite_count;
 
-        ++yd;
+    BackpropEvolverPool_UpdateHeaps(self);
 
-      } while(--size);
+    for (size_t i = 0; i < n; ++i)
+    {
+      self->rank_of[i] = n;
+    }
 
+    for (size_t r = 0; r < ordered_count; ++r)
+    {
+      self->ranks[r] = BackpropFitnessHeap_Pop(&self->best_heap);
+      self->rank_of[self->ranks[r]] = r;
+    }
 
-      // compute error and update weights
-      for(BACKPROP_SIZE_T k = network->layers.count - 1; k > 0; --k)  // for each layer in the network
-      {
-        BackpropLayer_t* pl_next = &network->layers.data[k];
-        layer = &network->layers.data[k-1];
+    for (size_t r = 0; r < ordered_count; ++r)
+    {
+      BackpropFitnessHeap_Push(&self->best_heap, self->ranks[r]);
+    }
 
-        // calculate weighted gradient of next layer
-        BackpropLayer_WeightedGradient(pl_next, layer->g);
+    for (size_t i = 0; i < n; ++i)
+    {
+      size_t parent = n;
 
-        // calculate the error
-        W = layer->W;
-    //    W_prev = trainer->W_prev[k-1];
+      // a network needs another to mate with
+      if ((self->rank_of[i] < elite_count) || (n < 2))
+      {
+        self->parents[i] = n;
+        continue;
+      }
 
-        for(size_t i = 0; i < layer->y_count; ++i)
+      switch (evolver->selection)
+      {
+        case BACKPROP_SELECTION_TOURNAMENT:
         {
-          layer->g[i] *= layer->y[i] * (1 - layer->y[i]);  // local gradient
+          const size_t tournament_size = evolver->tournament_size ? evolver->tournament_size : 1;
 
-          for(size_t j=0; j < layer->x_count; ++j)
+          for (size_t t = 0; t < tournament_size; ++t)
           {
-            BACKPROP_FLOAT_T momentum = 0.0;
-            BACKPROP_FLOAT_T mutation = 0.0;
+            // draw from the other networks
+            size_t j = BackpropRandom_ArrayIndex(&evolver->random, 0, n - 1);
+            j += (j >= i);
 
-            if (trainer->momentum_rate)
+            if ((parent == n) || BackpropFitnessHeap_Before(&self->best_heap, j, parent))
             {
-              // TODO add momentum
-              //momentum = trainer->momentum_rate * (*W - W_prev);
+              parent = j;
             }
+          }
+          break;
+        }
 
-            if (trainer->mutation_rate)
-            {
-              mutation = trainer->mutation_rate * BackpropLayer_RandomWeight();
-            }
+        case BACKPROP_SELECTION_ELITE:
+        {
+          parent = self->ranks[BackpropRandom_ArrayIndex(&evolver->random, 0, elite_count)];
+          break;
+        }
 
-            //      learning rate *   gradient    *   signal
-            {
-              const BACKPROP_FLOAT_T correction = (trainer->learning_rate) * (layer->g[i]) * (layer->x[j]);
-              weight_correction_total += fabs(correction);
-              (*W) += correction + momentum + mutation;
-            }
+        case BACKPROP_SELECTION_RANK:
+        {
+          // rank r of the n - 1 other networks has a density falling linearly from 2 / (n - 1) to 0,
+          // so invert its distribution function u = 1 - (1 - x)^2
+          const BACKPROP_FLOAT_T x = 1.0 - sqrt(1.0 - BackpropRandom_UniformFloat(&evolver->random));
 
-    //        *W_prev = *W; // update for next round
+          size_t r = (size_t) (x * (n - 1));
 
-            ++W;
-    //        ++W_prev;
+          if (r >= n - 1)
+          {
+            r = n - 2;
           }
-        }
-      }
-    }
-
-    // re-activate the network and compute the new error
-    BackpropNetwork_Activate(network);
 
-    if (trainer->events.AfterActivate)
-    {
-      trainer->events.AfterActivate(trainer, network);
-    }
+          r += (r >= self->rank_of[i]);
 
-    const BACKPROP_FLOAT_T end_last_layer_error = BackpropTrainer_ComputeLastLayerError(network, y_desired, y_desired_size);
+          parent = self->ranks[r];
+          break;
+        }
 
-    if (trainer->events.AfterComputeLastLayerError)
-    {
-      trainer->events.AfterComputeLastLayerError(trainer, network, end_last_layer_error);
-    }
+        default:
+          break;
+      }
 
-    error = BackpropTrainer_ComputeError(network, y_desired, y_desired_size);
+      self->parents[i] = parent;
 
-    if (trainer->events.AfterComputeError)
-    {
-      trainer->events.AfterComputeError(trainer, network, error);
+      if (parent < n)
+      {
+        ++evolution_stats->selection_count;
+      }
     }
 
-    stats->pair_error_correction = end_last_layer_error - begin_last_layer_error;
-
-    if (trainer->events.AfterTeachPair)
     {
-      trainer->events.AfterTeachPair(trainer, stats, network, x, x_size, y_desired, y_desired_size, network->y.data, network->y.size, error, weight_correction_total);
+      const long int clock_stop = clock();
+      evolution_stats->selection_clock += (clock_stop - clock_start);
     }
-
-
-    stats->batch_weight_correction_total += weight_correction_total;
-    stats->set_weight_correction_total += weight_correction_total;
-
-    ++stats->teach_total;
-
-    return error;
   }
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_TrainPair( BackpropTrainer_t* trainer
-                                          , BackpropTrainingStats_t* stats
-                                          , struct BackpropNetwork* network
-                                          , const BACKPROP_BYTE_T* x, BACKPROP_SIZE_T x_size
-                                          , const BACKPROP_BYTE_T* y_desired, BACKPROP_SIZE_T y_desired_size)
+/** Train the pool members one batch each, then mate every member but the best and worst with the best.
+ *  With skip_unchanged, a member the last generation did not mate, nor anything else changed, keeps its weights
+ *  and is only exercised, which the exercise cache answers without activating the network after the first time.
+ *  Returns false, without mating, if a member was trained to the error tolerance.
+ */
+static bool BackpropEvolverPool_Generation( BackpropEvolverPool_t* self
+                                          , BackpropEvolver_t* evolver
+                                          , BackpropEvolutionStats_t* evolution_stats
+                                          , BackpropTrainer_t* trainer
+                                          , BACKPROP_SIZE_T generation_count)
 {
   BACKPROP_TRACE();
 
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(evolver);
+  BACKPROP_ASSERT(evolution_stats);
   BACKPROP_ASSERT(trainer);
-  BACKPROP_ASSERT(stats);
-  BACKPROP_ASSERT(network);
-  BACKPROP_ASSERT(x);
-  BACKPROP_ASSERT(x_size);
-  BACKPROP_ASSERT(y_desired);
-  BACKPROP_ASSERT(y_desired_size);
+
+  if (evolver->BeforeGeneration)
   {
-    const BACKPROP_FLOAT_T tolerance = trainer->error_tolerance;
-    size_t reps = trainer->max_reps;
-    BACKPROP_FLOAT_T error = 0;
+    evolver->BeforeGeneration(evolver, evolution_stats, generation_count);
+  }
 
-    if (trainer->events.BeforeTrainPair)
+  if (self->members)
+  {
+    for (size_t i = 0; i < self->members_count; ++i)
     {
-      trainer->events.BeforeTrainPair(trainer, stats, network, x, x_size, y_desired, y_desired_size);
+      self->members[i].unchanged = evolver->skip_unchanged && (BackpropNetwork_GetWeightsVersion(self->members[i].network) == self->versions[i + 1]);
+      self->members[i].session.activate_total = 0;
     }
 
-    do
+    BackpropEvolver_TrainPool(evolver, trainer, self->session.stats, self->session.exercise_stats, self->members, self->members_count);
+
+    // select once every member has trained, in member order
+    for (size_t i = 0; i < self->members_count; ++i)
     {
-      error = BackpropTrainer_TeachPair(trainer, stats, network, x, x_size, y_desired, y_desired_size);
+      self->errors[i + 1] = self->members[i].error;
+      self->versions[i + 1] = BackpropNetwork_GetWeightsVersion(self->members[i].network);
 
-    } while (--reps && (error > tolerance));
+      evolution_stats->activate_count += self->members[i].session.activate_total;
 
+      if (self->members[i].error < self->best_error)
+      {
+        self->best_error = self->members[i].error;
+        self->best = self->members[i].network;
+      }
 
-    if (trainer->events.AfterTrainPair)
-    {
-      trainer->events.AfterTrainPair(trainer, stats, network, x, x_size, y_desired, y_desired_size, network->y.data, network->y.size, error);
+      if (self->members[i].error > self->worst_error)
+      {
+        self->worst_error = self->members[i].error;
+        self->worst = self->members[i].network;
+      }
     }
 
-    ++stats->pair_total;
-
-    return error;
+    self->error = self->best_error;
   }
-}
 
+  // train all pool members
+  for (size_t i = 1; !self->members && (i < self->networks_count); ++i)
+  {
+    struct BackpropNetwork* network = self->networks[i];
+    const BACKPROP_SIZE_T activate_total = self->session.activate_total;
 
+    if (evolver->skip_unchanged && (BackpropNetwork_GetWeightsVersion(network) == self->versions[i]))
+    {
+      self->error = BackpropTrainer_ExerciseSession(trainer, network, &self->session, HUGE_VAL);
+    }
 
+    else
+    {
+      self->error = BackpropTrainer_TrainBatch(trainer, network, &self->session);
+    }
 
-BACKPROP_FLOAT_T BackpropTrainer_TrainSet( BackpropTrainer_t* trainer
-                                         , struct BackpropNetwork* network
-                                         , struct BackpropTrainingSession* session)
-{
-  BACKPROP_TRACE();
+    self->errors[i] = self->error;
+    self->versions[i] = BackpropNetwork_GetWeightsVersion(network);
 
-  BACKPROP_ASSERT(trainer);
-  BACKPROP_ASSERT(network);
-  BACKPROP_ASSERT(session);
+    evolution_stats->activate_count += self->session.activate_total - activate_total;
 
-  if (0 == session->training_set->dims.count)
+    if (self->error < self->best_error)
+    {
+      self->best_error = self->error;
+      self->best = network;
+    }
+
+    if (self->error < trainer->error_tolerance)
+    {
+      break;
+    }
+
+    if (self->error > self->worst_error)
+    {
+      self->worst_error = self->error;
+      self->worst = network;
+    }
+  }
+
+  if (self->error < trainer->error_tolerance)
   {
-    return 0;
+    return false;
   }
 
-  else
+  if (BACKPROP_SELECTION_BEST != evolver->selection)
   {
-    BACKPROP_FLOAT_T error = 0;
+    BackpropEvolverPool_Select(self, evolver, evolution_stats);
+  }
 
-    // determine how many training sets to present
-    BACKPROP_SIZE_T training_set_count = (BACKPROP_SIZE_T) (trainer->training_ratio * session->training_set->dims.count);
+  // evolve pool members
+  for (size_t i = 0; i < self->networks_count; ++i)
+  {
+    struct BackpropNetwork* network = self->networks[i];
+    const struct BackpropNetwork* parent = self->best;
 
-    if (training_set_count > session->training_set->dims.count)
+    if (BACKPROP_SELECTION_BEST != evolver->selection)
     {
-      training_set_count = session->training_set->dims.count - 1;
+      if (self->parents[i] >= self->networks_count)
+      {
+        continue;
+      }
+
+      parent = self->networks[self->parents[i]];
+
+      // the error is not known again until the network is trained, so it cannot be selected as best before
+      self->errors[i] = HUGE_VAL;
     }
 
-    if (training_set_count < 1)
+    // do not mate best with self or worst member of pool
+    else if ((network == self->best) || (network == self->worst))
     {
-      training_set_count = 1;
+      continue;
     }
 
-    if (trainer->events.BeforeTrainSet)
+    if (evolver->BeforeMateNetworks)
     {
-      trainer->events.BeforeTrainSet(trainer, session->stats, network, session->training_set);
+      evolver->BeforeMateNetworks(evolver, evolution_stats, network);
     }
 
-    for(size_t i = 0; i < training_set_count; ++i)
+    BackpropEvolver_MateNetworks(evolver, evolution_stats, network, parent);
+
+    if (evolver->AfterMateNetworks)
     {
-      // preset a random training set
-      size_t j = Backprop_RandomArrayIndex(0, session->training_set->dims.count);
+      evolver->AfterMateNetworks(evolver, evolution_stats, network, parent);
+    }
+  }
 
-      const BACKPROP_BYTE_T* x = session->training_set->x + j * session->training_set->dims.x_size;
-      const BACKPROP_BYTE_T* y = session->training_set->y + j * session->training_set->dims.y_size;
+  if (evolver->AfterGeneration)
+  {
+    evolver->AfterGeneration(evolver, evolution_stats, generation_count);
+  }
 
-      const BACKPROP_FLOAT_T pair_error = BackpropTrainer_TrainPair(trainer, session->stats, network, x, session->training_set->dims.x_size, y, session->training_set->dims.y_size);
+  return true;
+}
 
-      error += pair_error;
-    }
 
-    if (trainer->events.AfterTrainSet)
+
+
+/** Evolve the pool until a member is trained to the error tolerance or for max_generations generations,
+ *  numbering the generations from generation_count.
+ *  Returns the number of generations evolved.
+ */
+static BACKPROP_SIZE_T BackpropEvolverPool_Run( BackpropEvolverPool_t* self
+                                              , BackpropEvolver_t* evolver
+                                              , BackpropEvolutionStats_t* evolution_stats
+                                              , BackpropTrainer_t* trainer
+                                              , BACKPROP_SIZE_T generation_count)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(evolver);
+  BACKPROP_ASSERT(evolution_stats);
+  BACKPROP_ASSERT(trainer);
+  {
+    // batch train the network pool
+    BACKPROP_SIZE_T generations = 0;
+    while ((self->error > trainer->error_tolerance) && (generations < evolver->max_generations))
     {
-      trainer->events.AfterTrainSet(trainer, session->stats, network, session->training_set, error);
-    }
+      if (!BackpropEvolverPool_Generation(self, evolver, evolution_stats, trainer, generation_count + generations))
+      {
+        break;
+      }
 
-    // update stats
-    ++session->stats->set_total;
+      ++generations;
+      ++evolution_stats->generation_count;
+    }
 
-    return error;
+    return generations;
   }
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_TrainBatch( BackpropTrainer_t* trainer
-                                         , struct BackpropNetwork* network
-                                         , struct BackpropTrainingSession* session)
+/** Replace the worst member of the pool, or another member if the worst is the best, with the weights of a migrant.
+ *  The migrant becomes the best member if its error is lower.
+ */
+static void BackpropEvolverPool_Receive( BackpropEvolverPool_t* self
+                                       , const BackpropEvolver_t* evolver
+                                       , const BACKPROP_FLOAT_T* weights
+                                       , BACKPROP_FLOAT_T error)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(trainer);
-  BACKPROP_ASSERT(network);
-  BACKPROP_ASSERT(session);
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(evolver);
+  BACKPROP_ASSERT(weights);
+
+  if (self->networks_count < 2)
   {
-    const BACKPROP_FLOAT_T tolerance = trainer->error_tolerance;
-    const BACKPROP_FLOAT_T stagnate_tolerance = trainer->stagnate_tolerance;
-    const BACKPROP_FLOAT_T max_stagnate_sets = trainer->max_stagnate_sets;
-    const BACKPROP_FLOAT_T max_batch_sets = trainer->max_batch_sets;
+    return;
+  }
 
-    BACKPROP_SIZE_T stagnate_sets = 0;
-    BACKPROP_SIZE_T batch_sets = 0;
+  if (BACKPROP_SELECTION_BEST != evolver->selection)
+  {
+    BackpropEvolverPool_UpdateHeaps(self);
 
-    BACKPROP_FLOAT_T error = BackpropTrainer_Exercise(trainer, session->exercise_stats, network, session->training_set);
-    BACKPROP_FLOAT_T last_error = error;
+    {
+      const size_t best = self->best_heap.nodes[0];
+      size_t slot = self->worst_heap.nodes[0];
 
-    if (trainer->events.BeforeTrainBatch)
+      if (slot == best)
+      {
+        slot = best ? 0 : 1;
+      }
+
+      BackpropNetwork_SetWeights(self->networks[slot], weights);
+      self->errors[slot] = error;
+
+      BackpropEvolverPool_UpdateHeaps(self);
+    }
+  }
+
+  else
+  {
+    struct BackpropNetwork* slot = self->worst;
+
+    if (slot == self->best)
     {
-      trainer->events.BeforeTrainBatch(trainer, session->stats, network, session->training_set);
+      slot = (self->networks[0] == self->best) ? self->networks[1] : self->networks[0];
     }
 
-    do
+    BackpropNetwork_SetWeights(slot, weights);
+
+    if (error < self->best_error)
     {
-      session->stats->set_weight_correction_total = 0;
+      self->best_error = error;
+      self->best = slot;
+    }
 
-      error = BackpropTrainer_TrainSet(trainer, network, session);
+    // the worst is found again by the next generation
+    self->worst_error = self->best_error;
+    self->worst = self->best;
+  }
+}
 
-      trainer->learning_rate = BackpropLearningAccelerator_Accelerate(&trainer->learning_accelerator, trainer->learning_rate, error, last_error);
 
-      if (error <= tolerance)
-      {
-        error = BackpropTrainer_Exercise(trainer, session->exercise_stats, network, session->training_set);
-      }
 
-      if (trainer->min_set_weight_correction_limit > session->stats->set_weight_correction_total)
-      {
-        if (trainer->events.AfterStubbornSet)
-        {
-          trainer->events.AfterStubbornSet(trainer, session->stats, network, session->training_set, error);
-        }
 
-        if ((last_error <= error) || ((last_error - error) < stagnate_tolerance))
-        {
-          ++stagnate_sets;
-          if (trainer->events.AfterStagnateSet)
-          {
-            trainer->events.AfterStagnateSet(trainer, session->stats, network, session->training_set, batch_sets, stagnate_sets, error);
-          }
-        }
-        else
-        {
-          stagnate_sets = 0;
-        }
-      }
+/** An island of BackpropEvolver_EvolveIslands(), evolving its own pool with its own evolver and trainer.
+ */
+typedef struct BackpropEvolverIsland
+{
+  pthread_t thread;
+  bool started;                                   ///< True if thread was created and must be joined.
 
-      if (trainer->events.AfterTrainSet)
-      {
-        trainer->events.AfterTrainSet(trainer, session->stats, network, session->training_set, error);
-      }
+  BackpropEvolver_t evolver;                      ///< Copy of the evolver, with its own seed.
+  BackpropTrainer_t* trainer;                     ///< Copy of the evolve trainer.
 
-      last_error = error;
-      ++batch_sets;
+  BackpropEvolutionStats_t evolution_stats;
+  BackpropTrainingStats_t training_stats;
+  BackpropExerciseStats_t exercise_stats;
 
+  BackpropEvolverPool_t pool;
 
-      if (error <= tolerance)
-      {
-        break;
-      }
+  BACKPROP_SIZE_T generation_count;               ///< Number of generations evolved.
+  BACKPROP_SIZE_T last_generation;                ///< Number of generations to evolve before the next migration.
+  bool done;                                      ///< True if a member was trained to the error tolerance.
 
-      if ((max_batch_sets) && (max_batch_sets <= batch_sets))
-      {
-        break;
-      }
+  BACKPROP_FLOAT_T* migrant;                      ///< Weights of the best member, sent to the next island.
+  BACKPROP_FLOAT_T migrant_error;
 
-      if (max_stagnate_sets <= stagnate_sets)
-      {
-        break;
-      }
+} BackpropEvolverIsland_t;
 
-      if (session->stats->set_weight_correction_total <= trainer->min_set_weight_correction_limit)
-      {
-        break;
-      }
 
-    } while (1);
 
 
-    if ((stagnate_sets >= max_stagnate_sets) && trainer->events.AfterMaxStagnateSets)
-    {
-      trainer->events.AfterMaxStagnateSets(trainer, session->stats, network, session->training_set, batch_sets, stagnate_sets, error);
-    }
+static void* BackpropEvolverIsland_Run(void* arg)
+{
+  BACKPROP_TRACE();
 
-    if (trainer->events.AfterTrainBatch)
+  BackpropEvolverIsland_t* self = arg;
+
+  BACKPROP_ASSERT(self);
+
+  while (!self->done && (self->pool.error > self->trainer->error_tolerance) && (self->generation_count < self->last_generation))
+  {
+    if (!BackpropEvolverPool_Generation(&self->pool, &self->evolver, &self->evolution_stats, self->trainer, self->generation_count))
     {
-      trainer->events.AfterTrainBatch(trainer, session->stats, network, session->training_set, batch_sets, error);
+      self->done = true;
+      break;
     }
 
-    ++session->stats->batches_total;
+    ++self->generation_count;
+    ++self->evolution_stats.generation_count;
+  }
 
-    return error;
+  if (self->pool.error <= self->trainer->error_tolerance)
+  {
+    self->done = true;
   }
+
+  return NULL;
 }
 
 
 
 
-BACKPROP_FLOAT_T BackpropTrainer_Train( BackpropTrainer_t* trainer
-                                      , struct BackpropNetwork* network
-                                      , struct BackpropTrainingSession* session)
+/** Evolve island_count pools, one thread each, for migration_interval generations at a time.
+ *  Between runs the best member of each island replaces a member of the next island, in a ring.
+ *  Each island has its own copy of the evolver and trainer, seeded in island order,
+ *  so the result does not depend on how the threads are scheduled.
+ *  Returns the error of the best member of all islands, or -1 if error.
+ */
+static BACKPROP_FLOAT_T BackpropEvolver_EvolveIslands( BackpropEvolver_t* evolver
+                                                     , BackpropEvolutionStats_t* evolution_stats
+                                                     , BackpropTrainer_t* trainer
+                                                     , BackpropTrainingStats_t* training_stats
+                                                     , BackpropExerciseStats_t* exercise_stats
+                                                     , struct BackpropNetwork* network
+                                                     , const BackpropTrainingSet_t* training_set)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(trainer);
-  BACKPROP_ASSERT(network);
-  BACKPROP_ASSERT(session);
+  BACKPROP_ASSERT(evolver);
+  BACKPROP_ASSERT(evolver->island_count > 1);
   {
-    const BACKPROP_FLOAT_T stagnate_tolerance = trainer->stagnate_tolerance;
-    const BACKPROP_FLOAT_T max_stagnate_batches = trainer->max_stagnate_batches;
-    BACKPROP_FLOAT_T stagnate_batches = 0;
-
-    const BACKPROP_SIZE_T max_batch_count = trainer->max_batches;
-    BACKPROP_SIZE_T batch_count = 0;
+    const size_t island_count = evolver->island_count;
+    const BACKPROP_SIZE_T migration_interval = evolver->migration_interval ? evolver->migration_interval : 1;
+    const size_t weights_count = BackpropNetwork_GetWeightsCount(network);
 
-    BACKPROP_FLOAT_T batch_prune_threshold = trainer->batch_prune_rate;
+    const size_t islands_size = island_count * sizeof(BackpropEvolverIsland_t);
+    const size_t migrants_size = island_count * weights_count * sizeof(BACKPROP_FLOAT_T);
 
-    const BACKPROP_FLOAT_T tolerance = trainer->error_tolerance;
-    BACKPROP_FLOAT_T error = BackpropTrainer_Exercise(trainer, session->exercise_stats, network, session->training_set);
-    BACKPROP_FLOAT_T last_error = error;
+    BackpropEvolverIsland_t* islands = Backprop_Malloc(islands_size);
+    BACKPROP_FLOAT_T* migrants = Backprop_Malloc(migrants_size ? migrants_size : 1);
 
-    long int clock_start = clock();
+    BACKPROP_FLOAT_T best_error = -1;
+    size_t islands_ready = 0;
 
-    if (error < trainer->error_tolerance)
+    if (islands && migrants)
     {
-      return error;
-    }
+      for (; islands_ready < island_count; ++islands_ready)
+      {
+        BackpropEvolverIsland_t* island = &islands[islands_ready];
 
-    if (trainer->events.BeforeTrain)
-    {
-      trainer->events.BeforeTrain(trainer, session->stats, network, session->training_set);
-    }
+        island->evolver = *evolver;
+        island->evolver.island_count = 0;
 
-    do
-    {
-      session->stats->batch_weight_correction_total = 0;
+        // a different seed for each island, so their pools start apart
+        BackpropEvolver_SetSeed(&island->evolver, evolver->seed + islands_ready * evolver->pool_count);
 
-      error = BackpropTrainer_TrainBatch(trainer, network, session);
+        island->trainer = BackpropTrainer_Clone(trainer);
 
-      if (error > tolerance)
-      {
-        if (trainer->batch_prune_threshold && trainer->batch_prune_rate)
+        if (!island->trainer)
         {
-          batch_prune_threshold = trainer->batch_prune_rate;
+          break;
         }
-      }
-      else
-      {
-        if (trainer->batch_prune_threshold)
-        {
-          BackpropTrainer_Prune(trainer, network, trainer->batch_prune_threshold);
-          batch_prune_threshold += trainer->batch_prune_rate;
 
-          if (batch_prune_threshold > trainer->batch_prune_threshold)
-          {
-            batch_prune_threshold = trainer->batch_prune_threshold;
-          }
+        BackpropRandom_Seed(&island->trainer->random, (unsigned long) BackpropRandom_ArrayIndex(&trainer->random, 0, ULONG_MAX));
+
+        if (!BackpropEvolverPool_Init(&island->pool, &island->evolver, network))
+        {
+          BackpropTrainer_Free(island->trainer);
+          break;
         }
+
+        BackpropEvolverPool_Start(&island->pool, &island->evolver, island->trainer, &island->training_stats, &island->exercise_stats, training_set);
+
+        island->migrant = migrants + islands_ready * weights_count;
       }
+    }
 
-      error = BackpropTrainer_Exercise(trainer, session->exercise_stats, network, session->training_set);
+    *evolution_stats = (BackpropEvolutionStats_t) {0};
 
-      if (error > tolerance)
+    if (islands_ready == island_count)
+    {
+      bool done = false;
+
+      for (BACKPROP_SIZE_T generation_count = 0; !done && (generation_count < evolver->max_generations); )
       {
-        if (trainer->min_batch_weight_correction_limit > session->stats->batch_weight_correction_total)
+        generation_count = (evolver->max_generations - generation_count < migration_interval) ? evolver->max_generations : generation_count + migration_interval;
+
+        for (size_t i = 0; i < island_count; ++i)
         {
-          ++session->stats->stubborn_batches_total;
-          if (trainer->events.AfterStubbornBatch)
+          islands[i].last_generation = generation_count;
+        }
+
+        // the calling thread evolves the first island, and any island whose thread could not be created
+        for (size_t i = 1; i < island_count; ++i)
+        {
+          islands[i].started = (0 == pthread_create(&islands[i].thread, NULL, BackpropEvolverIsland_Run, &islands[i]));
+        }
+
+        for (size_t i = 0; i < island_count; ++i)
+        {
+          if (!i || !islands[i].started)
           {
-            trainer->events.AfterStubbornBatch(trainer, session->stats, network, session->training_set, error);
+            BackpropEvolverIsland_Run(&islands[i]);
           }
+        }
 
-          if ((last_error <= error) || ((last_error - error) < stagnate_tolerance))
+        for (size_t i = 1; i < island_count; ++i)
+        {
+          if (islands[i].started)
           {
-            if (trainer->events.AfterStagnateBatch)
-            {
-              trainer->events.AfterStagnateBatch(trainer, session->stats, network, session->training_set, stagnate_batches, error);
-            }
-            ++stagnate_batches;
-            ++session->stats->stagnate_batches_total;
+            pthread_join(islands[i].thread, NULL);
+            islands[i].started = false;
           }
         }
-      }
 
-      last_error = error;
+        for (size_t i = 0; i < island_count; ++i)
+        {
+          done = done || islands[i].done;
+        }
 
-      ++batch_count;
+        if (done || (generation_count >= evolver->max_generations))
+        {
+          break;
+        }
 
-      if (error <= tolerance)
-      {
-        break;
-      }
+        // migrate the best of each island to the next
+        for (size_t i = 0; i < island_count; ++i)
+        {
+          BackpropNetwork_GetWeights(islands[i].pool.best, islands[i].migrant);
+          islands[i].migrant_error = islands[i].pool.best_error;
+        }
 
-      if ((max_batch_count) && (max_batch_count <= batch_count))
-      {
-        break;
+        for (size_t i = 0; i < island_count; ++i)
+        {
+          const BackpropEvolverIsland_t* from = &islands[(i + island_count - 1) % island_count];
+
+          BackpropEvolverPool_Receive(&islands[i].pool, &islands[i].evolver, from->migrant, from->migrant_error);
+        }
       }
 
-      if (trainer->batch_prune_threshold <= batch_prune_threshold)
+      // copy out the best network of all islands
       {
-        break;
+        const BackpropEvolverIsland_t* best = &islands[0];
+
+        for (size_t i = 1; i < island_count; ++i)
+        {
+          if (islands[i].pool.best_error < best->pool.best_error)
+          {
+            best = &islands[i];
+          }
+        }
+
+        BackpropNetwork_DeepCopy(best->pool.best, network);
+        best_error = best->pool.best_error;
       }
 
-      if ((max_stagnate_batches) && (max_stagnate_batches <= stagnate_batches))
+      for (size_t i = 0; i < island_count; ++i)
       {
-        break;
+        if (islands[i].evolution_stats.generation_count > evolution_stats->generation_count)
+        {
+          evolution_stats->generation_count = islands[i].evolution_stats.generation_count;
+        }
+
+        evolution_stats->mate_networks_count += islands[i].evolution_stats.mate_networks_count;
+        evolution_stats->selection_count += islands[i].evolution_stats.selection_count;
+        evolution_stats->selection_clock += islands[i].evolution_stats.selection_clock;
+
+        BackpropTrainingStats_Merge(training_stats, &islands[i].training_stats);
+        BackpropExerciseStats_Merge(exercise_stats, &islands[i].exercise_stats);
       }
+    }
 
-    } while (1);
+    for (size_t i = 0; i < islands_ready; ++i)
+    {
+      BackpropEvolverPool_Free(&islands[i].pool);
+      BackpropTrainer_Free(islands[i].trainer);
+    }
 
-    if ((stagnate_batches >= max_stagnate_batches) && trainer->events.AfterMaxStagnateBatches)
+    if (islands)
     {
-      trainer->events.AfterMaxStagnateBatches(trainer, session->stats, network, session->training_set, stagnate_batches, error);
+      Backprop_Free(islands, islands_size);
     }
 
-    if (error > tolerance)
+    if (migrants)
+    {
+      Backprop_Free(migrants, migrants_size ? migrants_size : 1);
+    }
+
+    return best_error;
+  }
+}
+
+
+
+
+/** Use an evolutionary algorithm to evolve a network trained for the given training set.
+ */
+BACKPROP_FLOAT_T BackpropEvolver_Evolve(BackpropEvolver_t* evolver, BackpropEvolutionStats_t* evolution_stats, BackpropTrainer_t* trainer, BackpropTrainingStats_t* training_stats, BackpropExerciseStats_t* exercise_stats, struct BackpropNetwork* network, const BackpropTrainingSet_t* training_set)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(evolver);
+  BACKPROP_ASSERT(evolution_stats);
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(training_stats);
+  BACKPROP_ASSERT(exercise_stats);
+  BACKPROP_ASSERT(network);
+  BACKPROP_ASSERT(training_set);
+  {
+    long int clock_start = clock();
+
+    BACKPROP_FLOAT_T best_error = -1;
+
+    if (evolver->island_count > 1)
     {
-      if (trainer->events.AfterTrainFailure)
-      {
-        trainer->events.AfterTrainFailure(trainer, session->stats, network, session->training_set, error);
-      }
+      best_error = BackpropEvolver_EvolveIslands(evolver, evolution_stats, trainer, training_stats, exercise_stats, network, training_set);
     }
+
     else
     {
-      if (trainer->events.AfterTrainSuccess)
+      BackpropEvolverPool_t pool;
+
+      // clear out stats
+      *evolution_stats = (BackpropEvolutionStats_t) {0};
+
+      if (BackpropEvolverPool_Init(&pool, evolver, network))
       {
-        trainer->events.AfterTrainSuccess(trainer, session->stats, network, session->training_set, error);
+        BackpropEvolverPool_Start(&pool, evolver, trainer, training_stats, exercise_stats, training_set);
+
+        BackpropEvolverPool_Run(&pool, evolver, evolution_stats, trainer, 0);
+
+        // copy out best network data
+        BackpropNetwork_DeepCopy(pool.best, network);
+        best_error = pool.best_error;
       }
-    }
 
-    if (trainer->events.AfterTrain)
-    {
-      trainer->events.AfterTrain(trainer, session->stats, network, session->training_set, error);
+      // all done
+      BackpropEvolverPool_Free(&pool);
     }
 
     {
       long int clock_stop = clock();
-      session->stats->train_clock = clock_stop - clock_start;
+      evolution_stats->evolve_clock = clock_stop - clock_start;
     }
 
-    return error;
+    return best_error;
   }
 }
 
 
 
 
-void BackpropTrainer_Prune(BackpropTrainer_t* trainer, struct BackpropNetwork* network, BACKPROP_FLOAT_T threshold)
-{
-  BACKPROP_TRACE();
+/*-------------------------------------------------------------------*
+ *
+ * BackpropPopulation
+ *
+ *-------------------------------------------------------------------*/
 
-  BACKPROP_ASSERT(trainer);
-  BACKPROP_ASSERT(network);
+#pragma mark BackpropPopulation
 
-  BackpropNetwork_Prune(network, trainer->batch_prune_threshold);
-}
+
+struct BackpropPopulation
+{
+  BackpropEvolverPool_t pool;
+  BACKPROP_SIZE_T generation_count;   ///< Number of generations evolved by all calls to BackpropPopulation_Evolve().
+  BackpropRandom_t random;            ///< PRNG used for selection and mating in place of the evolver PRNG.
+};
 
 
 
 
-static struct BackpropNetwork** BackpropNetwork_MallocPool(BACKPROP_SIZE_T x_size, BACKPROP_SIZE_T y_size, BACKPROP_SIZE_T layers_count, BACKPROP_SIZE_T pool_count, bool chain_layers)
+struct BackpropPopulation* BackpropPopulation_Malloc(const BackpropEvolver_t* evolver, const struct BackpropNetwork* network)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(x_size);
-  BACKPROP_ASSERT(y_size);
-  BACKPROP_ASSERT(layers_count);
-  BACKPROP_ASSERT(pool_count);
+  BACKPROP_ASSERT(evolver);
+  BACKPROP_ASSERT(network);
   {
-    struct BackpropNetwork** network_pool = Backprop_Malloc(pool_count * sizeof(struct BackpropNetwork*));
+    struct BackpropPopulation* self = Backprop_Malloc(sizeof(struct BackpropPopulation));
 
-    for (size_t i = 0; i < pool_count; ++i)
+    if (!self)
     {
-      struct BackpropNetwork* new_network = BackpropNetwork_Malloc(x_size, y_size, layers_count, chain_layers);
-
-      if (!new_network)
-      {
-        break;
-      }
+      return NULL;
+    }
 
-      network_pool[i] = new_network;
+    if (!BackpropEvolverPool_Init(&self->pool, evolver, network))
+    {
+      Backprop_Free(self, sizeof(struct BackpropPopulation));
+      return NULL;
     }
 
-    return network_pool;
+    self->random = evolver->random;
+
+    return self;
   }
 }
 
 
 
 
-static void BackpropNetwork_FreePool(struct BackpropNetwork** network_pool, BACKPROP_SIZE_T pool_count)
+void BackpropPopulation_Free(struct BackpropPopulation* self)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(network_pool);
-  BACKPROP_ASSERT(pool_count);
-
-  for (size_t i = 0; i < pool_count; ++i)
+  if (!self)
   {
-    BackpropNetwork_Free(network_pool[i]);
+    return;
   }
 
-  Backprop_Free(network_pool, pool_count * sizeof(struct BackpropNetwork*));
+  BackpropEvolverPool_Free(&self->pool);
+  Backprop_Free(self, sizeof(struct BackpropPopulation));
 }
 
 
 
 
+BACKPROP_SIZE_T BackpropPopulation_GetCount(const struct BackpropPopulation* self)
+{
+  BACKPROP_TRACE();
 
+  BACKPROP_ASSERT(self);
 
+  return self->pool.networks_count;
+}
 
 
-/*-------------------------------------------------------------------*
- *
- * BackpropEvolver
- *
- *-------------------------------------------------------------------*/
 
-#pragma mark BackpropEvolver
 
+BackpropRandom_t* BackpropPopulation_GetRandom(struct BackpropPopulation* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
 
-static void BackpropEvolver_MateLayers(BackpropEvolver_t* evolver, BackpropLayer_t* beta, const BackpropLayer_t* alpha)
+  return &self->random;
+}
+
+
+
+
+struct BackpropNetwork* BackpropPopulation_GetNetwork(struct BackpropPopulation* self, BACKPROP_SIZE_T i)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(beta);
-  BACKPROP_ASSERT(alpha);
+  BACKPROP_ASSERT(self);
+
+  if (i >= self->pool.networks_count)
   {
-    BACKPROP_FLOAT_T* W_b = (beta->W);
-    BACKPROP_FLOAT_T* W_a = (alpha->W);
+    return NULL;
+  }
+
+  return self->pool.networks[i];
+}
 
-    size_t count = beta->x_count * beta->y_count;
 
-    const BACKPROP_FLOAT_T mate_rate = evolver->mate_rate;
-    const BACKPROP_FLOAT_T one_minus_mate_rate = 1.0 - evolver->mate_rate;
-    do
-    {
-      const BACKPROP_FLOAT_T rand_a = BackpropLayer_RandomWeight() * mate_rate;
-      const BACKPROP_FLOAT_T rand_b = BackpropLayer_RandomWeight() * one_minus_mate_rate;
 
-      const BACKPROP_FLOAT_T W_new =  (((*W_a) + rand_a) + ((*W_b) + rand_b)) / 2;
 
-      (*W_b) = W_new;
+BACKPROP_SIZE_T BackpropPopulation_GetGenerationCount(const struct BackpropPopulation* self)
+{
+  BACKPROP_TRACE();
 
-      ++W_b;
-      ++W_a;
+  BACKPROP_ASSERT(self);
 
-    } while (--count);
-  }
+  return self->generation_count;
 }
 
 
 
 
-static void BackpropEvolver_MateNetworks(BackpropEvolver_t* evolver,  BackpropEvolutionStats_t* evolution_stats, struct BackpropNetwork* beta, const struct BackpropNetwork* alpha)
+void BackpropPopulation_SetGenerationCount(struct BackpropPopulation* self, BACKPROP_SIZE_T value)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(beta);
-  BACKPROP_ASSERT(alpha);
+  BACKPROP_ASSERT(self);
 
-  ++evolution_stats->mate_networks_count;
+  self->generation_count = value;
+}
 
-  for (size_t i = 0; i < beta->layers.count; ++i)
+
+
+
+BACKPROP_SIZE_T BackpropPopulation_GetBestIndex(const struct BackpropPopulation* self)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  for (size_t i = 0; i < self->pool.networks_count; ++i)
   {
-    if (evolver->BeforeMateLayers)
+    if (self->pool.networks[i] == self->pool.best)
     {
-      evolver->BeforeMateLayers(evolver, evolution_stats, beta, alpha);
+      return i;
     }
+  }
 
-    BackpropEvolver_MateLayers(evolver, &beta->layers.data[i], &alpha->layers.data[i]);
+  return 0;
+}
 
-    if (evolver->AfterMateLayers)
-    {
-      evolver->AfterMateLayers(evolver, evolution_stats, beta, alpha);
-    }
+
+
+
+void BackpropPopulation_SetBestIndex(struct BackpropPopulation* self, BACKPROP_SIZE_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  if (value < self->pool.networks_count)
+  {
+    self->pool.best = self->pool.networks[value];
+    self->pool.worst = self->pool.best;
   }
 }
 
 
 
 
-void BackpropEvolver_SetToDefault(BackpropEvolver_t* self)
+BACKPROP_FLOAT_T BackpropPopulation_GetBestError(const struct BackpropPopulation* self)
 {
   BACKPROP_TRACE();
 
   BACKPROP_ASSERT(self);
 
-  memset(self, 0, sizeof(BackpropEvolver_t));
+  return self->pool.best_error;
+}
 
-  self->pool_count = 4;                // 1 alpha + 2 beta + 1 charlie
-  self->mate_rate = BACKPROP_MIN_GOLD;
-  self->max_generations = 4; //32;
-  self->mutation_limit = 1.0;
-  self->seed = 0;
-  self->random_gain = 4.0;
+
+
+
+void BackpropPopulation_SetBestError(struct BackpropPopulation* self, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+
+  self->pool.best_error = value;
 }
 
 
 
 
-/** Use an evolutionary algorithm to evolve a network trained for the given training set.
- */
-BACKPROP_FLOAT_T BackpropEvolver_Evolve(BackpropEvolver_t* evolver, BackpropEvolutionStats_t* evolution_stats, BackpropTrainer_t* trainer, BackpropTrainingStats_t* training_stats, BackpropExerciseStats_t* exercise_stats, struct BackpropNetwork* network, const BackpropTrainingSet_t* training_set)
+BACKPROP_FLOAT_T BackpropPopulation_GetError(const struct BackpropPopulation* self, BACKPROP_SIZE_T i)
 {
   BACKPROP_TRACE();
 
-  BACKPROP_ASSERT(evolver);
-  BACKPROP_ASSERT(evolution_stats);
-  BACKPROP_ASSERT(trainer);
-  BACKPROP_ASSERT(training_stats);
-  BACKPROP_ASSERT(exercise_stats);
-  BACKPROP_ASSERT(network);
-  BACKPROP_ASSERT(training_set);
+  BACKPROP_ASSERT(self);
+
+  if (i >= self->pool.networks_count)
   {
-    const bool chain_layers = true;
+    return HUGE_VAL;
+  }
 
-    long int clock_start = clock();
+  return self->pool.errors[i];
+}
 
-    // allocate network pool
-    struct BackpropNetwork** network_pool = BackpropNetwork_MallocPool( network->x.size
-                                                                      , network->y.size
-                                                                      , network->layers.count
-                                                                      , evolver->pool_count
-                                                                      , chain_layers);
 
-    // copy existing network data into pool
-    BackpropNetwork_DeepCopy(network, network_pool[0]);
 
-    // randomize rest of pool
-    {
-      unsigned int seed = evolver->seed;
-      for (size_t i = 1; i < evolver->pool_count; ++i)
-      {
-        BackpropNetwork_Randomize(network_pool[i], evolver->random_gain, seed);
-        ++seed;
-      }
-    }
 
-    {
-      // get error benchmarks
-      BACKPROP_FLOAT_T error = BackpropTrainer_Exercise(trainer, exercise_stats, network_pool[0], training_set);
+void BackpropPopulation_SetError(struct BackpropPopulation* self, BACKPROP_SIZE_T i, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_TRACE();
 
-      BACKPROP_FLOAT_T best_error = error;
-      struct BackpropNetwork* best = network_pool[0];
+  BACKPROP_ASSERT(self);
 
-      BACKPROP_FLOAT_T worst_error = error;
-      struct BackpropNetwork* worst = network_pool[0];
+  if (i < self->pool.networks_count)
+  {
+    self->pool.errors[i] = value;
+  }
+}
 
-      // clear out stats
-      *evolution_stats = (BackpropEvolutionStats_t) {0};
 
-      // batch train the network pool
-      {
-        BACKPROP_SIZE_T generation_count = 0;
-        while ((error > trainer->error_tolerance) && (generation_count < evolver->max_generations))
-        {
-          if (evolver->BeforeGeneration)
-          {
-            evolver->BeforeGeneration(evolver, evolution_stats, generation_count);
-          }
 
-          // train all pool members
-          for (size_t i = 1; i < evolver->pool_count; ++i)
-          {
-            struct BackpropTrainingSession session = {
-              .training_set = training_set,
-              .stats = training_stats,
-              .exercise_stats = exercise_stats
-            };
 
-            error = BackpropTrainer_TrainBatch(trainer, network_pool[i], &session);
+bool BackpropPopulation_GetTrained(const struct BackpropPopulation* self, BACKPROP_SIZE_T i)
+{
+  BACKPROP_TRACE();
 
-            if (error < best_error)
-            {
-              best_error = error;
-              best = network_pool[i];
-            }
+  BACKPROP_ASSERT(self);
 
-            if (error < trainer->error_tolerance)
-            {
-              break;
-            }
+  if (i >= self->pool.networks_count)
+  {
+    return false;
+  }
 
-            if (error > worst_error)
-            {
-              worst_error = error;
-              worst = network_pool[i];
-            }
-          }
+  return self->pool.versions[i] && (self->pool.versions[i] == BackpropNetwork_GetWeightsVersion(self->pool.networks[i]));
+}
 
-          if (error < trainer->error_tolerance)
-          {
-            break;
-          }
 
-          // evolve pool members
-          for (size_t i = 0; i < evolver->pool_count; ++i)
-          {
-            struct BackpropNetwork* network = network_pool[i];
 
-            // do not mate best with self or worst member of pool
-            if ((network == best) || (network == worst))
-            {
-              continue;
-            }
 
-            if (evolver->BeforeMateNetworks)
-            {
-              evolver->BeforeMateNetworks(evolver, evolution_stats, network);
-            }
+void BackpropPopulation_SetTrained(struct BackpropPopulation* self, BACKPROP_SIZE_T i, bool value)
+{
+  BACKPROP_TRACE();
 
-            BackpropEvolver_MateNetworks(evolver, evolution_stats, network, best);
+  BACKPROP_ASSERT(self);
 
-            if (evolver->AfterMateNetworks)
-            {
-              evolver->AfterMateNetworks(evolver, evolution_stats, network, best);
-            }
-          }
+  if (i < self->pool.networks_count)
+  {
+    self->pool.versions[i] = value ? BackpropNetwork_GetWeightsVersion(self->pool.networks[i]) : 0;
+  }
+}
 
-          if (evolver->AfterGeneration)
-          {
-            evolver->AfterGeneration(evolver, evolution_stats, generation_count);
-          }
 
-          ++generation_count;
-          ++evolution_stats->generation_count;
-        }
-      }
 
-      // copy out best network data
-      BackpropNetwork_DeepCopy(best, network);
 
-      // all done
-      BackpropNetwork_FreePool(network_pool, evolver->pool_count);
+void BackpropPopulation_CopyBest(const struct BackpropPopulation* self, struct BackpropNetwork* network)
+{
+  BACKPROP_TRACE();
 
-      {
-        long int clock_stop = clock();
-        evolution_stats->evolve_clock = clock_stop - clock_start;
-      }
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(network);
+
+  BackpropNetwork_DeepCopy(self->pool.best, network);
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropPopulation_Evolve( struct BackpropPopulation* self
+                                          , BackpropEvolver_t* evolver
+                                          , BackpropEvolutionStats_t* evolution_stats
+                                          , BackpropTrainer_t* trainer
+                                          , BackpropTrainingStats_t* training_stats
+                                          , BackpropExerciseStats_t* exercise_stats
+                                          , const BackpropTrainingSet_t* training_set)
+{
+  BACKPROP_TRACE();
+
+  BACKPROP_ASSERT(self);
+  BACKPROP_ASSERT(evolver);
+  BACKPROP_ASSERT(evolution_stats);
+  BACKPROP_ASSERT(trainer);
+  BACKPROP_ASSERT(training_stats);
+  BACKPROP_ASSERT(exercise_stats);
+  BACKPROP_ASSERT(training_set);
+  {
+    long int clock_start = clock();
+
+    // select and mate with the population PRNG, so a saved population draws on where it stopped
+    const BackpropRandom_t evolver_random = evolver->random;
+    evolver->random = self->random;
 
-      return best_error;
+    // clear out stats
+    *evolution_stats = (BackpropEvolutionStats_t) {0};
+
+    BackpropEvolverPool_Start(&self->pool, evolver, trainer, training_stats, exercise_stats, training_set);
+
+    self->generation_count += BackpropEvolverPool_Run(&self->pool, evolver, evolution_stats, trainer, self->generation_count);
+
+    BackpropEvolverPool_Stop(&self->pool);
+
+    self->random = evolver->random;
+    evolver->random = evolver_random;
+
+    {
+      long int clock_stop = clock();
+      evolution_stats->evolve_clock = clock_stop - clock_start;
     }
+
+    return self->pool.best_error;
   }
 }
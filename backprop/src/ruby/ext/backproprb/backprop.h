@@ -165,6 +165,7 @@ struct BackpropLayer* BackpropLayersArray_GetLayer(struct BackpropLayersArray* s
 
 /** Set callback function to malloc().
  *  Can be used to override default behavior.
+ *  Must be thread safe if trainers or evolvers are given threads.
  */
 void Backprop_SetMalloc(void* (*) (size_t));
 
@@ -202,6 +203,37 @@ void Backprop_ResetTotals(void);
 size_t Backprop_GetMallocInUse(void);
 
 
+/** Instruction sets available to the vector math kernels.
+ */
+typedef enum BackpropSimd
+{
+  BACKPROP_SIMD_SCALAR = 0,  ///< Plain C loops.
+  BACKPROP_SIMD_SSE2,        ///< 2 doubles per instruction.
+  BACKPROP_SIMD_AVX2,        ///< 4 doubles per instruction, requires AVX2 and FMA.
+  BACKPROP_SIMD_AVX512,      ///< 8 doubles per instruction, requires AVX-512F.
+  BACKPROP_SIMD_COUNT
+
+} BackpropSimd_t;
+
+
+/** Returns the instruction set used by the vector math kernels.
+ *  By default, the best instruction set supported by the CPU is selected when the library is loaded.
+ */
+BackpropSimd_t Backprop_GetSimd(void);
+
+
+/** Select the instruction set used by the vector math kernels.
+ *  If the CPU does not support simd, the best supported instruction set below it is used.
+ *  Returns the instruction set actually selected.
+ */
+BackpropSimd_t Backprop_SetSimd(BackpropSimd_t simd);
+
+
+/** Returns the name of an instruction set, e.g. "avx2".
+ */
+const char* Backprop_GetSimdName(BackpropSimd_t simd);
+
+
 
 
 
@@ -222,6 +254,42 @@ size_t Backprop_GetMallocInUse(void);
 BACKPROP_FLOAT_T Backprop_Sigmoid(BACKPROP_FLOAT_T x);
 
 
+/** Sigmoid evaluation modes, see BackpropNetwork_SetSigmoid().
+ *  Max errors are measured against Backprop_Sigmoid() for all inputs.
+ */
+typedef enum BackpropSigmoid
+{
+  BACKPROP_SIGMOID_EXACT = 0,  ///< Backprop_Sigmoid(), calls exp().
+  BACKPROP_SIGMOID_FAST,       ///< Backprop_SigmoidFast(), max error 1.8e-9.
+  BACKPROP_SIGMOID_TABLE,      ///< Backprop_SigmoidTable(), max error 3.0e-6.
+  BACKPROP_SIGMOID_COUNT
+
+} BackpropSigmoid_t;
+
+
+/** Approximate sigmoid using a polynomial for exp().
+ *  Max absolute error is 1.8e-9 (at x near ln(2)/2).
+ *  Has no branches or calls, so loops over it can be vectorized.
+ */
+BACKPROP_FLOAT_T Backprop_SigmoidFast(BACKPROP_FLOAT_T x);
+
+
+/** Approximate sigmoid by linear interpolation of a 2049 entry table over [-16, 16].
+ *  Max absolute error is 3.0e-6, and 1.2e-7 outside the table range.
+ */
+BACKPROP_FLOAT_T Backprop_SigmoidTable(BACKPROP_FLOAT_T x);
+
+
+/** Evaluate sigmoid using mode.
+ */
+BACKPROP_FLOAT_T Backprop_SigmoidMode(BackpropSigmoid_t mode, BACKPROP_FLOAT_T x);
+
+
+/** Returns the name of a sigmoid mode, e.g. "fast".
+ */
+const char* Backprop_GetSigmoidName(BackpropSigmoid_t mode);
+
+
 
 
 
@@ -235,22 +303,71 @@ BACKPROP_FLOAT_T Backprop_Sigmoid(BACKPROP_FLOAT_T x);
  *-------------------------------------------------------------------*/
 
 
-/** Use pseudo-random number generator (PRNG) to generate a random integer.
+// Number of interleaved streams of a BackpropRandom, value i of a fill comes from stream i % BACKPROP_RANDOM_LANES.
+#define BACKPROP_RANDOM_LANES    (8)
+
+// Number of random numbers a BackpropRandom generates at a time for single draws.
+#define BACKPROP_RANDOM_POOL_COUNT    (64)
+
+
+/** Pseudo-random number generator (PRNG) state.
+ *  BACKPROP_RANDOM_LANES xoshiro256+ streams, generated in bulk by the vector math kernels,
+ *  so the same seed gives the same numbers on every instruction set.
+ *  Networks, trainers and evolvers each own one, so jobs on different threads do not share state.
+ *  The state is plain data, copy it to save it and copy it back to restore it.
+ */
+typedef struct BackpropRandom
+{
+  uint64_t s[4][BACKPROP_RANDOM_LANES];               ///< s[w][lane] is word w of the state of lane, so each word of every stream is one vector.
+  BACKPROP_FLOAT_T pool[BACKPROP_RANDOM_POOL_COUNT];  ///< Generated numbers for single draws.
+  BACKPROP_SIZE_T pool_next;                          ///< Index of the next unused number in pool.
+
+} BackpropRandom_t;
+
+
+/** Seed a PRNG, similar seeds give unrelated streams.
+ */
+void BackpropRandom_Seed(BackpropRandom_t* self, unsigned long seed);
+
+
+/** Seed a PRNG from the state of parent and index, without changing parent.
+ *  Each index gives a stream unrelated to parent and to the other indexes, so copies of one parent do not share draws.
+ */
+void BackpropRandom_Split(BackpropRandom_t* self, const BackpropRandom_t* parent, uint64_t index);
+
+
+/** Fill x with count uniform random numbers in the range [0, 1).
+ */
+void BackpropRandom_Fill(BackpropRandom_t* self, BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T count);
+
+
+/** Returns a uniform random number in the range [0, 1).
+ */
+BACKPROP_FLOAT_T BackpropRandom_UniformFloat(BackpropRandom_t* self);
+
+
+/** Returns a uniform random index in the range [lower, upper).
+ */
+BACKPROP_SIZE_T BackpropRandom_ArrayIndex(BackpropRandom_t* self, size_t lower, size_t upper);
+
+
+/** Use the module PRNG to generate a random integer.
+ *  The module PRNG is used by the functions below, and by objects that have no PRNG of their own.
  */
 int Backprop_UniformRandomInt(void);
 
 
-/** Seed the PRNG.
+/** Seed the module PRNG.
  */
 void Backprop_RandomSeed(unsigned long seed);
 
 
-/** Use the current time to seed the PRNG.
+/** Use the current time to seed the module PRNG.
  */
 void Backprop_RandomSeedTime(void);
 
 
-/** Use pseudo-random number generator (PRNG) to generate a random float.
+/** Use the module PRNG to generate a random float.
  */
 BACKPROP_FLOAT_T Backprop_UniformRandomFloat(void);
 
@@ -310,10 +427,15 @@ BACKPROP_FLOAT_T BackpropLayer_GetAtW(const struct BackpropLayer* self, size_t i
 
 void BackpropLayer_SetAtW(struct BackpropLayer* self, size_t i, BACKPROP_FLOAT_T value);
 
+/** Returns the weight matrix, y_count rows of x_count weights.
+ *  Rows are BackpropLayer_GetWStride() weights apart, the padding weights are zero.
+ */
 BACKPROP_FLOAT_T* BackpropLayer_GetW(struct BackpropLayer* self);
 
 const BACKPROP_FLOAT_T* BackpropLayer_GetConstW(const struct BackpropLayer* self);
 
+BACKPROP_SIZE_T BackpropLayer_GetWStride(const struct BackpropLayer* self);
+
 BACKPROP_SIZE_T BackpropLayer_GetWeightsCount(const BackpropLayer_t* self);
 
 BACKPROP_FLOAT_T BackpropLayer_GetWeightsSum(const BackpropLayer_t* self);
@@ -345,19 +467,52 @@ void BackpropLayer_Reset(BackpropLayer_t* self);
 
 
 /** Returns the number of bytes allocated for a network with the given sizes.
+ *  Large enough for either value of chain_layers.
  */
 size_t BackpropNetwork_MallocSize(BACKPROP_SIZE_T x_size, BACKPROP_SIZE_T y_size, BACKPROP_SIZE_T layers_count);
 
 
+/** Returns the number of bytes BackpropNetwork_Malloc() allocates for a network with the given sizes and chain_layers.
+ */
+size_t BackpropNetwork_MallocSizeWith(BACKPROP_SIZE_T x_size, BACKPROP_SIZE_T y_size, BACKPROP_SIZE_T layers_count, bool chain_layers);
+
+
 /** Dynamically allocate memory for a BackpropNetwork.
  *  Returns pointer to malloc'ed memory.
  *  Returns NULL if error.
  *  Must call BackpropNetwork_Free() with pointer returned from this function.
+ *  If chain_layers is true, each layer after the first uses the output of the previous layer
+ *  as its input, so activation does not copy values between layers.
+ *  The network and all of its buffers are one memory block, with every weight row cache line aligned.
  */
 struct BackpropNetwork* BackpropNetwork_Malloc(BACKPROP_SIZE_T x_size, BACKPROP_SIZE_T y_size, BACKPROP_SIZE_T layers_count, bool chain_layers);
 
 
-/** Free memory allocated by BackpropNetwork_Malloc().
+/** Build a BackpropNetwork inside a caller supplied buffer, without allocating memory.
+ *  size must be at least BackpropNetwork_MallocSizeWith(x_size, y_size, layers_count, chain_layers),
+ *  buffer needs no particular alignment.
+ *  A trainer for the network is built in a second buffer, see BackpropTrainer_Init().
+ *  Returns NULL if buffer is too small.
+ *  Must call BackpropNetwork_Detach() before the buffer is released or reused.
+ */
+struct BackpropNetwork* BackpropNetwork_Init(void* buffer, size_t size, BACKPROP_SIZE_T x_size, BACKPROP_SIZE_T y_size, BACKPROP_SIZE_T layers_count, bool chain_layers);
+
+
+/** Detach a network built by BackpropNetwork_Init() from its buffer.
+ *  Does not free the buffer, only the first layer lookup table if it is in use.
+ */
+void BackpropNetwork_Detach(struct BackpropNetwork* network);
+
+
+/** Dynamically allocate a copy of a BackpropNetwork, with one allocation and one copy.
+ *  The copy draws input jitter from its own PRNG, split from the one of self.
+ *  Returns NULL if error.
+ *  Must call BackpropNetwork_Free() with pointer returned from this function.
+ */
+struct BackpropNetwork* BackpropNetwork_Clone(const struct BackpropNetwork* self);
+
+
+/** Free memory allocated by BackpropNetwork_Malloc() or BackpropNetwork_Clone().
  */
 void BackpropNetwork_Free(struct BackpropNetwork* network);
 
@@ -398,6 +553,43 @@ void BackpropNetwork_InputCStr(struct BackpropNetwork* self, const char* values)
 void BackpropNetwork_Activate(struct BackpropNetwork* self);
 
 
+/** Activate a network for a batch of inputs.
+ *  x holds count packed input rows of BackpropNetwork_GetXSize() bytes,
+ *  y receives count packed output rows of BackpropNetwork_GetYSize() bytes.
+ *  Layers are evaluated for a block of rows at a time, so each weight matrix
+ *  is read once per block instead of once per input.
+ *  Does not change the network input, output or layer values.
+ *  Input jitter is drawn from random, so concurrent calls need a PRNG each.
+ *  random may be NULL if the network jitter is 0.
+ *  Returns false if the scratch memory could not be allocated, y is not written then.
+ */
+bool BackpropNetwork_ActivateBatch(const struct BackpropNetwork* self, BackpropRandom_t* random, const BACKPROP_BYTE_T* x, BACKPROP_BYTE_T* y, BACKPROP_SIZE_T count);
+
+
+/** Use a lookup table for the first layer.
+ *  The table holds the first layer weighted sums for each of the 256 values of each input byte,
+ *  so the first layer costs one add per input byte per neuron instead of CHAR_BIT multiply-adds.
+ *  Uses x_size * 256 * (first layer y_count) floats of memory.
+ *  The table is only used while jitter is 0 and it is up to date with the first layer weights.
+ *  Rebuilding it costs about 256 activations, so it is only rebuilt by BackpropNetwork_UpdateInputTable()
+ *  and by trainer exercises of a whole set, never by BackpropNetwork_Activate().
+ *  Training that changes the weights after every pair therefore runs without the table.
+ */
+void BackpropNetwork_SetUseInputTable(struct BackpropNetwork* self, bool use);
+
+
+/** Recompute the first layer lookup table if the first layer weights have changed.
+ *  Call before many activations with the same weights, e.g. before BackpropNetwork_ActivateBatch().
+ *  Returns true if the table may be used.
+ */
+bool BackpropNetwork_UpdateInputTable(struct BackpropNetwork* self);
+
+
+/** Returns true if the network uses a lookup table for the first layer.
+ */
+bool BackpropNetwork_GetUseInputTable(const struct BackpropNetwork* self);
+
+
 /** Output bytes values from a network.
  *  Returns number of input bytes used.
  */
@@ -432,6 +624,7 @@ void BackpropNetwork_Identity(struct BackpropNetwork* self);
 
 
 /** Randomize weights for a network.
+ *  Seeds the network PRNG with seed, see BackpropNetwork_GetRandom().
  */
 void BackpropNetwork_Randomize(struct BackpropNetwork* self, BACKPROP_FLOAT_T gain, unsigned int seed);
 
@@ -459,6 +652,21 @@ BACKPROP_SIZE_T BackpropNetwork_GetWeightsCount(const struct BackpropNetwork* se
 BACKPROP_SIZE_T BackpropNetwork_GetWeightsSize(const struct BackpropNetwork* self);
 
 
+/** Copy the weights of every layer, in layer and row order, into the BackpropNetwork_GetWeightsCount() values of weights.
+ */
+void BackpropNetwork_GetWeights(const struct BackpropNetwork* self, BACKPROP_FLOAT_T* weights);
+
+
+/** Set the weights of every layer from weights, in the order of BackpropNetwork_GetWeights().
+ */
+void BackpropNetwork_SetWeights(struct BackpropNetwork* self, const BACKPROP_FLOAT_T* weights);
+
+
+/** Add scale times deltas, in the order of BackpropNetwork_GetWeights(), to the weights of every layer.
+ */
+void BackpropNetwork_AddWeights(struct BackpropNetwork* self, BACKPROP_FLOAT_T scale, const BACKPROP_FLOAT_T* deltas);
+
+
 BACKPROP_FLOAT_T BackpropNetwork_GetWeightsSum(const struct BackpropNetwork* self);
 
 
@@ -508,6 +716,31 @@ BACKPROP_FLOAT_T BackpropNetwork_GetJitter(const struct BackpropNetwork* self);
 void BackpropNetwork_SetJitter(struct BackpropNetwork* self, BACKPROP_FLOAT_T jitter);
 
 
+/** Returns the PRNG used for input jitter and BackpropNetwork_Randomize().
+ *  BackpropNetwork_ActivateBatch() does not modify the network, so it draws jitter from a caller PRNG instead.
+ */
+BackpropRandom_t* BackpropNetwork_GetRandom(struct BackpropNetwork* self);
+
+
+/** Set how the network layers evaluate the sigmoid activation function.
+ *  Used by activation and training.  The default is BACKPROP_SIGMOID_EXACT.
+ *  Changing the mode changes the weights version of the network, see BackpropNetwork_GetWeightsVersion().
+ */
+void BackpropNetwork_SetSigmoid(struct BackpropNetwork* self, BackpropSigmoid_t mode);
+
+
+/** Returns how the network layers evaluate the sigmoid activation function.
+ */
+BackpropSigmoid_t BackpropNetwork_GetSigmoid(const struct BackpropNetwork* self);
+
+
+/** Returns a version that changes whenever the weights or the sigmoid mode of any layer of the network change,
+ *  0 if they never have. Training sessions reuse an exercise of the network while the version stays the same.
+ *  Every modification gives a layer the newest version in the process, so the latest layer version identifies the weights.
+ */
+uint64_t BackpropNetwork_GetWeightsVersion(const struct BackpropNetwork* self);
+
+
 
 
 
@@ -554,6 +787,95 @@ void BackpropNetwork_GetStats(const struct BackpropNetwork* self, BackpropNetwor
 
 
 
+/*-------------------------------------------------------------------*
+ *
+ * INFERENCE MODEL FUNCTIONS
+ *
+ * A BackpropInferenceModel is a read-only copy of the weights of a trained network.
+ * It has no input, output or gradient buffers, activation uses caller provided scratch memory,
+ * so any number of threads may activate the same model at once.
+ * The model is one block of memory without pointers, it may be copied with memcpy()
+ * or placed in shared memory.
+ * The input is used without jitter.
+ *
+ *-------------------------------------------------------------------*/
+
+
+struct BackpropInferenceModel;
+
+
+/** Returns the size in bytes of an inference model built from network.
+ */
+size_t BackpropInferenceModel_MallocSize(const struct BackpropNetwork* network);
+
+
+/** Build an inference model from network in a caller provided buffer.
+ *  size must be at least BackpropInferenceModel_MallocSize(network).
+ *  Returns a pointer to the model at the start of buffer, or NULL if size is too small.
+ */
+struct BackpropInferenceModel* BackpropInferenceModel_Init(void* buffer, size_t size, const struct BackpropNetwork* network);
+
+
+/** Returns true if a model built from network has the sizes, layers and weight offsets of self,
+ *  so building it over self only changes the weights and sigmoids.
+ */
+bool BackpropInferenceModel_HasLayout(const struct BackpropInferenceModel* self, const struct BackpropNetwork* network);
+
+
+/** Allocate and build an inference model from network.
+ *  Later changes to network do not change the model.
+ */
+struct BackpropInferenceModel* BackpropInferenceModel_Malloc(const struct BackpropNetwork* network);
+
+
+/** Free an inference model allocated by BackpropInferenceModel_Malloc().
+ */
+void BackpropInferenceModel_Free(struct BackpropInferenceModel* self);
+
+
+/** Returns the size in bytes of the model.
+ */
+size_t BackpropInferenceModel_GetSize(const struct BackpropInferenceModel* self);
+
+
+/** Returns the size of the model input in bytes.
+ */
+BACKPROP_SIZE_T BackpropInferenceModel_GetXSize(const struct BackpropInferenceModel* self);
+
+
+/** Returns the size of the model output in bytes.
+ */
+BACKPROP_SIZE_T BackpropInferenceModel_GetYSize(const struct BackpropInferenceModel* self);
+
+
+/** Returns the size in bytes of the scratch memory needed by each thread to activate the model.
+ *  Scratch memory must be aligned for BACKPROP_FLOAT_T.
+ */
+size_t BackpropInferenceModel_GetScratchSize(const struct BackpropInferenceModel* self);
+
+
+/** Activate the model for one input.
+ *  x holds BackpropInferenceModel_GetXSize() bytes, y receives BackpropInferenceModel_GetYSize() bytes.
+ */
+void BackpropInferenceModel_Activate(const struct BackpropInferenceModel* self, void* scratch, const BACKPROP_BYTE_T* x, BACKPROP_BYTE_T* y);
+
+
+/** Activate the model for count packed input rows.
+ *  Gives the same output as count calls to BackpropInferenceModel_Activate().
+ */
+void BackpropInferenceModel_ActivateBatch( const struct BackpropInferenceModel* self
+                                         , void* scratch
+                                         , const BACKPROP_BYTE_T* x
+                                         , BACKPROP_BYTE_T* y
+                                         , BACKPROP_SIZE_T count);
+
+
+
+
+
+
+
+
 /*-------------------------------------------------------------------*
  *
  * NETWORK TRAINING FUNCTIONS
@@ -597,6 +919,8 @@ typedef struct BackpropExerciseStats
   long int exercise_clock_ticks;
   BACKPROP_SIZE_T activate_count;
   BACKPROP_FLOAT_T error;
+  BACKPROP_FLOAT_T error_bound;   ///< Half width of the confidence interval of a sampled error, 0 if every pair was exercised.
+  bool stopped;                   ///< True if the exercise stopped once the error exceeded its limit, see BackpropTrainer_ExerciseBounded(), or a sample showed it.
 
 } BackpropExerciseStats_t;
 
@@ -682,7 +1006,7 @@ typedef struct BackpropTrainingStats
   BACKPROP_FLOAT_T pair_error_correction;
   BACKPROP_FLOAT_T set_weight_correction_total;
   BACKPROP_FLOAT_T batch_weight_correction_total;
-  BACKPROP_SIZE_T teach_total;                      ///< Total teaching.
+  BACKPROP_SIZE_T teach_total;                      ///< Total teaching, pairs already within the error tolerance are not taught.
   BACKPROP_SIZE_T pair_total;                       ///< Total number of training pairs.
   BACKPROP_SIZE_T set_total;                        ///< Total number of training sets.
   BACKPROP_SIZE_T batches_total;                    ///< Total number of training batches.
@@ -789,6 +1113,7 @@ BACKPROP_FLOAT_T BackpropLearningAccelerator_Accelerate(BackpropLearningAccelera
 
 
 /** Returns the number of bytes allocated for a trainer for a given network.
+ *  This includes one weight velocity for each weight of network, used for momentum.
  */
 size_t BackpropTrainer_MallocSize(const struct BackpropNetwork* network);
 
@@ -801,6 +1126,22 @@ size_t BackpropTrainer_MallocSize(const struct BackpropNetwork* network);
 struct BackpropTrainer* BackpropTrainer_Malloc(struct BackpropNetwork* network);
 
 
+/** Build a BackpropTrainer for network inside a caller supplied buffer, without allocating memory.
+ *  size must be at least BackpropTrainer_MallocSize(network),
+ *  buffer needs no particular alignment.
+ *  The trainer takes its own buffer, separate from the one of the network,
+ *  because its size depends on the layers of the network built first.
+ *  Returns NULL if buffer is too small.
+ *  Must call BackpropTrainer_Detach() before the buffer is released or reused.
+ */
+struct BackpropTrainer* BackpropTrainer_Init(void* buffer, size_t size, const struct BackpropNetwork* network);
+
+
+/** Detach a trainer built by BackpropTrainer_Init() from its buffer, does not free the buffer.
+ */
+void BackpropTrainer_Detach(struct BackpropTrainer* trainer);
+
+
 /** Free memory allocated by BackpropNetwork_Malloc().
  */
 void BackpropTrainer_Free(struct BackpropTrainer* network);
@@ -814,6 +1155,12 @@ void BackpropTrainer_SetToDefault(struct BackpropTrainer* self);
 struct BackpropTrainerEvents* BackpropTrainer_GetEvents(BackpropTrainer_t* self);
 
 
+/** Returns the PRNG used to pick training pairs and mutate weights, seeded with a fixed seed when the trainer is built.
+ *  Seed it with BackpropRandom_Seed(), or save and restore it by copying the BackpropRandom_t.
+ */
+BackpropRandom_t* BackpropTrainer_GetRandom(BackpropTrainer_t* self);
+
+
 BACKPROP_FLOAT_T BackpropTrainer_GetErrorTolerance(const struct BackpropTrainer* self);
 
 
@@ -832,9 +1179,23 @@ BACKPROP_FLOAT_T BackpropTrainer_GetMutationRate(const struct BackpropTrainer* s
 void BackpropTrainer_SetMutationRate(struct BackpropTrainer* self, BACKPROP_FLOAT_T value);
 
 
+BACKPROP_FLOAT_T BackpropTrainer_GetMutationProbability(const struct BackpropTrainer* self);
+
+
+/** Set the probability that each weight is mutated when it is updated, the default 1 mutates every weight.
+ *  Below 1 only the mutated weights draw random numbers, so a small probability makes mutation cheap.
+ */
+void BackpropTrainer_SetMutationProbability(struct BackpropTrainer* self, BACKPROP_FLOAT_T value);
+
+
 BACKPROP_FLOAT_T BackpropTrainer_GetMomentumRate(const struct BackpropTrainer* self);
 
 
+/** Set the fraction of the previous correction of each weight that is added to its next correction.
+ *  Momentum needs a trainer sized for the network being trained, see BackpropTrainer_MallocSize(),
+ *  and is restarted by each BackpropTrainer_Train() and each time the trainer moves on to another network.
+ *  0, the default, disables momentum.
+ */
 void BackpropTrainer_SetMomentumRate(struct BackpropTrainer* self, BACKPROP_FLOAT_T value);
 
 
@@ -892,6 +1253,60 @@ BACKPROP_FLOAT_T BackpropTrainer_GetTrainingRatio(const struct BackpropTrainer*
 void BackpropTrainer_SetTrainingRatio(struct BackpropTrainer* self, BACKPROP_FLOAT_T value);
 
 
+BACKPROP_SIZE_T BackpropTrainer_GetMiniBatchSize(const struct BackpropTrainer* self);
+
+
+/** Set the number of pairs BackpropTrainer_TrainSet() teaches together.
+ *  With a value greater than 1, each mini-batch is taught once, with one summed weight update per layer,
+ *  instead of training each pair up to max_reps times.  Per pair events are not called for mini-batches.
+ */
+void BackpropTrainer_SetMiniBatchSize(struct BackpropTrainer* self, BACKPROP_SIZE_T value);
+
+
+BACKPROP_SIZE_T BackpropTrainer_GetTrainThreadCount(const struct BackpropTrainer* self);
+
+
+/** Set the number of threads BackpropTrainer_TrainSet() teaches with, 0 trains each pair with BackpropTrainer_TrainPair().
+ *  With 1 or more, each thread teaches random pairs once each, or mini-batches if the mini-batch size is greater than 1,
+ *  and updates the shared network weights without locks (Hogwild).  The calling thread is one of them,
+ *  so 1 teaches in the calling thread, the baseline to measure the scaling of more threads against.
+ *  With more than 1, the trained weights depend on thread timing, so are not reproducible.  Per pair events are not called.
+ */
+void BackpropTrainer_SetTrainThreadCount(struct BackpropTrainer* self, BACKPROP_SIZE_T value);
+
+
+bool BackpropTrainer_GetDataParallel(const struct BackpropTrainer* self);
+
+
+/** Set true for BackpropTrainer_TrainSet() to train reproducibly with train_thread_count threads.
+ *  Each mini-batch of minibatch_size pairs is split into shards, the threads compute the shard gradients
+ *  against the same weights, and the gradients are summed in a fixed order and applied once.
+ *  The trained weights are the same, bit for bit, for any number of threads.  Per pair events are not called.
+ */
+void BackpropTrainer_SetDataParallel(struct BackpropTrainer* self, bool value);
+
+
+BACKPROP_SIZE_T BackpropTrainer_GetExerciseSampleCount(const struct BackpropTrainer* self);
+
+
+/** Set the number of pairs sampled to estimate the training set error during training, 0 always exercises the whole set.
+ *  Where training only checks whether the set is within the error tolerance, the whole set is only exercised
+ *  when the sample cannot show that the error is above it, see BackpropExerciseStats_t error_bound.
+ *  Errors returned by training are always of the whole set.
+ */
+void BackpropTrainer_SetExerciseSampleCount(struct BackpropTrainer* self, BACKPROP_SIZE_T value);
+
+
+BACKPROP_SIZE_T BackpropTrainer_GetExerciseThreadCount(const struct BackpropTrainer* self);
+
+
+/** Set the number of threads used by BackpropTrainer_Exercise(), 0 or 1 exercises in the calling thread.
+ *  The threads share the network weights and split the training set, the error is the same as with one thread.
+ *  Exercises with per pair events or with network jitter always run in the calling thread.
+ */
+void BackpropTrainer_SetExerciseThreadCount(struct BackpropTrainer* self, BACKPROP_SIZE_T value);
+
+
 BACKPROP_FLOAT_T BackpropTrainer_GetBatchPruneThreshold(const struct BackpropTrainer* self);
 
 
@@ -913,6 +1328,14 @@ void BackpropTrainer_SetBatchPruneRate(struct BackpropTrainer* self, BACKPROP_FL
 BACKPROP_FLOAT_T BackpropTrainer_Exercise(struct BackpropTrainer* self, BackpropExerciseStats_t* stats, struct BackpropNetwork* network, const BackpropTrainingSet_t* training_set);
 
 
+/** Exercise a network with a given training set until the total error exceeds error_limit, and return the error.
+ *  Use when only a comparison of the error with error_limit is needed.
+ *  If the exercise stopped before the last pair, stats->stopped is set and the error is a lower bound of the total error,
+ *  otherwise it is the total error for the training set.
+ */
+BACKPROP_FLOAT_T BackpropTrainer_ExerciseBounded(struct BackpropTrainer* self, BackpropExerciseStats_t* stats, struct BackpropNetwork* network, const BackpropTrainingSet_t* training_set, BACKPROP_FLOAT_T error_limit);
+
+
 /** Exercise a network with a given training set and return the total error for the training set.
  */
 BACKPROP_FLOAT_T BackpropTrainer_ExerciseConst(struct BackpropTrainer* self, BackpropExerciseStats_t* stats, struct BackpropNetwork* network, const BackpropConstTrainingSet_t* training_set);
@@ -935,14 +1358,69 @@ BACKPROP_FLOAT_T BackpropTrainer_TrainPair( struct BackpropTrainer* self
                                           , const BACKPROP_BYTE_T* y, size_t y_size);
 
 
+/** Last whole set exercise of a network.
+ */
+typedef struct BackpropExerciseRecord
+{
+  const struct BackpropNetwork* network;        ///< Network exercised, NULL if none.
+  const BackpropTrainingSet_t* training_set;    ///< Training set exercised.
+  uint64_t weights_version;                     ///< Weights version of the network when exercised, 0 if not exercised.
+  BackpropExerciseStats_t stats;                ///< Results of the exercise.
+
+} BackpropExerciseRecord_t;
+
+
+/** Exercise records of a fixed set of networks, such as an evolver pool, one record for each network.
+ *  Sessions training different networks of the set may share the cache from different threads.
+ */
+struct BackpropExerciseCache;
+
+
+/** A training session trains with one training set, which must not change during the session.
+ *  The error of the last whole set exercise of a network is reused until the network weights change,
+ *  kept in exercise_cache if the network is one of its networks, otherwise in last_exercise,
+ *  so initialize last_exercise to zero.
+ */
 struct BackpropTrainingSession
 {
   const BackpropTrainingSet_t* training_set;
   BackpropTrainingStats_t* stats;
   BackpropExerciseStats_t* exercise_stats;
+  BackpropExerciseRecord_t last_exercise;
+  struct BackpropExerciseCache* exercise_cache;   ///< Optional, NULL to keep only last_exercise.
+  BACKPROP_SIZE_T activate_total;                 ///< Number of pairs activated by the exercises of the session, reused exercises not counted.
 };
 
 
+/*-------------------------------------------------------------------*
+ *
+ * BACKPROP EXERCISE CACHE FUNCTIONS
+ *
+ *-------------------------------------------------------------------*/
+
+
+/** Allocate a cache with an empty record for each of count networks.
+ *  The networks must not be freed before the cache.
+ *  Returns NULL if error.
+ */
+struct BackpropExerciseCache* BackpropExerciseCache_Malloc(struct BackpropNetwork* const* networks, size_t count);
+
+
+/** Free a cache allocated with BackpropExerciseCache_Malloc().
+ */
+void BackpropExerciseCache_Free(struct BackpropExerciseCache* self);
+
+
+/** Empty every record of the cache, for example when a training set may have been changed in place.
+ */
+void BackpropExerciseCache_Clear(struct BackpropExerciseCache* self);
+
+
+/** Returns the record of network, or NULL if network is not one of the networks of the cache.
+ */
+BackpropExerciseRecord_t* BackpropExerciseCache_Find(struct BackpropExerciseCache* self, const struct BackpropNetwork* network);
+
+
 BACKPROP_FLOAT_T BackpropTrainer_TrainSet( BackpropTrainer_t* trainer
                                          , struct BackpropNetwork* network
                                          , struct BackpropTrainingSession* session);
@@ -973,25 +1451,60 @@ typedef struct BackpropEvolutionStats
 {
   BACKPROP_SIZE_T generation_count;
   BACKPROP_SIZE_T mate_networks_count;
+  BACKPROP_SIZE_T selection_count;   ///< Number of parents selected, 0 with BACKPROP_SELECTION_BEST.
+  BACKPROP_SIZE_T activate_count;    ///< Number of pairs activated exercising pool members in generations, reused exercises not counted.
 
   long int evolve_clock;
+  long int selection_clock;          ///< Clock ticks spent ordering the pool and selecting parents, see BackpropSelection_t.
 
 } BackpropEvolutionStats_t;
 
 
 
 
+/** How the evolver selects the network each pool member mates with.
+ *  Except for BACKPROP_SELECTION_BEST, the pool is kept in indexed heaps ordered by error,
+ *  so each selection costs O(log n) for a pool of n members, or O(tournament_size) for a tournament,
+ *  and the elite_count best members, at least the best, are not mated.
+ */
+typedef enum BackpropSelection
+{
+  BACKPROP_SELECTION_BEST = 0,    ///< Mate every member but the best and worst with the best.
+  BACKPROP_SELECTION_TOURNAMENT,  ///< Mate each member with the lowest error of tournament_size other members drawn at random.
+  BACKPROP_SELECTION_ELITE,       ///< Mate each member with one of the elite_count best members drawn at random.
+  BACKPROP_SELECTION_RANK,        ///< Mate each member with another member drawn with a probability falling linearly with its rank.
+  BACKPROP_SELECTION_COUNT
+
+} BackpropSelection_t;
+
+
+/** Returns the name of a selection, e.g. "tournament".
+ */
+const char* BackpropEvolver_GetSelectionName(BackpropSelection_t selection);
+
+
+
+
 /** Backprop Evolver structure.
  *  Holds parameters that affect network evolution.
  */
 typedef struct BackpropEvolver
 {
   BACKPROP_SIZE_T pool_count;      ///< Number of networks in the network pool.
+  BACKPROP_SIZE_T thread_count;    ///< Number of threads training the pool, each member with its own copy of the trainer.  0 trains every member with the trainer in the calling thread.
+  BACKPROP_SIZE_T island_count;    ///< Number of pools evolved side by side, one thread each, exchanging their best members.  0 or 1 evolves a single pool.
+  BACKPROP_SIZE_T migration_interval;  ///< Number of generations between exchanges of the best member of each island with the next.
   BACKPROP_SIZE_T max_generations; ///< Maximum number of generations to run.
   BACKPROP_FLOAT_T mate_rate;      ///< Proportion of alpha weight to beta weight.  0.5 is equal alpha and beta weights.  0.75 alpha is (0.75 * alpha) + (0.25 * beta).
   BACKPROP_FLOAT_T mutation_limit; ///< The maximum mutation in a single neuron weight.
-  unsigned int seed;               ///< Seed used for random number generator.
+  unsigned int seed;               ///< Seed used for random number generator, set with BackpropEvolver_SetSeed().
   BACKPROP_FLOAT_T random_gain;    ///< Gain to apply for random number generator.
+  BackpropRandom_t random;         ///< PRNG used for mating, seeded from seed.
+  BackpropSelection_t selection;   ///< How each member selects the network it mates with.
+  BACKPROP_SIZE_T elite_count;     ///< Number of best members not mated, at least 1, unless selection is BACKPROP_SELECTION_BEST.
+  BACKPROP_SIZE_T tournament_size; ///< Number of members drawn for each BACKPROP_SELECTION_TOURNAMENT selection.
+  bool cache_exercises;            ///< Keep the last exercise of each pool network, so members a generation leaves unchanged are not exercised again.
+  bool skip_unchanged;             ///< Only exercise the members the last generation left unchanged, such as the best and the elite, instead of training them again.
 
 
   void (*BeforeMateNetworks)(const struct BackpropEvolver*, const BackpropEvolutionStats_t* stats, const struct BackpropNetwork* network);
@@ -1014,8 +1527,14 @@ typedef struct BackpropEvolver
 void BackpropEvolver_SetToDefault(BackpropEvolver_t* self);
 
 
+/** Set the seed of the pool networks and reseed the mating PRNG.
+ */
+void BackpropEvolver_SetSeed(BackpropEvolver_t* self, unsigned int seed);
+
+
 
 /** Use an evolutionary algorithm to evolve a network trained for the given training set.
+ *  Each generation trains every member but the first, or with skip_unchanged, only the members changed since they were last trained.
  */
 BACKPROP_FLOAT_T BackpropEvolver_Evolve( BackpropEvolver_t* evolver
                                        , BackpropEvolutionStats_t* evolution_stats
@@ -1028,4 +1547,117 @@ BACKPROP_FLOAT_T BackpropEvolver_Evolve( BackpropEvolver_t* evolver
 
 
 
+/*-------------------------------------------------------------------*
+ *
+ * POPULATION FUNCTIONS
+ *
+ *-------------------------------------------------------------------*/
+
+
+/**
+ * A BackpropPopulation is an evolver network pool kept between evolutions,
+ * so it is allocated and randomized once and each evolution resumes where the last one stopped.
+ *
+ *   struct BackpropPopulation* population = BackpropPopulation_Malloc(&evolver, network);
+ *   while (BackpropPopulation_Evolve(population, &evolver, ...) > error_tolerance) {...}
+ *   BackpropPopulation_CopyBest(population, network);
+ *   BackpropPopulation_Free(population);
+ *
+ */
+struct BackpropPopulation;
+
+
+/** Allocate a pool of evolver pool_count networks, the first a copy of network, the rest randomized from the evolver seed.
+ *  The population PRNG starts as a copy of the evolver PRNG.
+ *  Returns NULL if error.
+ *  Must call BackpropPopulation_Free() with pointer returned from this function.
+ */
+struct BackpropPopulation* BackpropPopulation_Malloc(const BackpropEvolver_t* evolver, const struct BackpropNetwork* network);
+
+
+void BackpropPopulation_Free(struct BackpropPopulation* self);
+
+
+/** Returns the number of networks in the population.
+ */
+BACKPROP_SIZE_T BackpropPopulation_GetCount(const struct BackpropPopulation* self);
+
+
+/** Returns the PRNG the population selects and mates with, in place of the evolver PRNG.
+ *  It is saved with the population, so a loaded population draws on where the saved one stopped.
+ */
+BackpropRandom_t* BackpropPopulation_GetRandom(struct BackpropPopulation* self);
+
+
+/** Returns network i of the population, or NULL if there is none.
+ */
+struct BackpropNetwork* BackpropPopulation_GetNetwork(struct BackpropPopulation* self, BACKPROP_SIZE_T i);
+
+
+/** Returns the number of generations evolved by the population.
+ */
+BACKPROP_SIZE_T BackpropPopulation_GetGenerationCount(const struct BackpropPopulation* self);
+
+
+void BackpropPopulation_SetGenerationCount(struct BackpropPopulation* self, BACKPROP_SIZE_T value);
+
+
+/** Returns the index of the best network of the population.
+ */
+BACKPROP_SIZE_T BackpropPopulation_GetBestIndex(const struct BackpropPopulation* self);
+
+
+void BackpropPopulation_SetBestIndex(struct BackpropPopulation* self, BACKPROP_SIZE_T value);
+
+
+/** Returns the error of the best network of the last evolution, HUGE_VAL before the first.
+ */
+BACKPROP_FLOAT_T BackpropPopulation_GetBestError(const struct BackpropPopulation* self);
+
+
+void BackpropPopulation_SetBestError(struct BackpropPopulation* self, BACKPROP_FLOAT_T value);
+
+
+/** Returns the error of network i when it was last exercised, HUGE_VAL if it has not been.
+ *  Selections other than BACKPROP_SELECTION_BEST pick parents by these errors.
+ */
+BACKPROP_FLOAT_T BackpropPopulation_GetError(const struct BackpropPopulation* self, BACKPROP_SIZE_T i);
+
+
+void BackpropPopulation_SetError(struct BackpropPopulation* self, BACKPROP_SIZE_T i, BACKPROP_FLOAT_T value);
+
+
+/** Returns true if network i is as the last generation left it after training it, so the next generation only exercises it.
+ */
+bool BackpropPopulation_GetTrained(const struct BackpropPopulation* self, BACKPROP_SIZE_T i);
+
+
+/** Set whether network i, with its current weights, is left as trained, for example after loading its weights.
+ */
+void BackpropPopulation_SetTrained(struct BackpropPopulation* self, BACKPROP_SIZE_T i, bool value);
+
+
+/** Copy the best network of the population into network.
+ */
+void BackpropPopulation_CopyBest(const struct BackpropPopulation* self, struct BackpropNetwork* network);
+
+
+/** Evolve the population for up to max_generations more generations, as BackpropEvolver_Evolve() does.
+ *  The best network is exercised again first, so the training set may change between evolutions.
+ *  The island settings of the evolver are not used, and selection and mating draw from the population PRNG,
+ *  so the evolver PRNG is left as it was.  The trainer PRNG is the caller's to save and restore.
+ *  Returns the error of the best network.
+ */
+BACKPROP_FLOAT_T BackpropPopulation_Evolve( struct BackpropPopulation* self
+                                          , BackpropEvolver_t* evolver
+                                          , BackpropEvolutionStats_t* evolution_stats
+                                          , struct BackpropTrainer* trainer
+                                          , BackpropTrainingStats_t* training_stats
+                                          , BackpropExerciseStats_t* exercise_stats
+                                          , const BackpropTrainingSet_t* training_set);
+
+
+
+
+
 #endif //BACKPROP_H
@@ -495,33 +495,36 @@ size_t BackpropLayer_FprintfWeights(FILE* file, const struct BackpropLayer* self
     size_t W_row_count = x_count * CHAR_BIT;
     size_t count = x_count * BackpropLayer_GetYCount(self);
 
-    const BACKPROP_FLOAT_T* W = BackpropLayer_GetConstW(self);
+    size_t i = 0;
+    BACKPROP_FLOAT_T w = BackpropLayer_GetAtW(self, i);
 
-    if (*W >= 0)
+    if (w >= 0)
     {
-      fprintf_size += fprintf(file, " %f", *W);
+      fprintf_size += fprintf(file, " %f", w);
     }
     else
     {
-      fprintf_size += fprintf(file, "%f", *W);
+      fprintf_size += fprintf(file, "%f", w);
     }
 
-    ++W;
+    ++i;
     --count;
     --newline_count;
     --W_row_count;
 
     do
     {
-      if (*W >= 0)
+      w = BackpropLayer_GetAtW(self, i);
+
+      if (w >= 0)
       {
-        fprintf_size += fprintf(file, ",  %f", *W);
+        fprintf_size += fprintf(file, ",  %f", w);
       }
       else
       {
-        fprintf_size += fprintf(file, ", %f", *W);
+        fprintf_size += fprintf(file, ", %f", w);
       }
-      ++W;
+      ++i;
 
       --newline_count;
       if(!newline_count)
@@ -635,8 +638,13 @@ static size_t BackpropLayer_LoadWeights(struct BackpropLayer* self, FILE *file)
       {
         const BACKPROP_SIZE_T x_count = BackpropLayer_GetXCount(self);
         const BACKPROP_SIZE_T y_count = BackpropLayer_GetYCount(self);
+        const BACKPROP_SIZE_T W_stride = BackpropLayer_GetWStride(self);
 
-        c_count += json_fscanarray_float(file, W, x_count * y_count);
+        // the weights are saved without the row padding
+        for (BACKPROP_SIZE_T j = 0; j < y_count; ++j)
+        {
+          c_count += json_fscanarray_float(file, W + j * W_stride, x_count);
+        }
         c_count += fskipstr(file, "]");
         c_count += fskipspace(file);
       }
@@ -1812,3 +1820,212 @@ size_t BackpropEvolutionStats_Puts(const struct BackpropEvolutionStats* stats)
     return result;
   }
 }
+
+
+
+
+/*-------------------------------------------------------------------*
+ *
+ * BackpropPopulation
+ *
+ *-------------------------------------------------------------------*/
+
+#pragma mark BackpropPopulation
+
+
+// Identifies a population file, "BPPOP\0\0\4".
+#define BACKPROP_POPULATION_MAGIC    (0x04000000504F5042ull)
+
+
+
+
+/**
+ * Population file header, followed by the count network errors, then count networks of weights_count weights,
+ * then a byte for each network, 1 if it is left as trained, then the population PRNG and the jitter PRNG of each network.
+ */
+typedef struct BackpropPopulationHeader
+{
+  uint64_t magic;               ///< BACKPROP_POPULATION_MAGIC.
+  uint64_t count;               ///< Number of networks.
+  uint64_t weights_count;       ///< Number of weights of each network.
+  uint64_t generation_count;    ///< Number of generations evolved.
+  uint64_t best_index;          ///< Index of the best network.
+  double best_error;            ///< Error of the best network.
+
+} BackpropPopulationHeader_t;
+
+
+
+
+size_t BackpropPopulation_Save(const struct BackpropPopulation* self, const char* filename)
+{
+  BACKPROP_IO_ASSERT(self);
+  BACKPROP_IO_ASSERT(filename);
+  {
+    // the networks are only read, the population accessors are not const
+    struct BackpropPopulation* population = (struct BackpropPopulation*) self;
+
+    const BackpropPopulationHeader_t header = {
+      .magic = BACKPROP_POPULATION_MAGIC,
+      .count = BackpropPopulation_GetCount(self),
+      .weights_count = BackpropNetwork_GetWeightsCount(BackpropPopulation_GetNetwork(population, 0)),
+      .generation_count = BackpropPopulation_GetGenerationCount(self),
+      .best_index = BackpropPopulation_GetBestIndex(self),
+      .best_error = BackpropPopulation_GetBestError(self)
+    };
+
+    size_t write_size = 0;
+
+    // room for the errors or the weights of one network
+    const size_t array_count = (header.weights_count > header.count) ? header.weights_count : header.count;
+
+    BACKPROP_FLOAT_T* weights = malloc(array_count * sizeof(BACKPROP_FLOAT_T) + 1);
+    FILE* file = weights ? fopen(filename, "wb") : NULL;
+
+    if (NULL == file)
+    {
+      printf("Cannot open %s\n", filename);
+      free(weights);
+      return 0;
+    }
+
+    for (size_t i = 0; i < header.count; ++i)
+    {
+      weights[i] = BackpropPopulation_GetError(self, i);
+    }
+
+    if (   (1 == fwrite(&header, sizeof(header), 1, file))
+        && (header.count == fwrite(weights, sizeof(BACKPROP_FLOAT_T), header.count, file)))
+    {
+      write_size += sizeof(header) + header.count * sizeof(BACKPROP_FLOAT_T);
+
+      for (size_t i = 0; i < header.count; ++i)
+      {
+        BackpropNetwork_GetWeights(BackpropPopulation_GetNetwork(population, i), weights);
+
+        if (header.weights_count != fwrite(weights, sizeof(BACKPROP_FLOAT_T), header.weights_count, file))
+        {
+          write_size = 0;
+          break;
+        }
+
+        write_size += header.weights_count * sizeof(BACKPROP_FLOAT_T);
+      }
+    }
+
+    for (size_t i = 0; write_size && (i < header.count); ++i)
+    {
+      const uint8_t trained = BackpropPopulation_GetTrained(self, i);
+
+      if (1 != fwrite(&trained, sizeof(trained), 1, file))
+      {
+        write_size = 0;
+        break;
+      }
+
+      write_size += sizeof(trained);
+    }
+
+    if (write_size && (1 == fwrite(BackpropPopulation_GetRandom(population), sizeof(BackpropRandom_t), 1, file)))
+    {
+      write_size += sizeof(BackpropRandom_t);
+
+      for (size_t i = 0; i < header.count; ++i)
+      {
+        if (1 != fwrite(BackpropNetwork_GetRandom(BackpropPopulation_GetNetwork(population, i)), sizeof(BackpropRandom_t), 1, file))
+        {
+          write_size = 0;
+          break;
+        }
+
+        write_size += sizeof(BackpropRandom_t);
+      }
+    }
+
+    else
+    {
+      write_size = 0;
+    }
+
+    if (0 != fclose(file))
+    {
+      write_size = 0;
+    }
+
+    free(weights);
+
+    return write_size;
+  }
+}
+
+
+
+
+size_t BackpropPopulation_Load(struct BackpropPopulation* self, const char* filename)
+{
+  BACKPROP_IO_ASSERT(self);
+  BACKPROP_IO_ASSERT(filename);
+  {
+    BackpropPopulationHeader_t header;
+
+    const size_t count = BackpropPopulation_GetCount(self);
+    const size_t weights_count = BackpropNetwork_GetWeightsCount(BackpropPopulation_GetNetwork(self, 0));
+
+    size_t read_size = 0;
+
+    BACKPROP_FLOAT_T* weights = NULL;
+    FILE* file = fopen(filename, "rb");
+
+    if (NULL == file)
+    {
+      printf("Cannot open %s\n", filename);
+      return 0;
+    }
+
+    if (   (1 != fread(&header, sizeof(header), 1, file))
+        || (BACKPROP_POPULATION_MAGIC != header.magic)
+        || (count != header.count)
+        || (weights_count != header.weights_count)
+        || (header.best_index >= count))
+    {
+      fclose(file);
+      return 0;
+    }
+
+    // the PRNGs, then the errors, then the weights of every network, then the trained flags
+    const size_t randoms_size = (1 + count) * sizeof(BackpropRandom_t);
+
+    BackpropRandom_t* randoms = malloc(randoms_size + count * (1 + weights_count) * sizeof(BACKPROP_FLOAT_T) + count + 1);
+
+    weights = randoms ? (BACKPROP_FLOAT_T*) (randoms + 1 + count) : NULL;
+
+    uint8_t* trained = weights ? (uint8_t*) (weights + count * (1 + weights_count)) : NULL;
+
+    // read everything before changing anything, so a short file leaves the population as it was
+    if (   weights
+        && (count * (1 + weights_count) == fread(weights, sizeof(BACKPROP_FLOAT_T), count * (1 + weights_count), file))
+        && (count == fread(trained, sizeof(uint8_t), count, file))
+        && ((1 + count) == fread(randoms, sizeof(BackpropRandom_t), 1 + count, file)))
+    {
+      for (size_t i = 0; i < count; ++i)
+      {
+        BackpropPopulation_SetError(self, i, weights[i]);
+        BackpropNetwork_SetWeights(BackpropPopulation_GetNetwork(self, i), weights + count + i * weights_count);
+        BackpropPopulation_SetTrained(self, i, trained[i]);
+        *BackpropNetwork_GetRandom(BackpropPopulation_GetNetwork(self, i)) = randoms[1 + i];
+      }
+
+      BackpropPopulation_SetGenerationCount(self, header.generation_count);
+      BackpropPopulation_SetBestIndex(self, header.best_index);
+      BackpropPopulation_SetBestError(self, header.best_error);
+      *BackpropPopulation_GetRandom(self) = randoms[0];
+
+      read_size = sizeof(header) + count * (1 + weights_count) * sizeof(BACKPROP_FLOAT_T) + count + randoms_size;
+    }
+
+    free(randoms);
+    fclose(file);
+
+    return read_size;
+  }
+}
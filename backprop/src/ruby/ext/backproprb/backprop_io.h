@@ -419,4 +419,27 @@ size_t BackpropEvolutionStats_Puts(const struct BackpropEvolutionStats* stats);
 
 
 
+/*-------------------------------------------------------------------*
+ *
+ * BackpropPopulation
+ *
+ *-------------------------------------------------------------------*/
+
+
+/** Save the weights, last error, trained flag and jitter PRNG of every network of the population,
+ *  its generation count, best network, best error and PRNG to a binary file.
+ *  Weights are written in host byte order, exactly, so a loaded population evolves on as the saved one would.
+ *  Returns number of bytes written, 0 if error.
+ */
+size_t BackpropPopulation_Save(const struct BackpropPopulation* self, const char* filename);
+
+
+/** Load a population saved by BackpropPopulation_Save() into a population with the same number and shape of networks.
+ *  Returns number of bytes read, 0 if error or if the population does not match.
+ */
+size_t BackpropPopulation_Load(struct BackpropPopulation* self, const char* filename);
+
+
+
+
 #endif/*BACKPROP_IO_H*/
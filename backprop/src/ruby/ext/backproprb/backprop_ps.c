@@ -0,0 +1,919 @@
+/** backprop_ps.c
+
+
+Author: Joshua Petitt
+Available at: https://github.com/jpmec/ann
+
+
+Copyright (c) 2012-2013 Joshua Petitt
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+// socket(), poll() and getaddrinfo() are POSIX, not C99
+#define _POSIX_C_SOURCE 200809L
+
+
+#include "backprop_ps.h"
+#include "backprop.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+
+
+#ifndef NDEBUG
+  #include <assert.h>
+  #define BACKPROP_PS_ASSERT(_arg_)    assert(_arg_)
+
+#else
+  #define BACKPROP_PS_ASSERT(_arg_)
+
+#endif
+
+
+// Writes to a closed connection fail rather than raise SIGPIPE, where supported.
+#ifdef MSG_NOSIGNAL
+  #define BACKPROP_PS_SEND_FLAGS    (MSG_NOSIGNAL)
+#else
+  #define BACKPROP_PS_SEND_FLAGS    (0)
+#endif
+
+
+// The server reads only what poll() reported, this also keeps a spurious wakeup from blocking, where supported.
+#ifdef MSG_DONTWAIT
+  #define BACKPROP_PS_RECV_FLAGS    (MSG_DONTWAIT)
+#else
+  #define BACKPROP_PS_RECV_FLAGS    (0)
+#endif
+
+
+// Identifies a frame, "BPPS" in host byte order.
+#define BACKPROP_PS_MAGIC    (0x53505042u)
+
+// Maximum number of workers connected to a server at once.
+#define BACKPROP_PS_CLIENTS_MAX    (64)
+
+// Number of connections waiting to be accepted by a server.
+#define BACKPROP_PS_LISTEN_BACKLOG    (16)
+
+
+
+
+/**
+ * Frame types.
+ */
+typedef enum BackpropPsFrameType
+{
+  BACKPROP_PS_PULL = 1,       ///< Worker asks for the weights, count is 0.
+  BACKPROP_PS_WEIGHTS = 2,    ///< Server sends the weights of version.
+  BACKPROP_PS_PUSH = 3,       ///< Worker sends the change to the weights of version.
+  BACKPROP_PS_ACK = 4         ///< Server added the push, making version, count is 0.
+
+} BackpropPsFrameType_t;
+
+
+
+
+/**
+ * Frame header, followed by count weights.
+ */
+typedef struct BackpropPsFrame
+{
+  uint32_t magic;       ///< BACKPROP_PS_MAGIC.
+  uint32_t type;        ///< BackpropPsFrameType_t.
+  uint64_t version;     ///< Server version of the weights.
+  uint64_t count;       ///< Number of BACKPROP_FLOAT_T weights following.
+
+} BackpropPsFrame_t;
+
+
+
+
+/**
+ * Parameter server worker connection, receiving frames without blocking.
+ */
+typedef struct BackpropPsConnection
+{
+  int fd;                                   ///< Connected socket.
+  BackpropPsFrame_t frame;                  ///< Header of the frame being received.
+  BACKPROP_FLOAT_T* weights;                ///< Weights of the frame being received, room for the served weights.
+  size_t received;                          ///< Number of bytes of the frame received so far.
+
+} BackpropPsConnection_t;
+
+
+
+
+/**
+ * Parameter server.
+ */
+struct BackpropPsServer
+{
+  struct BackpropNetwork* network;          ///< Served network.
+  BACKPROP_FLOAT_T* weights;                ///< Buffer of weights_count weights for frames.
+  size_t weights_count;                     ///< Number of weights of network.
+
+  int listen_fd;                            ///< Listening socket.
+  BackpropPsConnection_t clients[BACKPROP_PS_CLIENTS_MAX];   ///< Connected workers.
+  size_t clients_count;                     ///< Number of connected workers.
+
+  uint64_t version;                         ///< Number of pushes added.
+  BACKPROP_FLOAT_T push_scale;              ///< Factor of each push.
+
+  char path[sizeof(((struct sockaddr_un*) 0)->sun_path)];   ///< UNIX-domain socket path, empty for TCP.
+  pid_t pid;                                ///< Process that created the socket, only it removes the path.
+};
+
+
+
+
+/**
+ * Parameter server worker connection.
+ */
+struct BackpropPsClient
+{
+  int fd;                                   ///< Connected socket.
+  uint64_t version;                         ///< Server version of the pulled weights.
+
+  BACKPROP_FLOAT_T* weights;                ///< Pulled weights.
+  size_t weights_count;                     ///< Number of pulled weights.
+  bool pulled;                              ///< True if weights were pulled and not yet pushed.
+};
+
+
+
+
+static bool BackpropPs_Read(int fd, void* data, size_t size)
+{
+  char* ptr = data;
+
+  while (size)
+  {
+    const ssize_t n = read(fd, ptr, size);
+
+    if (n < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+
+      return false;
+    }
+
+    if (0 == n)
+    {
+      return false;
+    }
+
+    ptr += n;
+    size -= n;
+  }
+
+  return true;
+}
+
+
+
+
+static bool BackpropPs_Write(int fd, const void* data, size_t size)
+{
+  const char* ptr = data;
+
+  while (size)
+  {
+    const ssize_t n = send(fd, ptr, size, BACKPROP_PS_SEND_FLAGS);
+
+    if (n < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+
+      return false;
+    }
+
+    ptr += n;
+    size -= n;
+  }
+
+  return true;
+}
+
+
+
+
+static bool BackpropPs_WriteFrame(int fd, uint32_t type, uint64_t version, const BACKPROP_FLOAT_T* weights, size_t count)
+{
+  const BackpropPsFrame_t frame = { .magic = BACKPROP_PS_MAGIC, .type = type, .version = version, .count = count };
+
+  return BackpropPs_Write(fd, &frame, sizeof(frame))
+      && BackpropPs_Write(fd, weights, count * sizeof(BACKPROP_FLOAT_T));
+}
+
+
+
+
+static bool BackpropPs_ReadFrame(int fd, BackpropPsFrame_t* frame)
+{
+  BACKPROP_PS_ASSERT(frame);
+
+  return BackpropPs_Read(fd, frame, sizeof(BackpropPsFrame_t))
+      && (BACKPROP_PS_MAGIC == frame->magic);
+}
+
+
+
+
+/** Open a socket for address, "unix:path" or "tcp:host:port", bound and listening if listen, else connected.
+ *  Sets path to the UNIX-domain socket path, if any.
+ *  Returns -1 if error.
+ */
+static int BackpropPs_Open(const char* address, bool listen_socket, char* path, size_t path_size)
+{
+  BACKPROP_PS_ASSERT(address);
+
+  if (0 == strncmp(address, "unix:", 5))
+  {
+    struct sockaddr_un addr;
+    const char* name = address + 5;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (!*name || (strlen(name) >= sizeof(addr.sun_path)))
+    {
+      return -1;
+    }
+
+    strcpy(addr.sun_path, name);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0)
+    {
+      return -1;
+    }
+
+    if (listen_socket)
+    {
+      // a socket file left by a server that exited is in the way
+      unlink(name);
+
+      if ((0 != bind(fd, (struct sockaddr*) &addr, sizeof(addr))) || (0 != listen(fd, BACKPROP_PS_LISTEN_BACKLOG)))
+      {
+        close(fd);
+        return -1;
+      }
+
+      if (path && (path_size > strlen(name)))
+      {
+        strcpy(path, name);
+      }
+    }
+
+    else if (0 != connect(fd, (struct sockaddr*) &addr, sizeof(addr)))
+    {
+      close(fd);
+      return -1;
+    }
+
+    return fd;
+  }
+
+  else if (0 == strncmp(address, "tcp:", 4))
+  {
+    char host[256];
+    const char* port = strrchr(address + 4, ':');
+
+    struct addrinfo hints;
+    struct addrinfo* info = NULL;
+
+    int fd = -1;
+
+    if (!port || ((size_t) (port - (address + 4)) >= sizeof(host)))
+    {
+      return -1;
+    }
+
+    memcpy(host, address + 4, port - (address + 4));
+    host[port - (address + 4)] = '\0';
+    ++port;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV | (listen_socket ? AI_PASSIVE : 0);
+
+    if (0 != getaddrinfo(*host ? host : NULL, port, &hints, &info))
+    {
+      return -1;
+    }
+
+    for (const struct addrinfo* ai = info; ai && (fd < 0); ai = ai->ai_next)
+    {
+      const int one = 1;
+
+      fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+
+      if (fd < 0)
+      {
+        continue;
+      }
+
+      if (listen_socket)
+      {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        if ((0 != bind(fd, ai->ai_addr, ai->ai_addrlen)) || (0 != listen(fd, BACKPROP_PS_LISTEN_BACKLOG)))
+        {
+          close(fd);
+          fd = -1;
+        }
+      }
+
+      else if (0 != connect(fd, ai->ai_addr, ai->ai_addrlen))
+      {
+        close(fd);
+        fd = -1;
+      }
+
+      else
+      {
+        // frames are written in two parts, send them without waiting for an ack
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      }
+    }
+
+    freeaddrinfo(info);
+
+    return fd;
+  }
+
+  return -1;
+}
+
+
+
+
+struct BackpropPsServer* BackpropPsServer_Create(struct BackpropNetwork* network, const char* address)
+{
+  BACKPROP_PS_ASSERT(network);
+  BACKPROP_PS_ASSERT(address);
+  {
+    struct BackpropPsServer* self = calloc(1, sizeof(struct BackpropPsServer));
+
+    if (!self)
+    {
+      return NULL;
+    }
+
+    self->network = network;
+    self->weights_count = BackpropNetwork_GetWeightsCount(network);
+    self->weights = malloc(self->weights_count * sizeof(BACKPROP_FLOAT_T) + 1);
+    self->push_scale = 1.0;
+    self->pid = getpid();
+
+    self->listen_fd = self->weights ? BackpropPs_Open(address, true, self->path, sizeof(self->path)) : -1;
+
+    if (self->listen_fd < 0)
+    {
+      free(self->weights);
+      free(self);
+      return NULL;
+    }
+
+    return self;
+  }
+}
+
+
+
+
+static void BackpropPsServer_Disconnect(struct BackpropPsServer* self, size_t i)
+{
+  BACKPROP_PS_ASSERT(self);
+  BACKPROP_PS_ASSERT(i < self->clients_count);
+
+  close(self->clients[i].fd);
+  free(self->clients[i].weights);
+  self->clients[i] = self->clients[--self->clients_count];
+}
+
+
+
+
+void BackpropPsServer_Close(struct BackpropPsServer* self)
+{
+  if (!self)
+  {
+    return;
+  }
+
+  while (self->clients_count)
+  {
+    BackpropPsServer_Disconnect(self, 0);
+  }
+
+  close(self->listen_fd);
+
+  // a forked worker closing its copy must not remove the server socket
+  if (self->path[0] && (getpid() == self->pid))
+  {
+    unlink(self->path);
+  }
+
+  free(self->weights);
+  free(self);
+}
+
+
+
+
+int BackpropPsServer_GetPort(const struct BackpropPsServer* self)
+{
+  BACKPROP_PS_ASSERT(self);
+  {
+    struct sockaddr_storage addr;
+    socklen_t addr_size = sizeof(addr);
+
+    if (self->path[0] || (0 != getsockname(self->listen_fd, (struct sockaddr*) &addr, &addr_size)))
+    {
+      return 0;
+    }
+
+    if (AF_INET == addr.ss_family)
+    {
+      return ntohs(((struct sockaddr_in*) &addr)->sin_port);
+    }
+
+    if (AF_INET6 == addr.ss_family)
+    {
+      return ntohs(((struct sockaddr_in6*) &addr)->sin6_port);
+    }
+
+    return 0;
+  }
+}
+
+
+
+
+uint64_t BackpropPsServer_GetVersion(const struct BackpropPsServer* self)
+{
+  BACKPROP_PS_ASSERT(self);
+
+  return self->version;
+}
+
+
+
+
+BACKPROP_FLOAT_T BackpropPsServer_GetPushScale(const struct BackpropPsServer* self)
+{
+  BACKPROP_PS_ASSERT(self);
+
+  return self->push_scale;
+}
+
+
+
+
+void BackpropPsServer_SetPushScale(struct BackpropPsServer* self, BACKPROP_FLOAT_T value)
+{
+  BACKPROP_PS_ASSERT(self);
+
+  self->push_scale = value;
+}
+
+
+
+
+/** Receive what is available of the frame a worker is sending, without blocking.
+ *  Returns 1 if the frame is complete, 0 if more is to come, or -1 if the worker must be disconnected.
+ */
+static int BackpropPsServer_Receive(struct BackpropPsServer* self, BackpropPsConnection_t* client)
+{
+  BACKPROP_PS_ASSERT(self);
+  BACKPROP_PS_ASSERT(client);
+  {
+    const size_t header_size = sizeof(BackpropPsFrame_t);
+    const bool header = (client->received < header_size);
+
+    char* ptr = header ? ((char*) &client->frame + client->received) : ((char*) client->weights + (client->received - header_size));
+    const size_t size = header ? (header_size - client->received) : (header_size + client->frame.count * sizeof(BACKPROP_FLOAT_T) - client->received);
+
+    const ssize_t n = recv(client->fd, ptr, size, BACKPROP_PS_RECV_FLAGS);
+
+    if (n < 0)
+    {
+      return ((EINTR == errno) || (EAGAIN == errno) || (EWOULDBLOCK == errno)) ? 0 : -1;
+    }
+
+    if (0 == n)
+    {
+      return -1;
+    }
+
+    client->received += n;
+
+    if (client->received < header_size)
+    {
+      return 0;
+    }
+
+    if (header && (client->received == header_size))
+    {
+      // check the header before waiting for any weights, the weights buffer only fits the served weights
+      const BackpropPsFrame_t* frame = &client->frame;
+
+      const bool valid = (BACKPROP_PS_MAGIC == frame->magic)
+                      && (   ((BACKPROP_PS_PULL == frame->type) && (0 == frame->count))
+                          || ((BACKPROP_PS_PUSH == frame->type) && (self->weights_count == frame->count)));
+
+      if (!valid)
+      {
+        return -1;
+      }
+    }
+
+    return (client->received == header_size + client->frame.count * sizeof(BACKPROP_FLOAT_T)) ? 1 : 0;
+  }
+}
+
+
+
+
+/** Answer the frame a worker has completely sent.
+ *  Returns false if the worker must be disconnected.
+ */
+static bool BackpropPsServer_Answer(struct BackpropPsServer* self, BackpropPsConnection_t* client, size_t* pushed)
+{
+  BACKPROP_PS_ASSERT(self);
+  BACKPROP_PS_ASSERT(client);
+  BACKPROP_PS_ASSERT(pushed);
+
+  client->received = 0;
+
+  switch (client->frame.type)
+  {
+    case BACKPROP_PS_PULL:
+    {
+      BackpropNetwork_GetWeights(self->network, self->weights);
+
+      return BackpropPs_WriteFrame(client->fd, BACKPROP_PS_WEIGHTS, self->version, self->weights, self->weights_count);
+    }
+
+    case BACKPROP_PS_PUSH:
+    {
+      BackpropNetwork_AddWeights(self->network, self->push_scale, client->weights);
+
+      ++self->version;
+      ++*pushed;
+
+      return BackpropPs_WriteFrame(client->fd, BACKPROP_PS_ACK, self->version, NULL, 0);
+    }
+
+    default:
+      return false;
+  }
+}
+
+
+
+
+/** Add an accepted worker, replies to it time out after timeout_ms milliseconds.
+ *  Returns false if the worker was not added.
+ */
+static bool BackpropPsServer_Connect(struct BackpropPsServer* self, int fd, int timeout_ms)
+{
+  BACKPROP_PS_ASSERT(self);
+  {
+    BackpropPsConnection_t* client = &self->clients[self->clients_count];
+    const int one = 1;
+
+    if (self->clients_count >= BACKPROP_PS_CLIENTS_MAX)
+    {
+      return false;
+    }
+
+    memset(client, 0, sizeof(BackpropPsConnection_t));
+    client->fd = fd;
+    client->weights = malloc(self->weights_count * sizeof(BACKPROP_FLOAT_T) + 1);
+
+    if (!client->weights)
+    {
+      return false;
+    }
+
+    // fails harmlessly on UNIX-domain sockets
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // a worker that stops reading must not hold up the others for ever
+    if (timeout_ms > 0)
+    {
+      const struct timeval timeout = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    }
+
+    ++self->clients_count;
+
+    return true;
+  }
+}
+
+
+
+
+size_t BackpropPsServer_Serve(struct BackpropPsServer* self, size_t push_count, int timeout_ms)
+{
+  BACKPROP_PS_ASSERT(self);
+  {
+    size_t pushed = 0;
+
+    while (pushed < push_count)
+    {
+      struct pollfd fds[BACKPROP_PS_CLIENTS_MAX + 1];
+      const size_t clients_count = self->clients_count;
+
+      int ready = 0;
+
+      for (size_t i = 0; i < clients_count; ++i)
+      {
+        fds[i].fd = self->clients[i].fd;
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+      }
+
+      fds[clients_count].fd = self->listen_fd;
+      fds[clients_count].events = POLLIN;
+      fds[clients_count].revents = 0;
+
+      ready = poll(fds, clients_count + 1, timeout_ms);
+
+      if (ready < 0)
+      {
+        if (EINTR == errno)
+        {
+          continue;
+        }
+
+        break;
+      }
+
+      if (0 == ready)
+      {
+        break;
+      }
+
+      // answer in reverse, so a disconnect only moves workers already answered
+      // a worker that sent part of a frame keeps it until the rest arrives, and is not waited for
+      for (size_t i = clients_count; i-- > 0; )
+      {
+        if (fds[i].revents && (pushed < push_count))
+        {
+          const int received = BackpropPsServer_Receive(self, &self->clients[i]);
+
+          if ((received < 0) || ((received > 0) && !BackpropPsServer_Answer(self, &self->clients[i], &pushed)))
+          {
+            BackpropPsServer_Disconnect(self, i);
+          }
+        }
+      }
+
+      if (fds[clients_count].revents & POLLIN)
+      {
+        int fd = accept(self->listen_fd, NULL, NULL);
+
+        if ((fd >= 0) && !BackpropPsServer_Connect(self, fd, timeout_ms))
+        {
+          close(fd);
+        }
+      }
+    }
+
+    return pushed;
+  }
+}
+
+
+
+
+struct BackpropPsClient* BackpropPsClient_Connect(const char* address)
+{
+  BACKPROP_PS_ASSERT(address);
+  {
+    struct BackpropPsClient* self = calloc(1, sizeof(struct BackpropPsClient));
+
+    if (!self)
+    {
+      return NULL;
+    }
+
+    self->fd = BackpropPs_Open(address, false, NULL, 0);
+
+    if (self->fd < 0)
+    {
+      free(self);
+      return NULL;
+    }
+
+    return self;
+  }
+}
+
+
+
+
+void BackpropPsClient_Close(struct BackpropPsClient* self)
+{
+  if (!self)
+  {
+    return;
+  }
+
+  close(self->fd);
+  free(self->weights);
+  free(self);
+}
+
+
+
+
+uint64_t BackpropPsClient_GetVersion(const struct BackpropPsClient* self)
+{
+  BACKPROP_PS_ASSERT(self);
+
+  return self->version;
+}
+
+
+
+
+bool BackpropPsClient_Pull(struct BackpropPsClient* self, struct BackpropNetwork* network)
+{
+  BACKPROP_PS_ASSERT(self);
+  BACKPROP_PS_ASSERT(network);
+  {
+    const size_t weights_count = BackpropNetwork_GetWeightsCount(network);
+
+    BackpropPsFrame_t frame;
+
+    self->pulled = false;
+
+    if (self->weights_count != weights_count)
+    {
+      BACKPROP_FLOAT_T* weights = realloc(self->weights, weights_count * sizeof(BACKPROP_FLOAT_T) + 1);
+
+      if (!weights)
+      {
+        return false;
+      }
+
+      self->weights = weights;
+      self->weights_count = weights_count;
+    }
+
+    if (   !BackpropPs_WriteFrame(self->fd, BACKPROP_PS_PULL, self->version, NULL, 0)
+        || !BackpropPs_ReadFrame(self->fd, &frame)
+        || (BACKPROP_PS_WEIGHTS != frame.type))
+    {
+      return false;
+    }
+
+    if (frame.count != weights_count)
+    {
+      // skip the weights, so the connection stays usable with a matching network
+      for (uint64_t i = 0; i < frame.count; ++i)
+      {
+        BACKPROP_FLOAT_T w;
+
+        if (!BackpropPs_Read(self->fd, &w, sizeof(w)))
+        {
+          break;
+        }
+      }
+
+      return false;
+    }
+
+    if (!BackpropPs_Read(self->fd, self->weights, weights_count * sizeof(BACKPROP_FLOAT_T)))
+    {
+      return false;
+    }
+
+    BackpropNetwork_SetWeights(network, self->weights);
+    self->version = frame.version;
+    self->pulled = true;
+
+    return true;
+  }
+}
+
+
+
+
+bool BackpropPsClient_Push(struct BackpropPsClient* self, const struct BackpropNetwork* network)
+{
+  BACKPROP_PS_ASSERT(self);
+  BACKPROP_PS_ASSERT(network);
+  {
+    const size_t weights_count = self->weights_count;
+
+    BACKPROP_FLOAT_T* pulled = self->weights;
+    BACKPROP_FLOAT_T* current = NULL;
+
+    BackpropPsFrame_t frame;
+    bool result = false;
+
+    if (!self->pulled || (BackpropNetwork_GetWeightsCount(network) != weights_count))
+    {
+      return false;
+    }
+
+    current = malloc(weights_count * sizeof(BACKPROP_FLOAT_T));
+
+    if (!current)
+    {
+      return false;
+    }
+
+    BackpropNetwork_GetWeights(network, current);
+
+    // the change is computed in place of the current weights
+    for (size_t i = 0; i < weights_count; ++i)
+    {
+      current[i] -= pulled[i];
+    }
+
+    result = BackpropPs_WriteFrame(self->fd, BACKPROP_PS_PUSH, self->version, current, weights_count)
+          && BackpropPs_ReadFrame(self->fd, &frame)
+          && (BACKPROP_PS_ACK == frame.type);
+
+    free(current);
+
+    // a push is made once, the next push needs another pull
+    self->pulled = false;
+
+    return result;
+  }
+}
+
+
+
+
+size_t BackpropPsClient_Train( struct BackpropPsClient* self
+                             , struct BackpropTrainer* trainer
+                             , struct BackpropNetwork* network
+                             , struct BackpropTrainingSession* session
+                             , size_t rounds)
+{
+  BACKPROP_PS_ASSERT(self);
+  BACKPROP_PS_ASSERT(trainer);
+  BACKPROP_PS_ASSERT(network);
+  BACKPROP_PS_ASSERT(session);
+  {
+    size_t i = 0;
+
+    for (; i < rounds; ++i)
+    {
+      if (!BackpropPsClient_Pull(self, network))
+      {
+        break;
+      }
+
+      BackpropTrainer_TrainSet(trainer, network, session);
+
+      if (!BackpropPsClient_Push(self, network))
+      {
+        break;
+      }
+    }
+
+    return i;
+  }
+}
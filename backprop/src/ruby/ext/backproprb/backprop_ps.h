@@ -0,0 +1,148 @@
+/** backprop_ps.h
+
+Defines parameter server training over sockets for backprop.h.
+
+One process serves the weights of a network, any number of worker processes train copies of it.
+Each worker pulls the current weights, trains with a BackpropTrainer on its own training set,
+and pushes back the change in its weights, which the server adds to the served network.
+Workers connect over a UNIX-domain socket, "unix:/path/to/socket", or a TCP socket, "tcp:host:port".
+
+Messages are a BackpropPsFrame header followed by count weights.
+Frames are in host byte order, so the server and workers must have the same byte order and BACKPROP_FLOAT_T.
+
+
+
+
+Author: Joshua Petitt
+Available at: https://github.com/jpmec/ann
+
+
+Copyright (c) 2012-2013 Joshua Petitt
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+
+*/
+
+
+#ifndef BACKPROP_PS_H
+#define BACKPROP_PS_H
+
+
+#include "backprop.h"
+
+
+
+
+/*-------------------------------------------------------------------*
+ *
+ * PARAMETER SERVER FUNCTIONS
+ *
+ *-------------------------------------------------------------------*/
+
+
+/**
+ * A BackpropPsServer serves the weights of a network to BackpropPsClient workers.
+ *
+ *   struct BackpropPsServer* server = BackpropPsServer_Create(network, "unix:/tmp/backprop.sock");
+ *   BackpropPsServer_Serve(server, push_count, 1000);
+ *   BackpropPsServer_Close(server);
+ *
+ */
+struct BackpropPsServer;
+
+
+/** Listen for workers on address, "unix:path" or "tcp:host:port", port 0 picks a free port.
+ *  The network must stay valid until BackpropPsServer_Close().
+ *  Returns NULL if error.
+ *  Must call BackpropPsServer_Close() with pointer returned from this function.
+ */
+struct BackpropPsServer* BackpropPsServer_Create(struct BackpropNetwork* network, const char* address);
+
+
+/** Close the server and all worker connections, and remove the UNIX-domain socket.
+ */
+void BackpropPsServer_Close(struct BackpropPsServer* self);
+
+
+/** Returns the TCP port the server listens on, 0 for a UNIX-domain socket.
+ */
+int BackpropPsServer_GetPort(const struct BackpropPsServer* self);
+
+
+/** Returns the number of pushes added to the network since the server was created.
+ */
+uint64_t BackpropPsServer_GetVersion(const struct BackpropPsServer* self);
+
+
+BACKPROP_FLOAT_T BackpropPsServer_GetPushScale(const struct BackpropPsServer* self);
+
+
+/** Set the factor each pushed change is multiplied by before it is added to the network, default 1.
+ *  With many workers, 1 / workers keeps the step size of a single worker.
+ */
+void BackpropPsServer_SetPushScale(struct BackpropPsServer* self, BACKPROP_FLOAT_T value);
+
+
+/** Accept workers and answer their pulls and pushes in the calling thread,
+ *  until push_count pushes have been added or nothing happens for timeout_ms milliseconds.
+ *  Pushes are added one at a time, in the order they arrive.
+ *  Frames are received without blocking, so a worker that stalls part way through a frame does not hold up the others,
+ *  and a reply that a worker does not read for timeout_ms milliseconds disconnects it.
+ *  Returns the number of pushes added.
+ */
+size_t BackpropPsServer_Serve(struct BackpropPsServer* self, size_t push_count, int timeout_ms);
+
+
+
+
+/**
+ * A BackpropPsClient is a worker connection to a BackpropPsServer.
+ */
+struct BackpropPsClient;
+
+
+/** Connect to the server at address, "unix:path" or "tcp:host:port".
+ *  Returns NULL if error.
+ *  Must call BackpropPsClient_Close() with pointer returned from this function.
+ */
+struct BackpropPsClient* BackpropPsClient_Connect(const char* address);
+
+
+void BackpropPsClient_Close(struct BackpropPsClient* self);
+
+
+/** Returns the server version of the weights last pulled, 0 if none.
+ */
+uint64_t BackpropPsClient_GetVersion(const struct BackpropPsClient* self);
+
+
+/** Set the weights of network to the weights served.
+ *  Returns false if error or if network does not have the same number of weights as the served network.
+ */
+bool BackpropPsClient_Pull(struct BackpropPsClient* self, struct BackpropNetwork* network);
+
+
+/** Push the change in the weights of network since the last BackpropPsClient_Pull().
+ *  Returns false if error or if nothing was pulled.
+ */
+bool BackpropPsClient_Push(struct BackpropPsClient* self, const struct BackpropNetwork* network);
+
+
+/** Pull, train the set once with BackpropTrainer_TrainSet() and push, rounds times.
+ *  Returns the number of rounds pushed, less than rounds if error.
+ */
+size_t BackpropPsClient_Train( struct BackpropPsClient* self
+                             , struct BackpropTrainer* trainer
+                             , struct BackpropNetwork* network
+                             , struct BackpropTrainingSession* session
+                             , size_t rounds);
+
+
+
+
+#endif
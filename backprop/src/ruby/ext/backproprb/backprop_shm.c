@@ -0,0 +1,424 @@
+/** backprop_shm.c
+
+
+Author: Joshua Petitt
+Available at: https://github.com/jpmec/ann
+
+
+Copyright (c) 2012-2013 Joshua Petitt
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+// shm_open(), ftruncate() and mmap() are POSIX, not C99
+#define _POSIX_C_SOURCE 200809L
+
+
+#include "backprop_shm.h"
+#include "backprop.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+
+
+#ifndef NDEBUG
+  #include <assert.h>
+  #define BACKPROP_SHM_ASSERT(_arg_)    assert(_arg_)
+
+#else
+  #define BACKPROP_SHM_ASSERT(_arg_)
+
+#endif
+
+
+// Identifies a segment created by BackpropShm_Create(), "BPSHM\0\0\2".
+#define BACKPROP_SHM_MAGIC    (0x02000000484D5350ull)
+
+// Number of model slots, a publish writes the slot not holding the latest model.
+#define BACKPROP_SHM_SLOTS_COUNT    (2)
+
+// Alignment of the model slots in the segment.
+#define BACKPROP_SHM_ALIGN_SIZE    (64)
+
+// Round _size_ up to a multiple of BACKPROP_SHM_ALIGN_SIZE.
+#define BACKPROP_SHM_ALIGN(_size_)    ((((_size_) + BACKPROP_SHM_ALIGN_SIZE - 1) / BACKPROP_SHM_ALIGN_SIZE) * BACKPROP_SHM_ALIGN_SIZE)
+
+
+
+
+/**
+ * Segment header, followed by BACKPROP_SHM_SLOTS_COUNT slots of slot_size bytes.
+ * Model generation g is in slot g % BACKPROP_SHM_SLOTS_COUNT.
+ * A slot sequence counter is odd while the slot is being written.
+ */
+typedef struct BackpropShmHeader
+{
+  uint64_t magic;                                 ///< BACKPROP_SHM_MAGIC once the segment is ready.
+  uint64_t slot_size;                             ///< Size in bytes of each slot.
+  uint64_t generation;                            ///< Number of models published.
+  uint64_t slot_seq[BACKPROP_SHM_SLOTS_COUNT];    ///< Sequence counter of each slot.
+  uint64_t x_size;                                ///< Input size of every model, set by the first publish.
+  uint64_t y_size;                                ///< Output size of every model, set by the first publish.
+  uint64_t scratch_size;                          ///< Scratch size of every model, set by the first publish.
+
+} BackpropShmHeader_t;
+
+
+
+
+/**
+ * Shared model mapping.
+ */
+struct BackpropShm
+{
+  BackpropShmHeader_t* header;  ///< Start of the mapped segment.
+  size_t map_size;              ///< Size in bytes of the mapping.
+  bool writable;                ///< True if mapped by BackpropShm_Create().
+};
+
+
+
+
+static size_t BackpropShm_HeaderSize(void)
+{
+  return BACKPROP_SHM_ALIGN(sizeof(BackpropShmHeader_t));
+}
+
+
+
+
+static char* BackpropShm_GetSlot(const struct BackpropShm* self, uint64_t slot)
+{
+  BACKPROP_SHM_ASSERT(self);
+  BACKPROP_SHM_ASSERT(slot < BACKPROP_SHM_SLOTS_COUNT);
+
+  return (char*) self->header + BackpropShm_HeaderSize() + slot * self->header->slot_size;
+}
+
+
+
+
+static struct BackpropShm* BackpropShm_Map(int fd, size_t map_size, bool writable)
+{
+  struct BackpropShm* self = NULL;
+
+  void* map = mmap(NULL, map_size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+
+  if (MAP_FAILED == map)
+  {
+    return NULL;
+  }
+
+  self = calloc(1, sizeof(struct BackpropShm));
+
+  if (!self)
+  {
+    munmap(map, map_size);
+    return NULL;
+  }
+
+  self->header = map;
+  self->map_size = map_size;
+  self->writable = writable;
+
+  return self;
+}
+
+
+
+
+struct BackpropShm* BackpropShm_Create(const char* name, size_t model_size)
+{
+  BACKPROP_SHM_ASSERT(name);
+  BACKPROP_SHM_ASSERT(model_size);
+  {
+    const size_t slot_size = BACKPROP_SHM_ALIGN(model_size);
+    const size_t map_size = BackpropShm_HeaderSize() + BACKPROP_SHM_SLOTS_COUNT * slot_size;
+
+    struct BackpropShm* self = NULL;
+
+    // replace rather than truncate, so readers of an old segment keep a valid mapping
+    shm_unlink(name);
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+
+    if (fd < 0)
+    {
+      return NULL;
+    }
+
+    if (0 == ftruncate(fd, map_size))
+    {
+      self = BackpropShm_Map(fd, map_size, true);
+    }
+
+    close(fd);
+
+    if (!self)
+    {
+      shm_unlink(name);
+      return NULL;
+    }
+
+    self->header->slot_size = slot_size;
+
+    // readers check the magic last
+    __atomic_store_n(&self->header->magic, BACKPROP_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    return self;
+  }
+}
+
+
+
+
+struct BackpropShm* BackpropShm_Open(const char* name)
+{
+  BACKPROP_SHM_ASSERT(name);
+  {
+    struct BackpropShm* self = NULL;
+    struct stat st;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if (fd < 0)
+    {
+      return NULL;
+    }
+
+    if ((0 == fstat(fd, &st)) && ((size_t) st.st_size >= BackpropShm_HeaderSize()))
+    {
+      self = BackpropShm_Map(fd, st.st_size, false);
+    }
+
+    close(fd);
+
+    if (self)
+    {
+      const BackpropShmHeader_t* header = self->header;
+
+      if (   (BACKPROP_SHM_MAGIC != __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE))
+          || (self->map_size < BackpropShm_HeaderSize() + BACKPROP_SHM_SLOTS_COUNT * header->slot_size))
+      {
+        BackpropShm_Close(self);
+        return NULL;
+      }
+    }
+
+    return self;
+  }
+}
+
+
+
+
+void BackpropShm_Close(struct BackpropShm* self)
+{
+  if (!self)
+  {
+    return;
+  }
+
+  munmap(self->header, self->map_size);
+  free(self);
+}
+
+
+
+
+bool BackpropShm_Unlink(const char* name)
+{
+  BACKPROP_SHM_ASSERT(name);
+
+  return 0 == shm_unlink(name);
+}
+
+
+
+
+bool BackpropShm_Publish(struct BackpropShm* self, const struct BackpropNetwork* network)
+{
+  BACKPROP_SHM_ASSERT(self);
+  BACKPROP_SHM_ASSERT(network);
+
+  if (!self->writable || (BackpropInferenceModel_MallocSize(network) > self->header->slot_size))
+  {
+    return false;
+  }
+  else
+  {
+    BackpropShmHeader_t* header = self->header;
+
+    // readers activate in place and read the sizes and offsets of a model while it may be rewritten,
+    // so after the first model only the weights may change, and the latest model holds the layout
+    if (   header->generation
+        && !BackpropInferenceModel_HasLayout((const struct BackpropInferenceModel*) BackpropShm_GetSlot(self, header->generation % BACKPROP_SHM_SLOTS_COUNT), network))
+    {
+      return false;
+    }
+
+    // only the publisher writes the header, so plain loads are current
+    const uint64_t generation = header->generation + 1;
+    const uint64_t slot = generation % BACKPROP_SHM_SLOTS_COUNT;
+    const uint64_t seq = header->slot_seq[slot];
+
+    // mark the slot as being written before any of it changes
+    __atomic_store_n(&header->slot_seq[slot], seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    const struct BackpropInferenceModel* model = BackpropInferenceModel_Init(BackpropShm_GetSlot(self, slot), header->slot_size, network);
+
+    // readers only read the sizes once they see a generation, which is stored after them
+    if (1 == generation)
+    {
+      header->x_size = BackpropInferenceModel_GetXSize(model);
+      header->y_size = BackpropInferenceModel_GetYSize(model);
+      header->scratch_size = BackpropInferenceModel_GetScratchSize(model);
+    }
+
+    __atomic_store_n(&header->slot_seq[slot], seq + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->generation, generation, __ATOMIC_RELEASE);
+
+    return true;
+  }
+}
+
+
+
+
+uint64_t BackpropShm_GetGeneration(const struct BackpropShm* self)
+{
+  BACKPROP_SHM_ASSERT(self);
+
+  return __atomic_load_n(&self->header->generation, __ATOMIC_ACQUIRE);
+}
+
+
+
+
+const struct BackpropInferenceModel* BackpropShm_Acquire(const struct BackpropShm* self, uint64_t* ticket)
+{
+  BACKPROP_SHM_ASSERT(self);
+  BACKPROP_SHM_ASSERT(ticket);
+
+  for (;;)
+  {
+    const uint64_t generation = BackpropShm_GetGeneration(self);
+
+    if (!generation)
+    {
+      return NULL;
+    }
+
+    {
+      const uint64_t slot = generation % BACKPROP_SHM_SLOTS_COUNT;
+      const uint64_t seq = __atomic_load_n(&self->header->slot_seq[slot], __ATOMIC_ACQUIRE);
+
+      // an odd sequence means the next publish but one has started, so there is a newer generation
+      if (!(seq & 1))
+      {
+        *ticket = (seq * BACKPROP_SHM_SLOTS_COUNT) + slot;
+
+        return (const struct BackpropInferenceModel*) BackpropShm_GetSlot(self, slot);
+      }
+    }
+  }
+}
+
+
+
+
+bool BackpropShm_Validate(const struct BackpropShm* self, uint64_t ticket)
+{
+  BACKPROP_SHM_ASSERT(self);
+
+  // order the reads of the model before the sequence check
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  {
+    const uint64_t slot = ticket % BACKPROP_SHM_SLOTS_COUNT;
+    const uint64_t seq = __atomic_load_n(&self->header->slot_seq[slot], __ATOMIC_RELAXED);
+
+    return seq == (ticket / BACKPROP_SHM_SLOTS_COUNT);
+  }
+}
+
+
+
+
+size_t BackpropShm_GetXSize(const struct BackpropShm* self)
+{
+  BACKPROP_SHM_ASSERT(self);
+
+  return BackpropShm_GetGeneration(self) ? self->header->x_size : 0;
+}
+
+
+
+
+size_t BackpropShm_GetYSize(const struct BackpropShm* self)
+{
+  BACKPROP_SHM_ASSERT(self);
+
+  return BackpropShm_GetGeneration(self) ? self->header->y_size : 0;
+}
+
+
+
+
+size_t BackpropShm_GetScratchSize(const struct BackpropShm* self)
+{
+  BACKPROP_SHM_ASSERT(self);
+
+  return BackpropShm_GetGeneration(self) ? self->header->scratch_size : 0;
+}
+
+
+
+
+struct BackpropInferenceModel* BackpropShm_CopyModel(const struct BackpropShm* self, void* buffer, size_t size)
+{
+  BACKPROP_SHM_ASSERT(self);
+  BACKPROP_SHM_ASSERT(buffer);
+
+  for (;;)
+  {
+    uint64_t ticket = 0;
+    const struct BackpropInferenceModel* model = BackpropShm_Acquire(self, &ticket);
+
+    if (!model)
+    {
+      return NULL;
+    }
+
+    {
+      // the size may be torn by a concurrent publish, so bound it before copying
+      const size_t model_size = BackpropInferenceModel_GetSize(model);
+
+      if ((model_size <= size) && (model_size <= self->header->slot_size))
+      {
+        memcpy(buffer, model, model_size);
+      }
+
+      if (BackpropShm_Validate(self, ticket))
+      {
+        return (model_size <= size) ? buffer : NULL;
+      }
+    }
+  }
+}
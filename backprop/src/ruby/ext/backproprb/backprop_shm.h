@@ -0,0 +1,140 @@
+/** backprop_shm.h
+
+Defines shared memory publishing of inference models for backprop.h.
+
+One process publishes the weights of a network into a named POSIX shared memory segment,
+any number of processes map the segment read-only and activate the published model in place.
+The segment holds two model slots, each guarded by a sequence counter (seqlock),
+so a publish never blocks readers and readers never see a partly written model.
+Every model published to a segment has the layout of the first, only its weights change,
+so a reader activating in place never sees the sizes or offsets of a model change under it.
+
+
+Author: Joshua Petitt
+Available at: https://github.com/jpmec/ann
+
+
+Copyright (c) 2012-2013 Joshua Petitt
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef BACKPROP_SHM_H
+#define BACKPROP_SHM_H
+
+
+#include "backprop.h"
+
+
+
+
+/*-------------------------------------------------------------------*
+ *
+ * SHARED MODEL FUNCTIONS
+ *
+ *-------------------------------------------------------------------*/
+
+
+/**
+ * A BackpropShm is a mapping of a named shared memory segment holding published inference models.
+ *
+ * Readers use the model in place, with x, y and scratch sized by BackpropShm_GetXSize(),
+ * BackpropShm_GetYSize() and BackpropShm_GetScratchSize():
+ *
+ *   uint64_t ticket;
+ *   do
+ *   {
+ *     const struct BackpropInferenceModel* model = BackpropShm_Acquire(shm, &ticket);
+ *     BackpropInferenceModel_Activate(model, scratch, x, y);
+ *   } while (!BackpropShm_Validate(shm, ticket));
+ *
+ */
+struct BackpropShm;
+
+
+/** Create, or replace, the named segment with room for models of up to model_size bytes
+ *  and map it for publishing.
+ *  model_size is usually BackpropInferenceModel_MallocSize() of the network to be published.
+ *  Returns NULL if error.
+ *  Must call BackpropShm_Close() with pointer returned from this function.
+ */
+struct BackpropShm* BackpropShm_Create(const char* name, size_t model_size);
+
+
+/** Map an existing named segment read-only.
+ *  Returns NULL if error or if the segment was not created by BackpropShm_Create().
+ *  Must call BackpropShm_Close() with pointer returned from this function.
+ */
+struct BackpropShm* BackpropShm_Open(const char* name);
+
+
+/** Unmap the segment, the segment remains until BackpropShm_Unlink().
+ */
+void BackpropShm_Close(struct BackpropShm* self);
+
+
+/** Remove the named segment, processes that have it mapped may continue to use it.
+ *  Returns true if the segment was removed.
+ */
+bool BackpropShm_Unlink(const char* name);
+
+
+/** Publish the weights of network as the next model generation.
+ *  Only one process may publish to a segment.
+ *  Returns false if the segment is read-only, the model does not fit,
+ *  or the model does not have the layout of the models already published, see BackpropInferenceModel_HasLayout().
+ */
+bool BackpropShm_Publish(struct BackpropShm* self, const struct BackpropNetwork* network);
+
+
+/** Returns the number of models published to the segment, 0 if none.
+ */
+uint64_t BackpropShm_GetGeneration(const struct BackpropShm* self);
+
+
+/** Returns the most recently published model, or NULL if none.
+ *  The model may be overwritten by the second publish after this call,
+ *  so any result computed from it must be checked with BackpropShm_Validate(shm, *ticket).
+ */
+const struct BackpropInferenceModel* BackpropShm_Acquire(const struct BackpropShm* self, uint64_t* ticket);
+
+
+/** Returns true if the model returned by BackpropShm_Acquire() with ticket has not been modified since.
+ */
+bool BackpropShm_Validate(const struct BackpropShm* self, uint64_t ticket);
+
+
+/** Returns the input size in bytes of every model of the segment, 0 if none has been published.
+ */
+size_t BackpropShm_GetXSize(const struct BackpropShm* self);
+
+
+/** Returns the output size in bytes of every model of the segment, 0 if none has been published.
+ */
+size_t BackpropShm_GetYSize(const struct BackpropShm* self);
+
+
+/** Returns the scratch size in bytes needed to activate any model of the segment, 0 if none has been published.
+ */
+size_t BackpropShm_GetScratchSize(const struct BackpropShm* self);
+
+
+/** Copy the most recently published model into buffer, so it may be used without validation.
+ *  Returns the copy, or NULL if none has been published or buffer is smaller than the model.
+ */
+struct BackpropInferenceModel* BackpropShm_CopyModel(const struct BackpropShm* self, void* buffer, size_t size);
+
+
+
+
+#endif
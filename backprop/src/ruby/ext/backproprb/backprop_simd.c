@@ -0,0 +1,1097 @@
+/** backprop_simd.c
+
+Implements the vector math kernels used by backprop.c.
+See backprop_simd.h for more information.
+
+
+Author: Joshua Petitt
+Available at: https://github.com/jpmec/ann
+
+
+Copyright (c) 2012-2013 Joshua Petitt
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#include "backprop_simd.h"
+
+#include <math.h>
+#include <string.h>
+
+
+// The x86 kernels are compiled with per-function target attributes,
+// so the rest of the library does not need to be built with -mavx2 etc.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(BACKPROP_NO_SIMD)
+#define USE_BACKPROP_SIMD_X86
+#include <immintrin.h>
+#endif
+
+
+#include <assert.h>
+#define BACKPROP_ASSERT(_arg_)    assert(_arg_)
+
+
+// Fast sigmoid input limit, beyond this the sigmoid is 0 or 1 to within 2.4e-16.
+#define BACKPROP_SIGMOID_FAST_LIMIT    (36.0)
+
+// 2^52 + 2^51, adding it rounds to an integer which is also left in the low mantissa bits.
+#define BACKPROP_ROUND_MAGIC    (6755399441055744.0)
+
+// Exponent bits of 1.0, or'ed with 52 random mantissa bits gives a double in [1, 2).
+#define BACKPROP_RANDOM_ONE_BITS    (0x3FF0000000000000ull)
+
+#define BACKPROP_LOG2_E    (1.4426950408889634)
+#define BACKPROP_LN_2      (0.6931471805599453)
+
+
+//#define USE_BACKPROP_TRACE
+
+#ifdef USE_BACKPROP_TRACE
+#include <stdio.h>
+#define BACKPROP_TRACE()    printf("%s:%d\t%s\n", __FILE__, __LINE__, __FUNCTION__)
+#else
+#define BACKPROP_TRACE()
+#endif
+
+
+
+
+/***************************************************************
+ * Scalar
+ **************************************************************/
+
+#pragma mark Scalar
+
+
+static BACKPROP_FLOAT_T BackpropKernels_DotScalar(const BACKPROP_FLOAT_T* a, const BACKPROP_FLOAT_T* b, BACKPROP_SIZE_T count)
+{
+  BACKPROP_FLOAT_T sum = 0;
+
+  for (BACKPROP_SIZE_T i = 0; i < count; ++i)
+  {
+    sum += a[i] * b[i];
+  }
+
+  return sum;
+}
+
+
+
+
+static void BackpropKernels_AxpyScalar(BACKPROP_FLOAT_T* y, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T count)
+{
+  for (BACKPROP_SIZE_T i = 0; i < count; ++i)
+  {
+    y[i] += alpha * x[i];
+  }
+}
+
+
+
+
+static BACKPROP_FLOAT_T BackpropKernels_AxpyAbsSumScalar(BACKPROP_FLOAT_T* y, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T count)
+{
+  BACKPROP_FLOAT_T sum = 0;
+
+  for (BACKPROP_SIZE_T i = 0; i < count; ++i)
+  {
+    const BACKPROP_FLOAT_T d = alpha * x[i];
+    y[i] += d;
+    sum += fabs(d);
+  }
+
+  return sum;
+}
+
+
+
+
+static BACKPROP_FLOAT_T BackpropKernels_MomentumAbsSumScalar(BACKPROP_FLOAT_T* y, BACKPROP_FLOAT_T* v, BACKPROP_FLOAT_T momentum, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T count)
+{
+  BACKPROP_FLOAT_T sum = 0;
+
+  for (BACKPROP_SIZE_T i = 0; i < count; ++i)
+  {
+    const BACKPROP_FLOAT_T d = momentum * v[i] + alpha * x[i];
+    v[i] = d;
+    y[i] += d;
+    sum += fabs(d);
+  }
+
+  return sum;
+}
+
+
+
+
+/** Approximate sigmoid without calling exp().
+ *  exp(-x) = 2^k * exp(g), where k is an integer and |g| <= ln(2)/2,
+ *  and exp(g) is evaluated with a degree 7 Taylor polynomial.
+ *  The vector kernels below do exactly the same operations in the same order.
+ */
+static inline double BackpropKernels_SigmoidFastInline(double x)
+{
+  const double t = (x > BACKPROP_SIGMOID_FAST_LIMIT) ? -BACKPROP_SIGMOID_FAST_LIMIT
+                 : (x < -BACKPROP_SIGMOID_FAST_LIMIT) ? BACKPROP_SIGMOID_FAST_LIMIT
+                 : -x;
+
+  const double z = t * BACKPROP_LOG2_E;
+  const double z_magic = z + BACKPROP_ROUND_MAGIC;
+  const double k = z_magic - BACKPROP_ROUND_MAGIC;
+  const double g = (z - k) * BACKPROP_LN_2;
+
+  const double p = 1.0 + g * (1.0 + g * (1.0 / 2 + g * (1.0 / 6 + g * (1.0 / 24 + g * (1.0 / 120 + g * (1.0 / 720 + g * (1.0 / 5040)))))));
+
+  // build 2^k directly in the exponent bits
+  uint64_t bits;
+  memcpy(&bits, &z_magic, sizeof(bits));
+  bits = (bits + 1023) << 52;
+
+  double scale;
+  memcpy(&scale, &bits, sizeof(scale));
+
+  return 1.0 / (1.0 + p * scale);
+}
+
+
+
+
+BACKPROP_FLOAT_T Backprop_SigmoidFast(BACKPROP_FLOAT_T x)
+{
+  BACKPROP_TRACE();
+
+  return (BACKPROP_FLOAT_T) BackpropKernels_SigmoidFastInline(x);
+}
+
+
+
+
+static void BackpropKernels_SigmoidFastScalar(BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T count)
+{
+  for (BACKPROP_SIZE_T i = 0; i < count; ++i)
+  {
+    x[i] = (BACKPROP_FLOAT_T) BackpropKernels_SigmoidFastInline(x[i]);
+  }
+}
+
+
+
+
+/** Advance one xoshiro256+ stream and return a uniform random number in [0, 1).
+ */
+static inline double BackpropKernels_RandomNextInline(uint64_t* s0, uint64_t* s1, uint64_t* s2, uint64_t* s3)
+{
+  const uint64_t r = *s0 + *s3;
+  const uint64_t t = *s1 << 17;
+
+  *s2 ^= *s0;
+  *s3 ^= *s1;
+  *s1 ^= *s2;
+  *s0 ^= *s3;
+  *s2 ^= t;
+  *s3 = (*s3 << 45) | (*s3 >> 19);
+
+  const uint64_t bits = (r >> 12) | BACKPROP_RANDOM_ONE_BITS;
+
+  double x;
+  memcpy(&x, &bits, sizeof(x));
+
+  return x - 1.0;
+}
+
+
+
+
+static void BackpropKernels_RandomFillScalar(BackpropRandom_t* random, BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T count)
+{
+  uint64_t (*s)[BACKPROP_RANDOM_LANES] = random->s;
+
+  for (BACKPROP_SIZE_T i = 0; i < count; i += BACKPROP_RANDOM_LANES)
+  {
+    for (BACKPROP_SIZE_T lane = 0; lane < BACKPROP_RANDOM_LANES; ++lane)
+    {
+      const double r = BackpropKernels_RandomNextInline(&s[0][lane], &s[1][lane], &s[2][lane], &s[3][lane]);
+
+      if (i + lane < count)
+      {
+        x[i + lane] = (BACKPROP_FLOAT_T) r;
+      }
+    }
+  }
+}
+
+
+
+
+static const BackpropKernels_t BackpropKernels_Scalar =
+{
+  .simd = BACKPROP_SIMD_SCALAR,
+  .Dot = BackpropKernels_DotScalar,
+  .Axpy = BackpropKernels_AxpyScalar,
+  .AxpyAbsSum = BackpropKernels_AxpyAbsSumScalar,
+  .MomentumAbsSum = BackpropKernels_MomentumAbsSumScalar,
+  .SigmoidFast = BackpropKernels_SigmoidFastScalar,
+  .RandomFill = BackpropKernels_RandomFillScalar
+};
+
+
+
+
+#ifdef USE_BACKPROP_SIMD_X86
+
+// The vector kernels operate on doubles.
+// If BACKPROP_FLOAT_T is changed to float, only the scalar kernels are selected.
+#define BACKPROP_SIMD_FLOAT_IS_DOUBLE    (sizeof(BACKPROP_FLOAT_T) == sizeof(double))
+
+
+
+
+/***************************************************************
+ * SSE2
+ **************************************************************/
+
+#pragma mark SSE2
+
+
+__attribute__((target("sse2")))
+static BACKPROP_FLOAT_T BackpropKernels_DotSse2(const BACKPROP_FLOAT_T* a_, const BACKPROP_FLOAT_T* b_, BACKPROP_SIZE_T count)
+{
+  const double* a = (const double*) a_;
+  const double* b = (const double*) b_;
+
+  __m128d s0 = _mm_setzero_pd();
+  __m128d s1 = _mm_setzero_pd();
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+  }
+
+  s0 = _mm_add_pd(s0, s1);
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, s0);
+
+  double sum = lanes[0] + lanes[1];
+  for (; i < count; ++i)
+  {
+    sum += a[i] * b[i];
+  }
+
+  return sum;
+}
+
+
+
+
+__attribute__((target("sse2")))
+static void BackpropKernels_AxpySse2(BACKPROP_FLOAT_T* y_, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* y = (double*) y_;
+  const double* x = (const double*) x_;
+
+  const __m128d a = _mm_set1_pd(alpha);
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 2 <= count; i += 2)
+  {
+    _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(a, _mm_loadu_pd(x + i))));
+  }
+
+  for (; i < count; ++i)
+  {
+    y[i] += alpha * x[i];
+  }
+}
+
+
+
+
+__attribute__((target("sse2")))
+static BACKPROP_FLOAT_T BackpropKernels_AxpyAbsSumSse2(BACKPROP_FLOAT_T* y_, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* y = (double*) y_;
+  const double* x = (const double*) x_;
+
+  const __m128d a = _mm_set1_pd(alpha);
+  const __m128d sign = _mm_set1_pd(-0.0);
+  __m128d s = _mm_setzero_pd();
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 2 <= count; i += 2)
+  {
+    const __m128d d = _mm_mul_pd(a, _mm_loadu_pd(x + i));
+    _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), d));
+    s = _mm_add_pd(s, _mm_andnot_pd(sign, d));
+  }
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, s);
+
+  double sum = lanes[0] + lanes[1];
+  for (; i < count; ++i)
+  {
+    const double d = alpha * x[i];
+    y[i] += d;
+    sum += fabs(d);
+  }
+
+  return sum;
+}
+
+
+
+
+__attribute__((target("sse2")))
+static BACKPROP_FLOAT_T BackpropKernels_MomentumAbsSumSse2(BACKPROP_FLOAT_T* y_, BACKPROP_FLOAT_T* v_, BACKPROP_FLOAT_T momentum, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* y = (double*) y_;
+  double* v = (double*) v_;
+  const double* x = (const double*) x_;
+
+  const __m128d m = _mm_set1_pd(momentum);
+  const __m128d a = _mm_set1_pd(alpha);
+  const __m128d sign = _mm_set1_pd(-0.0);
+  __m128d s = _mm_setzero_pd();
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 2 <= count; i += 2)
+  {
+    const __m128d d = _mm_add_pd(_mm_mul_pd(m, _mm_loadu_pd(v + i)), _mm_mul_pd(a, _mm_loadu_pd(x + i)));
+    _mm_storeu_pd(v + i, d);
+    _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), d));
+    s = _mm_add_pd(s, _mm_andnot_pd(sign, d));
+  }
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, s);
+
+  return lanes[0] + lanes[1] + BackpropKernels_MomentumAbsSumScalar(y_ + i, v_ + i, momentum, alpha, x_ + i, count - i);
+}
+
+
+
+
+__attribute__((target("sse2")))
+static void BackpropKernels_SigmoidFastSse2(BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* x = (double*) x_;
+
+  const __m128d limit = _mm_set1_pd(BACKPROP_SIGMOID_FAST_LIMIT);
+  const __m128d magic = _mm_set1_pd(BACKPROP_ROUND_MAGIC);
+  const __m128d one = _mm_set1_pd(1.0);
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 2 <= count; i += 2)
+  {
+    const __m128d t = _mm_min_pd(_mm_max_pd(_mm_sub_pd(_mm_setzero_pd(), _mm_loadu_pd(x + i)), _mm_sub_pd(_mm_setzero_pd(), limit)), limit);
+
+    const __m128d z = _mm_mul_pd(t, _mm_set1_pd(BACKPROP_LOG2_E));
+    const __m128d z_magic = _mm_add_pd(z, magic);
+    const __m128d k = _mm_sub_pd(z_magic, magic);
+    const __m128d g = _mm_mul_pd(_mm_sub_pd(z, k), _mm_set1_pd(BACKPROP_LN_2));
+
+    __m128d p = _mm_add_pd(_mm_set1_pd(1.0 / 720), _mm_mul_pd(g, _mm_set1_pd(1.0 / 5040)));
+    p = _mm_add_pd(_mm_set1_pd(1.0 / 120), _mm_mul_pd(g, p));
+    p = _mm_add_pd(_mm_set1_pd(1.0 / 24), _mm_mul_pd(g, p));
+    p = _mm_add_pd(_mm_set1_pd(1.0 / 6), _mm_mul_pd(g, p));
+    p = _mm_add_pd(_mm_set1_pd(1.0 / 2), _mm_mul_pd(g, p));
+    p = _mm_add_pd(one, _mm_mul_pd(g, p));
+    p = _mm_add_pd(one, _mm_mul_pd(g, p));
+
+    // build 2^k directly in the exponent bits
+    const __m128d scale = _mm_castsi128_pd(_mm_slli_epi64(_mm_add_epi64(_mm_castpd_si128(z_magic), _mm_set1_epi64x(1023)), 52));
+
+    _mm_storeu_pd(x + i, _mm_div_pd(one, _mm_add_pd(one, _mm_mul_pd(p, scale))));
+  }
+
+  BackpropKernels_SigmoidFastScalar(x_ + i, count - i);
+}
+
+
+
+
+__attribute__((target("sse2")))
+static void BackpropKernels_RandomFillSse2(BackpropRandom_t* random, BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* x = (double*) x_;
+
+  const __m128i one_bits = _mm_set1_epi64x(BACKPROP_RANDOM_ONE_BITS);
+  const __m128d one = _mm_set1_pd(1.0);
+
+  __m128i s[4][BACKPROP_RANDOM_LANES / 2];
+
+  for (size_t w = 0; w < 4; ++w)
+  {
+    for (size_t v = 0; v < BACKPROP_RANDOM_LANES / 2; ++v)
+    {
+      s[w][v] = _mm_loadu_si128((const __m128i*) &random->s[w][2 * v]);
+    }
+  }
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + BACKPROP_RANDOM_LANES <= count; i += BACKPROP_RANDOM_LANES)
+  {
+    for (size_t v = 0; v < BACKPROP_RANDOM_LANES / 2; ++v)
+    {
+      const __m128i r = _mm_add_epi64(s[0][v], s[3][v]);
+      const __m128i t = _mm_slli_epi64(s[1][v], 17);
+
+      s[2][v] = _mm_xor_si128(s[2][v], s[0][v]);
+      s[3][v] = _mm_xor_si128(s[3][v], s[1][v]);
+      s[1][v] = _mm_xor_si128(s[1][v], s[2][v]);
+      s[0][v] = _mm_xor_si128(s[0][v], s[3][v]);
+      s[2][v] = _mm_xor_si128(s[2][v], t);
+      s[3][v] = _mm_or_si128(_mm_slli_epi64(s[3][v], 45), _mm_srli_epi64(s[3][v], 19));
+
+      const __m128d d = _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(r, 12), one_bits));
+      _mm_storeu_pd(x + i + 2 * v, _mm_sub_pd(d, one));
+    }
+  }
+
+  for (size_t w = 0; w < 4; ++w)
+  {
+    for (size_t v = 0; v < BACKPROP_RANDOM_LANES / 2; ++v)
+    {
+      _mm_storeu_si128((__m128i*) &random->s[w][2 * v], s[w][v]);
+    }
+  }
+
+  BackpropKernels_RandomFillScalar(random, x_ + i, count - i);
+}
+
+
+
+
+static const BackpropKernels_t BackpropKernels_Sse2 =
+{
+  .simd = BACKPROP_SIMD_SSE2,
+  .Dot = BackpropKernels_DotSse2,
+  .Axpy = BackpropKernels_AxpySse2,
+  .AxpyAbsSum = BackpropKernels_AxpyAbsSumSse2,
+  .MomentumAbsSum = BackpropKernels_MomentumAbsSumSse2,
+  .SigmoidFast = BackpropKernels_SigmoidFastSse2,
+  .RandomFill = BackpropKernels_RandomFillSse2
+};
+
+
+
+
+/***************************************************************
+ * AVX2
+ **************************************************************/
+
+#pragma mark AVX2
+
+
+__attribute__((target("avx2,fma")))
+static BACKPROP_FLOAT_T BackpropKernels_DotAvx2(const BACKPROP_FLOAT_T* a_, const BACKPROP_FLOAT_T* b_, BACKPROP_SIZE_T count)
+{
+  const double* a = (const double*) a_;
+  const double* b = (const double*) b_;
+
+  __m256d s0 = _mm256_setzero_pd();
+  __m256d s1 = _mm256_setzero_pd();
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+    s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), s1);
+  }
+
+  for (; i + 4 <= count; i += 4)
+  {
+    s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), s0);
+  }
+
+  s0 = _mm256_add_pd(s0, s1);
+
+  double lanes[4];
+  _mm256_storeu_pd(lanes, s0);
+
+  double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for (; i < count; ++i)
+  {
+    sum += a[i] * b[i];
+  }
+
+  return sum;
+}
+
+
+
+
+// No FMA here, so every element is rounded exactly as the scalar kernel rounds it.
+__attribute__((target("avx2")))
+static void BackpropKernels_AxpyAvx2(BACKPROP_FLOAT_T* y_, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* y = (double*) y_;
+  const double* x = (const double*) x_;
+
+  const __m256d a = _mm256_set1_pd(alpha);
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_loadu_pd(y + i), _mm256_mul_pd(a, _mm256_loadu_pd(x + i))));
+  }
+
+  for (; i < count; ++i)
+  {
+    y[i] += alpha * x[i];
+  }
+}
+
+
+
+
+__attribute__((target("avx2")))
+static BACKPROP_FLOAT_T BackpropKernels_AxpyAbsSumAvx2(BACKPROP_FLOAT_T* y_, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* y = (double*) y_;
+  const double* x = (const double*) x_;
+
+  const __m256d a = _mm256_set1_pd(alpha);
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  __m256d s = _mm256_setzero_pd();
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    const __m256d d = _mm256_mul_pd(a, _mm256_loadu_pd(x + i));
+    _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_loadu_pd(y + i), d));
+    s = _mm256_add_pd(s, _mm256_andnot_pd(sign, d));
+  }
+
+  double lanes[4];
+  _mm256_storeu_pd(lanes, s);
+
+  double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for (; i < count; ++i)
+  {
+    const double d = alpha * x[i];
+    y[i] += d;
+    sum += fabs(d);
+  }
+
+  return sum;
+}
+
+
+
+
+__attribute__((target("avx2")))
+static BACKPROP_FLOAT_T BackpropKernels_MomentumAbsSumAvx2(BACKPROP_FLOAT_T* y_, BACKPROP_FLOAT_T* v_, BACKPROP_FLOAT_T momentum, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* y = (double*) y_;
+  double* v = (double*) v_;
+  const double* x = (const double*) x_;
+
+  const __m256d m = _mm256_set1_pd(momentum);
+  const __m256d a = _mm256_set1_pd(alpha);
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  __m256d s = _mm256_setzero_pd();
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    const __m256d d = _mm256_add_pd(_mm256_mul_pd(m, _mm256_loadu_pd(v + i)), _mm256_mul_pd(a, _mm256_loadu_pd(x + i)));
+    _mm256_storeu_pd(v + i, d);
+    _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_loadu_pd(y + i), d));
+    s = _mm256_add_pd(s, _mm256_andnot_pd(sign, d));
+  }
+
+  double lanes[4];
+  _mm256_storeu_pd(lanes, s);
+
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + BackpropKernels_MomentumAbsSumScalar(y_ + i, v_ + i, momentum, alpha, x_ + i, count - i);
+}
+
+
+
+
+__attribute__((target("avx2")))
+static void BackpropKernels_SigmoidFastAvx2(BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* x = (double*) x_;
+
+  const __m256d limit = _mm256_set1_pd(BACKPROP_SIGMOID_FAST_LIMIT);
+  const __m256d magic = _mm256_set1_pd(BACKPROP_ROUND_MAGIC);
+  const __m256d one = _mm256_set1_pd(1.0);
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    const __m256d t = _mm256_min_pd(_mm256_max_pd(_mm256_sub_pd(_mm256_setzero_pd(), _mm256_loadu_pd(x + i)), _mm256_sub_pd(_mm256_setzero_pd(), limit)), limit);
+
+    const __m256d z = _mm256_mul_pd(t, _mm256_set1_pd(BACKPROP_LOG2_E));
+    const __m256d z_magic = _mm256_add_pd(z, magic);
+    const __m256d k = _mm256_sub_pd(z_magic, magic);
+    const __m256d g = _mm256_mul_pd(_mm256_sub_pd(z, k), _mm256_set1_pd(BACKPROP_LN_2));
+
+    __m256d p = _mm256_add_pd(_mm256_set1_pd(1.0 / 720), _mm256_mul_pd(g, _mm256_set1_pd(1.0 / 5040)));
+    p = _mm256_add_pd(_mm256_set1_pd(1.0 / 120), _mm256_mul_pd(g, p));
+    p = _mm256_add_pd(_mm256_set1_pd(1.0 / 24), _mm256_mul_pd(g, p));
+    p = _mm256_add_pd(_mm256_set1_pd(1.0 / 6), _mm256_mul_pd(g, p));
+    p = _mm256_add_pd(_mm256_set1_pd(1.0 / 2), _mm256_mul_pd(g, p));
+    p = _mm256_add_pd(one, _mm256_mul_pd(g, p));
+    p = _mm256_add_pd(one, _mm256_mul_pd(g, p));
+
+    // build 2^k directly in the exponent bits
+    const __m256d scale = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(_mm256_castpd_si256(z_magic), _mm256_set1_epi64x(1023)), 52));
+
+    _mm256_storeu_pd(x + i, _mm256_div_pd(one, _mm256_add_pd(one, _mm256_mul_pd(p, scale))));
+  }
+
+  BackpropKernels_SigmoidFastScalar(x_ + i, count - i);
+}
+
+
+
+
+__attribute__((target("avx2")))
+static void BackpropKernels_RandomFillAvx2(BackpropRandom_t* random, BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* x = (double*) x_;
+
+  const __m256i one_bits = _mm256_set1_epi64x(BACKPROP_RANDOM_ONE_BITS);
+  const __m256d one = _mm256_set1_pd(1.0);
+
+  __m256i s[4][BACKPROP_RANDOM_LANES / 4];
+
+  for (size_t w = 0; w < 4; ++w)
+  {
+    for (size_t v = 0; v < BACKPROP_RANDOM_LANES / 4; ++v)
+    {
+      s[w][v] = _mm256_loadu_si256((const __m256i*) &random->s[w][4 * v]);
+    }
+  }
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + BACKPROP_RANDOM_LANES <= count; i += BACKPROP_RANDOM_LANES)
+  {
+    // the two vectors are independent streams, so their latencies overlap
+    for (size_t v = 0; v < BACKPROP_RANDOM_LANES / 4; ++v)
+    {
+      const __m256i r = _mm256_add_epi64(s[0][v], s[3][v]);
+      const __m256i t = _mm256_slli_epi64(s[1][v], 17);
+
+      s[2][v] = _mm256_xor_si256(s[2][v], s[0][v]);
+      s[3][v] = _mm256_xor_si256(s[3][v], s[1][v]);
+      s[1][v] = _mm256_xor_si256(s[1][v], s[2][v]);
+      s[0][v] = _mm256_xor_si256(s[0][v], s[3][v]);
+      s[2][v] = _mm256_xor_si256(s[2][v], t);
+      s[3][v] = _mm256_or_si256(_mm256_slli_epi64(s[3][v], 45), _mm256_srli_epi64(s[3][v], 19));
+
+      const __m256d d = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(r, 12), one_bits));
+      _mm256_storeu_pd(x + i + 4 * v, _mm256_sub_pd(d, one));
+    }
+  }
+
+  for (size_t w = 0; w < 4; ++w)
+  {
+    for (size_t v = 0; v < BACKPROP_RANDOM_LANES / 4; ++v)
+    {
+      _mm256_storeu_si256((__m256i*) &random->s[w][4 * v], s[w][v]);
+    }
+  }
+
+  BackpropKernels_RandomFillScalar(random, x_ + i, count - i);
+}
+
+
+
+
+static const BackpropKernels_t BackpropKernels_Avx2 =
+{
+  .simd = BACKPROP_SIMD_AVX2,
+  .Dot = BackpropKernels_DotAvx2,
+  .Axpy = BackpropKernels_AxpyAvx2,
+  .AxpyAbsSum = BackpropKernels_AxpyAbsSumAvx2,
+  .MomentumAbsSum = BackpropKernels_MomentumAbsSumAvx2,
+  .SigmoidFast = BackpropKernels_SigmoidFastAvx2,
+  .RandomFill = BackpropKernels_RandomFillAvx2
+};
+
+
+
+
+/***************************************************************
+ * AVX-512
+ **************************************************************/
+
+#pragma mark AVX-512
+
+
+__attribute__((target("avx512f")))
+static BACKPROP_FLOAT_T BackpropKernels_DotAvx512(const BACKPROP_FLOAT_T* a_, const BACKPROP_FLOAT_T* b_, BACKPROP_SIZE_T count)
+{
+  const double* a = (const double*) a_;
+  const double* b = (const double*) b_;
+
+  __m512d s0 = _mm512_setzero_pd();
+  __m512d s1 = _mm512_setzero_pd();
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 16 <= count; i += 16)
+  {
+    s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+    s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8), s1);
+  }
+
+  // the tail is handled with a masked load, so no scalar loop is needed
+  if (i < count)
+  {
+    const BACKPROP_SIZE_T rest = count - i;
+
+    if (8 <= rest)
+    {
+      s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i), s0);
+      i += 8;
+    }
+
+    if (i < count)
+    {
+      const __mmask8 mask = (__mmask8) ((1u << (count - i)) - 1);
+      s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, a + i), _mm512_maskz_loadu_pd(mask, b + i), s1);
+    }
+  }
+
+  return _mm512_reduce_add_pd(_mm512_add_pd(s0, s1));
+}
+
+
+
+
+__attribute__((target("avx512f")))
+static void BackpropKernels_AxpyAvx512(BACKPROP_FLOAT_T* y_, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* y = (double*) y_;
+  const double* x = (const double*) x_;
+
+  const __m512d a = _mm512_set1_pd(alpha);
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    _mm512_storeu_pd(y + i, _mm512_add_pd(_mm512_loadu_pd(y + i), _mm512_mul_pd(a, _mm512_loadu_pd(x + i))));
+  }
+
+  if (i < count)
+  {
+    const __mmask8 mask = (__mmask8) ((1u << (count - i)) - 1);
+    const __m512d d = _mm512_mul_pd(a, _mm512_maskz_loadu_pd(mask, x + i));
+    _mm512_mask_storeu_pd(y + i, mask, _mm512_add_pd(_mm512_maskz_loadu_pd(mask, y + i), d));
+  }
+}
+
+
+
+
+__attribute__((target("avx512f")))
+static BACKPROP_FLOAT_T BackpropKernels_AxpyAbsSumAvx512(BACKPROP_FLOAT_T* y_, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* y = (double*) y_;
+  const double* x = (const double*) x_;
+
+  const __m512d a = _mm512_set1_pd(alpha);
+  __m512d s = _mm512_setzero_pd();
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    const __m512d d = _mm512_mul_pd(a, _mm512_loadu_pd(x + i));
+    _mm512_storeu_pd(y + i, _mm512_add_pd(_mm512_loadu_pd(y + i), d));
+    s = _mm512_add_pd(s, _mm512_abs_pd(d));
+  }
+
+  if (i < count)
+  {
+    const __mmask8 mask = (__mmask8) ((1u << (count - i)) - 1);
+    const __m512d d = _mm512_mul_pd(a, _mm512_maskz_loadu_pd(mask, x + i));
+    _mm512_mask_storeu_pd(y + i, mask, _mm512_add_pd(_mm512_maskz_loadu_pd(mask, y + i), d));
+    s = _mm512_add_pd(s, _mm512_abs_pd(d));
+  }
+
+  return _mm512_reduce_add_pd(s);
+}
+
+
+
+
+__attribute__((target("avx512f")))
+static BACKPROP_FLOAT_T BackpropKernels_MomentumAbsSumAvx512(BACKPROP_FLOAT_T* y_, BACKPROP_FLOAT_T* v_, BACKPROP_FLOAT_T momentum, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* y = (double*) y_;
+  double* v = (double*) v_;
+  const double* x = (const double*) x_;
+
+  const __m512d m = _mm512_set1_pd(momentum);
+  const __m512d a = _mm512_set1_pd(alpha);
+  __m512d s = _mm512_setzero_pd();
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    const __m512d d = _mm512_add_pd(_mm512_mul_pd(m, _mm512_loadu_pd(v + i)), _mm512_mul_pd(a, _mm512_loadu_pd(x + i)));
+    _mm512_storeu_pd(v + i, d);
+    _mm512_storeu_pd(y + i, _mm512_add_pd(_mm512_loadu_pd(y + i), d));
+    s = _mm512_add_pd(s, _mm512_abs_pd(d));
+  }
+
+  if (i < count)
+  {
+    const __mmask8 mask = (__mmask8) ((1u << (count - i)) - 1);
+    const __m512d d = _mm512_add_pd(_mm512_mul_pd(m, _mm512_maskz_loadu_pd(mask, v + i)), _mm512_mul_pd(a, _mm512_maskz_loadu_pd(mask, x + i)));
+    _mm512_mask_storeu_pd(v + i, mask, d);
+    _mm512_mask_storeu_pd(y + i, mask, _mm512_add_pd(_mm512_maskz_loadu_pd(mask, y + i), d));
+    s = _mm512_add_pd(s, _mm512_abs_pd(d));
+  }
+
+  return _mm512_reduce_add_pd(s);
+}
+
+
+
+
+__attribute__((target("avx512f")))
+static void BackpropKernels_SigmoidFastAvx512(BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* x = (double*) x_;
+
+  const __m512d limit = _mm512_set1_pd(BACKPROP_SIGMOID_FAST_LIMIT);
+  const __m512d magic = _mm512_set1_pd(BACKPROP_ROUND_MAGIC);
+  const __m512d one = _mm512_set1_pd(1.0);
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    const __m512d t = _mm512_min_pd(_mm512_max_pd(_mm512_sub_pd(_mm512_setzero_pd(), _mm512_loadu_pd(x + i)), _mm512_sub_pd(_mm512_setzero_pd(), limit)), limit);
+
+    const __m512d z = _mm512_mul_pd(t, _mm512_set1_pd(BACKPROP_LOG2_E));
+    const __m512d z_magic = _mm512_add_pd(z, magic);
+    const __m512d k = _mm512_sub_pd(z_magic, magic);
+    const __m512d g = _mm512_mul_pd(_mm512_sub_pd(z, k), _mm512_set1_pd(BACKPROP_LN_2));
+
+    __m512d p = _mm512_add_pd(_mm512_set1_pd(1.0 / 720), _mm512_mul_pd(g, _mm512_set1_pd(1.0 / 5040)));
+    p = _mm512_add_pd(_mm512_set1_pd(1.0 / 120), _mm512_mul_pd(g, p));
+    p = _mm512_add_pd(_mm512_set1_pd(1.0 / 24), _mm512_mul_pd(g, p));
+    p = _mm512_add_pd(_mm512_set1_pd(1.0 / 6), _mm512_mul_pd(g, p));
+    p = _mm512_add_pd(_mm512_set1_pd(1.0 / 2), _mm512_mul_pd(g, p));
+    p = _mm512_add_pd(one, _mm512_mul_pd(g, p));
+    p = _mm512_add_pd(one, _mm512_mul_pd(g, p));
+
+    // build 2^k directly in the exponent bits
+    const __m512d scale = _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_add_epi64(_mm512_castpd_si512(z_magic), _mm512_set1_epi64(1023)), 52));
+
+    _mm512_storeu_pd(x + i, _mm512_div_pd(one, _mm512_add_pd(one, _mm512_mul_pd(p, scale))));
+  }
+
+  BackpropKernels_SigmoidFastScalar(x_ + i, count - i);
+}
+
+
+
+
+__attribute__((target("avx512f")))
+static void BackpropKernels_RandomFillAvx512(BackpropRandom_t* random, BACKPROP_FLOAT_T* x_, BACKPROP_SIZE_T count)
+{
+  double* x = (double*) x_;
+
+  const __m512i one_bits = _mm512_set1_epi64(BACKPROP_RANDOM_ONE_BITS);
+  const __m512d one = _mm512_set1_pd(1.0);
+
+  __m512i s0 = _mm512_loadu_si512(random->s[0]);
+  __m512i s1 = _mm512_loadu_si512(random->s[1]);
+  __m512i s2 = _mm512_loadu_si512(random->s[2]);
+  __m512i s3 = _mm512_loadu_si512(random->s[3]);
+
+  BACKPROP_SIZE_T i = 0;
+  for (; i + BACKPROP_RANDOM_LANES <= count; i += BACKPROP_RANDOM_LANES)
+  {
+    const __m512i r = _mm512_add_epi64(s0, s3);
+    const __m512i t = _mm512_slli_epi64(s1, 17);
+
+    s2 = _mm512_xor_si512(s2, s0);
+    s3 = _mm512_xor_si512(s3, s1);
+    s1 = _mm512_xor_si512(s1, s2);
+    s0 = _mm512_xor_si512(s0, s3);
+    s2 = _mm512_xor_si512(s2, t);
+    s3 = _mm512_rol_epi64(s3, 45);
+
+    const __m512d d = _mm512_castsi512_pd(_mm512_or_si512(_mm512_srli_epi64(r, 12), one_bits));
+    _mm512_storeu_pd(x + i, _mm512_sub_pd(d, one));
+  }
+
+  _mm512_storeu_si512(random->s[0], s0);
+  _mm512_storeu_si512(random->s[1], s1);
+  _mm512_storeu_si512(random->s[2], s2);
+  _mm512_storeu_si512(random->s[3], s3);
+
+  BackpropKernels_RandomFillScalar(random, x_ + i, count - i);
+}
+
+
+
+
+static const BackpropKernels_t BackpropKernels_Avx512 =
+{
+  .simd = BACKPROP_SIMD_AVX512,
+  .Dot = BackpropKernels_DotAvx512,
+  .Axpy = BackpropKernels_AxpyAvx512,
+  .AxpyAbsSum = BackpropKernels_AxpyAbsSumAvx512,
+  .MomentumAbsSum = BackpropKernels_MomentumAbsSumAvx512,
+  .SigmoidFast = BackpropKernels_SigmoidFastAvx512,
+  .RandomFill = BackpropKernels_RandomFillAvx512
+};
+
+
+#endif/*USE_BACKPROP_SIMD_X86*/
+
+
+
+
+/***************************************************************
+ * Dispatch
+ **************************************************************/
+
+#pragma mark Dispatch
+
+
+static const BackpropKernels_t* BackpropKernels = &BackpropKernels_Scalar;
+
+
+
+
+/** Returns the kernels for simd, or NULL if the CPU does not support simd.
+ */
+static const BackpropKernels_t* BackpropKernels_Find(BackpropSimd_t simd)
+{
+  BACKPROP_TRACE();
+
+  switch (simd)
+  {
+    case BACKPROP_SIMD_SCALAR:
+      return &BackpropKernels_Scalar;
+
+#ifdef USE_BACKPROP_SIMD_X86
+    case BACKPROP_SIMD_SSE2:
+      __builtin_cpu_init();
+      if (BACKPROP_SIMD_FLOAT_IS_DOUBLE && __builtin_cpu_supports("sse2"))
+      {
+        return &BackpropKernels_Sse2;
+      }
+      break;
+
+    case BACKPROP_SIMD_AVX2:
+      __builtin_cpu_init();
+      if (BACKPROP_SIMD_FLOAT_IS_DOUBLE && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      {
+        return &BackpropKernels_Avx2;
+      }
+      break;
+
+    case BACKPROP_SIMD_AVX512:
+      __builtin_cpu_init();
+      if (BACKPROP_SIMD_FLOAT_IS_DOUBLE && __builtin_cpu_supports("avx512f"))
+      {
+        return &BackpropKernels_Avx512;
+      }
+      break;
+#endif
+
+    default:
+      break;
+  }
+
+  return NULL;
+}
+
+
+
+
+BackpropSimd_t Backprop_SetSimd(BackpropSimd_t simd)
+{
+  BACKPROP_TRACE();
+
+  if (simd >= BACKPROP_SIMD_COUNT)
+  {
+    simd = BACKPROP_SIMD_COUNT - 1;
+  }
+
+  for (;;)
+  {
+    const BackpropKernels_t* kernels = BackpropKernels_Find(simd);
+    if (kernels)
+    {
+      BackpropKernels = kernels;
+      return simd;
+    }
+
+    BACKPROP_ASSERT(simd != BACKPROP_SIMD_SCALAR);
+    simd = (BackpropSimd_t) (simd - 1);
+  }
+}
+
+
+
+
+BackpropSimd_t Backprop_GetSimd(void)
+{
+  BACKPROP_TRACE();
+
+  return BackpropKernels->simd;
+}
+
+
+
+
+const char* Backprop_GetSimdName(BackpropSimd_t simd)
+{
+  BACKPROP_TRACE();
+
+  switch (simd)
+  {
+    case BACKPROP_SIMD_SCALAR:  return "scalar";
+    case BACKPROP_SIMD_SSE2:    return "sse2";
+    case BACKPROP_SIMD_AVX2:    return "avx2";
+    case BACKPROP_SIMD_AVX512:  return "avx512";
+    default:                    return "unknown";
+  }
+}
+
+
+
+
+const BackpropKernels_t* Backprop_GetKernels(void)
+{
+  return BackpropKernels;
+}
+
+
+
+
+/** Select the best kernels when the library is loaded.
+ */
+#if defined(__GNUC__)
+__attribute__((constructor))
+static void BackpropKernels_Init(void)
+{
+  BACKPROP_TRACE();
+
+  Backprop_SetSimd(BACKPROP_SIMD_COUNT);
+}
+#endif
@@ -0,0 +1,85 @@
+/** backprop_simd.h
+
+Defines the vector math kernels used by backprop.c.
+
+The kernels are selected at load time from the instruction sets supported by the CPU.
+Every implementation computes the same values as the scalar kernels,
+but may sum in a different order, so results can differ in the last bits.
+
+
+Author: Joshua Petitt
+Available at: https://github.com/jpmec/ann
+
+
+Copyright (c) 2012-2013 Joshua Petitt
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+
+#ifndef BACKPROP_SIMD_H
+#define BACKPROP_SIMD_H
+
+
+#include "backprop.h"
+
+
+
+
+/** Table of vector math kernels for one instruction set.
+ */
+typedef struct BackpropKernels
+{
+  BackpropSimd_t simd;  ///< Instruction set used by the kernels.
+
+  /** Returns the dot product of a and b.
+   */
+  BACKPROP_FLOAT_T (*Dot)(const BACKPROP_FLOAT_T* a, const BACKPROP_FLOAT_T* b, BACKPROP_SIZE_T count);
+
+  /** Computes y += alpha * x.
+   *  Each element is rounded exactly as the scalar loop would round it.
+   */
+  void (*Axpy)(BACKPROP_FLOAT_T* y, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T count);
+
+  /** Computes y += alpha * x and returns the sum of |alpha * x|.
+   */
+  BACKPROP_FLOAT_T (*AxpyAbsSum)(BACKPROP_FLOAT_T* y, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T count);
+
+  /** Computes v = momentum * v + alpha * x, then y += v, and returns the sum of |v|.
+   *  Each element is rounded exactly as the scalar loop would round it.
+   */
+  BACKPROP_FLOAT_T (*MomentumAbsSum)(BACKPROP_FLOAT_T* y, BACKPROP_FLOAT_T* v, BACKPROP_FLOAT_T momentum, BACKPROP_FLOAT_T alpha, const BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T count);
+
+  /** Replaces each x with Backprop_SigmoidFast(x).
+   *  Results are the same for every instruction set.
+   */
+  void (*SigmoidFast)(BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T count);
+
+  /** Fills x with uniform random numbers in the range [0, 1), each with 52 random bits.
+   *  Every stream of random advances by count / BACKPROP_RANDOM_LANES steps, rounded up, its pool is not used.
+   *  Results are the same for every instruction set.
+   */
+  void (*RandomFill)(BackpropRandom_t* random, BACKPROP_FLOAT_T* x, BACKPROP_SIZE_T count);
+
+} BackpropKernels_t;
+
+
+
+
+/** Get the kernels currently used by the library.
+ */
+const BackpropKernels_t* Backprop_GetKernels(void);
+
+
+
+
+#endif/*BACKPROP_SIMD_H*/
@@ -2,6 +2,8 @@
 #include "ruby.h"
 #include "backprop.h"
 #include "backprop_io.h"
+#include "backprop_shm.h"
+#include "backprop_ps.h"
 
 
 
@@ -23,7 +25,12 @@ typedef struct BackpropNetwork BackpropNetwork_t;
 // Defining a space for information and references about the module to be stored internally
 static VALUE cBackproprb = Qnil;
 static VALUE cBackpropLayer = Qnil;
+static VALUE cBackpropBuffer = Qnil;
 static VALUE cBackpropNetwork = Qnil;
+static VALUE cBackpropInferenceModel = Qnil;
+static VALUE cBackpropShm = Qnil;
+static VALUE cBackpropPsServer = Qnil;
+static VALUE cBackpropPsClient = Qnil;
 static VALUE cBackpropNetworkStats = Qnil;
 static VALUE cBackpropTrainer = Qnil;
 static VALUE cBackpropTrainingSet = Qnil;
@@ -31,6 +38,7 @@ static VALUE cBackpropTrainingStats = Qnil;
 static VALUE cBackpropExerciseStats = Qnil;
 static VALUE cBackpropEvolutionStats = Qnil;
 static VALUE cBackpropEvolver = Qnil;
+static VALUE cBackpropPopulation = Qnil;
 
 
 //#define USE_BACKPROPRB_TRACE
@@ -62,11 +70,39 @@ static void CBackprop_Free(void* obj)
 
 
 
-VALUE CBackprop_sigmoid(VALUE self, VALUE x)
+static BackpropSigmoid_t CBackprop_sigmoid_mode(VALUE name_val)
 {
   BACKPROPRB_TRACE();
   {
-    const BACKPROP_FLOAT_T y = Backprop_Sigmoid(NUM2DBL(x));
+    const char* name = StringValueCStr(name_val);
+
+    for (int i = 0; i < BACKPROP_SIGMOID_COUNT; ++i)
+    {
+      if (0 == strcmp(name, Backprop_GetSigmoidName((BackpropSigmoid_t) i)))
+      {
+        return (BackpropSigmoid_t) i;
+      }
+    }
+
+    rb_raise(rb_eArgError, "unknown sigmoid %s", name);
+    return BACKPROP_SIGMOID_EXACT;
+  }
+}
+
+
+
+
+VALUE CBackprop_sigmoid(int argc, VALUE* argv, VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    VALUE x;
+    VALUE mode_val;
+    rb_scan_args(argc, argv, "11", &x, &mode_val);
+
+    const BackpropSigmoid_t mode = NIL_P(mode_val) ? BACKPROP_SIGMOID_EXACT : CBackprop_sigmoid_mode(mode_val);
+
+    const BACKPROP_FLOAT_T y = Backprop_SigmoidMode(mode, NUM2DBL(x));
     return rb_float_new(y);
   }
 }
@@ -98,6 +134,69 @@ VALUE CBackprop_used(void)
 
 
 
+VALUE CBackprop_get_simd(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  return rb_str_new2(Backprop_GetSimdName(Backprop_GetSimd()));
+}
+
+
+
+
+VALUE CBackprop_set_simd(VALUE self, VALUE name_val)
+{
+  BACKPROPRB_TRACE();
+  {
+    const char* name = StringValueCStr(name_val);
+
+    for (int i = 0; i < BACKPROP_SIMD_COUNT; ++i)
+    {
+      if (0 == strcmp(name, Backprop_GetSimdName((BackpropSimd_t) i)))
+      {
+        return rb_str_new2(Backprop_GetSimdName(Backprop_SetSimd((BackpropSimd_t) i)));
+      }
+    }
+
+    rb_raise(rb_eArgError, "unknown simd %s", name);
+    return Qnil;
+  }
+}
+
+
+
+
+/** Returns the state of a PRNG as a binary string.
+ */
+static VALUE CBackpropRandom_get_state(const BackpropRandom_t* random)
+{
+  BACKPROPRB_TRACE();
+
+  return rb_str_new((const char*) random, sizeof(BackpropRandom_t));
+}
+
+
+
+
+/** Restore the state of a PRNG from a string returned by CBackpropRandom_get_state().
+ */
+static void CBackpropRandom_set_state(BackpropRandom_t* random, VALUE state)
+{
+  BACKPROPRB_TRACE();
+
+  StringValue(state);
+
+  if (RSTRING_LEN(state) != sizeof(BackpropRandom_t))
+  {
+    rb_raise(rb_eArgError, "invalid random state");
+  }
+
+  memcpy(random, RSTRING_PTR(state), sizeof(BackpropRandom_t));
+}
+
+
+
+
 
 //------------------------------------------------------------------------------
 //
@@ -883,6 +982,115 @@ static VALUE CBackpropNetworkStats_new(VALUE klass)
 
 
 
+//------------------------------------------------------------------------------
+//
+// Buffer
+//
+//------------------------------------------------------------------------------
+
+
+/** Caller owned memory for BackpropNetwork_Init() and BackpropTrainer_Init().
+ */
+struct CBackpropBuffer
+{
+  void* data;
+  size_t size;
+  struct BackpropNetwork* network;  ///< Network built in data, detached before data is freed.
+  BackpropTrainer_t* trainer;       ///< Trainer built in data, detached before data is freed.
+};
+
+
+
+
+static struct CBackpropBuffer* CBackpropBuffer_get(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  struct CBackpropBuffer* buffer;
+  Data_Get_Struct(self, struct CBackpropBuffer, buffer);
+
+  if (buffer->network || buffer->trainer)
+  {
+    rb_raise(rb_eArgError, "buffer is in use");
+  }
+
+  return buffer;
+}
+
+
+
+
+static VALUE CBackpropBuffer_size(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  struct CBackpropBuffer* buffer;
+  Data_Get_Struct(self, struct CBackpropBuffer, buffer);
+
+  return SIZET2NUM(buffer->size);
+}
+
+
+
+
+static VALUE CBackpropBuffer_data(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  struct CBackpropBuffer* buffer;
+  Data_Get_Struct(self, struct CBackpropBuffer, buffer);
+
+  return rb_str_new(buffer->data, buffer->size);
+}
+
+
+
+
+static void CBackpropBuffer_free(struct CBackpropBuffer* buffer)
+{
+  BACKPROPRB_TRACE();
+
+  // the network and trainer objects do not own the buffer, detach them here
+  if (buffer->network)
+  {
+    BackpropNetwork_Detach(buffer->network);
+  }
+
+  if (buffer->trainer)
+  {
+    BackpropTrainer_Detach(buffer->trainer);
+  }
+
+  CBackprop_Free(buffer->data);
+  CBackprop_Free(buffer);
+}
+
+
+
+
+static VALUE CBackpropBuffer_new(VALUE klass, VALUE size_val)
+{
+  BACKPROPRB_TRACE();
+
+  const size_t size = NUM2SIZET(size_val);
+
+  struct CBackpropBuffer* buffer = CBackprop_Malloc(sizeof(struct CBackpropBuffer));
+  memset(buffer, 0, sizeof(struct CBackpropBuffer));
+
+  buffer->data = CBackprop_Malloc(size ? size : 1);
+  buffer->size = size;
+  memset(buffer->data, 0, buffer->size);
+
+  return Data_Wrap_Struct(klass, 0, CBackpropBuffer_free, buffer);
+}
+
+
+
+
+
+
+
+
 //------------------------------------------------------------------------------
 //
 // BackpropNetwork
@@ -920,6 +1128,74 @@ static VALUE CBackpropNetwork_activate(VALUE self, VALUE input)
 
 
 
+static VALUE CBackpropNetwork_activate_batch(VALUE self, VALUE inputs)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropNetwork_t* network;
+  Data_Get_Struct(self, BackpropNetwork_t, network);
+
+  Check_Type(inputs, T_ARRAY);
+  {
+    const size_t count = RARRAY_LEN(inputs);
+    const size_t x_size = BackpropNetwork_GetXSize(network);
+    const size_t y_size = BackpropNetwork_GetYSize(network);
+
+    VALUE return_value = rb_ary_new2(count);
+
+    if (!count)
+    {
+      return return_value;
+    }
+
+    // check the inputs before allocating, StringValueCStr() may raise
+    for (size_t i = 0; i < count; ++i)
+    {
+      VALUE input = rb_ary_entry(inputs, i);
+      StringValueCStr(input);
+    }
+
+    BACKPROP_BYTE_T* x = calloc(count, x_size);
+    BACKPROP_BYTE_T* y = malloc(count * y_size);
+
+    if (!x || !y)
+    {
+      free(x);
+      free(y);
+      rb_raise(rb_eNoMemError, "could not allocate batch buffers");
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      VALUE input = rb_ary_entry(inputs, i);
+      const char* cstr_in = StringValueCStr(input);
+      const size_t len = strlen(cstr_in);
+
+      memcpy(x + i * x_size, cstr_in, (len < x_size) ? len : x_size);
+    }
+
+    if (!BackpropNetwork_ActivateBatch(network, BackpropNetwork_GetRandom(network), x, y, count))
+    {
+      free(x);
+      free(y);
+      rb_raise(rb_eNoMemError, "could not allocate activation scratch");
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      rb_ary_store(return_value, i, rb_str_new((const char*) (y + i * y_size), y_size));
+    }
+
+    free(x);
+    free(y);
+
+    return return_value;
+  }
+}
+
+
+
+
 static VALUE CBackpropNetwork_x_size(VALUE self)
 {
   BACKPROPRB_TRACE();
@@ -1080,32 +1356,27 @@ static VALUE CBackpropNetwork_set_jitter(VALUE self, VALUE value)
 
 
 
-static VALUE CBackpropNetwork_randomize(VALUE self, VALUE gain_val, VALUE seed_val)
+static VALUE CBackpropNetwork_get_random_state(VALUE self)
 {
   BACKPROPRB_TRACE();
 
   BackpropNetwork_t* network;
   Data_Get_Struct(self, BackpropNetwork_t, network);
 
-  const BACKPROP_FLOAT_T gain = NUM2DBL(gain_val);
-  const unsigned int seed = NUM2UINT(seed_val);
-
-  BackpropNetwork_Randomize(network, gain, seed);
-
-  return self;
+  return CBackpropRandom_get_state(BackpropNetwork_GetRandom(network));
 }
 
 
 
 
-static VALUE CBackpropNetwork_identity(VALUE self)
+static VALUE CBackpropNetwork_set_random_state(VALUE self, VALUE value)
 {
   BACKPROPRB_TRACE();
 
   BackpropNetwork_t* network;
   Data_Get_Struct(self, BackpropNetwork_t, network);
 
-  BackpropNetwork_Identity(network);
+  CBackpropRandom_set_state(BackpropNetwork_GetRandom(network), value);
 
   return self;
 }
@@ -1113,28 +1384,27 @@ static VALUE CBackpropNetwork_identity(VALUE self)
 
 
 
-static VALUE CBackpropNetwork_round(VALUE self)
+static VALUE CBackpropNetwork_get_use_input_table(VALUE self)
 {
   BACKPROPRB_TRACE();
 
   BackpropNetwork_t* network;
   Data_Get_Struct(self, BackpropNetwork_t, network);
 
-  BackpropNetwork_Round(network);
-
-  return self;
+  return BackpropNetwork_GetUseInputTable(network) ? Qtrue : Qfalse;
 }
 
 
 
-static VALUE CBackpropNetwork_reset(VALUE self)
+
+static VALUE CBackpropNetwork_set_use_input_table(VALUE self, VALUE value)
 {
   BACKPROPRB_TRACE();
 
   BackpropNetwork_t* network;
   Data_Get_Struct(self, BackpropNetwork_t, network);
 
-  BackpropNetwork_Reset(network);
+  BackpropNetwork_SetUseInputTable(network, RTEST(value));
 
   return self;
 }
@@ -1142,84 +1412,71 @@ static VALUE CBackpropNetwork_reset(VALUE self)
 
 
 
-static VALUE CBackpropNetwork_prune(VALUE self, VALUE threshold_val)
+static VALUE CBackpropNetwork_update_input_table(VALUE self)
 {
   BACKPROPRB_TRACE();
 
   BackpropNetwork_t* network;
   Data_Get_Struct(self, BackpropNetwork_t, network);
 
-  BACKPROP_FLOAT_T threshold = NUM2DBL(threshold_val);
-
-  BackpropNetwork_Prune(network, threshold);
-
-  return self;
+  return BackpropNetwork_UpdateInputTable(network) ? Qtrue : Qfalse;
 }
 
 
 
 
-static VALUE CBackpropNetwork_get_stats(VALUE self)
+static VALUE CBackpropNetwork_get_sigmoid(VALUE self)
 {
   BACKPROPRB_TRACE();
 
   BackpropNetwork_t* network;
   Data_Get_Struct(self, BackpropNetwork_t, network);
 
-  VALUE stats_value = CBackpropNetworkStats_new(cBackpropNetworkStats);
-
-  BackpropNetworkStats_t* stats;
-  Data_Get_Struct(stats_value, BackpropNetworkStats_t, stats);
-
-  BackpropNetwork_GetStats(network, stats);
-
-  return stats_value;
+  return rb_str_new2(Backprop_GetSigmoidName(BackpropNetwork_GetSigmoid(network)));
 }
 
 
 
 
-static VALUE CBackpropNetwork_to_hash(VALUE self)
+static VALUE CBackpropNetwork_set_sigmoid(VALUE self, VALUE value)
 {
   BACKPROPRB_TRACE();
 
   BackpropNetwork_t* network;
   Data_Get_Struct(self, BackpropNetwork_t, network);
 
-  VALUE x_array = CBackpropNetwork_get_x(self);
-  VALUE y_array = CBackpropNetwork_get_y(self);
+  BackpropNetwork_SetSigmoid(network, CBackprop_sigmoid_mode(value));
 
-  const BACKPROP_SIZE_T layers_count = BackpropNetwork_GetLayersCount(network);
+  return self;
+}
 
-  VALUE layers_array = rb_ary_new2(layers_count);
 
-  for (BACKPROP_SIZE_T i = 0; i < layers_count; ++i)
-  {
-    VALUE layer = CBackpropNetwork_get_layer(self, INT2NUM(i));
-    rb_ary_store(layers_array, i, CBackpropLayer_to_hash(layer));
-  }
 
-  VALUE hash = rb_hash_new();
-  rb_hash_aset(hash, rb_str_new2("layers"), layers_array);
-  rb_hash_aset(hash, rb_str_new2("x"), x_array);
-  rb_hash_aset(hash, rb_str_new2("y"), y_array);
-  rb_hash_aset(hash, rb_str_new2("jitter"), CBackpropNetwork_get_jitter(self));
 
-  return hash;
+static VALUE CBackpropNetwork_get_weights_version(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropNetwork_t* network;
+  Data_Get_Struct(self, BackpropNetwork_t, network);
+
+  return ULL2NUM(BackpropNetwork_GetWeightsVersion(network));
 }
 
 
 
 
-static VALUE CBackpropNetwork_to_file(VALUE self, VALUE file_name_val)
+static VALUE CBackpropNetwork_randomize(VALUE self, VALUE gain_val, VALUE seed_val)
 {
   BACKPROPRB_TRACE();
 
-  VALUE_TO_C_PTR(BackpropNetwork_t, network, self);
+  BackpropNetwork_t* network;
+  Data_Get_Struct(self, BackpropNetwork_t, network);
 
-  const char* file_name = StringValueCStr(file_name_val);
+  const BACKPROP_FLOAT_T gain = NUM2DBL(gain_val);
+  const unsigned int seed = NUM2UINT(seed_val);
 
-  BackpropNetwork_SaveWeights(network, file_name);
+  BackpropNetwork_Randomize(network, gain, seed);
 
   return self;
 }
@@ -1227,15 +1484,14 @@ static VALUE CBackpropNetwork_to_file(VALUE self, VALUE file_name_val)
 
 
 
-static VALUE CBackpropNetwork_from_file(VALUE self, VALUE file_name_val)
+static VALUE CBackpropNetwork_identity(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  VALUE_TO_C_PTR(BackpropNetwork_t, network, self);
-
-  const char* file_name = StringValueCStr(file_name_val);
+  BackpropNetwork_t* network;
+  Data_Get_Struct(self, BackpropNetwork_t, network);
 
-  BackpropNetwork_LoadWeights(network, file_name);
+  BackpropNetwork_Identity(network);
 
   return self;
 }
@@ -1243,384 +1499,386 @@ static VALUE CBackpropNetwork_from_file(VALUE self, VALUE file_name_val)
 
 
 
-static VALUE CBackpropNetwork_initialize(VALUE self)
+static VALUE CBackpropNetwork_round(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  CBackpropNetwork_reset(self);
+  BackpropNetwork_t* network;
+  Data_Get_Struct(self, BackpropNetwork_t, network);
+
+  BackpropNetwork_Round(network);
 
   return self;
 }
 
 
 
-
-static void CBackpropNetwork_free(struct BackpropNetwork* network)
+static VALUE CBackpropNetwork_reset(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  BackpropNetwork_Free(network);
-}
+  BackpropNetwork_t* network;
+  Data_Get_Struct(self, BackpropNetwork_t, network);
+
+  BackpropNetwork_Reset(network);
 
+  return self;
+}
 
 
 
-static VALUE CBackpropNetwork_new(VALUE klass, VALUE args)
+
+static VALUE CBackpropNetwork_prune(VALUE self, VALUE threshold_val)
 {
   BACKPROPRB_TRACE();
 
-  VALUE x_size_val = rb_hash_aref(args, rb_str_new2("x_size"));
-  VALUE y_size_val = rb_hash_aref(args, rb_str_new2("y_size"));
-  VALUE layer_count_val = rb_hash_aref(args, rb_str_new2("layer_count"));
+  BackpropNetwork_t* network;
+  Data_Get_Struct(self, BackpropNetwork_t, network);
 
-  BACKPROP_SIZE_T x_size = NUM2INT(x_size_val);
-  BACKPROP_SIZE_T y_size = NUM2INT(y_size_val);
-  BACKPROP_SIZE_T layer_count = NUM2INT(layer_count_val);
+  BACKPROP_FLOAT_T threshold = NUM2DBL(threshold_val);
 
-  // allocate structure
-  struct BackpropNetwork* network = BackpropNetwork_Malloc( x_size
-                                                          , y_size
-                                                          , layer_count
-                                                          , true);
+  BackpropNetwork_Prune(network, threshold);
 
-  // wrap it in a ruby object, this will cause GC to call free function
-  VALUE tdata = Data_Wrap_Struct(klass, 0, CBackpropNetwork_free, network);
+  return self;
+}
 
-  // call initialize
-  VALUE argv[1] = {args};
-  rb_obj_call_init(tdata, 1, argv);
 
-  return tdata;
-}
 
 
+static VALUE CBackpropNetwork_get_stats(VALUE self)
+{
+  BACKPROPRB_TRACE();
 
+  BackpropNetwork_t* network;
+  Data_Get_Struct(self, BackpropNetwork_t, network);
 
+  VALUE stats_value = CBackpropNetworkStats_new(cBackpropNetworkStats);
 
+  BackpropNetworkStats_t* stats;
+  Data_Get_Struct(stats_value, BackpropNetworkStats_t, stats);
 
+  BackpropNetwork_GetStats(network, stats);
 
+  return stats_value;
+}
 
-//------------------------------------------------------------------------------
-//
-// BackpropTrainingSet
-//
-//------------------------------------------------------------------------------
 
 
-static VALUE CBackpropTrainingSet_x_at(VALUE self, VALUE index)
+
+static VALUE CBackpropNetwork_to_hash(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingSet_t* training_set;
-  Data_Get_Struct(self, BackpropTrainingSet_t, training_set);
+  BackpropNetwork_t* network;
+  Data_Get_Struct(self, BackpropNetwork_t, network);
 
-  const size_t x_size = training_set->dims.x_size;
-  char* result = malloc(x_size);
+  VALUE x_array = CBackpropNetwork_get_x(self);
+  VALUE y_array = CBackpropNetwork_get_y(self);
 
-  memcpy( result
-        , training_set->x + NUM2INT(index) * x_size
-        , x_size);
+  const BACKPROP_SIZE_T layers_count = BackpropNetwork_GetLayersCount(network);
 
-  VALUE result_value = rb_str_new2(result);
+  VALUE layers_array = rb_ary_new2(layers_count);
 
-  free(result);
+  for (BACKPROP_SIZE_T i = 0; i < layers_count; ++i)
+  {
+    VALUE layer = CBackpropNetwork_get_layer(self, INT2NUM(i));
+    rb_ary_store(layers_array, i, CBackpropLayer_to_hash(layer));
+  }
 
-  return result_value;
+  VALUE hash = rb_hash_new();
+  rb_hash_aset(hash, rb_str_new2("layers"), layers_array);
+  rb_hash_aset(hash, rb_str_new2("x"), x_array);
+  rb_hash_aset(hash, rb_str_new2("y"), y_array);
+  rb_hash_aset(hash, rb_str_new2("jitter"), CBackpropNetwork_get_jitter(self));
+
+  return hash;
 }
 
 
 
 
-static VALUE CBackpropTrainingSet_y_at(VALUE self, VALUE index)
+static VALUE CBackpropNetwork_to_file(VALUE self, VALUE file_name_val)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingSet_t* training_set;
-  Data_Get_Struct(self, BackpropTrainingSet_t, training_set);
-
-  const size_t y_size = training_set->dims.y_size;
-  char* result = malloc(y_size);
-
-  memcpy( result
-        , training_set->y + NUM2INT(index) * y_size
-        , y_size);
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, self);
 
-  VALUE result_value = rb_str_new2(result);
+  const char* file_name = StringValueCStr(file_name_val);
 
-  free(result);
+  BackpropNetwork_SaveWeights(network, file_name);
 
-  return result_value;
+  return self;
 }
 
 
 
 
-static VALUE CBackpropTrainingSet_count(VALUE self)
+static VALUE CBackpropNetwork_from_file(VALUE self, VALUE file_name_val)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingSet_t* training_set;
-  Data_Get_Struct(self, BackpropTrainingSet_t, training_set);
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, self);
 
-  return INT2NUM(training_set->dims.count);
+  const char* file_name = StringValueCStr(file_name_val);
+
+  BackpropNetwork_LoadWeights(network, file_name);
+
+  return self;
 }
 
 
 
 
-static VALUE CBackpropTrainingSet_x_size(VALUE self)
+static VALUE CBackpropNetwork_initialize(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingSet_t* training_set;
-  Data_Get_Struct(self, BackpropTrainingSet_t, training_set);
+  CBackpropNetwork_reset(self);
 
-  return INT2NUM(training_set->dims.x_size);
+  return self;
 }
 
 
 
 
-static VALUE CBackpropTrainingSet_y_size(VALUE self)
+static void CBackpropNetwork_free(struct BackpropNetwork* network)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingSet_t* training_set;
-  Data_Get_Struct(self, BackpropTrainingSet_t, training_set);
-
-  return INT2NUM(training_set->dims.y_size);
+  BackpropNetwork_Free(network);
 }
 
 
 
 
-static VALUE CBackpropTrainingSet_to_hash(VALUE self)
+static VALUE CBackpropNetwork_new(VALUE klass, VALUE args)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingSet_t* training_set;
-  Data_Get_Struct(self, BackpropTrainingSet_t, training_set);
-
-  const BACKPROP_SIZE_T count = training_set->dims.count;
+  VALUE x_size_val = rb_hash_aref(args, rb_str_new2("x_size"));
+  VALUE y_size_val = rb_hash_aref(args, rb_str_new2("y_size"));
+  VALUE layer_count_val = rb_hash_aref(args, rb_str_new2("layer_count"));
 
-  VALUE hash = rb_hash_new();
+  BACKPROP_SIZE_T x_size = NUM2INT(x_size_val);
+  BACKPROP_SIZE_T y_size = NUM2INT(y_size_val);
+  BACKPROP_SIZE_T layer_count = NUM2INT(layer_count_val);
 
-  VALUE x_array = rb_ary_new2(count);
-  VALUE y_array = rb_ary_new2(count);
+  // allocate structure
+  struct BackpropNetwork* network = BackpropNetwork_Malloc( x_size
+                                                          , y_size
+                                                          , layer_count
+                                                          , true);
 
-  for (BACKPROP_SIZE_T i = 0; i < count; ++i)
-  {
-    rb_ary_store(x_array, i, CBackpropTrainingSet_x_at(self, INT2NUM(i)));
-    rb_ary_store(y_array, i, CBackpropTrainingSet_y_at(self, INT2NUM(i)));
-  }
+  // wrap it in a ruby object, this will cause GC to call free function
+  VALUE tdata = Data_Wrap_Struct(klass, 0, CBackpropNetwork_free, network);
 
-  rb_hash_aset(hash, rb_str_new2("count"), INT2NUM(count));
-  rb_hash_aset(hash, rb_str_new2("x_size"), INT2NUM(training_set->dims.x_size));
-  rb_hash_aset(hash, rb_str_new2("y_size"), INT2NUM(training_set->dims.y_size));
-  rb_hash_aset(hash, rb_str_new2("x"), x_array);
-  rb_hash_aset(hash, rb_str_new2("y"), y_array);
+  // call initialize
+  VALUE argv[1] = {args};
+  rb_obj_call_init(tdata, 1, argv);
 
-  return hash;
+  return tdata;
 }
 
 
 
 
-static VALUE CBackpropTrainingSet_to_file(VALUE self, VALUE file_name_val)
+static VALUE CBackpropNetwork_clone(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  VALUE_TO_C_PTR(BackpropTrainingSet_t, training_set, self);
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, self);
 
-  const char* file_name = StringValueCStr(file_name_val);
+  struct BackpropNetwork* clone = BackpropNetwork_Clone(network);
 
-  BackpropTrainingSet_Save(training_set, file_name);
+  if (!clone)
+  {
+    rb_raise(rb_eNoMemError, "failed to clone network");
+  }
 
-  return self;
+  return Data_Wrap_Struct(rb_obj_class(self), 0, CBackpropNetwork_free, clone);
 }
 
 
 
 
-static VALUE CBackpropTrainingSet_from_file(VALUE self, VALUE file_name_val)
+static VALUE CBackpropNetwork_malloc_size(VALUE klass, VALUE args)
 {
   BACKPROPRB_TRACE();
 
-  VALUE_TO_C_PTR(BackpropTrainingSet_t, training_set, self);
-
-  const char* file_name = StringValueCStr(file_name_val);
-
-  BackpropTrainingSet_Load(training_set, file_name);
+  VALUE x_size_val = rb_hash_aref(args, rb_str_new2("x_size"));
+  VALUE y_size_val = rb_hash_aref(args, rb_str_new2("y_size"));
+  VALUE layer_count_val = rb_hash_aref(args, rb_str_new2("layer_count"));
 
-  return self;
+  return SIZET2NUM(BackpropNetwork_MallocSizeWith(NUM2INT(x_size_val), NUM2INT(y_size_val), NUM2INT(layer_count_val), true));
 }
 
 
 
 
-static VALUE CBackpropTrainingSet_initialize(VALUE self)
+static VALUE CBackpropNetwork_init(VALUE klass, VALUE buffer_val, VALUE args)
 {
   BACKPROPRB_TRACE();
 
-  return self;
-}
+  struct CBackpropBuffer* buffer = CBackpropBuffer_get(buffer_val);
 
+  VALUE x_size_val = rb_hash_aref(args, rb_str_new2("x_size"));
+  VALUE y_size_val = rb_hash_aref(args, rb_str_new2("y_size"));
+  VALUE layer_count_val = rb_hash_aref(args, rb_str_new2("layer_count"));
 
+  struct BackpropNetwork* network = BackpropNetwork_Init( buffer->data
+                                                        , buffer->size
+                                                        , NUM2INT(x_size_val)
+                                                        , NUM2INT(y_size_val)
+                                                        , NUM2INT(layer_count_val)
+                                                        , true);
 
+  if (!network)
+  {
+    return Qnil;
+  }
 
-static void CBackpropTrainingSet_free(struct BackpropTrainingSet* self)
-{
-  BACKPROPRB_TRACE();
+  buffer->network = network;
 
-  BackpropTrainingSet_Free(self);
+  {
+    // the buffer frees the network, keep it alive as long as the network
+    VALUE tdata = Data_Wrap_Struct(klass, 0, 0, network);
+    rb_iv_set(tdata, "@buffer", buffer_val);
+
+    VALUE argv[1] = {args};
+    rb_obj_call_init(tdata, 1, argv);
+
+    return tdata;
+  }
 }
 
 
 
 
-static VALUE CBackpropTrainingSet_new(VALUE klass, VALUE x_value, VALUE y_value)
+static VALUE CBackpropNetwork_detach(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  size_t count = 0;
-  size_t x_size = 0;
-  size_t y_size = 0;
-
-  if ((x_value != Qnil) || (y_value != Qnil))
-  {
-    VALUE x_count = rb_funcall(x_value, rb_intern("size"),  0);
-    VALUE y_count = rb_funcall(y_value, rb_intern("size"),  0);
-
-    if (x_count != y_count)
-    {
-      return Qnil;
-    }
-
-    VALUE x_str_val = rb_funcall(x_value, rb_intern("at"), 1, INT2NUM(0));
-    VALUE y_str_val = rb_funcall(y_value, rb_intern("at"), 1, INT2NUM(0));
-
-    VALUE x_size_val = rb_funcall(x_str_val, rb_intern("size"), 0);
-    VALUE y_size_val = rb_funcall(y_str_val, rb_intern("size"), 0);
-
-    count = NUM2INT(x_count);
-    x_size = NUM2INT(x_size_val);
-    y_size = NUM2INT(y_size_val);
-  }
-
-  BackpropTrainingSet_t* instance = BackpropTrainingSet_Malloc(count, x_size, y_size);
-
-  // wrap it in a ruby object, this will cause GC to call free function
-  VALUE tdata = Data_Wrap_Struct(klass, 0, CBackpropTrainingSet_free, instance);
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, self);
 
-  // call initialize
-  //VALUE argv[3] = {count, x_size, y_size};
-  //  rb_obj_call_init(tdata, 0, 0);
+  BackpropNetwork_Detach(network);
 
-  if ((x_value != Qnil) || (y_value != Qnil))
-  {
-    for (size_t i = 0; i < count; ++i)
-    {
-      VALUE x_str_val = rb_funcall(x_value, rb_intern("at"), 1, INT2NUM(i));
-      char* x_str = StringValueCStr(x_str_val);
+  return self;
+}
 
-      BACKPROP_BYTE_T* x = instance->x + i * x_size;
-      memcpy(x, x_str, x_size);
-    }
 
-    for (size_t j = 0; j < count; ++j)
-    {
-      VALUE y_str_val = rb_funcall(y_value, rb_intern("at"), 1, INT2NUM(j));
-      char* y_str = StringValueCStr(y_str_val);
 
-      BACKPROP_BYTE_T* y = instance->y + j * y_size;
-      memcpy(y, y_str, y_size);
-    }
-  }
 
-  return tdata;
-}
 
 
 
 
 //------------------------------------------------------------------------------
 //
-// BackpropExerciseStats
+// BackpropInferenceModel
 //
 //------------------------------------------------------------------------------
 
 
-static VALUE CBackpropExerciseStats_exercise_clock_ticks(VALUE self)
+static VALUE CBackpropInferenceModel_activate_batch(VALUE self, VALUE inputs)
 {
   BACKPROPRB_TRACE();
 
-  BackpropExerciseStats_t* stats;
-  Data_Get_Struct(self, BackpropExerciseStats_t, stats);
+  struct BackpropInferenceModel* model;
+  Data_Get_Struct(self, struct BackpropInferenceModel, model);
 
-  return INT2NUM(stats->exercise_clock_ticks);
+  Check_Type(inputs, T_ARRAY);
+  {
+    const size_t count = RARRAY_LEN(inputs);
+    const size_t x_size = BackpropInferenceModel_GetXSize(model);
+    const size_t y_size = BackpropInferenceModel_GetYSize(model);
+    const size_t scratch_size = BackpropInferenceModel_GetScratchSize(model);
+
+    VALUE return_value = rb_ary_new2(count);
+
+    if (!count)
+    {
+      return return_value;
+    }
+
+    BACKPROP_BYTE_T* x = malloc(count * x_size);
+    BACKPROP_BYTE_T* y = malloc(count * y_size);
+    void* scratch = malloc(scratch_size);
+    memset(x, 0, count * x_size);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      VALUE input = rb_ary_entry(inputs, i);
+      const char* cstr_in = StringValueCStr(input);
+      const size_t len = strlen(cstr_in);
+
+      memcpy(x + i * x_size, cstr_in, (len < x_size) ? len : x_size);
+    }
+
+    BackpropInferenceModel_ActivateBatch(model, scratch, x, y, count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      rb_ary_store(return_value, i, rb_str_new((const char*) (y + i * y_size), y_size));
+    }
+
+    free(scratch);
+    free(x);
+    free(y);
+
+    return return_value;
+  }
 }
 
 
 
 
-static VALUE CBackpropExerciseStats_activate_count(VALUE self)
+static VALUE CBackpropInferenceModel_activate(VALUE self, VALUE input)
 {
   BACKPROPRB_TRACE();
 
-  BackpropExerciseStats_t* stats;
-  Data_Get_Struct(self, BackpropExerciseStats_t, stats);
+  VALUE outputs = CBackpropInferenceModel_activate_batch(self, rb_ary_new3(1, input));
 
-  return INT2NUM(stats->activate_count);
+  return rb_ary_entry(outputs, 0);
 }
 
 
 
-static VALUE CBackpropExerciseStats_error(VALUE self)
+
+static VALUE CBackpropInferenceModel_size(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  BackpropExerciseStats_t* stats;
-  Data_Get_Struct(self, BackpropExerciseStats_t, stats);
+  struct BackpropInferenceModel* model;
+  Data_Get_Struct(self, struct BackpropInferenceModel, model);
 
-  return rb_float_new(stats->error);
+  return SIZET2NUM(BackpropInferenceModel_GetSize(model));
 }
 
 
 
 
-static VALUE CBackpropExerciseStats_to_hash(VALUE self)
+static void CBackpropInferenceModel_free(struct BackpropInferenceModel* model)
 {
   BACKPROPRB_TRACE();
 
-  BackpropExerciseStats_t* stats;
-  Data_Get_Struct(self, BackpropExerciseStats_t, stats);
-
-  VALUE hash = rb_hash_new();
-  rb_hash_aset(hash, rb_str_new2("exercise_clock_ticks"), CBackpropExerciseStats_exercise_clock_ticks(self));
-  rb_hash_aset(hash, rb_str_new2("activate_count"), CBackpropExerciseStats_activate_count(self));
-  rb_hash_aset(hash, rb_str_new2("error"), CBackpropExerciseStats_error(self));
-
-  return hash;
+  BackpropInferenceModel_Free(model);
 }
 
 
 
 
-static VALUE CBackpropExerciseStats_new(VALUE klass)
+static VALUE CBackpropInferenceModel_new(VALUE klass, VALUE network_val)
 {
   BACKPROPRB_TRACE();
 
-  // allocate structure
-  BackpropExerciseStats_t* instance = xmalloc(sizeof(BackpropExerciseStats_t));
+  BackpropNetwork_t* network;
+  Data_Get_Struct(network_val, BackpropNetwork_t, network);
 
-  // initialize structure
-  memset(instance, 0, sizeof(BackpropExerciseStats_t));
+  // allocate structure
+  struct BackpropInferenceModel* model = BackpropInferenceModel_Malloc(network);
 
   // wrap it in a ruby object, this will cause GC to call free function
-  VALUE tdata = Data_Wrap_Struct(klass, 0, xfree, instance);
-
-  // call initialize
-  rb_obj_call_init(tdata, 0, 0);
+  VALUE tdata = Data_Wrap_Struct(klass, 0, CBackpropInferenceModel_free, model);
 
   return tdata;
 }
@@ -1628,399 +1886,399 @@ static VALUE CBackpropExerciseStats_new(VALUE klass)
 
 
 
+
+
+
+
 //------------------------------------------------------------------------------
 //
-// BackpropTrainingStats
+// BackpropShm
 //
 //------------------------------------------------------------------------------
 
 
-static VALUE CBackpropTrainingStats_pair_error_correction(VALUE self)
+static struct BackpropShm* CBackpropShm_get(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingStats_t* stats;
-  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+  struct BackpropShm* shm;
+  Data_Get_Struct(self, struct BackpropShm, shm);
 
-  return rb_float_new(stats->pair_error_correction);
+  if (!shm)
+  {
+    rb_raise(rb_eIOError, "shared model is closed");
+  }
+
+  return shm;
 }
 
 
 
 
-static VALUE CBackpropTrainingStats_set_weight_correction_total(VALUE self)
+static VALUE CBackpropShm_publish(VALUE self, VALUE network_val)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingStats_t* stats;
-  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+  struct BackpropShm* shm = CBackpropShm_get(self);
 
-  return rb_float_new(stats->set_weight_correction_total);
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, network_val);
+
+  return BackpropShm_Publish(shm, network) ? Qtrue : Qfalse;
 }
 
 
 
 
-static VALUE CBackpropTrainingStats_batch_weight_correction_total(VALUE self)
+static VALUE CBackpropShm_generation(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingStats_t* stats;
-  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
-
-  return rb_float_new(stats->batch_weight_correction_total);
+  return ULL2NUM(BackpropShm_GetGeneration(CBackpropShm_get(self)));
 }
 
 
 
 
-static VALUE CBackpropTrainingStats_teach_total(VALUE self)
+static VALUE CBackpropShm_activate(VALUE self, VALUE input)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingStats_t* stats;
-  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+  struct BackpropShm* shm = CBackpropShm_get(self);
 
-  return INT2NUM(stats->teach_total);
+  const char* cstr_in = StringValueCStr(input);
+  const size_t len = strlen(cstr_in);
+
+  // every model of the segment has the sizes of the first, so the buffers fit any model acquired below
+  const size_t x_size = BackpropShm_GetXSize(shm);
+  const size_t y_size = BackpropShm_GetYSize(shm);
+  const size_t scratch_size = BackpropShm_GetScratchSize(shm);
+
+  if (!x_size)
+  {
+    return Qnil;
+  }
+
+  BACKPROP_BYTE_T* x = calloc(1, x_size);
+  BACKPROP_BYTE_T* y = malloc(y_size);
+  void* scratch = malloc(scratch_size);
+
+  if (!x || !y || !scratch)
+  {
+    free(scratch);
+    free(x);
+    free(y);
+    rb_raise(rb_eNoMemError, "could not allocate activation buffers");
+  }
+
+  memcpy(x, cstr_in, (len < x_size) ? len : x_size);
+
+  VALUE return_value = Qnil;
+
+  for (;;)
+  {
+    uint64_t ticket = 0;
+    const struct BackpropInferenceModel* model = BackpropShm_Acquire(shm, &ticket);
+
+    BackpropInferenceModel_Activate(model, scratch, x, y);
+
+    if (BackpropShm_Validate(shm, ticket))
+    {
+      return_value = rb_str_new((const char*) y, y_size);
+      break;
+    }
+  }
+
+  free(scratch);
+  free(x);
+  free(y);
+
+  return return_value;
 }
 
 
 
 
-static VALUE CBackpropTrainingStats_pair_total(VALUE self)
+static VALUE CBackpropShm_close(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingStats_t* stats;
-  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+  struct BackpropShm* shm;
+  Data_Get_Struct(self, struct BackpropShm, shm);
 
-  return INT2NUM(stats->pair_total);
+  BackpropShm_Close(shm);
+  DATA_PTR(self) = NULL;
+
+  return Qnil;
 }
 
 
 
 
-static VALUE CBackpropTrainingStats_set_total(VALUE self)
+static VALUE CBackpropShm_unlink(VALUE klass, VALUE name_val)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingStats_t* stats;
-  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+  return BackpropShm_Unlink(StringValueCStr(name_val)) ? Qtrue : Qfalse;
+}
 
-  return INT2NUM(stats->set_total);
+
+
+
+static void CBackpropShm_free(struct BackpropShm* shm)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropShm_Close(shm);
 }
 
 
 
 
-static VALUE CBackpropTrainingStats_batches_total(VALUE self)
+static VALUE CBackpropShm_create(VALUE klass, VALUE name_val, VALUE network_val)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingStats_t* stats;
-  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, network_val);
 
-  return INT2NUM(stats->batches_total);
+  struct BackpropShm* shm = BackpropShm_Create(StringValueCStr(name_val), BackpropInferenceModel_MallocSize(network));
+
+  if (!shm)
+  {
+    rb_sys_fail(StringValueCStr(name_val));
+  }
+
+  BackpropShm_Publish(shm, network);
+
+  return Data_Wrap_Struct(klass, 0, CBackpropShm_free, shm);
 }
 
 
 
 
-static VALUE CBackpropTrainingStats_stubborn_batches_total(VALUE self)
+static VALUE CBackpropShm_open(VALUE klass, VALUE name_val)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingStats_t* stats;
-  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+  struct BackpropShm* shm = BackpropShm_Open(StringValueCStr(name_val));
 
-  return INT2NUM(stats->stubborn_batches_total);
+  if (!shm)
+  {
+    rb_sys_fail(StringValueCStr(name_val));
+  }
+
+  return Data_Wrap_Struct(klass, 0, CBackpropShm_free, shm);
 }
 
 
 
 
-static VALUE CBackpropTrainingStats_stagnate_batches_total(VALUE self)
+//------------------------------------------------------------------------------
+//
+// BackpropPsServer
+//
+//------------------------------------------------------------------------------
+
+
+static struct BackpropPsServer* CBackpropPsServer_get(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingStats_t* stats;
-  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+  struct BackpropPsServer* server;
+  Data_Get_Struct(self, struct BackpropPsServer, server);
 
-  return INT2NUM(stats->stagnate_batches_total);
+  if (!server)
+  {
+    rb_raise(rb_eIOError, "parameter server is closed");
+  }
+
+  return server;
 }
 
 
 
 
-static VALUE CBackpropTrainingStats_train_clock(VALUE self)
+static VALUE CBackpropPsServer_serve(VALUE self, VALUE push_count_val, VALUE timeout_ms_val)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingStats_t* stats;
-  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+  struct BackpropPsServer* server = CBackpropPsServer_get(self);
 
-  return INT2NUM(stats->train_clock);
+  return SIZET2NUM(BackpropPsServer_Serve(server, NUM2SIZET(push_count_val), NUM2INT(timeout_ms_val)));
 }
 
 
 
 
-static VALUE CBackpropTrainingStats_to_hash(VALUE self)
+static VALUE CBackpropPsServer_version(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainingStats_t* stats;
-  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+  return ULL2NUM(BackpropPsServer_GetVersion(CBackpropPsServer_get(self)));
+}
 
-  VALUE hash = rb_hash_new();
-  rb_hash_aset(hash, rb_str_new2("set_weight_correction_total"), CBackpropTrainingStats_set_weight_correction_total(self));
-  rb_hash_aset(hash, rb_str_new2("batch_weight_correction_total"), CBackpropTrainingStats_batch_weight_correction_total(self));
-  rb_hash_aset(hash, rb_str_new2("teach_total"), CBackpropTrainingStats_teach_total(self));
-  rb_hash_aset(hash, rb_str_new2("pair_total"), CBackpropTrainingStats_pair_total(self));
-  rb_hash_aset(hash, rb_str_new2("set_total"), CBackpropTrainingStats_set_total(self));
-  rb_hash_aset(hash, rb_str_new2("batches_total"), CBackpropTrainingStats_batches_total(self));
-  rb_hash_aset(hash, rb_str_new2("stubborn_batches_total"), CBackpropTrainingStats_stubborn_batches_total(self));
-  rb_hash_aset(hash, rb_str_new2("stagnate_batches_total"), CBackpropTrainingStats_stagnate_batches_total(self));
-  rb_hash_aset(hash, rb_str_new2("train_clock"), CBackpropTrainingStats_train_clock(self));
 
-  return hash;
+
+
+static VALUE CBackpropPsServer_port(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  return INT2NUM(BackpropPsServer_GetPort(CBackpropPsServer_get(self)));
 }
 
 
 
 
-static VALUE CBackpropTrainingStats_new(VALUE klass)
+static VALUE CBackpropPsServer_get_push_scale(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  // allocate structure
-  BackpropTrainingStats_t* instance = xmalloc(sizeof(BackpropTrainingStats_t));
+  return rb_float_new(BackpropPsServer_GetPushScale(CBackpropPsServer_get(self)));
+}
 
-  // initialize structure
-  memset(instance, 0, sizeof(BackpropTrainingStats_t));
 
-  // wrap it in a ruby object, this will cause GC to call free function
-  VALUE tdata = Data_Wrap_Struct(klass, 0, xfree, instance);
 
-  // call initialize
-  rb_obj_call_init(tdata, 0, 0);
 
-  return tdata;
-}
+static VALUE CBackpropPsServer_set_push_scale(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
 
+  BackpropPsServer_SetPushScale(CBackpropPsServer_get(self), NUM2DBL(value));
 
+  return self;
+}
 
 
-//------------------------------------------------------------------------------
-//
-// BackpropTrainer
-//
-//------------------------------------------------------------------------------
 
 
-static VALUE CBackpropTrainer_teach_pair( VALUE trainer_val
-                                        , VALUE training_stats_val
-                                        , VALUE network_val
-                                        , VALUE x_val
-                                        , VALUE y_desired_val)
+static VALUE CBackpropPsServer_close(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainer_t* trainer = NULL;
-  Data_Get_Struct(trainer_val, BackpropTrainer_t, trainer);
+  struct BackpropPsServer* server;
+  Data_Get_Struct(self, struct BackpropPsServer, server);
 
-  if (!trainer)
-  {
-    rb_raise(rb_eArgError, "NULL trainer");
-    return Qnil;
-  }
+  BackpropPsServer_Close(server);
+  DATA_PTR(self) = NULL;
 
-  BackpropTrainingStats_t* training_stats = NULL;
-  Data_Get_Struct(training_stats_val, BackpropTrainingStats_t, training_stats);
+  return Qnil;
+}
 
-  if (!training_stats)
-  {
-    rb_raise(rb_eArgError, "NULL training_stats");
-    return Qnil;
-  }
 
-  BackpropNetwork_t* network = NULL;
-  Data_Get_Struct(network_val, BackpropNetwork_t, network);
 
-  if (!network)
-  {
-    rb_raise(rb_eArgError, "NULL network");
-    return Qnil;
-  }
 
-  char* x_str = StringValueCStr(x_val);
+static void CBackpropPsServer_free(struct BackpropPsServer* server)
+{
+  BACKPROPRB_TRACE();
 
-  if (!x_str)
-  {
-    rb_raise(rb_eArgError, "NULL x");
-    return Qnil;
-  }
+  BackpropPsServer_Close(server);
+}
 
-  BACKPROP_SIZE_T x_len = strlen(x_str);
 
-  if (x_len <= 0)
-  {
-    rb_raise(rb_eArgError, "invalid x length");
-    return Qnil;
-  }
 
-  char* y_desired_str = StringValueCStr(y_desired_val);
 
-  if (!y_desired_str)
-  {
-    rb_raise(rb_eArgError, "NULL y");
-    return Qnil;
-  }
+static VALUE CBackpropPsServer_create(VALUE klass, VALUE network_val, VALUE address_val)
+{
+  BACKPROPRB_TRACE();
 
-  BACKPROP_SIZE_T y_desired_len = strlen(y_desired_str);
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, network_val);
 
-  if (y_desired_len <= 0)
+  struct BackpropPsServer* server = BackpropPsServer_Create(network, StringValueCStr(address_val));
+
+  if (!server)
   {
-    rb_raise(rb_eArgError, "invalid y length");
-    return Qnil;
+    rb_sys_fail(StringValueCStr(address_val));
   }
 
-  BACKPROP_FLOAT_T result = BackpropTrainer_TeachPair( trainer
-                                                     , training_stats
-                                                     , network
-                                                     , x_str, x_len
-                                                     , y_desired_str, y_desired_len);
+  VALUE self = Data_Wrap_Struct(klass, 0, CBackpropPsServer_free, server);
 
-  return rb_float_new(result);
+  // the server changes the weights of network, keep it alive as long as the server
+  rb_iv_set(self, "@network", network_val);
+
+  return self;
 }
 
 
 
 
-static VALUE CBackpropTrainer_train_pair( VALUE trainer_val
-                                        , VALUE training_stats_val
-                                        , VALUE network_val
-                                        , VALUE x_val
-                                        , VALUE y_desired_val)
+//------------------------------------------------------------------------------
+//
+// BackpropPsClient
+//
+//------------------------------------------------------------------------------
+
+
+static struct BackpropPsClient* CBackpropPsClient_get(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainer_t* trainer = NULL;
-  Data_Get_Struct(trainer_val, BackpropTrainer_t, trainer);
+  struct BackpropPsClient* client;
+  Data_Get_Struct(self, struct BackpropPsClient, client);
 
-  if (!trainer)
+  if (!client)
   {
-    rb_raise(rb_eArgError, "NULL trainer");
-    return Qnil;
+    rb_raise(rb_eIOError, "parameter client is closed");
   }
 
-  BackpropTrainingStats_t* training_stats = NULL;
-  Data_Get_Struct(training_stats_val, BackpropTrainingStats_t, training_stats);
-
-  if (!training_stats)
-  {
-    rb_raise(rb_eArgError, "NULL training_stats");
-    return Qnil;
-  }
+  return client;
+}
 
-  BackpropNetwork_t* network = NULL;
-  Data_Get_Struct(network_val, BackpropNetwork_t, network);
 
-  if (!network)
-  {
-    rb_raise(rb_eArgError, "NULL network");
-    return Qnil;
-  }
 
-  char* x_str = StringValueCStr(x_val);
 
-  if (!x_str)
-  {
-    rb_raise(rb_eArgError, "NULL x");
-    return Qnil;
-  }
+static VALUE CBackpropPsClient_pull(VALUE self, VALUE network_val)
+{
+  BACKPROPRB_TRACE();
 
-  BACKPROP_SIZE_T x_len = strlen(x_str);
+  struct BackpropPsClient* client = CBackpropPsClient_get(self);
 
-  if (x_len <= 0)
-  {
-    rb_raise(rb_eArgError, "invalid x length");
-    return Qnil;
-  }
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, network_val);
 
-  char* y_desired_str = StringValueCStr(y_desired_val);
+  return BackpropPsClient_Pull(client, network) ? Qtrue : Qfalse;
+}
 
-  if (!y_desired_str)
-  {
-    rb_raise(rb_eArgError, "NULL y");
-    return Qnil;
-  }
 
-  BACKPROP_SIZE_T y_desired_len = strlen(y_desired_str);
 
-  if (y_desired_len <= 0)
-  {
-    rb_raise(rb_eArgError, "invalid y length");
-    return Qnil;
-  }
 
-  BACKPROP_FLOAT_T result = BackpropTrainer_TrainPair( trainer
-                                                     , training_stats
-                                                     , network
-                                                     , x_str, x_len
-                                                     , y_desired_str, y_desired_len);
+static VALUE CBackpropPsClient_push(VALUE self, VALUE network_val)
+{
+  BACKPROPRB_TRACE();
 
-  return rb_float_new(result);
-}
+  struct BackpropPsClient* client = CBackpropPsClient_get(self);
 
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, network_val);
 
+  return BackpropPsClient_Push(client, network) ? Qtrue : Qfalse;
+}
 
 
 
 
-static VALUE CBackpropTrainer_train_set( VALUE trainer_val
-                                       , VALUE training_stats_val
-                                       , VALUE network_val
-                                       , VALUE training_set_val)
+static VALUE CBackpropPsClient_version(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainer_t* trainer = NULL;
-  Data_Get_Struct(trainer_val, BackpropTrainer_t, trainer);
-
-  if (!trainer)
-  {
-    rb_raise(rb_eArgError, "NULL trainer");
-    return Qnil;
-  }
-
-  BackpropTrainingStats_t* training_stats = NULL;
-  Data_Get_Struct(training_stats_val, BackpropTrainingStats_t, training_stats);
+  return ULL2NUM(BackpropPsClient_GetVersion(CBackpropPsClient_get(self)));
+}
 
-  if (!training_stats)
-  {
-    rb_raise(rb_eArgError, "NULL training stats");
-    return Qnil;
-  }
 
-  BackpropNetwork_t* network = NULL;
-  Data_Get_Struct(network_val, BackpropNetwork_t, network);
 
-  if (!network)
-  {
-    rb_raise(rb_eArgError, "NULL network");
-    return Qnil;
-  }
 
+static VALUE CBackpropPsClient_train( VALUE self
+                                    , VALUE trainer_val
+                                    , VALUE training_stats_val
+                                    , VALUE network_val
+                                    , VALUE training_set_val
+                                    , VALUE rounds_val)
+{
+  BACKPROPRB_TRACE();
 
-  BackpropTrainingSet_t* training_set = NULL;
-  Data_Get_Struct(training_set_val, BackpropTrainingSet_t, training_set);
+  struct BackpropPsClient* client = CBackpropPsClient_get(self);
 
-  if (!training_set)
-  {
-    rb_raise(rb_eArgError, "NULL training set");
-    return Qnil;
-  }
+  VALUE_TO_C_PTR(BackpropTrainer_t, trainer, trainer_val);
+  VALUE_TO_C_PTR(BackpropTrainingStats_t, training_stats, training_stats_val);
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, network_val);
+  VALUE_TO_C_PTR(BackpropTrainingSet_t, training_set, training_set_val);
 
   struct BackpropTrainingSession session =
   {
@@ -2029,152 +2287,1061 @@ static VALUE CBackpropTrainer_train_set( VALUE trainer_val
     .exercise_stats = NULL,
   };
 
+  return SIZET2NUM(BackpropPsClient_Train(client, trainer, network, &session, NUM2SIZET(rounds_val)));
+}
 
-  BACKPROP_FLOAT_T error = BackpropTrainer_TrainSet( trainer
-                                                   , network
-                                                   , &session);
 
-  return rb_float_new(error);
+
+
+static VALUE CBackpropPsClient_close(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  struct BackpropPsClient* client;
+  Data_Get_Struct(self, struct BackpropPsClient, client);
+
+  BackpropPsClient_Close(client);
+  DATA_PTR(self) = NULL;
+
+  return Qnil;
 }
 
 
 
 
+static void CBackpropPsClient_free(struct BackpropPsClient* client)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropPsClient_Close(client);
+}
+
+
 
 
-static VALUE CBackpropTrainer_train_batch( VALUE trainer_val
-                                         , VALUE training_stats_val
-                                         , VALUE exercise_stats_val
-                                         , VALUE network_val
-                                         , VALUE training_set_val)
+static VALUE CBackpropPsClient_connect(VALUE klass, VALUE address_val)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainer_t* trainer = NULL;
-  Data_Get_Struct(trainer_val, BackpropTrainer_t, trainer);
+  struct BackpropPsClient* client = BackpropPsClient_Connect(StringValueCStr(address_val));
 
-  if (!trainer)
+  if (!client)
   {
-    rb_raise(rb_eArgError, "NULL trainer");
-    return Qnil;
+    rb_sys_fail(StringValueCStr(address_val));
   }
 
-  BackpropTrainingStats_t* training_stats = NULL;
-  Data_Get_Struct(training_stats_val, BackpropTrainingStats_t, training_stats);
+  return Data_Wrap_Struct(klass, 0, CBackpropPsClient_free, client);
+}
 
-  if (!training_stats)
-  {
-    rb_raise(rb_eArgError, "NULL training stats");
-    return Qnil;
-  }
 
-  BackpropExerciseStats_t* exercise_stats = NULL;
-  Data_Get_Struct(exercise_stats_val, BackpropExerciseStats_t, exercise_stats);
 
-  if (!exercise_stats)
-  {
-    rb_raise(rb_eArgError, "NULL exercise stats");
-    return Qnil;
-  }
 
-  BackpropNetwork_t* network = NULL;
-  Data_Get_Struct(network_val, BackpropNetwork_t, network);
 
-  if (!network)
-  {
-    rb_raise(rb_eArgError, "NULL network");
-    return Qnil;
-  }
 
 
-  BackpropTrainingSet_t* training_set = NULL;
-  Data_Get_Struct(training_set_val, BackpropTrainingSet_t, training_set);
 
-  if (!training_set)
-  {
-    rb_raise(rb_eArgError, "NULL training set");
-    return Qnil;
-  }
+//------------------------------------------------------------------------------
+//
+// BackpropTrainingSet
+//
+//------------------------------------------------------------------------------
 
-  struct BackpropTrainingSession session =
-  {
-    .training_set = training_set,
-    .stats = training_stats,
-    .exercise_stats = exercise_stats,
-  };
 
+static VALUE CBackpropTrainingSet_x_at(VALUE self, VALUE index)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingSet_t* training_set;
+  Data_Get_Struct(self, BackpropTrainingSet_t, training_set);
 
-  BACKPROP_FLOAT_T error = BackpropTrainer_TrainBatch( trainer
-                                                     , network
-                                                     , &session);
+  const size_t x_size = training_set->dims.x_size;
+  char* result = malloc(x_size);
 
-  return rb_float_new(error);
+  memcpy( result
+        , training_set->x + NUM2INT(index) * x_size
+        , x_size);
+
+  VALUE result_value = rb_str_new2(result);
+
+  free(result);
+
+  return result_value;
 }
 
 
 
 
-static VALUE CBackpropTrainer_train( VALUE trainer_val
-                                   , VALUE training_stats_val
-                                   , VALUE exercise_stats_val
-                                   , VALUE network_val
-                                   , VALUE training_set_val)
+static VALUE CBackpropTrainingSet_y_at(VALUE self, VALUE index)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainer_t* trainer = NULL;
-  BackpropTrainingStats_t* training_stats = NULL;
-  BackpropExerciseStats_t* exercise_stats = NULL;
-  BackpropNetwork_t* network = NULL;
-  BackpropTrainingSet_t* training_set = NULL;
-  BACKPROP_FLOAT_T error = 0;
+  BackpropTrainingSet_t* training_set;
+  Data_Get_Struct(self, BackpropTrainingSet_t, training_set);
 
-  Data_Get_Struct(trainer_val, BackpropTrainer_t, trainer);
-  if (!trainer)
-  {
-    rb_raise(rb_eArgError, "NULL trainer");
-    return Qnil;
-  }
+  const size_t y_size = training_set->dims.y_size;
+  char* result = malloc(y_size);
 
-  Data_Get_Struct(training_stats_val, BackpropTrainingStats_t, training_stats);
-  if (!training_stats)
-  {
-    rb_raise(rb_eArgError, "NULL training stats");
-    return Qnil;
-  }
+  memcpy( result
+        , training_set->y + NUM2INT(index) * y_size
+        , y_size);
 
-  Data_Get_Struct(exercise_stats_val, BackpropExerciseStats_t, exercise_stats);
-  if (!exercise_stats)
-  {
-    rb_raise(rb_eArgError, "NULL exercise stats");
-    return Qnil;
-  }
+  VALUE result_value = rb_str_new2(result);
 
-  Data_Get_Struct(network_val, BackpropNetwork_t, network);
+  free(result);
 
-  if (!network)
-  {
-    rb_raise(rb_eArgError, "NULL network");
-    return Qnil;
-  }
+  return result_value;
+}
 
-  Data_Get_Struct(training_set_val, BackpropTrainingSet_t, training_set);
-  if (!training_set)
-  {
-    rb_raise(rb_eArgError, "NULL training set");
-    return Qnil;
-  }
 
-  struct BackpropTrainingSession session =
-  {
-    .training_set = training_set,
-    .stats = training_stats,
-    .exercise_stats = exercise_stats,
-  };
 
-  error = BackpropTrainer_Train( trainer
-                               , network
-                               , &session);
+
+static VALUE CBackpropTrainingSet_count(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingSet_t* training_set;
+  Data_Get_Struct(self, BackpropTrainingSet_t, training_set);
+
+  return INT2NUM(training_set->dims.count);
+}
+
+
+
+
+static VALUE CBackpropTrainingSet_x_size(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingSet_t* training_set;
+  Data_Get_Struct(self, BackpropTrainingSet_t, training_set);
+
+  return INT2NUM(training_set->dims.x_size);
+}
+
+
+
+
+static VALUE CBackpropTrainingSet_y_size(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingSet_t* training_set;
+  Data_Get_Struct(self, BackpropTrainingSet_t, training_set);
+
+  return INT2NUM(training_set->dims.y_size);
+}
+
+
+
+
+static VALUE CBackpropTrainingSet_to_hash(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingSet_t* training_set;
+  Data_Get_Struct(self, BackpropTrainingSet_t, training_set);
+
+  const BACKPROP_SIZE_T count = training_set->dims.count;
+
+  VALUE hash = rb_hash_new();
+
+  VALUE x_array = rb_ary_new2(count);
+  VALUE y_array = rb_ary_new2(count);
+
+  for (BACKPROP_SIZE_T i = 0; i < count; ++i)
+  {
+    rb_ary_store(x_array, i, CBackpropTrainingSet_x_at(self, INT2NUM(i)));
+    rb_ary_store(y_array, i, CBackpropTrainingSet_y_at(self, INT2NUM(i)));
+  }
+
+  rb_hash_aset(hash, rb_str_new2("count"), INT2NUM(count));
+  rb_hash_aset(hash, rb_str_new2("x_size"), INT2NUM(training_set->dims.x_size));
+  rb_hash_aset(hash, rb_str_new2("y_size"), INT2NUM(training_set->dims.y_size));
+  rb_hash_aset(hash, rb_str_new2("x"), x_array);
+  rb_hash_aset(hash, rb_str_new2("y"), y_array);
+
+  return hash;
+}
+
+
+
+
+static VALUE CBackpropTrainingSet_to_file(VALUE self, VALUE file_name_val)
+{
+  BACKPROPRB_TRACE();
+
+  VALUE_TO_C_PTR(BackpropTrainingSet_t, training_set, self);
+
+  const char* file_name = StringValueCStr(file_name_val);
+
+  BackpropTrainingSet_Save(training_set, file_name);
+
+  return self;
+}
+
+
+
+
+static VALUE CBackpropTrainingSet_from_file(VALUE self, VALUE file_name_val)
+{
+  BACKPROPRB_TRACE();
+
+  VALUE_TO_C_PTR(BackpropTrainingSet_t, training_set, self);
+
+  const char* file_name = StringValueCStr(file_name_val);
+
+  BackpropTrainingSet_Load(training_set, file_name);
+
+  return self;
+}
+
+
+
+
+static VALUE CBackpropTrainingSet_initialize(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  return self;
+}
+
+
+
+
+static void CBackpropTrainingSet_free(struct BackpropTrainingSet* self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingSet_Free(self);
+}
+
+
+
+
+static VALUE CBackpropTrainingSet_new(VALUE klass, VALUE x_value, VALUE y_value)
+{
+  BACKPROPRB_TRACE();
+
+  size_t count = 0;
+  size_t x_size = 0;
+  size_t y_size = 0;
+
+  if ((x_value != Qnil) || (y_value != Qnil))
+  {
+    VALUE x_count = rb_funcall(x_value, rb_intern("size"),  0);
+    VALUE y_count = rb_funcall(y_value, rb_intern("size"),  0);
+
+    if (x_count != y_count)
+    {
+      return Qnil;
+    }
+
+    VALUE x_str_val = rb_funcall(x_value, rb_intern("at"), 1, INT2NUM(0));
+    VALUE y_str_val = rb_funcall(y_value, rb_intern("at"), 1, INT2NUM(0));
+
+    VALUE x_size_val = rb_funcall(x_str_val, rb_intern("size"), 0);
+    VALUE y_size_val = rb_funcall(y_str_val, rb_intern("size"), 0);
+
+    count = NUM2INT(x_count);
+    x_size = NUM2INT(x_size_val);
+    y_size = NUM2INT(y_size_val);
+  }
+
+  BackpropTrainingSet_t* instance = BackpropTrainingSet_Malloc(count, x_size, y_size);
+
+  // wrap it in a ruby object, this will cause GC to call free function
+  VALUE tdata = Data_Wrap_Struct(klass, 0, CBackpropTrainingSet_free, instance);
+
+  // call initialize
+  //VALUE argv[3] = {count, x_size, y_size};
+  //  rb_obj_call_init(tdata, 0, 0);
+
+  if ((x_value != Qnil) || (y_value != Qnil))
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      VALUE x_str_val = rb_funcall(x_value, rb_intern("at"), 1, INT2NUM(i));
+      char* x_str = StringValueCStr(x_str_val);
+
+      BACKPROP_BYTE_T* x = instance->x + i * x_size;
+      memcpy(x, x_str, x_size);
+    }
+
+    for (size_t j = 0; j < count; ++j)
+    {
+      VALUE y_str_val = rb_funcall(y_value, rb_intern("at"), 1, INT2NUM(j));
+      char* y_str = StringValueCStr(y_str_val);
+
+      BACKPROP_BYTE_T* y = instance->y + j * y_size;
+      memcpy(y, y_str, y_size);
+    }
+  }
+
+  return tdata;
+}
+
+
+
+
+//------------------------------------------------------------------------------
+//
+// BackpropExerciseStats
+//
+//------------------------------------------------------------------------------
+
+
+static VALUE CBackpropExerciseStats_exercise_clock_ticks(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropExerciseStats_t* stats;
+  Data_Get_Struct(self, BackpropExerciseStats_t, stats);
+
+  return INT2NUM(stats->exercise_clock_ticks);
+}
+
+
+
+
+static VALUE CBackpropExerciseStats_activate_count(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropExerciseStats_t* stats;
+  Data_Get_Struct(self, BackpropExerciseStats_t, stats);
+
+  return INT2NUM(stats->activate_count);
+}
+
+
+
+static VALUE CBackpropExerciseStats_error(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropExerciseStats_t* stats;
+  Data_Get_Struct(self, BackpropExerciseStats_t, stats);
+
+  return rb_float_new(stats->error);
+}
+
+
+
+
+static VALUE CBackpropExerciseStats_error_bound(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropExerciseStats_t* stats;
+  Data_Get_Struct(self, BackpropExerciseStats_t, stats);
+
+  return rb_float_new(stats->error_bound);
+}
+
+
+
+
+static VALUE CBackpropExerciseStats_stopped(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropExerciseStats_t* stats;
+  Data_Get_Struct(self, BackpropExerciseStats_t, stats);
+
+  return stats->stopped ? Qtrue : Qfalse;
+}
+
+
+
+
+static VALUE CBackpropExerciseStats_to_hash(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropExerciseStats_t* stats;
+  Data_Get_Struct(self, BackpropExerciseStats_t, stats);
+
+  VALUE hash = rb_hash_new();
+  rb_hash_aset(hash, rb_str_new2("exercise_clock_ticks"), CBackpropExerciseStats_exercise_clock_ticks(self));
+  rb_hash_aset(hash, rb_str_new2("activate_count"), CBackpropExerciseStats_activate_count(self));
+  rb_hash_aset(hash, rb_str_new2("error"), CBackpropExerciseStats_error(self));
+  rb_hash_aset(hash, rb_str_new2("error_bound"), CBackpropExerciseStats_error_bound(self));
+  rb_hash_aset(hash, rb_str_new2("stopped"), CBackpropExerciseStats_stopped(self));
+
+  return hash;
+}
+
+
+
+
+static VALUE CBackpropExerciseStats_new(VALUE klass)
+{
+  BACKPROPRB_TRACE();
+
+  // allocate structure
+  BackpropExerciseStats_t* instance = xmalloc(sizeof(BackpropExerciseStats_t));
+
+  // initialize structure
+  memset(instance, 0, sizeof(BackpropExerciseStats_t));
+
+  // wrap it in a ruby object, this will cause GC to call free function
+  VALUE tdata = Data_Wrap_Struct(klass, 0, xfree, instance);
+
+  // call initialize
+  rb_obj_call_init(tdata, 0, 0);
+
+  return tdata;
+}
+
+
+
+
+//------------------------------------------------------------------------------
+//
+// BackpropTrainingStats
+//
+//------------------------------------------------------------------------------
+
+
+static VALUE CBackpropTrainingStats_pair_error_correction(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingStats_t* stats;
+  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+
+  return rb_float_new(stats->pair_error_correction);
+}
+
+
+
+
+static VALUE CBackpropTrainingStats_set_weight_correction_total(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingStats_t* stats;
+  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+
+  return rb_float_new(stats->set_weight_correction_total);
+}
+
+
+
+
+static VALUE CBackpropTrainingStats_batch_weight_correction_total(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingStats_t* stats;
+  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+
+  return rb_float_new(stats->batch_weight_correction_total);
+}
+
+
+
+
+static VALUE CBackpropTrainingStats_teach_total(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingStats_t* stats;
+  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+
+  return INT2NUM(stats->teach_total);
+}
+
+
+
+
+static VALUE CBackpropTrainingStats_pair_total(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingStats_t* stats;
+  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+
+  return INT2NUM(stats->pair_total);
+}
+
+
+
+
+static VALUE CBackpropTrainingStats_set_total(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingStats_t* stats;
+  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+
+  return INT2NUM(stats->set_total);
+}
+
+
+
+
+static VALUE CBackpropTrainingStats_batches_total(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingStats_t* stats;
+  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+
+  return INT2NUM(stats->batches_total);
+}
+
+
+
+
+static VALUE CBackpropTrainingStats_stubborn_batches_total(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingStats_t* stats;
+  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+
+  return INT2NUM(stats->stubborn_batches_total);
+}
+
+
+
+
+static VALUE CBackpropTrainingStats_stagnate_batches_total(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingStats_t* stats;
+  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+
+  return INT2NUM(stats->stagnate_batches_total);
+}
+
+
+
+
+static VALUE CBackpropTrainingStats_train_clock(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingStats_t* stats;
+  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+
+  return INT2NUM(stats->train_clock);
+}
+
+
+
+
+static VALUE CBackpropTrainingStats_to_hash(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainingStats_t* stats;
+  Data_Get_Struct(self, BackpropTrainingStats_t, stats);
+
+  VALUE hash = rb_hash_new();
+  rb_hash_aset(hash, rb_str_new2("set_weight_correction_total"), CBackpropTrainingStats_set_weight_correction_total(self));
+  rb_hash_aset(hash, rb_str_new2("batch_weight_correction_total"), CBackpropTrainingStats_batch_weight_correction_total(self));
+  rb_hash_aset(hash, rb_str_new2("teach_total"), CBackpropTrainingStats_teach_total(self));
+  rb_hash_aset(hash, rb_str_new2("pair_total"), CBackpropTrainingStats_pair_total(self));
+  rb_hash_aset(hash, rb_str_new2("set_total"), CBackpropTrainingStats_set_total(self));
+  rb_hash_aset(hash, rb_str_new2("batches_total"), CBackpropTrainingStats_batches_total(self));
+  rb_hash_aset(hash, rb_str_new2("stubborn_batches_total"), CBackpropTrainingStats_stubborn_batches_total(self));
+  rb_hash_aset(hash, rb_str_new2("stagnate_batches_total"), CBackpropTrainingStats_stagnate_batches_total(self));
+  rb_hash_aset(hash, rb_str_new2("train_clock"), CBackpropTrainingStats_train_clock(self));
+
+  return hash;
+}
+
+
+
+
+static VALUE CBackpropTrainingStats_new(VALUE klass)
+{
+  BACKPROPRB_TRACE();
+
+  // allocate structure
+  BackpropTrainingStats_t* instance = xmalloc(sizeof(BackpropTrainingStats_t));
+
+  // initialize structure
+  memset(instance, 0, sizeof(BackpropTrainingStats_t));
+
+  // wrap it in a ruby object, this will cause GC to call free function
+  VALUE tdata = Data_Wrap_Struct(klass, 0, xfree, instance);
+
+  // call initialize
+  rb_obj_call_init(tdata, 0, 0);
+
+  return tdata;
+}
+
+
+
+
+//------------------------------------------------------------------------------
+//
+// BackpropTrainer
+//
+//------------------------------------------------------------------------------
+
+
+static VALUE CBackpropTrainer_teach_pair( VALUE trainer_val
+                                        , VALUE training_stats_val
+                                        , VALUE network_val
+                                        , VALUE x_val
+                                        , VALUE y_desired_val)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainer_t* trainer = NULL;
+  Data_Get_Struct(trainer_val, BackpropTrainer_t, trainer);
+
+  if (!trainer)
+  {
+    rb_raise(rb_eArgError, "NULL trainer");
+    return Qnil;
+  }
+
+  BackpropTrainingStats_t* training_stats = NULL;
+  Data_Get_Struct(training_stats_val, BackpropTrainingStats_t, training_stats);
+
+  if (!training_stats)
+  {
+    rb_raise(rb_eArgError, "NULL training_stats");
+    return Qnil;
+  }
+
+  BackpropNetwork_t* network = NULL;
+  Data_Get_Struct(network_val, BackpropNetwork_t, network);
+
+  if (!network)
+  {
+    rb_raise(rb_eArgError, "NULL network");
+    return Qnil;
+  }
+
+  char* x_str = StringValueCStr(x_val);
+
+  if (!x_str)
+  {
+    rb_raise(rb_eArgError, "NULL x");
+    return Qnil;
+  }
+
+  BACKPROP_SIZE_T x_len = strlen(x_str);
+
+  if (x_len <= 0)
+  {
+    rb_raise(rb_eArgError, "invalid x length");
+    return Qnil;
+  }
+
+  char* y_desired_str = StringValueCStr(y_desired_val);
+
+  if (!y_desired_str)
+  {
+    rb_raise(rb_eArgError, "NULL y");
+    return Qnil;
+  }
+
+  BACKPROP_SIZE_T y_desired_len = strlen(y_desired_str);
+
+  if (y_desired_len <= 0)
+  {
+    rb_raise(rb_eArgError, "invalid y length");
+    return Qnil;
+  }
+
+  BACKPROP_FLOAT_T result = BackpropTrainer_TeachPair( trainer
+                                                     , training_stats
+                                                     , network
+                                                     , x_str, x_len
+                                                     , y_desired_str, y_desired_len);
+
+  return rb_float_new(result);
+}
+
+
+
+
+static VALUE CBackpropTrainer_train_pair( VALUE trainer_val
+                                        , VALUE training_stats_val
+                                        , VALUE network_val
+                                        , VALUE x_val
+                                        , VALUE y_desired_val)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainer_t* trainer = NULL;
+  Data_Get_Struct(trainer_val, BackpropTrainer_t, trainer);
+
+  if (!trainer)
+  {
+    rb_raise(rb_eArgError, "NULL trainer");
+    return Qnil;
+  }
+
+  BackpropTrainingStats_t* training_stats = NULL;
+  Data_Get_Struct(training_stats_val, BackpropTrainingStats_t, training_stats);
+
+  if (!training_stats)
+  {
+    rb_raise(rb_eArgError, "NULL training_stats");
+    return Qnil;
+  }
+
+  BackpropNetwork_t* network = NULL;
+  Data_Get_Struct(network_val, BackpropNetwork_t, network);
+
+  if (!network)
+  {
+    rb_raise(rb_eArgError, "NULL network");
+    return Qnil;
+  }
+
+  char* x_str = StringValueCStr(x_val);
+
+  if (!x_str)
+  {
+    rb_raise(rb_eArgError, "NULL x");
+    return Qnil;
+  }
+
+  BACKPROP_SIZE_T x_len = strlen(x_str);
+
+  if (x_len <= 0)
+  {
+    rb_raise(rb_eArgError, "invalid x length");
+    return Qnil;
+  }
+
+  char* y_desired_str = StringValueCStr(y_desired_val);
+
+  if (!y_desired_str)
+  {
+    rb_raise(rb_eArgError, "NULL y");
+    return Qnil;
+  }
+
+  BACKPROP_SIZE_T y_desired_len = strlen(y_desired_str);
+
+  if (y_desired_len <= 0)
+  {
+    rb_raise(rb_eArgError, "invalid y length");
+    return Qnil;
+  }
+
+  BACKPROP_FLOAT_T result = BackpropTrainer_TrainPair( trainer
+                                                     , training_stats
+                                                     , network
+                                                     , x_str, x_len
+                                                     , y_desired_str, y_desired_len);
+
+  return rb_float_new(result);
+}
+
+
+
+
+
+
+static VALUE CBackpropTrainer_train_set( VALUE trainer_val
+                                       , VALUE training_stats_val
+                                       , VALUE network_val
+                                       , VALUE training_set_val)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainer_t* trainer = NULL;
+  Data_Get_Struct(trainer_val, BackpropTrainer_t, trainer);
+
+  if (!trainer)
+  {
+    rb_raise(rb_eArgError, "NULL trainer");
+    return Qnil;
+  }
+
+  BackpropTrainingStats_t* training_stats = NULL;
+  Data_Get_Struct(training_stats_val, BackpropTrainingStats_t, training_stats);
+
+  if (!training_stats)
+  {
+    rb_raise(rb_eArgError, "NULL training stats");
+    return Qnil;
+  }
+
+  BackpropNetwork_t* network = NULL;
+  Data_Get_Struct(network_val, BackpropNetwork_t, network);
+
+  if (!network)
+  {
+    rb_raise(rb_eArgError, "NULL network");
+    return Qnil;
+  }
+
+
+  BackpropTrainingSet_t* training_set = NULL;
+  Data_Get_Struct(training_set_val, BackpropTrainingSet_t, training_set);
+
+  if (!training_set)
+  {
+    rb_raise(rb_eArgError, "NULL training set");
+    return Qnil;
+  }
+
+  struct BackpropTrainingSession session =
+  {
+    .training_set = training_set,
+    .stats = training_stats,
+    .exercise_stats = NULL,
+  };
+
+
+  BACKPROP_FLOAT_T error = BackpropTrainer_TrainSet( trainer
+                                                   , network
+                                                   , &session);
+
+  return rb_float_new(error);
+}
+
+
+
+
+
+
+static VALUE CBackpropTrainer_train_batch( VALUE trainer_val
+                                         , VALUE training_stats_val
+                                         , VALUE exercise_stats_val
+                                         , VALUE network_val
+                                         , VALUE training_set_val)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainer_t* trainer = NULL;
+  Data_Get_Struct(trainer_val, BackpropTrainer_t, trainer);
+
+  if (!trainer)
+  {
+    rb_raise(rb_eArgError, "NULL trainer");
+    return Qnil;
+  }
+
+  BackpropTrainingStats_t* training_stats = NULL;
+  Data_Get_Struct(training_stats_val, BackpropTrainingStats_t, training_stats);
+
+  if (!training_stats)
+  {
+    rb_raise(rb_eArgError, "NULL training stats");
+    return Qnil;
+  }
+
+  BackpropExerciseStats_t* exercise_stats = NULL;
+  Data_Get_Struct(exercise_stats_val, BackpropExerciseStats_t, exercise_stats);
+
+  if (!exercise_stats)
+  {
+    rb_raise(rb_eArgError, "NULL exercise stats");
+    return Qnil;
+  }
+
+  BackpropNetwork_t* network = NULL;
+  Data_Get_Struct(network_val, BackpropNetwork_t, network);
+
+  if (!network)
+  {
+    rb_raise(rb_eArgError, "NULL network");
+    return Qnil;
+  }
+
+
+  BackpropTrainingSet_t* training_set = NULL;
+  Data_Get_Struct(training_set_val, BackpropTrainingSet_t, training_set);
+
+  if (!training_set)
+  {
+    rb_raise(rb_eArgError, "NULL training set");
+    return Qnil;
+  }
+
+  struct BackpropTrainingSession session =
+  {
+    .training_set = training_set,
+    .stats = training_stats,
+    .exercise_stats = exercise_stats,
+  };
+
+
+  BACKPROP_FLOAT_T error = BackpropTrainer_TrainBatch( trainer
+                                                     , network
+                                                     , &session);
+
+  return rb_float_new(error);
+}
+
+
+
+
+static VALUE CBackpropTrainer_train( VALUE trainer_val
+                                   , VALUE training_stats_val
+                                   , VALUE exercise_stats_val
+                                   , VALUE network_val
+                                   , VALUE training_set_val)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainer_t* trainer = NULL;
+  BackpropTrainingStats_t* training_stats = NULL;
+  BackpropExerciseStats_t* exercise_stats = NULL;
+  BackpropNetwork_t* network = NULL;
+  BackpropTrainingSet_t* training_set = NULL;
+  BACKPROP_FLOAT_T error = 0;
+
+  Data_Get_Struct(trainer_val, BackpropTrainer_t, trainer);
+  if (!trainer)
+  {
+    rb_raise(rb_eArgError, "NULL trainer");
+    return Qnil;
+  }
+
+  Data_Get_Struct(training_stats_val, BackpropTrainingStats_t, training_stats);
+  if (!training_stats)
+  {
+    rb_raise(rb_eArgError, "NULL training stats");
+    return Qnil;
+  }
+
+  Data_Get_Struct(exercise_stats_val, BackpropExerciseStats_t, exercise_stats);
+  if (!exercise_stats)
+  {
+    rb_raise(rb_eArgError, "NULL exercise stats");
+    return Qnil;
+  }
+
+  Data_Get_Struct(network_val, BackpropNetwork_t, network);
+
+  if (!network)
+  {
+    rb_raise(rb_eArgError, "NULL network");
+    return Qnil;
+  }
+
+  Data_Get_Struct(training_set_val, BackpropTrainingSet_t, training_set);
+  if (!training_set)
+  {
+    rb_raise(rb_eArgError, "NULL training set");
+    return Qnil;
+  }
+
+  struct BackpropTrainingSession session =
+  {
+    .training_set = training_set,
+    .stats = training_stats,
+    .exercise_stats = exercise_stats,
+  };
+
+  error = BackpropTrainer_Train( trainer
+                               , network
+                               , &session);
+
+  return rb_float_new(error);
+}
+
+
+
+
+static VALUE CBackpropTrainer_exercise( VALUE self_val
+                                      , VALUE stats_val
+                                      , VALUE network_val
+                                      , VALUE training_set_val)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainer_t* trainer = NULL;
+  BackpropExerciseStats_t* stats = NULL;
+  BackpropNetwork_t* network = NULL;
+  BackpropTrainingSet_t* training_set = NULL;
+  BACKPROP_FLOAT_T error = 0.0;
+
+  Data_Get_Struct(self_val, BackpropTrainer_t, trainer);
+  if (!trainer)
+  {
+    rb_raise(rb_eArgError, "NULL self");
+    return Qnil;
+  }
+
+  Data_Get_Struct(stats_val, BackpropExerciseStats_t, stats);
+  if (!stats)
+  {
+    rb_raise(rb_eArgError, "NULL stats");
+    return Qnil;
+  }
+
+  Data_Get_Struct(network_val, BackpropNetwork_t, network);
+  if (!network)
+  {
+    rb_raise(rb_eArgError, "NULL network");
+    return Qnil;
+  }
+
+  Data_Get_Struct(training_set_val, BackpropTrainingSet_t, training_set);
+  if (!training_set)
+  {
+    rb_raise(rb_eArgError, "NULL training set");
+    return Qnil;
+  }
+
+  error = BackpropTrainer_Exercise(trainer, stats, network, training_set);
+
+  return rb_float_new(error);
+}
+
+
+
+
+static VALUE CBackpropTrainer_exercise_bounded( VALUE self_val
+                                              , VALUE stats_val
+                                              , VALUE network_val
+                                              , VALUE training_set_val
+                                              , VALUE error_limit_val)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropTrainer_t* trainer = NULL;
+  BackpropExerciseStats_t* stats = NULL;
+  BackpropNetwork_t* network = NULL;
+  BackpropTrainingSet_t* training_set = NULL;
+  BACKPROP_FLOAT_T error = 0.0;
+
+  Data_Get_Struct(self_val, BackpropTrainer_t, trainer);
+  if (!trainer)
+  {
+    rb_raise(rb_eArgError, "NULL self");
+    return Qnil;
+  }
+
+  Data_Get_Struct(stats_val, BackpropExerciseStats_t, stats);
+  if (!stats)
+  {
+    rb_raise(rb_eArgError, "NULL stats");
+    return Qnil;
+  }
+
+  Data_Get_Struct(network_val, BackpropNetwork_t, network);
+  if (!network)
+  {
+    rb_raise(rb_eArgError, "NULL network");
+    return Qnil;
+  }
+
+  Data_Get_Struct(training_set_val, BackpropTrainingSet_t, training_set);
+  if (!training_set)
+  {
+    rb_raise(rb_eArgError, "NULL training set");
+    return Qnil;
+  }
+
+  error = BackpropTrainer_ExerciseBounded(trainer, stats, network, training_set, NUM2DBL(error_limit_val));
 
   return rb_float_new(error);
 }
@@ -2182,306 +3349,903 @@ static VALUE CBackpropTrainer_train( VALUE trainer_val
 
 
 
-static VALUE CBackpropTrainer_exercise( VALUE self_val
-                                      , VALUE stats_val
-                                      , VALUE network_val
-                                      , VALUE training_set_val)
+static VALUE CBackpropTrainer_get_error_tolerance(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return rb_float_new(BackpropTrainer_GetErrorTolerance(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_set_error_tolerance(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    BackpropTrainer_SetErrorTolerance(trainer, NUM2DBL(value));
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_learning_rate(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return rb_float_new(BackpropTrainer_GetLearningRate(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_mutation_rate(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return rb_float_new(BackpropTrainer_GetMutationRate(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_mutation_probability(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return rb_float_new(BackpropTrainer_GetMutationProbability(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_set_mutation_probability(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    BackpropTrainer_SetMutationProbability(trainer, NUM2DBL(value));
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_momentum_rate(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return rb_float_new(BackpropTrainer_GetMomentumRate(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_max_reps(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return INT2NUM(BackpropTrainer_GetMaxReps(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_max_batch_sets(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return INT2NUM(BackpropTrainer_GetMaxBatchSets(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_set_max_batch_sets(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    BackpropTrainer_SetMaxBatchSets(trainer, NUM2INT(value));
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_max_batches(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return INT2NUM(BackpropTrainer_GetMaxBatches(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_set_max_batches(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    BackpropTrainer_SetMaxBatches(trainer, NUM2INT(value));
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_stagnate_tolerance(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return rb_float_new(BackpropTrainer_GetStagnateTolerance(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_max_stagnate_sets(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return INT2NUM(BackpropTrainer_GetMaxStagnateSets(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_max_stagnate_batches(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return INT2NUM(BackpropTrainer_GetMaxStagnateBatches(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_min_set_weight_correction_limit(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return rb_float_new(BackpropTrainer_GetMinSetWeightCorrectionLimit(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_min_batch_weight_correction_limit(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return rb_float_new(BackpropTrainer_GetMinBatchWeightCorrectionLimit(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_batch_prune_threshold(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return rb_float_new(BackpropTrainer_GetBatchPruneThreshold(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_training_ratio(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return rb_float_new(BackpropTrainer_GetTrainingRatio(trainer));
+  }
+}
+
+
+
+
+
+static VALUE CBackpropTrainer_set_momentum_rate(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    BackpropTrainer_SetMomentumRate(trainer, NUM2DBL(value));
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_set_seed(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    BackpropRandom_Seed(BackpropTrainer_GetRandom(trainer), NUM2UINT(value));
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_random_state(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return CBackpropRandom_get_state(BackpropTrainer_GetRandom(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_set_random_state(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    CBackpropRandom_set_state(BackpropTrainer_GetRandom(trainer), value);
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_minibatch_size(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return INT2NUM(BackpropTrainer_GetMiniBatchSize(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_set_minibatch_size(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    BackpropTrainer_SetMiniBatchSize(trainer, NUM2INT(value));
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_train_thread_count(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return INT2NUM(BackpropTrainer_GetTrainThreadCount(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_set_train_thread_count(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    BackpropTrainer_SetTrainThreadCount(trainer, NUM2INT(value));
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_data_parallel(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return BackpropTrainer_GetDataParallel(trainer) ? Qtrue : Qfalse;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_set_data_parallel(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    BackpropTrainer_SetDataParallel(trainer, RTEST(value));
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_exercise_sample_count(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return INT2NUM(BackpropTrainer_GetExerciseSampleCount(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_set_exercise_sample_count(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    BackpropTrainer_SetExerciseSampleCount(trainer, NUM2INT(value));
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_exercise_thread_count(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return INT2NUM(BackpropTrainer_GetExerciseThreadCount(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_set_exercise_thread_count(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    BackpropTrainer_SetExerciseThreadCount(trainer, NUM2INT(value));
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_get_batch_prune_rate(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    return rb_float_new(BackpropTrainer_GetBatchPruneRate(trainer));
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_set_batch_prune_rate(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    BackpropTrainer_SetBatchPruneRate(trainer, NUM2DBL(value));
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_set_to_verbose_io(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    BackpropTrainer_SetToVerboseIO(trainer);
+
+    return self;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_to_hash(VALUE self)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropTrainer_t* trainer;
+    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+
+    VALUE hash = rb_hash_new();
+    rb_hash_aset(hash, rb_str_new2("error_tolerance"), CBackpropTrainer_get_error_tolerance(self));
+    rb_hash_aset(hash, rb_str_new2("learning_rate"), CBackpropTrainer_get_learning_rate(self));
+    rb_hash_aset(hash, rb_str_new2("mutation_rate"), CBackpropTrainer_get_mutation_rate(self));
+    rb_hash_aset(hash, rb_str_new2("mutation_probability"), CBackpropTrainer_get_mutation_probability(self));
+    rb_hash_aset(hash, rb_str_new2("momentum_rate"), CBackpropTrainer_get_momentum_rate(self));
+    rb_hash_aset(hash, rb_str_new2("max_reps"), CBackpropTrainer_get_max_reps(self));
+    rb_hash_aset(hash, rb_str_new2("max_batch_sets"), CBackpropTrainer_get_max_batch_sets(self));
+    rb_hash_aset(hash, rb_str_new2("max_batches"), CBackpropTrainer_get_max_batches(self));
+    rb_hash_aset(hash, rb_str_new2("stagnate_tolerance"), CBackpropTrainer_get_stagnate_tolerance(self));
+    rb_hash_aset(hash, rb_str_new2("max_stagnate_sets"), CBackpropTrainer_get_max_stagnate_sets(self));
+    rb_hash_aset(hash, rb_str_new2("max_stagnate_batches"), CBackpropTrainer_get_max_stagnate_batches(self));
+    rb_hash_aset(hash, rb_str_new2("min_set_weight_correction_limit"), CBackpropTrainer_get_min_set_weight_correction_limit(self));
+    rb_hash_aset(hash, rb_str_new2("min_batch_weight_correction_limit"), CBackpropTrainer_get_min_batch_weight_correction_limit(self));
+    rb_hash_aset(hash, rb_str_new2("batch_prune_threshold"), CBackpropTrainer_get_batch_prune_threshold(self));
+    rb_hash_aset(hash, rb_str_new2("batch_prune_rate"), CBackpropTrainer_get_batch_prune_rate(self));
+    rb_hash_aset(hash, rb_str_new2("training_ratio"), CBackpropTrainer_get_training_ratio(self));
+    rb_hash_aset(hash, rb_str_new2("minibatch_size"), CBackpropTrainer_get_minibatch_size(self));
+    rb_hash_aset(hash, rb_str_new2("train_thread_count"), CBackpropTrainer_get_train_thread_count(self));
+    rb_hash_aset(hash, rb_str_new2("data_parallel"), CBackpropTrainer_get_data_parallel(self));
+    rb_hash_aset(hash, rb_str_new2("exercise_sample_count"), CBackpropTrainer_get_exercise_sample_count(self));
+    rb_hash_aset(hash, rb_str_new2("exercise_thread_count"), CBackpropTrainer_get_exercise_thread_count(self));
+
+    return hash;
+  }
+}
+
+
+
+
+static VALUE CBackpropTrainer_initialize(VALUE self)
 {
   BACKPROPRB_TRACE();
 
-  BackpropTrainer_t* trainer = NULL;
-  BackpropExerciseStats_t* stats = NULL;
-  BackpropNetwork_t* network = NULL;
-  BackpropTrainingSet_t* training_set = NULL;
-  BACKPROP_FLOAT_T error = 0.0;
-
-  Data_Get_Struct(self_val, BackpropTrainer_t, trainer);
-  if (!trainer)
-  {
-    rb_raise(rb_eArgError, "NULL self");
-    return Qnil;
-  }
+  return self;
+}
 
-  Data_Get_Struct(stats_val, BackpropExerciseStats_t, stats);
-  if (!stats)
-  {
-    rb_raise(rb_eArgError, "NULL stats");
-    return Qnil;
-  }
 
-  Data_Get_Struct(network_val, BackpropNetwork_t, network);
-  if (!network)
-  {
-    rb_raise(rb_eArgError, "NULL network");
-    return Qnil;
-  }
 
-  Data_Get_Struct(training_set_val, BackpropTrainingSet_t, training_set);
-  if (!training_set)
-  {
-    rb_raise(rb_eArgError, "NULL training set");
-    return Qnil;
-  }
 
-  error = BackpropTrainer_Exercise(trainer, stats, network, training_set);
+static void CBackpropTrainer_Free(struct BackpropTrainer* trainer)
+{
+  BACKPROPRB_TRACE();
 
-  return rb_float_new(error);
+  BackpropTrainer_Free(trainer);
 }
 
 
 
 
-static VALUE CBackpropTrainer_get_error_tolerance(VALUE self)
+static VALUE CBackpropTrainer_new(VALUE klass, VALUE network_value)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    // get the network
+    BackpropNetwork_t* network;
+    Data_Get_Struct(network_value, BackpropNetwork_t, network);
 
-    return rb_float_new(BackpropTrainer_GetErrorTolerance(trainer));
+    // allocate a trainer
+    BackpropTrainer_t* trainer = BackpropTrainer_Malloc(network);
+
+    BackpropTrainer_SetToDefault(trainer);
+    BackpropTrainer_SetToDefaultIO(trainer);
+
+    // wrap it in a ruby object, this will cause GC to call free function
+    VALUE tdata = Data_Wrap_Struct(klass, 0, CBackpropTrainer_Free, trainer);
+
+    // call initialize
+    VALUE argv[1] = {network_value};
+    rb_obj_call_init(tdata, 1, argv);
+
+    return tdata;
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_get_learning_rate(VALUE self)
+static VALUE CBackpropTrainer_malloc_size(VALUE klass, VALUE network_value)
 {
   BACKPROPRB_TRACE();
-  {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
 
-    return rb_float_new(BackpropTrainer_GetLearningRate(trainer));
-  }
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, network_value);
+
+  return SIZET2NUM(BackpropTrainer_MallocSize(network));
 }
 
 
 
 
-static VALUE CBackpropTrainer_get_mutation_rate(VALUE self)
+static VALUE CBackpropTrainer_init(VALUE klass, VALUE buffer_val, VALUE network_value)
 {
   BACKPROPRB_TRACE();
+
+  struct CBackpropBuffer* buffer = CBackpropBuffer_get(buffer_val);
+
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, network_value);
+
+  BackpropTrainer_t* trainer = BackpropTrainer_Init(buffer->data, buffer->size, network);
+
+  if (!trainer)
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    return Qnil;
+  }
 
-    return rb_float_new(BackpropTrainer_GetMutationRate(trainer));
+  buffer->trainer = trainer;
+
+  BackpropTrainer_SetToDefault(trainer);
+  BackpropTrainer_SetToDefaultIO(trainer);
+
+  {
+    // the buffer frees the trainer, keep it alive as long as the trainer
+    VALUE tdata = Data_Wrap_Struct(klass, 0, 0, trainer);
+    rb_iv_set(tdata, "@buffer", buffer_val);
+
+    VALUE argv[1] = {network_value};
+    rb_obj_call_init(tdata, 1, argv);
+
+    return tdata;
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_get_momentum_rate(VALUE self)
+static VALUE CBackpropTrainer_detach(VALUE self)
 {
   BACKPROPRB_TRACE();
-  {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
 
-    return rb_float_new(BackpropTrainer_GetMomentumRate(trainer));
-  }
+  VALUE_TO_C_PTR(BackpropTrainer_t, trainer, self);
+
+  BackpropTrainer_Detach(trainer);
+
+  return self;
 }
 
 
 
 
-static VALUE CBackpropTrainer_get_max_reps(VALUE self)
+//------------------------------------------------------------------------------
+//
+// BackpropEvolutionStats
+//
+//------------------------------------------------------------------------------
+
+
+static VALUE CBackpropEvolutionStats_get_generation_count(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    BackpropEvolutionStats_t* stats;
+    Data_Get_Struct(self, BackpropEvolutionStats_t, stats);
 
-    return INT2NUM(BackpropTrainer_GetMaxReps(trainer));
+    return INT2NUM(stats->generation_count);
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_get_max_batch_sets(VALUE self)
+static VALUE CBackpropEvolutionStats_get_mate_networks_count(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    BackpropEvolutionStats_t* stats;
+    Data_Get_Struct(self, BackpropEvolutionStats_t, stats);
 
-    return INT2NUM(BackpropTrainer_GetMaxBatchSets(trainer));
+    return INT2NUM(stats->mate_networks_count);
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_set_max_batch_sets(VALUE self, VALUE value)
+static VALUE CBackpropEvolutionStats_get_evolve_clock(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
-
-    BackpropTrainer_SetMaxBatchSets(trainer, NUM2INT(value));
+    BackpropEvolutionStats_t* stats;
+    Data_Get_Struct(self, BackpropEvolutionStats_t, stats);
 
-    return self;
+    return INT2NUM(stats->evolve_clock);
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_get_max_batches(VALUE self)
+static VALUE CBackpropEvolutionStats_get_selection_count(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    BackpropEvolutionStats_t* stats;
+    Data_Get_Struct(self, BackpropEvolutionStats_t, stats);
 
-    return INT2NUM(BackpropTrainer_GetMaxBatches(trainer));
+    return INT2NUM(stats->selection_count);
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_set_max_batches(VALUE self, VALUE value)
+static VALUE CBackpropEvolutionStats_get_activate_count(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
-
-    BackpropTrainer_SetMaxBatches(trainer, NUM2INT(value));
+    BackpropEvolutionStats_t* stats;
+    Data_Get_Struct(self, BackpropEvolutionStats_t, stats);
 
-    return self;
+    return INT2NUM(stats->activate_count);
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_get_stagnate_tolerance(VALUE self)
+static VALUE CBackpropEvolutionStats_get_selection_clock(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    BackpropEvolutionStats_t* stats;
+    Data_Get_Struct(self, BackpropEvolutionStats_t, stats);
 
-    return rb_float_new(BackpropTrainer_GetStagnateTolerance(trainer));
+    return INT2NUM(stats->selection_clock);
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_get_max_stagnate_sets(VALUE self)
+static VALUE CBackpropEvolutionStats_to_hash(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    VALUE hash = rb_hash_new();
 
-    return INT2NUM(BackpropTrainer_GetMaxStagnateSets(trainer));
+    rb_hash_aset(hash, rb_str_new2("generation_count"), CBackpropEvolutionStats_get_generation_count(self));
+    rb_hash_aset(hash, rb_str_new2("mate_networks_count"), CBackpropEvolutionStats_get_mate_networks_count(self));
+    rb_hash_aset(hash, rb_str_new2("evolve_clock"), CBackpropEvolutionStats_get_evolve_clock(self));
+    rb_hash_aset(hash, rb_str_new2("selection_count"), CBackpropEvolutionStats_get_selection_count(self));
+    rb_hash_aset(hash, rb_str_new2("selection_clock"), CBackpropEvolutionStats_get_selection_clock(self));
+    rb_hash_aset(hash, rb_str_new2("activate_count"), CBackpropEvolutionStats_get_activate_count(self));
+
+    return hash;
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_get_max_stagnate_batches(VALUE self)
+static VALUE CBackpropEvolutionStats_new(VALUE klass)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    BackpropEvolutionStats_t* obj = xmalloc(sizeof(BackpropEvolutionStats_t));
 
-    return INT2NUM(BackpropTrainer_GetMaxStagnateBatches(trainer));
+    // wrap it in a ruby object, this will cause GC to call free function
+    VALUE tdata = Data_Wrap_Struct(klass, 0, xfree, obj);
+
+    // call initialize
+    //rb_obj_call_init(tdata, 0, 0);
+
+    return tdata;
   }
 }
 
 
 
+//------------------------------------------------------------------------------
+//
+// BackpropEvolutionStats
+//
+//------------------------------------------------------------------------------
+
 
-static VALUE CBackpropTrainer_get_min_set_weight_correction_limit(VALUE self)
+static VALUE CBackpropEvolver_get_pool_count(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    return rb_float_new(BackpropTrainer_GetMinSetWeightCorrectionLimit(trainer));
+    return INT2NUM(obj->pool_count);
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_get_min_batch_weight_correction_limit(VALUE self)
+static VALUE CBackpropEvolver_set_pool_count(VALUE self, VALUE value)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    return rb_float_new(BackpropTrainer_GetMinBatchWeightCorrectionLimit(trainer));
+    obj->pool_count = NUM2INT(value);
+
+    return self;
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_get_batch_prune_threshold(VALUE self)
+static VALUE CBackpropEvolver_get_thread_count(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    return rb_float_new(BackpropTrainer_GetBatchPruneThreshold(trainer));
+    return INT2NUM(obj->thread_count);
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_get_training_ratio(VALUE self)
+static VALUE CBackpropEvolver_set_thread_count(VALUE self, VALUE value)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    return rb_float_new(BackpropTrainer_GetTrainingRatio(trainer));
+    obj->thread_count = NUM2INT(value);
+
+    return self;
   }
 }
 
 
 
 
-
-static VALUE CBackpropTrainer_get_batch_prune_rate(VALUE self)
+static VALUE CBackpropEvolver_get_island_count(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    return rb_float_new(BackpropTrainer_GetBatchPruneRate(trainer));
+    return INT2NUM(obj->island_count);
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_set_batch_prune_rate(VALUE self, VALUE value)
+static VALUE CBackpropEvolver_set_island_count(VALUE self, VALUE value)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    BackpropTrainer_SetBatchPruneRate(trainer, NUM2DBL(value));
+    obj->island_count = NUM2INT(value);
 
     return self;
   }
@@ -2490,200 +4254,190 @@ static VALUE CBackpropTrainer_set_batch_prune_rate(VALUE self, VALUE value)
 
 
 
-static VALUE CBackpropTrainer_set_to_verbose_io(VALUE self)
+static VALUE CBackpropEvolver_get_migration_interval(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
-
-    BackpropTrainer_SetToVerboseIO(trainer);
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    return self;
+    return INT2NUM(obj->migration_interval);
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_to_hash(VALUE self)
+static VALUE CBackpropEvolver_set_migration_interval(VALUE self, VALUE value)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropTrainer_t* trainer;
-    Data_Get_Struct(self, BackpropTrainer_t, trainer);
-
-    VALUE hash = rb_hash_new();
-    rb_hash_aset(hash, rb_str_new2("error_tolerance"), CBackpropTrainer_get_error_tolerance(self));
-    rb_hash_aset(hash, rb_str_new2("learning_rate"), CBackpropTrainer_get_learning_rate(self));
-    rb_hash_aset(hash, rb_str_new2("mutation_rate"), CBackpropTrainer_get_mutation_rate(self));
-    rb_hash_aset(hash, rb_str_new2("momentum_rate"), CBackpropTrainer_get_momentum_rate(self));
-    rb_hash_aset(hash, rb_str_new2("max_reps"), CBackpropTrainer_get_max_reps(self));
-    rb_hash_aset(hash, rb_str_new2("max_batch_sets"), CBackpropTrainer_get_max_batch_sets(self));
-    rb_hash_aset(hash, rb_str_new2("max_batches"), CBackpropTrainer_get_max_batches(self));
-    rb_hash_aset(hash, rb_str_new2("stagnate_tolerance"), CBackpropTrainer_get_stagnate_tolerance(self));
-    rb_hash_aset(hash, rb_str_new2("max_stagnate_sets"), CBackpropTrainer_get_max_stagnate_sets(self));
-    rb_hash_aset(hash, rb_str_new2("max_stagnate_batches"), CBackpropTrainer_get_max_stagnate_batches(self));
-    rb_hash_aset(hash, rb_str_new2("min_set_weight_correction_limit"), CBackpropTrainer_get_min_set_weight_correction_limit(self));
-    rb_hash_aset(hash, rb_str_new2("min_batch_weight_correction_limit"), CBackpropTrainer_get_min_batch_weight_correction_limit(self));
-    rb_hash_aset(hash, rb_str_new2("batch_prune_threshold"), CBackpropTrainer_get_batch_prune_threshold(self));
-    rb_hash_aset(hash, rb_str_new2("batch_prune_rate"), CBackpropTrainer_get_batch_prune_rate(self));
-    rb_hash_aset(hash, rb_str_new2("training_ratio"), CBackpropTrainer_get_training_ratio(self));
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    return hash;
+    obj->migration_interval = NUM2INT(value);
+
+    return self;
   }
 }
 
 
 
 
-static VALUE CBackpropTrainer_initialize(VALUE self)
+static VALUE CBackpropEvolver_get_selection(VALUE self)
 {
   BACKPROPRB_TRACE();
+  {
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-  return self;
+    return rb_str_new2(BackpropEvolver_GetSelectionName(obj->selection));
+  }
 }
 
 
 
 
-static void CBackpropTrainer_Free(struct BackpropTrainer* trainer)
+static VALUE CBackpropEvolver_set_selection(VALUE self, VALUE value)
 {
   BACKPROPRB_TRACE();
+  {
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-  BackpropTrainer_Free(trainer);
+    const char* name = StringValueCStr(value);
+
+    for (int i = 0; i < BACKPROP_SELECTION_COUNT; ++i)
+    {
+      if (0 == strcmp(name, BackpropEvolver_GetSelectionName((BackpropSelection_t) i)))
+      {
+        obj->selection = (BackpropSelection_t) i;
+        return self;
+      }
+    }
+
+    rb_raise(rb_eArgError, "unknown selection %s", name);
+    return self;
+  }
 }
 
 
 
 
-static VALUE CBackpropTrainer_new(VALUE klass, VALUE network_value)
+static VALUE CBackpropEvolver_get_elite_count(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    // get the network
-    BackpropNetwork_t* network;
-    Data_Get_Struct(network_value, BackpropNetwork_t, network);
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    // allocate a trainer
-    BackpropTrainer_t* trainer = BackpropTrainer_Malloc(network);
+    return INT2NUM(obj->elite_count);
+  }
+}
 
-    BackpropTrainer_SetToDefault(trainer);
-    BackpropTrainer_SetToDefaultIO(trainer);
 
-    // wrap it in a ruby object, this will cause GC to call free function
-    VALUE tdata = Data_Wrap_Struct(klass, 0, CBackpropTrainer_Free, trainer);
 
-    // call initialize
-    VALUE argv[1] = {network_value};
-    rb_obj_call_init(tdata, 1, argv);
 
-    return tdata;
-  }
-}
+static VALUE CBackpropEvolver_set_elite_count(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
+    obj->elite_count = NUM2INT(value);
 
+    return self;
+  }
+}
 
 
-//------------------------------------------------------------------------------
-//
-// BackpropEvolutionStats
-//
-//------------------------------------------------------------------------------
 
 
-static VALUE CBackpropEvolutionStats_get_generation_count(VALUE self)
+static VALUE CBackpropEvolver_get_tournament_size(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropEvolutionStats_t* stats;
-    Data_Get_Struct(self, BackpropEvolutionStats_t, stats);
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    return INT2NUM(stats->generation_count);
+    return INT2NUM(obj->tournament_size);
   }
 }
 
 
 
 
-static VALUE CBackpropEvolutionStats_get_mate_networks_count(VALUE self)
+static VALUE CBackpropEvolver_set_tournament_size(VALUE self, VALUE value)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropEvolutionStats_t* stats;
-    Data_Get_Struct(self, BackpropEvolutionStats_t, stats);
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    return INT2NUM(stats->mate_networks_count);
+    obj->tournament_size = NUM2INT(value);
+
+    return self;
   }
 }
 
 
 
 
-static VALUE CBackpropEvolutionStats_get_evolve_clock(VALUE self)
+static VALUE CBackpropEvolver_get_cache_exercises(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropEvolutionStats_t* stats;
-    Data_Get_Struct(self, BackpropEvolutionStats_t, stats);
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    return INT2NUM(stats->evolve_clock);
+    return obj->cache_exercises ? Qtrue : Qfalse;
   }
 }
 
 
 
 
-static VALUE CBackpropEvolutionStats_to_hash(VALUE self)
+static VALUE CBackpropEvolver_set_cache_exercises(VALUE self, VALUE value)
 {
   BACKPROPRB_TRACE();
   {
-    VALUE hash = rb_hash_new();
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    rb_hash_aset(hash, rb_str_new2("generation_count"), CBackpropEvolutionStats_get_generation_count(self));
-    rb_hash_aset(hash, rb_str_new2("mate_networks_count"), CBackpropEvolutionStats_get_mate_networks_count(self));
-    rb_hash_aset(hash, rb_str_new2("evolve_clock"), CBackpropEvolutionStats_get_evolve_clock(self));
+    obj->cache_exercises = RTEST(value);
 
-    return hash;
+    return self;
   }
 }
 
 
 
 
-static VALUE CBackpropEvolutionStats_new(VALUE klass)
+static VALUE CBackpropEvolver_get_skip_unchanged(VALUE self)
 {
   BACKPROPRB_TRACE();
   {
-    BackpropEvolutionStats_t* obj = xmalloc(sizeof(BackpropEvolutionStats_t));
-
-    // wrap it in a ruby object, this will cause GC to call free function
-    VALUE tdata = Data_Wrap_Struct(klass, 0, xfree, obj);
-
-    // call initialize
-    //rb_obj_call_init(tdata, 0, 0);
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    return tdata;
+    return obj->skip_unchanged ? Qtrue : Qfalse;
   }
 }
 
 
 
-//------------------------------------------------------------------------------
-//
-// BackpropEvolutionStats
-//
-//------------------------------------------------------------------------------
-
 
-static VALUE CBackpropEvolver_get_pool_count(VALUE self)
+static VALUE CBackpropEvolver_set_skip_unchanged(VALUE self, VALUE value)
 {
   BACKPROPRB_TRACE();
   {
     BackpropEvolver_t* obj;
     Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    return INT2NUM(obj->pool_count);
+    obj->skip_unchanged = RTEST(value);
+
+    return self;
   }
 }
 
@@ -2739,7 +4493,23 @@ static VALUE CBackpropEvolver_get_seed(VALUE self)
     BackpropEvolver_t* obj;
     Data_Get_Struct(self, BackpropEvolver_t, obj);
 
-    return rb_float_new(obj->mutation_limit);
+    return UINT2NUM(obj->seed);
+  }
+}
+
+
+
+
+static VALUE CBackpropEvolver_set_seed(VALUE self, VALUE value)
+{
+  BACKPROPRB_TRACE();
+  {
+    BackpropEvolver_t* obj;
+    Data_Get_Struct(self, BackpropEvolver_t, obj);
+
+    BackpropEvolver_SetSeed(obj, NUM2UINT(value));
+
+    return self;
   }
 }
 
@@ -2753,6 +4523,14 @@ static VALUE CBackpropEvolver_to_hash(VALUE self)
     VALUE hash = rb_hash_new();
 
     rb_hash_aset(hash, rb_str_new2("pool_count"), CBackpropEvolver_get_pool_count(self));
+    rb_hash_aset(hash, rb_str_new2("thread_count"), CBackpropEvolver_get_thread_count(self));
+    rb_hash_aset(hash, rb_str_new2("island_count"), CBackpropEvolver_get_island_count(self));
+    rb_hash_aset(hash, rb_str_new2("migration_interval"), CBackpropEvolver_get_migration_interval(self));
+    rb_hash_aset(hash, rb_str_new2("selection"), CBackpropEvolver_get_selection(self));
+    rb_hash_aset(hash, rb_str_new2("elite_count"), CBackpropEvolver_get_elite_count(self));
+    rb_hash_aset(hash, rb_str_new2("tournament_size"), CBackpropEvolver_get_tournament_size(self));
+    rb_hash_aset(hash, rb_str_new2("cache_exercises"), CBackpropEvolver_get_cache_exercises(self));
+    rb_hash_aset(hash, rb_str_new2("skip_unchanged"), CBackpropEvolver_get_skip_unchanged(self));
     rb_hash_aset(hash, rb_str_new2("max_generations"), CBackpropEvolver_get_max_generations(self));
     rb_hash_aset(hash, rb_str_new2("mate_rate"), CBackpropEvolver_get_mate_rate(self));
     rb_hash_aset(hash, rb_str_new2("mutation_limit"), CBackpropEvolver_get_mutation_limit(self));
@@ -2836,6 +4614,186 @@ static VALUE CBackpropEvolver_new(VALUE klass)
 
 
 
+//------------------------------------------------------------------------------
+//
+// BackpropPopulation
+//
+//------------------------------------------------------------------------------
+
+
+static VALUE CBackpropPopulation_count(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  VALUE_TO_C_PTR(struct BackpropPopulation, population, self);
+
+  return INT2NUM(BackpropPopulation_GetCount(population));
+}
+
+
+
+
+static VALUE CBackpropPopulation_generation_count(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  VALUE_TO_C_PTR(struct BackpropPopulation, population, self);
+
+  return INT2NUM(BackpropPopulation_GetGenerationCount(population));
+}
+
+
+
+
+static VALUE CBackpropPopulation_best_index(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  VALUE_TO_C_PTR(struct BackpropPopulation, population, self);
+
+  return INT2NUM(BackpropPopulation_GetBestIndex(population));
+}
+
+
+
+
+static VALUE CBackpropPopulation_best_error(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  VALUE_TO_C_PTR(struct BackpropPopulation, population, self);
+
+  return rb_float_new(BackpropPopulation_GetBestError(population));
+}
+
+
+
+
+static VALUE CBackpropPopulation_errors(VALUE self)
+{
+  BACKPROPRB_TRACE();
+
+  VALUE_TO_C_PTR(struct BackpropPopulation, population, self);
+  {
+    const BACKPROP_SIZE_T count = BackpropPopulation_GetCount(population);
+
+    VALUE a = rb_ary_new2(count);
+
+    for (BACKPROP_SIZE_T i = 0; i < count; ++i)
+    {
+      rb_ary_push(a, rb_float_new(BackpropPopulation_GetError(population, i)));
+    }
+
+    return a;
+  }
+}
+
+
+
+
+static VALUE CBackpropPopulation_copy_best(VALUE self, VALUE network_val)
+{
+  BACKPROPRB_TRACE();
+
+  VALUE_TO_C_PTR(struct BackpropPopulation, population, self);
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, network_val);
+
+  BackpropPopulation_CopyBest(population, network);
+
+  return network_val;
+}
+
+
+
+
+static VALUE CBackpropPopulation_evolve( VALUE self
+                                       , VALUE evolver_val
+                                       , VALUE evolution_stats_val
+                                       , VALUE trainer_val
+                                       , VALUE training_stats_val
+                                       , VALUE exercise_stats_val
+                                       , VALUE training_set_val)
+{
+  BACKPROPRB_TRACE();
+  {
+    VALUE_TO_C_PTR(struct BackpropPopulation, population, self);
+    VALUE_TO_C_PTR(BackpropEvolver_t, evolver, evolver_val);
+    VALUE_TO_C_PTR(BackpropEvolutionStats_t, evolution_stats, evolution_stats_val);
+    VALUE_TO_C_PTR(BackpropTrainer_t, trainer, trainer_val);
+    VALUE_TO_C_PTR(BackpropTrainingStats_t, training_stats, training_stats_val);
+    VALUE_TO_C_PTR(BackpropExerciseStats_t, exercise_stats, exercise_stats_val);
+    VALUE_TO_C_PTR(BackpropTrainingSet_t, training_set, training_set_val);
+    {
+      BACKPROP_FLOAT_T result = BackpropPopulation_Evolve( population
+                                                         , evolver
+                                                         , evolution_stats
+                                                         , trainer
+                                                         , training_stats
+                                                         , exercise_stats
+                                                         , training_set);
+
+      return rb_float_new(result);
+    }
+  }
+}
+
+
+
+
+static VALUE CBackpropPopulation_to_file(VALUE self, VALUE file_name_val)
+{
+  BACKPROPRB_TRACE();
+
+  VALUE_TO_C_PTR(struct BackpropPopulation, population, self);
+
+  return SIZET2NUM(BackpropPopulation_Save(population, StringValueCStr(file_name_val)));
+}
+
+
+
+
+static VALUE CBackpropPopulation_from_file(VALUE self, VALUE file_name_val)
+{
+  BACKPROPRB_TRACE();
+
+  VALUE_TO_C_PTR(struct BackpropPopulation, population, self);
+
+  return SIZET2NUM(BackpropPopulation_Load(population, StringValueCStr(file_name_val)));
+}
+
+
+
+
+static void CBackpropPopulation_free(struct BackpropPopulation* population)
+{
+  BACKPROPRB_TRACE();
+
+  BackpropPopulation_Free(population);
+}
+
+
+
+
+static VALUE CBackpropPopulation_new(VALUE klass, VALUE evolver_val, VALUE network_val)
+{
+  BACKPROPRB_TRACE();
+
+  VALUE_TO_C_PTR(BackpropEvolver_t, evolver, evolver_val);
+  VALUE_TO_C_PTR(BackpropNetwork_t, network, network_val);
+
+  struct BackpropPopulation* population = BackpropPopulation_Malloc(evolver, network);
+
+  if (!population)
+  {
+    rb_raise(rb_eNoMemError, "cannot allocate population");
+  }
+
+  return Data_Wrap_Struct(klass, 0, CBackpropPopulation_free, population);
+}
+
+
+
+
 //------------------------------------------------------------------------------
 //
 // module initialization
@@ -2854,8 +4812,10 @@ void Init_backproprb()
   // Define module methods
   cBackproprb = rb_define_module("Backproprb");
   rb_define_module_function(cBackproprb, "used", CBackprop_used, 0);
-  rb_define_module_function(cBackproprb, "sigmoid", CBackprop_sigmoid, 1);
+  rb_define_module_function(cBackproprb, "sigmoid", CBackprop_sigmoid, -1);
   rb_define_module_function(cBackproprb, "uniform_random_int", CBackprop_uniform_random_int, 0);
+  rb_define_module_function(cBackproprb, "simd", CBackprop_get_simd, 0);
+  rb_define_module_function(cBackproprb, "simd=", CBackprop_set_simd, 1);
 
 
   // Define class CBackproprb::CBackpropLayer
@@ -2884,11 +4844,23 @@ void Init_backproprb()
   rb_define_method(cBackpropLayer, "to_hash", CBackpropLayer_to_hash, 0);
 
 
+  // Define class CBackproprb::Buffer
+  cBackpropBuffer = rb_define_class_under(cBackproprb, "Buffer", rb_cObject);
+  rb_define_singleton_method(cBackpropBuffer, "new", CBackpropBuffer_new, 1);
+  rb_define_method(cBackpropBuffer, "size", CBackpropBuffer_size, 0);
+  rb_define_method(cBackpropBuffer, "data", CBackpropBuffer_data, 0);
+
+
   // Define class CBackproprb::CNetwork
   cBackpropNetwork = rb_define_class_under(cBackproprb, "Network", rb_cObject);
   rb_define_singleton_method(cBackpropNetwork, "new", CBackpropNetwork_new, 1);
+  rb_define_singleton_method(cBackpropNetwork, "malloc_size", CBackpropNetwork_malloc_size, 1);
+  rb_define_singleton_method(cBackpropNetwork, "init", CBackpropNetwork_init, 2);
+  rb_define_method(cBackpropNetwork, "detach", CBackpropNetwork_detach, 0);
   rb_define_method(cBackpropNetwork, "initialize", CBackpropNetwork_initialize, 1);
+  rb_define_method(cBackpropNetwork, "clone", CBackpropNetwork_clone, 0);
   rb_define_method(cBackpropNetwork, "activate", CBackpropNetwork_activate, 1);
+  rb_define_method(cBackpropNetwork, "activate_batch", CBackpropNetwork_activate_batch, 1);
   rb_define_method(cBackpropNetwork, "x", CBackpropNetwork_get_x, 0);
   rb_define_method(cBackpropNetwork, "x_size", CBackpropNetwork_x_size, 0);
   rb_define_method(cBackpropNetwork, "y", CBackpropNetwork_get_y, 0);
@@ -2898,6 +4870,14 @@ void Init_backproprb()
 
   rb_define_method(cBackpropNetwork, "jitter", CBackpropNetwork_get_jitter, 0);
   rb_define_method(cBackpropNetwork, "jitter=", CBackpropNetwork_set_jitter, 1);
+  rb_define_method(cBackpropNetwork, "random_state", CBackpropNetwork_get_random_state, 0);
+  rb_define_method(cBackpropNetwork, "random_state=", CBackpropNetwork_set_random_state, 1);
+  rb_define_method(cBackpropNetwork, "use_input_table", CBackpropNetwork_get_use_input_table, 0);
+  rb_define_method(cBackpropNetwork, "use_input_table=", CBackpropNetwork_set_use_input_table, 1);
+  rb_define_method(cBackpropNetwork, "update_input_table", CBackpropNetwork_update_input_table, 0);
+  rb_define_method(cBackpropNetwork, "sigmoid", CBackpropNetwork_get_sigmoid, 0);
+  rb_define_method(cBackpropNetwork, "sigmoid=", CBackpropNetwork_set_sigmoid, 1);
+  rb_define_method(cBackpropNetwork, "weights_version", CBackpropNetwork_get_weights_version, 0);
   rb_define_method(cBackpropNetwork, "randomize", CBackpropNetwork_randomize, 2);
   rb_define_method(cBackpropNetwork, "identity", CBackpropNetwork_identity, 0);
   rb_define_method(cBackpropNetwork, "reset", CBackpropNetwork_reset, 0);
@@ -2933,6 +4913,42 @@ void Init_backproprb()
   rb_define_method(cBackpropNetworkStats, "to_hash", CBackpropNetworkStats_to_hash, 0);
 
 
+  // Define class CBackproprb::CInferenceModel
+  cBackpropInferenceModel = rb_define_class_under(cBackproprb, "InferenceModel", rb_cObject);
+  rb_define_singleton_method(cBackpropInferenceModel, "new", CBackpropInferenceModel_new, 1);
+  rb_define_method(cBackpropInferenceModel, "activate", CBackpropInferenceModel_activate, 1);
+  rb_define_method(cBackpropInferenceModel, "activate_batch", CBackpropInferenceModel_activate_batch, 1);
+  rb_define_method(cBackpropInferenceModel, "size", CBackpropInferenceModel_size, 0);
+
+
+  // Define class CBackproprb::SharedModel
+  cBackpropShm = rb_define_class_under(cBackproprb, "SharedModel", rb_cObject);
+  rb_define_singleton_method(cBackpropShm, "create", CBackpropShm_create, 2);
+  rb_define_singleton_method(cBackpropShm, "open", CBackpropShm_open, 1);
+  rb_define_singleton_method(cBackpropShm, "unlink", CBackpropShm_unlink, 1);
+  rb_define_method(cBackpropShm, "publish", CBackpropShm_publish, 1);
+  rb_define_method(cBackpropShm, "generation", CBackpropShm_generation, 0);
+  rb_define_method(cBackpropShm, "activate", CBackpropShm_activate, 1);
+  rb_define_method(cBackpropShm, "close", CBackpropShm_close, 0);
+
+  cBackpropPsServer = rb_define_class_under(cBackproprb, "ParameterServer", rb_cObject);
+  rb_define_singleton_method(cBackpropPsServer, "create", CBackpropPsServer_create, 2);
+  rb_define_method(cBackpropPsServer, "serve", CBackpropPsServer_serve, 2);
+  rb_define_method(cBackpropPsServer, "version", CBackpropPsServer_version, 0);
+  rb_define_method(cBackpropPsServer, "port", CBackpropPsServer_port, 0);
+  rb_define_method(cBackpropPsServer, "push_scale", CBackpropPsServer_get_push_scale, 0);
+  rb_define_method(cBackpropPsServer, "push_scale=", CBackpropPsServer_set_push_scale, 1);
+  rb_define_method(cBackpropPsServer, "close", CBackpropPsServer_close, 0);
+
+  cBackpropPsClient = rb_define_class_under(cBackproprb, "ParameterClient", rb_cObject);
+  rb_define_singleton_method(cBackpropPsClient, "connect", CBackpropPsClient_connect, 1);
+  rb_define_method(cBackpropPsClient, "pull", CBackpropPsClient_pull, 1);
+  rb_define_method(cBackpropPsClient, "push", CBackpropPsClient_push, 1);
+  rb_define_method(cBackpropPsClient, "version", CBackpropPsClient_version, 0);
+  rb_define_method(cBackpropPsClient, "train", CBackpropPsClient_train, 5);
+  rb_define_method(cBackpropPsClient, "close", CBackpropPsClient_close, 0);
+
+
   // Define class CBackproprb::CTrainingSet
   cBackpropTrainingSet = rb_define_class_under(cBackproprb, "TrainingSet", rb_cObject);
   rb_define_singleton_method(cBackpropTrainingSet, "new", CBackpropTrainingSet_new, 2);
@@ -2954,6 +4970,8 @@ void Init_backproprb()
   rb_define_method(cBackpropExerciseStats, "exercise_clock_ticks", CBackpropExerciseStats_exercise_clock_ticks, 0);
   rb_define_method(cBackpropExerciseStats, "activate_count", CBackpropExerciseStats_activate_count, 0);
   rb_define_method(cBackpropExerciseStats, "error", CBackpropExerciseStats_error, 0);
+  rb_define_method(cBackpropExerciseStats, "error_bound", CBackpropExerciseStats_error_bound, 0);
+  rb_define_method(cBackpropExerciseStats, "stopped", CBackpropExerciseStats_stopped, 0);
   rb_define_method(cBackpropExerciseStats, "to_hash", CBackpropExerciseStats_to_hash, 0);
 
 
@@ -2975,11 +4993,16 @@ void Init_backproprb()
   // Define class CBackprop::CTrainer
   cBackpropTrainer = rb_define_class_under(cBackproprb, "Trainer", rb_cObject);
   rb_define_singleton_method(cBackpropTrainer, "new", CBackpropTrainer_new, 1);
+  rb_define_singleton_method(cBackpropTrainer, "malloc_size", CBackpropTrainer_malloc_size, 1);
+  rb_define_singleton_method(cBackpropTrainer, "init", CBackpropTrainer_init, 2);
+  rb_define_method(cBackpropTrainer, "detach", CBackpropTrainer_detach, 0);
   rb_define_method(cBackpropTrainer, "initialize", CBackpropTrainer_initialize, 1);
 
   rb_define_method(cBackpropTrainer, "error_tolerance", CBackpropTrainer_get_error_tolerance, 0);
+  rb_define_method(cBackpropTrainer, "error_tolerance=", CBackpropTrainer_set_error_tolerance, 1);
   rb_define_method(cBackpropTrainer, "learning_rate", CBackpropTrainer_get_learning_rate, 0);
   rb_define_method(cBackpropTrainer, "mutation_rate", CBackpropTrainer_get_mutation_rate, 0);
+  rb_define_method(cBackpropTrainer, "mutation_probability", CBackpropTrainer_get_mutation_probability, 0);
   rb_define_method(cBackpropTrainer, "momentum_rate", CBackpropTrainer_get_momentum_rate, 0);
   rb_define_method(cBackpropTrainer, "max_reps", CBackpropTrainer_get_max_reps, 0);
   rb_define_method(cBackpropTrainer, "max_batch_sets", CBackpropTrainer_get_max_batch_sets, 0);
@@ -2992,12 +5015,28 @@ void Init_backproprb()
   rb_define_method(cBackpropTrainer, "batch_prune_threshold", CBackpropTrainer_get_batch_prune_threshold, 0);
   rb_define_method(cBackpropTrainer, "batch_prune_rate", CBackpropTrainer_get_batch_prune_rate, 0);
   rb_define_method(cBackpropTrainer, "training_ratio", CBackpropTrainer_get_training_ratio, 0);
+  rb_define_method(cBackpropTrainer, "minibatch_size", CBackpropTrainer_get_minibatch_size, 0);
+  rb_define_method(cBackpropTrainer, "train_thread_count", CBackpropTrainer_get_train_thread_count, 0);
+  rb_define_method(cBackpropTrainer, "data_parallel", CBackpropTrainer_get_data_parallel, 0);
+  rb_define_method(cBackpropTrainer, "exercise_sample_count", CBackpropTrainer_get_exercise_sample_count, 0);
+  rb_define_method(cBackpropTrainer, "exercise_thread_count", CBackpropTrainer_get_exercise_thread_count, 0);
 
   rb_define_method(cBackpropTrainer, "max_batch_sets=", CBackpropTrainer_set_max_batch_sets, 1);
   rb_define_method(cBackpropTrainer, "max_batches=", CBackpropTrainer_set_max_batches, 1);
   rb_define_method(cBackpropTrainer, "batch_prune_rate=", CBackpropTrainer_set_batch_prune_rate, 1);
+  rb_define_method(cBackpropTrainer, "mutation_probability=", CBackpropTrainer_set_mutation_probability, 1);
+  rb_define_method(cBackpropTrainer, "momentum_rate=", CBackpropTrainer_set_momentum_rate, 1);
+  rb_define_method(cBackpropTrainer, "minibatch_size=", CBackpropTrainer_set_minibatch_size, 1);
+  rb_define_method(cBackpropTrainer, "train_thread_count=", CBackpropTrainer_set_train_thread_count, 1);
+  rb_define_method(cBackpropTrainer, "data_parallel=", CBackpropTrainer_set_data_parallel, 1);
+  rb_define_method(cBackpropTrainer, "exercise_sample_count=", CBackpropTrainer_set_exercise_sample_count, 1);
+  rb_define_method(cBackpropTrainer, "exercise_thread_count=", CBackpropTrainer_set_exercise_thread_count, 1);
+  rb_define_method(cBackpropTrainer, "seed=", CBackpropTrainer_set_seed, 1);
+  rb_define_method(cBackpropTrainer, "random_state", CBackpropTrainer_get_random_state, 0);
+  rb_define_method(cBackpropTrainer, "random_state=", CBackpropTrainer_set_random_state, 1);
 
   rb_define_method(cBackpropTrainer, "exercise", CBackpropTrainer_exercise, 3);
+  rb_define_method(cBackpropTrainer, "exercise_bounded", CBackpropTrainer_exercise_bounded, 4);
   rb_define_method(cBackpropTrainer, "teach_pair", CBackpropTrainer_teach_pair, 4);
   rb_define_method(cBackpropTrainer, "train_pair", CBackpropTrainer_train_pair, 4);
   rb_define_method(cBackpropTrainer, "train_set", CBackpropTrainer_train_set, 3);
@@ -3013,18 +5052,52 @@ void Init_backproprb()
   rb_define_method(cBackpropEvolutionStats, "generation_count", CBackpropEvolutionStats_get_generation_count, 0);
   rb_define_method(cBackpropEvolutionStats, "mate_networks_count", CBackpropEvolutionStats_get_mate_networks_count, 0);
   rb_define_method(cBackpropEvolutionStats, "evolve_clock", CBackpropEvolutionStats_get_evolve_clock, 0);
+  rb_define_method(cBackpropEvolutionStats, "selection_count", CBackpropEvolutionStats_get_selection_count, 0);
+  rb_define_method(cBackpropEvolutionStats, "selection_clock", CBackpropEvolutionStats_get_selection_clock, 0);
+  rb_define_method(cBackpropEvolutionStats, "activate_count", CBackpropEvolutionStats_get_activate_count, 0);
   rb_define_method(cBackpropEvolutionStats, "to_hash", CBackpropEvolutionStats_to_hash, 0);
 
 
   cBackpropEvolver = rb_define_class_under(cBackproprb, "Evolver", rb_cObject);
   rb_define_singleton_method(cBackpropEvolver, "new", CBackpropEvolver_new, 0);
   rb_define_method(cBackpropEvolver, "pool_count", CBackpropEvolver_get_pool_count, 0);
+  rb_define_method(cBackpropEvolver, "pool_count=", CBackpropEvolver_set_pool_count, 1);
+  rb_define_method(cBackpropEvolver, "thread_count", CBackpropEvolver_get_thread_count, 0);
+  rb_define_method(cBackpropEvolver, "thread_count=", CBackpropEvolver_set_thread_count, 1);
+  rb_define_method(cBackpropEvolver, "island_count", CBackpropEvolver_get_island_count, 0);
+  rb_define_method(cBackpropEvolver, "island_count=", CBackpropEvolver_set_island_count, 1);
+  rb_define_method(cBackpropEvolver, "migration_interval", CBackpropEvolver_get_migration_interval, 0);
+  rb_define_method(cBackpropEvolver, "migration_interval=", CBackpropEvolver_set_migration_interval, 1);
+  rb_define_method(cBackpropEvolver, "selection", CBackpropEvolver_get_selection, 0);
+  rb_define_method(cBackpropEvolver, "selection=", CBackpropEvolver_set_selection, 1);
+  rb_define_method(cBackpropEvolver, "elite_count", CBackpropEvolver_get_elite_count, 0);
+  rb_define_method(cBackpropEvolver, "elite_count=", CBackpropEvolver_set_elite_count, 1);
+  rb_define_method(cBackpropEvolver, "tournament_size", CBackpropEvolver_get_tournament_size, 0);
+  rb_define_method(cBackpropEvolver, "tournament_size=", CBackpropEvolver_set_tournament_size, 1);
+  rb_define_method(cBackpropEvolver, "cache_exercises", CBackpropEvolver_get_cache_exercises, 0);
+  rb_define_method(cBackpropEvolver, "cache_exercises=", CBackpropEvolver_set_cache_exercises, 1);
+  rb_define_method(cBackpropEvolver, "skip_unchanged", CBackpropEvolver_get_skip_unchanged, 0);
+  rb_define_method(cBackpropEvolver, "skip_unchanged=", CBackpropEvolver_set_skip_unchanged, 1);
   rb_define_method(cBackpropEvolver, "max_generations", CBackpropEvolver_get_max_generations, 0);
   rb_define_method(cBackpropEvolver, "mate_rate", CBackpropEvolver_get_mate_rate, 0);
   rb_define_method(cBackpropEvolver, "mutation_limit", CBackpropEvolver_get_mutation_limit, 0);
   rb_define_method(cBackpropEvolver, "seed", CBackpropEvolver_get_seed, 0);
+  rb_define_method(cBackpropEvolver, "seed=", CBackpropEvolver_set_seed, 1);
   rb_define_method(cBackpropEvolver, "to_hash", CBackpropEvolver_to_hash, 0);
 
   rb_define_method(cBackpropEvolver, "set_to_default", CBackpropEvolver_set_to_default, 0);
   rb_define_method(cBackpropEvolver, "evolve", CBackpropEvolver_evolve, 6);
+
+
+  cBackpropPopulation = rb_define_class_under(cBackproprb, "Population", rb_cObject);
+  rb_define_singleton_method(cBackpropPopulation, "new", CBackpropPopulation_new, 2);
+  rb_define_method(cBackpropPopulation, "count", CBackpropPopulation_count, 0);
+  rb_define_method(cBackpropPopulation, "generation_count", CBackpropPopulation_generation_count, 0);
+  rb_define_method(cBackpropPopulation, "best_index", CBackpropPopulation_best_index, 0);
+  rb_define_method(cBackpropPopulation, "best_error", CBackpropPopulation_best_error, 0);
+  rb_define_method(cBackpropPopulation, "errors", CBackpropPopulation_errors, 0);
+  rb_define_method(cBackpropPopulation, "copy_best", CBackpropPopulation_copy_best, 1);
+  rb_define_method(cBackpropPopulation, "evolve", CBackpropPopulation_evolve, 6);
+  rb_define_method(cBackpropPopulation, "to_file", CBackpropPopulation_to_file, 1);
+  rb_define_method(cBackpropPopulation, "from_file", CBackpropPopulation_from_file, 1);
 }
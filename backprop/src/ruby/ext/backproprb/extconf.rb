@@ -3,5 +3,11 @@ require 'mkmf'
 
 $CFLAGS += " -std=c99"
 
+# shm_open() is in librt on older systems
+have_library('rt', 'shm_open')
+
+# BackpropTrainer_Exercise() may split a training set over threads
+have_library('pthread', 'pthread_create')
+
 # Do the work
 create_makefile('backproprb')
@@ -0,0 +1,124 @@
+# Benchmarks for backproprb module.
+#
+# Run with: ruby -I <path to backproprb.so> test/bench_backproprb.rb
+
+require 'benchmark'
+
+require 'backproprb'
+
+
+
+
+X_SIZE = (ENV['BENCH_X_SIZE'] || 16).to_i
+Y_SIZE = (ENV['BENCH_Y_SIZE'] || 2).to_i
+LAYER_COUNT = (ENV['BENCH_LAYER_COUNT'] || 3).to_i
+ROWS = (ENV['BENCH_ROWS'] || 4096).to_i
+REPS = (ENV['BENCH_REPS'] || 5).to_i
+
+
+def make_network
+  network = Backproprb::Network.new({"x_size" => X_SIZE, "y_size" => Y_SIZE, "layer_count" => LAYER_COUNT})
+  network.randomize 1, 0
+  network
+end
+
+
+def make_inputs(count, size)
+  Array.new(count) { |i| Array.new(size) { |j| (32 + (i * 31 + j * 7) % 95).chr }.join }
+end
+
+
+# Print throughput of the block for count items.
+def report(label, count)
+  seconds = Benchmark.realtime { yield }
+  printf("%-32s %12.0f /s  (%.3f s)\n", label, count / seconds, seconds)
+end
+
+
+
+
+puts "network #{X_SIZE}x#{Y_SIZE} bytes, #{LAYER_COUNT} layers, simd #{Backproprb::simd}"
+
+x = make_inputs(ROWS, X_SIZE)
+y = make_inputs(ROWS, Y_SIZE)
+
+
+puts "\nactivate_batch rows"
+
+["exact", "fast", "table"].each do |mode|
+  network = make_network
+  network.sigmoid = mode
+
+  report("  #{mode}", ROWS * REPS) do
+    REPS.times { network.activate_batch x }
+  end
+end
+
+
+puts "\nteach_pair"
+
+["exact", "fast", "table"].each do |mode|
+  network = make_network
+  network.sigmoid = mode
+
+  trainer = Backproprb::Trainer.new network
+  stats = Backproprb::TrainingStats.new
+
+  count = ROWS / 4
+
+  report("  #{mode}", count) do
+    count.times { |i| trainer.teach_pair stats, network, x[i], y[i] }
+  end
+end
+
+
+puts "\nteach_pair input table"
+
+[false, true].each do |use|
+  network = make_network
+  network.use_input_table = use
+
+  trainer = Backproprb::Trainer.new network
+  stats = Backproprb::TrainingStats.new
+
+  count = ROWS / 4
+
+  report("  use_input_table #{use}", count) do
+    count.times { |i| trainer.teach_pair stats, network, x[i], y[i] }
+  end
+end
+
+
+# 0 threads trains each pair with train_pair, which repeats it until it is within tolerance,
+# 1 or more teach each pair once on the lock-free path, so scaling is measured against 1 thread.
+puts "\ntrain_set threads"
+
+digits = ("0".."9").to_a
+alphabet = ("a".."z").to_a
+
+train_sets = {
+  "xor" => [["00", "01", "10", "11"], ["0", "1", "1", "0"]],
+  "add" => [digits.product(digits).map(&:join), digits.product(digits).map { |a, b| ((a.to_i + b.to_i) % 10).to_s }],
+  "caesar" => [alphabet, alphabet.rotate(3)]
+}
+
+thread_counts = (ENV['BENCH_THREADS'] || "0,1,2,4,8").split(",").map(&:to_i)
+sets_count = (ENV['BENCH_SETS'] || 200).to_i
+
+train_sets.each do |name, (set_x, set_y)|
+  training_set = Backproprb::TrainingSet.new set_x, set_y
+
+  thread_counts.each do |thread_count|
+    network = Backproprb::Network.new({"x_size" => set_x[0].length, "y_size" => 1, "layer_count" => LAYER_COUNT})
+    network.randomize 2, 0
+
+    trainer = Backproprb::Trainer.new network
+    trainer.train_thread_count = thread_count
+    stats = Backproprb::TrainingStats.new
+
+    seconds = Benchmark.realtime { sets_count.times { trainer.train_set stats, network, training_set } }
+
+    error = trainer.exercise Backproprb::ExerciseStats.new, network, training_set
+    printf("  %-8s %2d threads %12.0f pairs/s %12.0f teaches/s  (%.3f s, error %d)\n", name, thread_count, stats.pair_total / seconds, stats.teach_total / seconds, seconds, error)
+  end
+end
@@ -5,6 +5,7 @@ require 'test/unit'
 require 'pp'
 require 'backproprb'
 require 'json'
+require 'socket'
 
 
 
@@ -17,6 +18,21 @@ class BackproprbTestCase < Test::Unit::TestCase
     assert_equal(0.5, result)
   end
 
+  def test_sigmoid_modes
+    max_error = { "fast" => 1.8e-9, "table" => 3.0e-6 }
+
+    (-400..400).each do |i|
+      x = i / 19.0
+      exact = Backproprb::sigmoid(x, "exact")
+
+      max_error.each do |mode, error|
+        assert_in_delta exact, Backproprb::sigmoid(x, mode), error
+      end
+    end
+
+    assert_raise(ArgumentError) { Backproprb::sigmoid(0, "slow") }
+  end
+
   def test_uniform_random_int
     result1 = Backproprb::uniform_random_int
     result2 = Backproprb::uniform_random_int
@@ -24,6 +40,49 @@ class BackproprbTestCase < Test::Unit::TestCase
     assert_not_equal(result1, result2)
   end
 
+  def test_simd
+    best = Backproprb::simd
+
+    layer = Backproprb::Layer.new 37, 5
+    layer.randomize 1, 0
+    layer.x = (0...37).map { |i| (i % 7) / 7.0 - 0.5 }
+
+    Backproprb::simd = "scalar"
+    assert_equal "scalar", Backproprb::simd
+    layer.activate
+    expected = layer.y
+
+    ["sse2", "avx2", "avx512"].each do |name|
+      Backproprb::simd = name
+      layer.activate
+      layer.y.zip(expected).each { |y, e| assert_in_delta e, y, 1e-12 }
+    end
+
+    assert_raise(ArgumentError) { Backproprb::simd = "mmx" }
+  ensure
+    Backproprb::simd = best
+  end
+
+  def test_simd_random
+    best = Backproprb::simd
+
+    layers = lambda do
+      network = Backproprb::Network.new({"x_size" => 3, "y_size" => 1, "layer_count" => 2})
+      network.randomize 1, 3
+      network.to_hash["layers"]
+    end
+
+    Backproprb::simd = "scalar"
+    expected = layers.call
+
+    ["sse2", "avx2", "avx512"].each do |name|
+      Backproprb::simd = name
+      assert_equal expected, layers.call
+    end
+  ensure
+    Backproprb::simd = best
+  end
+
 end
 
 
@@ -262,6 +321,205 @@ class BackproprbNetworkTestCase < Test::Unit::TestCase
 #    puts "b : #{y.hex}"
   end
 
+  def test__activate_batch
+    @sut.randomize 2, 0
+
+    x = ("a".."z").to_a
+    y = @sut.activate_batch x
+
+    assert_equal x.length, y.length
+
+    x.each_with_index do |xi, i|
+      assert_equal @sut.activate(xi), y[i]
+    end
+  end
+
+  def test__sigmoid
+    @sut.randomize 2, 0
+
+    x = ("a".."z").to_a
+    expected = x.map { |xi| @sut.activate xi }
+
+    assert_equal "exact", @sut.sigmoid
+
+    ["fast", "table"].each do |mode|
+      @sut.sigmoid = mode
+      assert_equal mode, @sut.sigmoid
+      assert_equal expected, x.map { |xi| @sut.activate xi }
+    end
+  end
+
+  def test__sigmoid__weights_version
+    @sut.randomize 2, 0
+
+    version = @sut.weights_version
+    assert 0 < version
+
+    # the same mode leaves the exercises a training session keeps for the network valid
+    @sut.sigmoid = "exact"
+    assert_equal version, @sut.weights_version
+
+    # another mode changes the layer outputs, so a session must exercise the network again
+    ["fast", "table", "exact"].each do |mode|
+      @sut.sigmoid = mode
+      assert version < @sut.weights_version, mode
+      version = @sut.weights_version
+    end
+  end
+
+  def test__use_input_table
+    sut = Backproprb::Network.new({"x_size" => 4, "y_size" => 2, "layer_count" => 2})
+    sut.randomize 2, 0
+
+    x = ("a".."z").map { |c| c * 4 }
+    expected = x.map { |xi| sut.activate xi }
+
+    assert_equal false, sut.use_input_table
+    sut.use_input_table = true
+    assert_equal true, sut.use_input_table
+
+    assert_equal expected, x.map { |xi| sut.activate xi }
+    assert_equal true, sut.update_input_table
+    assert_equal expected, x.map { |xi| sut.activate xi }
+    assert_equal expected, sut.activate_batch(x)
+
+    # table follows weight changes
+    sut.randomize 2, 1
+    y = x.map { |xi| sut.activate xi }
+    assert_equal true, sut.update_input_table
+    assert_equal y, sut.activate_batch(x)
+    sut.use_input_table = false
+    assert_equal y, x.map { |xi| sut.activate xi }
+  end
+
+  def test__use_input_table__teach_pair
+    networks = [false, true].map do |use|
+      network = Backproprb::Network.new({"x_size" => 16, "y_size" => 2, "layer_count" => 2})
+      network.randomize 2, 0
+      network.use_input_table = use
+      network
+    end
+
+    x = ("a".."z").map { |c| c * 16 }
+    y = ("a".."z").map { |c| c * 2 }
+
+    seconds = networks.map do |network|
+      trainer = Backproprb::Trainer.new network
+      stats = Backproprb::TrainingStats.new
+
+      start = Time.now
+      200.times { |i| trainer.teach_pair stats, network, x[i % x.length], y[i % y.length] }
+      Time.now - start
+    end
+
+    # weight updates after every pair must not rebuild the table
+    (0...networks[0].layers_count).each do |i|
+      assert_equal networks[0].layer_get(i).w, networks[1].layer_get(i).w
+    end
+    assert_operator seconds[1], :<, 10 * seconds[0] + 0.5
+  end
+
+  def test__chain_layers
+    sut = Backproprb::Network.new({"x_size" => 2, "y_size" => 1, "layer_count" => 3})
+    sut.randomize 2, 0
+    sut.activate "ab"
+
+    (1...sut.layers_count).each do |i|
+      assert_equal sut.layer_get(i - 1).y, sut.layer_get(i).x
+    end
+  end
+
+  def test__clone
+    sut = Backproprb::Network.new({"x_size" => 2, "y_size" => 1, "layer_count" => 3})
+    sut.randomize 2, 0
+    sut.jitter = 0
+
+    clone = sut.clone
+
+    assert_equal sut.layers_count, clone.layers_count
+    (0...sut.layers_count).each do |i|
+      assert_equal sut.layer_get(i).w, clone.layer_get(i).w
+    end
+    assert_equal sut.activate("ab"), clone.activate("ab")
+
+    clone.randomize 1, 0
+    refute_equal sut.layer_get(0).w, clone.layer_get(0).w
+
+    (1...clone.layers_count).each do |i|
+      assert_equal clone.layer_get(i - 1).y, clone.layer_get(i).x
+    end
+  end
+
+  def test__clone__jitter
+    sut = Backproprb::Network.new({"x_size" => 1, "y_size" => 1, "layer_count" => 3})
+    sut.randomize 2, 0
+    sut.jitter = 0.5
+
+    x = ("a".."z").to_a * 4
+
+    # each clone draws its own jitter, so the clones of one network do not activate alike
+    a = sut.clone
+    b = sut.clone
+    refute_equal a.activate_batch(x), b.activate_batch(x)
+  end
+
+  def test__init
+    args = {"x_size" => 2, "y_size" => 1, "layer_count" => 3}
+    buffer = Backproprb::Buffer.new Backproprb::Network.malloc_size(args)
+
+    sut = Backproprb::Network.init buffer, args
+    assert_not_nil sut
+    assert_equal 2, sut.x_size
+    assert_equal 1, sut.y_size
+
+    expected = Backproprb::Network.new args
+    expected.randomize 2, 0
+    sut.randomize 2, 0
+    assert_equal expected.to_hash["layers"], sut.to_hash["layers"]
+
+    x = ("a".."z").map { |c| c + c.upcase }
+    assert_equal expected.activate_batch(x), sut.activate_batch(x)
+
+    # the network lives in the buffer, so its weights show up in the buffer bytes
+    w = (1..16).map { |i| i / 64.0 }
+    sut.layer_get(0).w = w
+    assert buffer.data.include?(w.pack("d*"))
+  end
+
+  def test__init__too_small
+    args = {"x_size" => 2, "y_size" => 1, "layer_count" => 3}
+    size = Backproprb::Network.malloc_size(args)
+
+    assert_nil Backproprb::Network.init(Backproprb::Buffer.new(size - 1), args)
+    assert_nil Backproprb::Network.init(Backproprb::Buffer.new(0), args)
+  end
+
+  def test__detach
+    args = {"x_size" => 2, "y_size" => 1, "layer_count" => 3}
+    buffer = Backproprb::Buffer.new Backproprb::Network.malloc_size(args)
+
+    sut = Backproprb::Network.init buffer, args
+    sut.randomize 2, 0
+    sut.activate "ab"
+
+    data = buffer.data
+    sut.detach
+    assert_equal data, buffer.data
+
+    # with a lookup table, detach frees the table but leaves the weights in place
+    w = (1..16).map { |i| i / 64.0 }
+    sut.layer_get(0).w = w
+    sut.use_input_table = true
+    sut.activate "ab"
+
+    sut.detach
+    assert_equal false, sut.use_input_table
+    assert buffer.data.include?(w.pack("d*"))
+
+    # a buffer holds one network at a time
+    assert_raise(ArgumentError) { Backproprb::Network.init buffer, args }
+  end
+
   def test__x_size
     x_size = @sut.x_size
 
@@ -362,6 +620,219 @@ end
 
 
 
+class BackproprbInferenceModelTestCase < Test::Unit::TestCase
+
+  def setup
+    @network = Backproprb::Network.new({"x_size" => 2, "y_size" => 1, "layer_count" => 3})
+    @network.randomize 2, 0
+
+    @sut = Backproprb::InferenceModel.new @network
+  end
+
+  def test__activate
+    x = ("a".."z").map { |c| c + c.upcase }
+
+    x.each do |xi|
+      assert_equal @network.activate(xi), @sut.activate(xi)
+    end
+
+    assert_equal x.map { |xi| @sut.activate xi }, @sut.activate_batch(x)
+  end
+
+  def test__frozen
+    x = ("a".."z").map { |c| c + c.upcase }
+    expected = @sut.activate_batch x
+
+    @network.randomize 2, 1
+    assert_equal expected, @sut.activate_batch(x)
+  end
+
+  def test__size
+    assert 2 * 8 * 16 * 8 < @sut.size
+  end
+
+end
+
+
+
+
+class BackproprbSharedModelTestCase < Test::Unit::TestCase
+
+  def setup
+    @name = "/backproprb_test_#{Process.pid}"
+    @network = Backproprb::Network.new({"x_size" => 2, "y_size" => 2, "layer_count" => 3})
+    @network.randomize 2, 1
+    @sut = Backproprb::SharedModel.create @name, @network
+  end
+
+  def test__activate
+    reader = Backproprb::SharedModel.open @name
+    model = Backproprb::InferenceModel.new @network
+
+    assert_equal 1, reader.generation
+    assert_equal model.activate("ab"), reader.activate("ab")
+
+    reader.close
+  end
+
+  def test__publish
+    reader = Backproprb::SharedModel.open @name
+
+    @network.randomize 2, 2
+    model = Backproprb::InferenceModel.new @network
+
+    assert @sut.publish(@network)
+    assert_equal 2, reader.generation
+    assert_equal model.activate("ab"), reader.activate("ab")
+
+    # readers are read-only, and larger networks do not fit
+    assert !reader.publish(@network)
+    assert !@sut.publish(Backproprb::Network.new({"x_size" => 4, "y_size" => 2, "layer_count" => 3}))
+
+    # smaller networks fit, but would change the layout under readers activating in place
+    assert !@sut.publish(Backproprb::Network.new({"x_size" => 1, "y_size" => 2, "layer_count" => 3}))
+    assert !@sut.publish(Backproprb::Network.new({"x_size" => 2, "y_size" => 2, "layer_count" => 2}))
+    assert_equal 2, reader.generation
+
+    # networks of the same shape only change the weights
+    other = Backproprb::Network.new({"x_size" => 2, "y_size" => 2, "layer_count" => 3})
+    other.randomize 3, 2
+    assert @sut.publish(other)
+    assert_equal 3, reader.generation
+    assert_equal Backproprb::InferenceModel.new(other).activate("ab"), reader.activate("ab")
+
+    reader.close
+  end
+
+  def test__activate__reader_process
+    @network.sigmoid = "table"
+    assert @sut.publish(@network)
+
+    x = ("a".."p").map { |c| c + c.upcase }
+    expected = Backproprb::InferenceModel.new(@network).activate_batch(x)
+    assert 1 < expected.uniq.length
+
+    # a fresh process has not built the sigmoid table yet
+    lib = File.dirname($LOADED_FEATURES.grep(/backproprb\.so$/).first)
+    script = "print Marshal.dump(Backproprb::SharedModel.open(#{@name.inspect}).then { |r| #{x.inspect}.map { |xi| r.activate xi } })"
+    output = IO.popen([RbConfig.ruby, "-W0", "-I", lib, "-rbackproprb", "-e", script], "rb") { |io| io.read }
+
+    assert $?.success?
+    assert_equal expected, Marshal.load(output)
+  end
+
+  def teardown
+    @sut.close
+    Backproprb::SharedModel.unlink @name
+  end
+
+end
+
+
+
+
+class BackproprbParameterServerTestCase < Test::Unit::TestCase
+
+  def setup
+    @network = Backproprb::Network.new({"x_size" => 1, "y_size" => 1, "layer_count" => 3})
+    @network.randomize 2, 0
+  end
+
+  def worker(address, x, rounds)
+    fork do
+      network = Backproprb::Network.new({"x_size" => 1, "y_size" => 1, "layer_count" => 3})
+      trainer = Backproprb::Trainer.new network
+      training_set = Backproprb::TrainingSet.new x, x.map { |c| c.upcase }
+
+      client = Backproprb::ParameterClient.connect address
+      taught = client.train trainer, Backproprb::TrainingStats.new, network, training_set, rounds
+      client.close
+
+      # skip finalizers, the server belongs to the parent
+      exit! taught == rounds
+    end
+  end
+
+  def train_workers(address)
+    layers = @network.to_hash["layers"]
+    error = @network.activate_batch(("a".."p").to_a).zip(("A".."P").to_a).count { |a, b| a != b }
+
+    pids = [("a".."h").to_a, ("i".."p").to_a].map { |x| worker address, x, 20 }
+
+    assert_equal 40, @sut.serve(40, 10000)
+    assert_equal 40, @sut.version
+
+    pids.each { |pid| assert Process.wait2(pid)[1].success? }
+
+    assert_not_equal layers, @network.to_hash["layers"]
+    assert error > @network.activate_batch(("a".."p").to_a).zip(("A".."P").to_a).count { |a, b| a != b }
+  end
+
+  def test__unix
+    address = "unix:/tmp/backproprb_test_#{Process.pid}.sock"
+
+    @sut = Backproprb::ParameterServer.create @network, address
+    assert_equal 0, @sut.port
+
+    train_workers address
+    @sut.close
+
+    assert !File.exist?(address.sub("unix:", ""))
+  end
+
+  def test__tcp
+    @sut = Backproprb::ParameterServer.create @network, "tcp:127.0.0.1:0"
+    assert @sut.port > 0
+
+    train_workers "tcp:127.0.0.1:#{@sut.port}"
+    @sut.close
+  end
+
+  def test__pull_push
+    address = "unix:/tmp/backproprb_test_#{Process.pid}.sock"
+    @sut = Backproprb::ParameterServer.create @network, address
+
+    pid = fork do
+      network = Backproprb::Network.new({"x_size" => 1, "y_size" => 1, "layer_count" => 3})
+      client = Backproprb::ParameterClient.connect address
+
+      # pushing needs a pull, and networks must match the served network
+      ok = !client.push(network)
+      ok &&= !client.pull(Backproprb::Network.new({"x_size" => 2, "y_size" => 1, "layer_count" => 3}))
+      ok &&= client.pull(network) && (0 == client.version) && client.push(network)
+
+      exit! ok
+    end
+
+    assert_equal 1, @sut.serve(1, 10000)
+    assert_equal 1, @sut.version
+    assert Process.wait2(pid)[1].success?
+    @sut.close
+  end
+
+  def test__stalled_client
+    address = "unix:/tmp/backproprb_test_#{Process.pid}.sock"
+    @sut = Backproprb::ParameterServer.create @network, address
+
+    # half a frame header, then nothing
+    stalled = UNIXSocket.new address.sub("unix:", "")
+    stalled.write "BPPS\x03\x00\x00\x00"
+    stalled.flush
+
+    pid = worker address, ("a".."h").to_a, 5
+
+    assert_equal 5, @sut.serve(5, 10000)
+    assert Process.wait2(pid)[1].success?
+
+    stalled.close
+    @sut.close
+  end
+
+end
+
+
+
+
 class BackproprbTrainingSetTestCase < Test::Unit::TestCase
 
   def test__new
@@ -476,6 +947,47 @@ class CBackproprbTrainerTestCase  < Test::Unit::TestCase
     @sut = Backproprb::Trainer.new @network
 
     assert_not_nil @sut.to_hash
+    assert_equal 1.0, @sut.to_hash["mutation_probability"]
+
+    @sut.mutation_probability = 0.25
+    assert_equal 0.25, @sut.mutation_probability
+  end
+
+
+  def test__init
+    x = ("a".."p").to_a
+    y = x.map { |c| c.upcase }
+
+    @training_set = Backproprb::TrainingSet.new x, y
+    @training_stats = Backproprb::TrainingStats.new
+
+    args = {"x_size"=>1, "y_size"=>1, "layer_count"=>3}
+    network_buffer = Backproprb::Buffer.new Backproprb::Network.malloc_size(args)
+    @network = Backproprb::Network.init network_buffer, args
+    @network.randomize 2, 0
+
+    expected = Backproprb::Network.new args
+    expected.randomize 2, 0
+
+    assert_nil Backproprb::Trainer.init(Backproprb::Buffer.new(Backproprb::Trainer.malloc_size(@network) - 1), @network)
+
+    buffer = Backproprb::Buffer.new Backproprb::Trainer.malloc_size(@network)
+    @sut = Backproprb::Trainer.init buffer, @network
+    @sut.momentum_rate = 0.5
+    trainer = Backproprb::Trainer.new expected
+    trainer.momentum_rate = 0.5
+
+    # network and trainer both in caller buffers train the same as allocated ones
+    data = buffer.data
+    10.times { @sut.train_set @training_stats, @network, @training_set }
+    10.times { trainer.train_set @training_stats, expected, @training_set }
+
+    assert_not_equal data, buffer.data
+    assert_equal expected.to_hash["layers"], @network.to_hash["layers"]
+
+    data = buffer.data
+    @sut.detach
+    assert_equal data, buffer.data
   end
 
 
@@ -495,6 +1007,65 @@ class CBackproprbTrainerTestCase  < Test::Unit::TestCase
   end
 
 
+  def test__exercise_thread_count
+    @network = Backproprb::Network.new({"x_size"=>2, "y_size"=>1, "layer_count"=>3})
+    @network.randomize 2, 0
+
+    x = ("aa".."zz").to_a
+    @training_set = Backproprb::TrainingSet.new x, x.map { |s| s[1] }
+    @sut = Backproprb::Trainer.new @network
+
+    expected = @sut.exercise Backproprb::ExerciseStats.new, @network, @training_set
+
+    [2, 3, 8, 1000].each do |thread_count|
+      @sut.exercise_thread_count = thread_count
+      assert_equal thread_count, @sut.exercise_thread_count
+
+      exercise_stats = Backproprb::ExerciseStats.new
+      assert_equal expected, @sut.exercise(exercise_stats, @network, @training_set)
+      assert_equal x.length, exercise_stats.activate_count
+    end
+  end
+
+
+  def test__exercise_bounded
+    @network = Backproprb::Network.new({"x_size"=>2, "y_size"=>1, "layer_count"=>3})
+    @network.randomize 2, 0
+
+    x = ("aa".."zz").to_a
+    @training_set = Backproprb::TrainingSet.new x, x.map { |s| s[1] }
+    @sut = Backproprb::Trainer.new @network
+
+    expected = @sut.exercise Backproprb::ExerciseStats.new, @network, @training_set
+    assert 0 < expected
+
+    [1, 3].each do |thread_count|
+      @sut.exercise_thread_count = thread_count
+
+      # a limit the error does not exceed exercises the whole set
+      exercise_stats = Backproprb::ExerciseStats.new
+      assert_equal expected, @sut.exercise_bounded(exercise_stats, @network, @training_set, expected)
+      assert_equal x.length, exercise_stats.activate_count
+      assert_equal false, exercise_stats.stopped
+
+      # a limit of 0 stops after the first pairs with an error
+      exercise_stats = Backproprb::ExerciseStats.new
+      error = @sut.exercise_bounded(exercise_stats, @network, @training_set, 0)
+      assert 0 < error
+      assert error <= expected
+      assert x.length > exercise_stats.activate_count
+      assert_equal true, exercise_stats.stopped
+
+      # threads stop on their shared error, not once the error of their own part exceeds the limit
+      exercise_stats = Backproprb::ExerciseStats.new
+      error = @sut.exercise_bounded(exercise_stats, @network, @training_set, expected / 2)
+      assert error > expected / 2
+      assert x.length > exercise_stats.activate_count
+      assert_equal true, exercise_stats.stopped
+    end
+  end
+
+
   def test__teach_pair
     puts "#{self.class}_#{__method__}"
     filename = "#{self.class}_#{__method__}.txt"
@@ -535,6 +1106,57 @@ class CBackproprbTrainerTestCase  < Test::Unit::TestCase
   end
 
 
+  def test__train_pair__matches_teach_pair
+    @network = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>2})
+    @network.randomize 2, 0
+    network2 = @network.clone
+
+    # mutation draws from the trainer, so each network gets a trainer with the same seed
+    @sut = Backproprb::Trainer.new @network
+    @sut.seed = 5
+    trainer2 = Backproprb::Trainer.new network2
+    trainer2.seed = 5
+
+    training_stats = Backproprb::TrainingStats.new
+    result = @sut.train_pair training_stats, @network, "a", "b"
+
+    training_stats2 = Backproprb::TrainingStats.new
+    reps = trainer2.max_reps
+    begin
+      result2 = trainer2.teach_pair training_stats2, network2, "a", "b"
+      reps -= 1
+    end while (0 < reps) && (result2 > trainer2.error_tolerance)
+
+    assert_equal result2, result
+    assert_equal training_stats2.teach_total, training_stats.teach_total
+    assert_equal network2.to_hash["layers"], @network.to_hash["layers"]
+  end
+
+
+  def test__train_pair__near_zero_mutation_probability
+    @network = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>2})
+    @network.randomize 2, 0
+    expected = @network.clone
+
+    trainer = Backproprb::Trainer.new expected
+    trainer.seed = 5
+    trainer.mutation_probability = 0.0
+    trainer.train_pair Backproprb::TrainingStats.new, expected, "a", "b"
+
+    # the gaps between mutations are far past the weight count, or infinite
+    [1e-300, Float::MIN, 5e-324].each do |p|
+      network = @network.clone
+      @sut = Backproprb::Trainer.new network
+      @sut.seed = 5
+      @sut.mutation_probability = p
+
+      @sut.train_pair Backproprb::TrainingStats.new, network, "a", "b"
+
+      assert_equal expected.to_hash["layers"], network.to_hash["layers"]
+    end
+  end
+
+
   def test__train_set
     filename = "#{self.class}_#{__method__}.txt"
 
@@ -556,6 +1178,165 @@ class CBackproprbTrainerTestCase  < Test::Unit::TestCase
   end
 
 
+  def test__train_set__minibatch
+    @network = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>3})
+    @network.randomize 2, 0
+
+    x = ("a".."p").to_a
+    y = x.map { |c| c.upcase }
+
+    @training_set = Backproprb::TrainingSet.new x, y
+    @training_stats = Backproprb::TrainingStats.new
+    @exercise_stats = Backproprb::ExerciseStats.new
+    @sut = Backproprb::Trainer.new @network
+
+    @sut.minibatch_size = 4
+    assert_equal 4, @sut.minibatch_size
+    assert_equal 4, @sut.to_hash["minibatch_size"]
+
+    error_before = @sut.exercise @exercise_stats, @network, @training_set
+
+    50.times { @sut.train_set @training_stats, @network, @training_set }
+
+    error_after = @sut.exercise @exercise_stats, @network, @training_set
+
+    assert error_after < error_before
+    assert_equal 50 * 8, @training_stats.pair_total
+    assert_equal 50 * 8, @training_stats.teach_total
+
+    # pairs within tolerance, here every pair, are not taught, as with minibatch_size 1
+    [1, 4].each do |minibatch_size|
+      @sut.minibatch_size = minibatch_size
+      @sut.error_tolerance = 9
+      assert_equal 9, @sut.error_tolerance
+
+      training_stats = Backproprb::TrainingStats.new
+      @sut.train_set training_stats, @network, @training_set
+
+      assert_equal 8, training_stats.pair_total
+      assert_equal 0, training_stats.teach_total
+    end
+  end
+
+
+  def test__random_state
+    @network = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>3})
+    @network.randomize 2, 0
+    clone = @network.clone
+
+    @training_set = Backproprb::TrainingSet.new ("a".."h").to_a, ("A".."H").to_a
+    @training_stats = Backproprb::TrainingStats.new
+    @sut = Backproprb::Trainer.new @network
+
+    @sut.seed = 5
+    state = @sut.random_state
+
+    3.times { @sut.train_set @training_stats, @network, @training_set }
+
+    # the other trainer draws from its own PRNG, so it does not disturb the replay
+    other = Backproprb::Trainer.new clone
+    other.train_set @training_stats, Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>3}), @training_set
+
+    @sut.random_state = state
+    3.times { @sut.train_set @training_stats, clone, @training_set }
+
+    assert_equal @network.to_hash["layers"], clone.to_hash["layers"]
+
+    assert_raise(ArgumentError) { @sut.random_state = "short" }
+  end
+
+
+  def test__train_set__momentum
+    x = ("a".."p").to_a
+    y = x.map { |c| c.upcase }
+
+    @training_set = Backproprb::TrainingSet.new x, y
+    @training_stats = Backproprb::TrainingStats.new
+    @exercise_stats = Backproprb::ExerciseStats.new
+
+    sets = [0.0, 0.5].map do |momentum_rate|
+      @network = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>3})
+      @network.randomize 2, 0
+
+      @sut = Backproprb::Trainer.new @network
+      assert_equal 0, @sut.momentum_rate
+
+      @sut.momentum_rate = momentum_rate
+      assert_equal momentum_rate, @sut.momentum_rate
+
+      count = 0
+      while (0 < @sut.exercise(@exercise_stats, @network, @training_set)) && (count < 200)
+        @sut.train_set @training_stats, @network, @training_set
+        count += 1
+      end
+
+      assert_equal 0, @sut.exercise(@exercise_stats, @network, @training_set)
+      count
+    end
+
+    assert sets[1] < sets[0]
+  end
+
+
+  def test__train_set__train_thread_count
+    x = ("a".."p").to_a
+    y = x.map { |c| c.upcase }
+
+    @training_set = Backproprb::TrainingSet.new x, y
+    @training_stats = Backproprb::TrainingStats.new
+    @exercise_stats = Backproprb::ExerciseStats.new
+
+    @network = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>3})
+    @network.randomize 2, 0
+    layers = @network.to_hash["layers"]
+    error = @network.activate_batch(x).zip(y).count { |a, b| a != b }
+
+    @sut = Backproprb::Trainer.new @network
+    @sut.train_thread_count = 4
+    assert_equal 4, @sut.train_thread_count
+
+    sets = 100
+    sets.times { @sut.train_set @training_stats, @network, @training_set }
+
+    # half the set is taught once per set, shared between the threads
+    assert_equal sets * x.length / 2, @training_stats.pair_total
+    assert_equal sets, @training_stats.set_total
+
+    assert_not_equal layers, @network.to_hash["layers"]
+    assert error > @network.activate_batch(x).zip(y).count { |a, b| a != b }
+  end
+
+
+  def test__train_set__data_parallel
+    x = ("!".."~").to_a
+    y = x.reverse
+
+    @training_set = Backproprb::TrainingSet.new x, y
+
+    results = [1, 2, 3, 8].map do |thread_count|
+      @training_stats = Backproprb::TrainingStats.new
+      @network = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>3})
+      @network.randomize 2, 0
+
+      @sut = Backproprb::Trainer.new @network
+      @sut.seed = 3
+      @sut.minibatch_size = 64
+      @sut.train_thread_count = thread_count
+      @sut.data_parallel = true
+      assert_equal true, @sut.data_parallel
+
+      10.times { @sut.train_set @training_stats, @network, @training_set }
+
+      assert_equal 10 * (x.length / 2), @training_stats.pair_total
+      @network.to_hash["layers"]
+    end
+
+    # the weights do not depend on the number of threads
+    assert_not_equal results.first, Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>3}).tap { |n| n.randomize 2, 0 }.to_hash["layers"]
+    results.each { |layers| assert_equal results.first, layers }
+  end
+
+
   def test__train_batch
     filename = "#{self.class}_#{__method__}.txt"
 
@@ -578,6 +1359,33 @@ class CBackproprbTrainerTestCase  < Test::Unit::TestCase
   end
 
 
+  def test__train_batch__stopped_exercise
+    x = (33..126).map(&:chr)
+    y = x.map { |c| ((c.ord - 33 + 7) % 94 + 33).chr }
+
+    @training_set = Backproprb::TrainingSet.new x, y
+    @training_stats = Backproprb::TrainingStats.new
+    @exercise_stats = Backproprb::ExerciseStats.new
+
+    @network = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>2})
+    @network.randomize 2, 0
+
+    @sut = Backproprb::Trainer.new @network
+    @sut.max_batch_sets = 1
+
+    # each set trains within tolerance, so the exercise bounded by the tolerance stops early,
+    # and the batch returns the error of the whole set anyway
+    5.times do
+      result = @sut.train_batch @training_stats, @exercise_stats, @network, @training_set
+
+      assert_equal false, @exercise_stats.stopped
+      assert_equal x.length, @exercise_stats.activate_count
+      assert_equal @sut.exercise(Backproprb::ExerciseStats.new, @network, @training_set), result
+      assert 0 < result
+    end
+  end
+
+
   def test__train
     @network = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>2})
     @network.randomize 2, 0
@@ -597,6 +1405,41 @@ class CBackproprbTrainerTestCase  < Test::Unit::TestCase
     @network.to_file filename
   end
 
+
+  def test__train__exercise_sample_count
+    x = ("a".."p").to_a
+    y = x.map { |c| c.upcase }
+
+    @training_set = Backproprb::TrainingSet.new x, y
+    @training_stats = Backproprb::TrainingStats.new
+    @exercise_stats = Backproprb::ExerciseStats.new
+
+    @network = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>3})
+    @network.randomize 2, 0
+
+    @sut = Backproprb::Trainer.new @network
+    @sut.exercise_sample_count = 4
+    assert_equal 4, @sut.exercise_sample_count
+
+    # a batch returns the error of the whole set, never the estimate of a sample
+    @sut.max_batch_sets = 1
+    3.times do
+      result = @sut.train_batch @training_stats, @exercise_stats, @network, @training_set
+
+      assert_equal @sut.exercise(Backproprb::ExerciseStats.new, @network, @training_set), result
+      assert_equal 0, @exercise_stats.error_bound
+    end
+
+    # success is only reported after the whole set is exercised
+    @sut.max_batch_sets = 255
+    result = @sut.train @training_stats, @exercise_stats, @network, @training_set
+
+    assert_equal 0, result
+    assert_equal x.length, @exercise_stats.activate_count
+    assert_equal 0, @exercise_stats.error_bound
+    assert_equal 0, @sut.exercise(@exercise_stats, @network, @training_set)
+  end
+
 end
 
 
@@ -770,6 +1613,279 @@ class CBackproprbEvolverTestCase  < Test::Unit::TestCase
   end
 
 
+  def test__evolve_xor__thread_count
+    i = ["00", "01", "10", "11"]
+    o = ["0",  "1",  "1",  "0"]
+
+    @training_set = Backproprb::TrainingSet.new i, o
+
+    results = [1, 3].map do |thread_count|
+      @network = Backproprb::Network.new({"x_size"=>2, "y_size"=>1, "layer_count"=>2})
+      @network.randomize 2, 0
+
+      @training_stats = Backproprb::TrainingStats.new
+      @exercise_stats = Backproprb::ExerciseStats.new
+      @trainer = Backproprb::Trainer.new @network
+      @evolution_stats = Backproprb::EvolutionStats.new
+      @sut = Backproprb::Evolver.new
+      @sut.set_to_default
+      @sut.pool_count = 6
+      @sut.thread_count = thread_count
+      assert_equal thread_count, @sut.thread_count
+
+      result = @sut.evolve @evolution_stats, @trainer, @training_stats, @exercise_stats, @network, @training_set
+
+      [result, @network.to_hash["layers"], @training_stats.pair_total, @evolution_stats.generation_count]
+    end
+
+    # every member trains with its own trainer, so the threads do not change the result
+    assert_equal results.first, results.last
+    assert_equal 0, results.first.first
+  end
+
+
+  def test__evolve_xor__island_count
+    i = ["00", "01", "10", "11"]
+    o = ["0",  "1",  "1",  "0"]
+
+    @training_set = Backproprb::TrainingSet.new i, o
+
+    results = 2.times.map do
+      @network = Backproprb::Network.new({"x_size"=>2, "y_size"=>1, "layer_count"=>2})
+      @network.randomize 2, 0
+
+      @training_stats = Backproprb::TrainingStats.new
+      @exercise_stats = Backproprb::ExerciseStats.new
+      @trainer = Backproprb::Trainer.new @network
+      @evolution_stats = Backproprb::EvolutionStats.new
+      @sut = Backproprb::Evolver.new
+      @sut.set_to_default
+      @sut.island_count = 3
+      @sut.migration_interval = 1
+      assert_equal 3, @sut.island_count
+      assert_equal 1, @sut.migration_interval
+
+      result = @sut.evolve @evolution_stats, @trainer, @training_stats, @exercise_stats, @network, @training_set
+
+      [result, @network.to_hash["layers"], @training_stats.pair_total]
+    end
+
+    # islands migrate between runs, in island order
+    assert_equal results.first, results.last
+    assert_equal 0, results.first.first
+    assert_equal "0", @network.activate("00")
+    assert_equal "1", @network.activate("01")
+    assert_equal "1", @network.activate("10")
+    assert_equal "0", @network.activate("11")
+  end
+
+
+  def test__evolve_xor__selection
+    i = ["00", "01", "10", "11"]
+    o = ["0",  "1",  "1",  "0"]
+
+    @training_set = Backproprb::TrainingSet.new i, o
+
+    ["tournament", "elite", "rank"].each do |selection|
+      results = [1, 3].map do |thread_count|
+        @network = Backproprb::Network.new({"x_size"=>2, "y_size"=>1, "layer_count"=>2})
+        @network.randomize 2, 0
+
+        @training_stats = Backproprb::TrainingStats.new
+        @exercise_stats = Backproprb::ExerciseStats.new
+        @trainer = Backproprb::Trainer.new @network
+        @evolution_stats = Backproprb::EvolutionStats.new
+        @sut = Backproprb::Evolver.new
+        @sut.set_to_default
+        @sut.pool_count = 32
+        @sut.thread_count = thread_count
+        @sut.selection = selection
+        @sut.elite_count = 4
+        @sut.tournament_size = 3
+        assert_equal selection, @sut.selection
+        assert_equal 4, @sut.elite_count
+        assert_equal 3, @sut.tournament_size
+
+        result = @sut.evolve @evolution_stats, @trainer, @training_stats, @exercise_stats, @network, @training_set
+
+        # the network copied out has the error returned
+        assert_equal result, @trainer.exercise(Backproprb::ExerciseStats.new, @network, @training_set)
+
+        # the elite are not mated
+        assert_equal @evolution_stats.mate_networks_count, @evolution_stats.selection_count
+        assert @evolution_stats.selection_count <= (32 - 4) * @evolution_stats.generation_count
+
+        [result, @network.to_hash["layers"].map { |l| l["w"] }, @training_stats.pair_total, @evolution_stats.selection_count]
+      end
+
+      # selection only depends on the evolver PRNG and the errors of the members, not on the threads
+      assert_equal results.first, results.last
+    end
+
+    assert_raise(ArgumentError) { @sut.selection = "roulette" }
+  end
+
+
+  def test__evolve_caesar__selection__elite_count_0
+    x = ("a".."p").to_a
+    @training_set = Backproprb::TrainingSet.new x, x.map { |c| (c.ord + 3).chr }
+
+    ["tournament", "rank"].each do |selection|
+      10.times do |seed|
+        @network = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>2})
+        @network.randomize 2, seed
+
+        @training_stats = Backproprb::TrainingStats.new
+        @exercise_stats = Backproprb::ExerciseStats.new
+        @trainer = Backproprb::Trainer.new @network
+        @evolution_stats = Backproprb::EvolutionStats.new
+        @sut = Backproprb::Evolver.new
+        @sut.set_to_default
+        @sut.pool_count = 8
+        @sut.seed = seed
+        @sut.selection = selection
+        @sut.elite_count = 0
+
+        result = @sut.evolve @evolution_stats, @trainer, @training_stats, @exercise_stats, @network, @training_set
+
+        # the best is kept out of mating even without an elite
+        assert_equal result, @trainer.exercise(Backproprb::ExerciseStats.new, @network, @training_set), "#{selection} seed #{seed}"
+        assert @evolution_stats.selection_count <= 7 * @evolution_stats.generation_count
+      end
+    end
+  end
+
+
+  def test__evolve_caesar__cache_exercises
+    x = ("a".."p").to_a
+    @training_set = Backproprb::TrainingSet.new x, x.map { |c| (c.ord + 3).chr }
+
+    ["best", "elite"].each do |selection|
+      [false, true].each do |skip_unchanged|
+        results = [true, false].map do |cache_exercises|
+          @network = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>2})
+          @network.randomize 2, 0
+
+          @training_stats = Backproprb::TrainingStats.new
+          @exercise_stats = Backproprb::ExerciseStats.new
+          @trainer = Backproprb::Trainer.new @network
+          @trainer.max_batch_sets = 1
+          @evolution_stats = Backproprb::EvolutionStats.new
+          @sut = Backproprb::Evolver.new
+          @sut.set_to_default
+          assert_equal true, @sut.cache_exercises
+          assert_equal false, @sut.skip_unchanged
+          @sut.pool_count = 8
+          @sut.selection = selection
+          @sut.elite_count = 3
+          @sut.cache_exercises = cache_exercises
+          @sut.skip_unchanged = skip_unchanged
+          assert_equal cache_exercises, @sut.cache_exercises
+          assert_equal skip_unchanged, @sut.skip_unchanged
+
+          result = @sut.evolve @evolution_stats, @trainer, @training_stats, @exercise_stats, @network, @training_set
+          assert @evolution_stats.generation_count > 1
+
+          # every member but the first trains each generation, unless it is left unchanged and skipped
+          if skip_unchanged
+            assert @training_stats.batches_total < 7 * @evolution_stats.generation_count
+          else
+            assert @training_stats.batches_total >= 7 * @evolution_stats.generation_count
+          end
+
+          [result, @network.to_hash["layers"].map { |l| l["w"] }, @evolution_stats.generation_count, @evolution_stats.activate_count.fdiv(@evolution_stats.generation_count)]
+        end
+
+        cached, uncached = results
+        message = "#{selection} skip_unchanged #{skip_unchanged}"
+
+        # the cache only saves exercises of members left unchanged, it does not change the evolution
+        assert_equal cached[0..2], uncached[0..2], message
+        assert cached[3] <= uncached[3], message
+
+        # members only exercised are exercised again each generation without the cache
+        if skip_unchanged
+          assert cached[3] < uncached[3], "#{message}: #{cached[3]} >= #{uncached[3]} activations per generation"
+        end
+      end
+    end
+  end
+
+
+  def test__population
+    filename = "#{self.class}_#{__method__}.bin"
+
+    x = ("a".."p").to_a
+    y = x.map { |c| c.upcase }
+
+    @training_set = Backproprb::TrainingSet.new x, y
+    @network = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>2})
+    @network.randomize 2, 0
+
+    @evolution_stats = Backproprb::EvolutionStats.new
+    @sut = Backproprb::Evolver.new
+    @sut.set_to_default
+
+    ["best", "tournament"].each do |selection|
+      @sut.selection = selection
+
+      population = Backproprb::Population.new @sut, @network
+      assert_equal @sut.pool_count, population.count
+      assert_equal 0, population.generation_count
+      assert_equal Float::INFINITY, population.best_error
+      assert_equal [Float::INFINITY] * population.count, population.errors
+
+      evolve = lambda do |p|
+        # train little per generation, so each evolution runs all of its generations
+        trainer = Backproprb::Trainer.new(@network)
+        trainer.max_batch_sets = 1
+        p.evolve @sut, @evolution_stats, trainer, Backproprb::TrainingStats.new, Backproprb::ExerciseStats.new, @training_set
+      end
+
+      evolve.call population
+      generations = population.generation_count
+      best_error = population.best_error
+      errors = population.errors
+      assert generations > 0
+      assert best_error < Float::INFINITY
+      assert population.to_file(filename) > 0
+
+      # the population resumes from where it stopped
+      evolve.call population
+      assert @evolution_stats.generation_count > 0
+      assert_equal generations + @evolution_stats.generation_count, population.generation_count
+
+      # the selection and mating draws are saved with the population, not taken from the evolver
+      other_evolver = Backproprb::Evolver.new
+      other_evolver.set_to_default
+      other_evolver.seed = 99
+      other_evolver.selection = selection
+
+      loaded = Backproprb::Population.new other_evolver, Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>2})
+      assert loaded.from_file(filename) > 0
+      assert_equal generations, loaded.generation_count
+      assert_equal best_error, loaded.best_error
+      assert_equal errors, loaded.errors
+
+      # a loaded population evolves on as the saved one did
+      evolve.call loaded
+      assert_equal population.generation_count, loaded.generation_count
+      assert_equal population.best_index, loaded.best_index
+      assert_equal population.best_error, loaded.best_error
+
+      a = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>2})
+      b = Backproprb::Network.new({"x_size"=>1, "y_size"=>1, "layer_count"=>2})
+      assert_equal population.copy_best(a).to_hash["layers"].map { |l| l["w"] }, loaded.copy_best(b).to_hash["layers"].map { |l| l["w"] }
+    end
+
+    # populations of other shapes do not load
+    other = Backproprb::Population.new @sut, Backproprb::Network.new({"x_size"=>2, "y_size"=>1, "layer_count"=>2})
+    assert_equal 0, other.from_file(filename)
+
+    File.delete filename
+  end
+
+
   # Warning this test may take awhile...
   #def test__evolve_tictactoe
   #  filename = "#{self.class}_#{__method__}.txt"